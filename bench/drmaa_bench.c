@@ -0,0 +1,655 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * drmaa_bench - end-to-end throughput and latency of DRMAA API
+ * calls against stand-in libslurm (slurm_drmaa/test/slurm_stub.h).
+ *
+ * Usage: drmaa_bench [-t THREADS] [-n JOBS_PER_THREAD] [-k BULK_TASKS]
+ *                    [-p PS_CALLS_PER_THREAD] [-w WAIT_BATCH]
+ *                    [-s SCENARIO,...] [-o FILE]
+ *
+ * Scenarios (all by default):
+ *   run          THREADS threads submitting JOBS_PER_THREAD jobs each
+ *                with drmaa_run_job()
+ *   bulk         one drmaa_run_bulk_jobs() of BULK_TASKS tasks
+ *   wait_any     reaping BULK_TASKS jobs with drmaa_wait(ANY)
+ *   wait_any_n   reaping BULK_TASKS jobs with drmaa_wait_any_n()
+ *                of up to WAIT_BATCH jobs per call
+ *   synchronize  drmaa_synchronize(ALL) of BULK_TASKS jobs
+ *   job_ps       THREADS threads querying states of BULK_TASKS running
+ *                jobs with drmaa_job_ps() PS_CALLS_PER_THREAD times each
+ *   control      drmaa_control(ALL, TERMINATE) of BULK_TASKS running jobs
+ *
+ * For every scenario one line of JSON is written with number of jobs
+ * and measured calls (ops), elapsed time, jobs and ops per second,
+ * latency percentiles of measured calls, RPCs sent to (stand-in)
+ * slurmctld per job, peak resident set size of process and time spent
+ * waiting for contended session and DRM connection locks.
+ *
+ * Stand-in slurmctld is configured with SLURM_STUB_* environment
+ * variables (e.g. SLURM_STUB_LATENCY_US to simulate RPC round trip).
+ * Library configuration may be given with SLURM_DRMAA_CONF (otherwise
+ * one with pool_delay of 1 second is used).
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include <drmaa_utils/drmaa.h>
+
+#include "slurm_stub.h"
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+#define BENCH_LONG_RUN_MS 3600000 /* jobs which stay running */
+
+typedef struct {
+	double *values; /* microseconds */
+	size_t n;
+	size_t capacity;
+} bench_samples_t;
+
+typedef struct {
+	const char *scenario;
+	unsigned threads;
+	unsigned long jobs;
+	bench_samples_t latency;
+	/* measured */
+	double start;
+	double seconds;
+	unsigned long rpcs;
+	unsigned long long session_lock_wait_us;
+	unsigned long long drm_lock_wait_us;
+} bench_result_t;
+
+typedef struct {
+	pthread_t thread;
+	unsigned index;
+	unsigned n;
+	const char **job_ids;
+	unsigned n_job_ids;
+	bench_samples_t latency;
+} bench_worker_t;
+
+static unsigned n_threads = 8;
+static unsigned jobs_per_thread = 100;
+static unsigned bulk_tasks = 1000;
+static unsigned ps_calls_per_thread = 1000;
+static unsigned wait_batch = 256;
+static FILE *output = NULL;
+
+
+static double
+now_us( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+
+static void
+check( int rc, const char *call, const char *diagnosis )
+{
+	if( rc != DRMAA_ERRNO_SUCCESS )
+	 {
+		fprintf( stderr, "%s: %s: %s\n", call, drmaa_strerror( rc ), diagnosis );
+		exit( 1 );
+	 }
+}
+
+
+static void
+samples_add( bench_samples_t *samples, double value )
+{
+	if( samples->n == samples->capacity )
+	 {
+		samples->capacity = samples->capacity ? 2 * samples->capacity : 1024;
+		samples->values = realloc( samples->values, samples->capacity * sizeof(double) );
+		assert( samples->values != NULL );
+	 }
+	samples->values[ samples->n++ ] = value;
+}
+
+
+static void
+samples_merge( bench_samples_t *samples, const bench_samples_t *other )
+{
+	size_t i;
+	for( i = 0;  i < other->n;  i++ )
+		samples_add( samples, other->values[i] );
+}
+
+
+static int
+compare_doubles( const void *a, const void *b )
+{
+	double x = *(const double*)a, y = *(const double*)b;
+	return x < y ? -1 : x > y;
+}
+
+
+/* Percentile of sorted samples (nearest rank). */
+static double
+percentile( const bench_samples_t *samples, double p )
+{
+	size_t rank;
+	if( samples->n == 0 )
+		return 0;
+	rank = (size_t)(p / 100.0 * samples->n + 0.999999);
+	if( rank < 1 )
+		rank = 1;
+	if( rank > samples->n )
+		rank = samples->n;
+	return samples->values[ rank - 1 ];
+}
+
+
+static drmaa_job_template_t *
+new_template( void )
+{
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	drmaa_job_template_t *jt = NULL;
+
+	check( drmaa_allocate_job_template( &jt, diagnosis, sizeof(diagnosis) ),
+			"drmaa_allocate_job_template", diagnosis );
+	check( drmaa_set_attribute( jt, DRMAA_REMOTE_COMMAND, "/bin/true",
+				diagnosis, sizeof(diagnosis) ), "drmaa_set_attribute", diagnosis );
+	check( drmaa_set_attribute( jt, DRMAA_JOB_NAME, "drmaa_bench",
+				diagnosis, sizeof(diagnosis) ), "drmaa_set_attribute", diagnosis );
+	return jt;
+}
+
+
+/*
+ * Submits bulk_tasks jobs.  When @a ids is given stores their identifiers
+ * (NULL terminated) and returns how many (it may be less than bulk_tasks).
+ */
+static unsigned
+submit_bulk( char ***ids )
+{
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	drmaa_job_template_t *jt = new_template();
+	drmaa_job_ids_t *job_ids = NULL;
+	unsigned n = 0;
+
+	check( drmaa_run_bulk_jobs( &job_ids, jt, 1, bulk_tasks, 1, diagnosis, sizeof(diagnosis) ),
+			"drmaa_run_bulk_jobs", diagnosis );
+	if( ids != NULL )
+	 {
+		*ids = calloc( bulk_tasks + 1, sizeof(char*) );
+		assert( *ids != NULL );
+		while( n < bulk_tasks
+				&&  drmaa_get_next_job_id( job_ids, job_id, sizeof(job_id) ) == DRMAA_ERRNO_SUCCESS )
+			(*ids)[n++] = strdup( job_id );
+	 }
+	drmaa_release_job_ids( job_ids );
+	drmaa_delete_job_template( jt, NULL, 0 );
+	return n;
+}
+
+
+static void
+free_ids( char **ids )
+{
+	char **i;
+	for( i = ids;  *i;  i++ )
+		free( *i );
+	free( ids );
+}
+
+
+/* Terminates and disposes all jobs of session (not measured). */
+static void
+cleanup( void )
+{
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	const char *all[] = { DRMAA_JOB_IDS_SESSION_ALL, NULL };
+	drmaa_control( DRMAA_JOB_IDS_SESSION_ALL, DRMAA_CONTROL_TERMINATE, NULL, 0 );
+	check( drmaa_synchronize( all, DRMAA_TIMEOUT_WAIT_FOREVER, 1, diagnosis, sizeof(diagnosis) ),
+			"drmaa_synchronize", diagnosis );
+}
+
+
+static void
+set_run_ms( unsigned run_ms )
+{
+	slurm_stub_config_t config;
+	slurm_stub_get_config( &config );
+	config.run_ms = run_ms;
+	slurm_stub_set_config( &config );
+}
+
+
+static unsigned long long
+metric_sum( const char *metrics, const char *name )
+{
+	char key[128];
+	const char *line;
+	snprintf( key, sizeof(key), "drmaa_%s_sum ", name );
+	line = strstr( metrics, key );
+	return line != NULL ? strtoull( line + strlen(key), NULL, 10 ) : 0;
+}
+
+
+static void
+begin( bench_result_t *result, const char *scenario, unsigned threads )
+{
+	memset( result, 0, sizeof(bench_result_t) );
+	result->scenario = scenario;
+	result->threads = threads;
+	drmaa_reset_metrics( NULL, 0 );
+	result->rpcs = slurm_stub_calls( NULL );
+	result->start = now_us();
+}
+
+
+static void
+end( bench_result_t *result )
+{
+	static char metrics[0x10000];
+	result->seconds = (now_us() - result->start) / 1e6;
+	result->rpcs = slurm_stub_calls( NULL ) - result->rpcs;
+	if( drmaa_get_metrics( DRMAA_METRICS_PROMETHEUS, metrics, sizeof(metrics), NULL, 0 )
+			== DRMAA_ERRNO_SUCCESS )
+	 {
+		result->session_lock_wait_us = metric_sum( metrics, "session_lock_wait_us" );
+		result->drm_lock_wait_us = metric_sum( metrics, "drm_lock_wait_us" );
+	 }
+}
+
+
+static void
+report( bench_result_t *result )
+{
+	bench_samples_t *latency = &result->latency;
+	slurm_stub_config_t config;
+	struct rusage usage;
+	double seconds = result->seconds > 0 ? result->seconds : 1e-9;
+
+	slurm_stub_get_config( &config );
+	getrusage( RUSAGE_SELF, &usage );
+	qsort( latency->values, latency->n, sizeof(double), compare_doubles );
+
+	fprintf( output, "{\"scenario\": \"%s\", \"threads\": %u, \"jobs\": %lu, \"ops\": %lu, "
+			"\"seconds\": %.6f, \"jobs_per_s\": %.1f, \"ops_per_s\": %.1f, "
+			"\"latency_us\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}, "
+			"\"rpcs\": %lu, \"rpcs_per_job\": %.3f, \"peak_rss_kb\": %ld, "
+			"\"session_lock_wait_us\": %llu, \"drm_lock_wait_us\": %llu, "
+			"\"stub_latency_us\": %u}\n",
+			result->scenario, result->threads, result->jobs, (unsigned long)latency->n,
+			result->seconds, result->jobs / seconds, latency->n / seconds,
+			percentile( latency, 50 ), percentile( latency, 90 ),
+			percentile( latency, 99 ), percentile( latency, 100 ),
+			result->rpcs, result->jobs ? (double)result->rpcs / result->jobs : 0.0,
+			usage.ru_maxrss,
+			result->session_lock_wait_us, result->drm_lock_wait_us,
+			config.latency_us );
+	fflush( output );
+	free( latency->values );
+}
+
+
+static void
+run_workers( bench_result_t *result, void *(*worker)( void* ),
+		const char **job_ids, unsigned n_job_ids, unsigned n )
+{
+	bench_worker_t *workers = calloc( n_threads, sizeof(bench_worker_t) );
+	unsigned i;
+
+	assert( workers != NULL );
+	begin( result, result->scenario, n_threads );
+	for( i = 0;  i < n_threads;  i++ )
+	 {
+		workers[i].index = i;
+		workers[i].n = n;
+		workers[i].job_ids = job_ids;
+		workers[i].n_job_ids = n_job_ids;
+		if( pthread_create( &workers[i].thread, NULL, worker, &workers[i] ) != 0 )
+		 {
+			perror( "pthread_create" );
+			exit( 1 );
+		 }
+	 }
+	for( i = 0;  i < n_threads;  i++ )
+	 {
+		pthread_join( workers[i].thread, NULL );
+		samples_merge( &result->latency, &workers[i].latency );
+		free( workers[i].latency.values );
+	 }
+	end( result );
+	free( workers );
+}
+
+
+static void *
+run_worker( void *arg )
+{
+	bench_worker_t *self = (bench_worker_t*)arg;
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	drmaa_job_template_t *jt = new_template();
+	unsigned i;
+
+	for( i = 0;  i < self->n;  i++ )
+	 {
+		double start = now_us();
+		check( drmaa_run_job( job_id, sizeof(job_id), jt, diagnosis, sizeof(diagnosis) ),
+				"drmaa_run_job", diagnosis );
+		samples_add( &self->latency, now_us() - start );
+	 }
+	drmaa_delete_job_template( jt, NULL, 0 );
+	return NULL;
+}
+
+
+static void *
+job_ps_worker( void *arg )
+{
+	bench_worker_t *self = (bench_worker_t*)arg;
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	unsigned seed = self->index + 1;
+	unsigned i;
+
+	for( i = 0;  i < self->n;  i++ )
+	 {
+		const char *job_id = self->job_ids[ rand_r( &seed ) % self->n_job_ids ];
+		int state;
+		double start = now_us();
+		check( drmaa_job_ps( job_id, &state, diagnosis, sizeof(diagnosis) ),
+				"drmaa_job_ps", diagnosis );
+		samples_add( &self->latency, now_us() - start );
+	 }
+	return NULL;
+}
+
+
+static void
+scenario_run( void )
+{
+	bench_result_t result;
+	memset( &result, 0, sizeof(result) );
+	result.scenario = "run";
+	run_workers( &result, run_worker, NULL, 0, jobs_per_thread );
+	result.jobs = (unsigned long)n_threads * jobs_per_thread;
+	report( &result );
+	cleanup();
+}
+
+
+static void
+scenario_bulk( void )
+{
+	bench_result_t result;
+	begin( &result, "bulk", 1 );
+	submit_bulk( NULL );
+	samples_add( &result.latency, now_us() - result.start );
+	end( &result );
+	result.jobs = bulk_tasks;
+	report( &result );
+	cleanup();
+}
+
+
+static void
+scenario_wait_any( void )
+{
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	bench_result_t result;
+	unsigned i;
+
+	submit_bulk( NULL );
+	begin( &result, "wait_any", 1 );
+	for( i = 0;  i < bulk_tasks;  i++ )
+	 {
+		int stat;
+		double start = now_us();
+		check( drmaa_wait( DRMAA_JOB_IDS_SESSION_ANY, job_id, sizeof(job_id), &stat,
+					DRMAA_TIMEOUT_WAIT_FOREVER, NULL, diagnosis, sizeof(diagnosis) ),
+				"drmaa_wait", diagnosis );
+		samples_add( &result.latency, now_us() - start );
+	 }
+	end( &result );
+	result.jobs = bulk_tasks;
+	report( &result );
+}
+
+
+static void
+scenario_wait_any_n( void )
+{
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	int *stats = calloc( wait_batch, sizeof(int) );
+	bench_result_t result;
+	unsigned long reaped = 0;
+
+	assert( stats != NULL );
+	submit_bulk( NULL );
+	begin( &result, "wait_any_n", 1 );
+	while( reaped < bulk_tasks )
+	 {
+		drmaa_job_ids_t *job_ids = NULL;
+		size_t n = 0;
+		double start = now_us();
+		check( drmaa_wait_any_n( wait_batch, DRMAA_TIMEOUT_WAIT_FOREVER,
+					&job_ids, stats, NULL, &n, diagnosis, sizeof(diagnosis) ),
+				"drmaa_wait_any_n", diagnosis );
+		samples_add( &result.latency, now_us() - start );
+		drmaa_release_job_ids( job_ids );
+		assert( n > 0  &&  n <= wait_batch );
+		reaped += n;
+	 }
+	end( &result );
+	assert( reaped == bulk_tasks );
+	result.jobs = bulk_tasks;
+	report( &result );
+	free( stats );
+}
+
+
+static void
+scenario_synchronize( void )
+{
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	const char *all[] = { DRMAA_JOB_IDS_SESSION_ALL, NULL };
+	bench_result_t result;
+
+	submit_bulk( NULL );
+	begin( &result, "synchronize", 1 );
+	check( drmaa_synchronize( all, DRMAA_TIMEOUT_WAIT_FOREVER, 1, diagnosis, sizeof(diagnosis) ),
+			"drmaa_synchronize", diagnosis );
+	samples_add( &result.latency, now_us() - result.start );
+	end( &result );
+	result.jobs = bulk_tasks;
+	report( &result );
+}
+
+
+static void
+scenario_job_ps( void )
+{
+	bench_result_t result;
+	slurm_stub_config_t config;
+	char **ids = NULL;
+	unsigned n_ids;
+
+	slurm_stub_get_config( &config );
+	set_run_ms( BENCH_LONG_RUN_MS );
+	n_ids = submit_bulk( &ids );
+	assert( n_ids > 0 );
+	memset( &result, 0, sizeof(result) );
+	result.scenario = "job_ps";
+	run_workers( &result, job_ps_worker, (const char**)ids, n_ids, ps_calls_per_thread );
+	result.jobs = n_ids;
+	report( &result );
+	free_ids( ids );
+	cleanup();
+	slurm_stub_set_config( &config );
+}
+
+
+static void
+scenario_control( void )
+{
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	bench_result_t result;
+	slurm_stub_config_t config;
+
+	slurm_stub_get_config( &config );
+	set_run_ms( BENCH_LONG_RUN_MS );
+	submit_bulk( NULL );
+	begin( &result, "control", 1 );
+	check( drmaa_control( DRMAA_JOB_IDS_SESSION_ALL, DRMAA_CONTROL_TERMINATE,
+				diagnosis, sizeof(diagnosis) ), "drmaa_control", diagnosis );
+	samples_add( &result.latency, now_us() - result.start );
+	end( &result );
+	result.jobs = bulk_tasks;
+	report( &result );
+	cleanup();
+	slurm_stub_set_config( &config );
+}
+
+
+static const struct {
+	const char *name;
+	void (*run)( void );
+} scenarios[] = {
+	{ "run", scenario_run },
+	{ "bulk", scenario_bulk },
+	{ "wait_any", scenario_wait_any },
+	{ "wait_any_n", scenario_wait_any_n },
+	{ "synchronize", scenario_synchronize },
+	{ "job_ps", scenario_job_ps },
+	{ "control", scenario_control },
+	{ NULL, NULL }
+};
+
+
+static bool
+selected( const char *list, const char *name )
+{
+	size_t len = strlen( name );
+	const char *p = list;
+
+	if( list == NULL )
+		return true;
+	while( (p = strstr( p, name )) != NULL )
+	 {
+		if( (p == list  ||  p[-1] == ',')  &&  (p[len] == ','  ||  p[len] == '\0') )
+			return true;
+		p += len;
+	 }
+	return false;
+}
+
+
+static void
+usage( const char *program )
+{
+	fprintf( stderr, "Usage: %s [-t THREADS] [-n JOBS_PER_THREAD] [-k BULK_TASKS]\n"
+			"       [-p PS_CALLS_PER_THREAD] [-w WAIT_BATCH] [-s SCENARIO,...] [-o FILE]\n"
+			"Scenarios: run, bulk, wait_any, wait_any_n, synchronize, job_ps, control\n",
+			program );
+	exit( 1 );
+}
+
+
+int
+main( int argc, char **argv )
+{
+	char diagnosis[DRMAA_ERROR_STRING_BUFFER] = "";
+	char conf_path[] = "/tmp/drmaa_bench.XXXXXX";
+	const char *scenario_list = NULL;
+	int opt;
+	int i;
+
+	output = stdout;
+	while( (opt = getopt( argc, argv, "t:n:k:p:w:s:o:" )) != -1 )
+		switch( opt )
+		 {
+			case 't':  n_threads = (unsigned)atoi( optarg );  break;
+			case 'n':  jobs_per_thread = (unsigned)atoi( optarg );  break;
+			case 'k':  bulk_tasks = (unsigned)atoi( optarg );  break;
+			case 'p':  ps_calls_per_thread = (unsigned)atoi( optarg );  break;
+			case 'w':  wait_batch = (unsigned)atoi( optarg );  break;
+			case 's':  scenario_list = optarg;  break;
+			case 'o':
+				if( (output = fopen( optarg, "a" )) == NULL )
+				 {
+					perror( optarg );
+					exit( 1 );
+				 }
+				break;
+			default:
+				usage( argv[0] );
+		 }
+	if( optind != argc  ||  n_threads == 0  ||  bulk_tasks == 0
+			||  wait_batch == 0 )
+		usage( argv[0] );
+
+	if( getenv( "SLURM_DRMAA_CONF" ) == NULL )
+	 {
+		int fd = mkstemp( conf_path );
+		if( fd < 0  ||  write( fd, "pool_delay: 1,\n", 15 ) != 15 )
+		 {
+			perror( conf_path );
+			exit( 1 );
+		 }
+		close( fd );
+		setenv( "SLURM_DRMAA_CONF", conf_path, 1 );
+	 }
+	else
+		conf_path[0] = '\0';
+	setenv( "DRMAA_LOG_LEVEL", "ERROR", 0 );
+
+	slurm_stub_reset();
+	check( drmaa_init( NULL, diagnosis, sizeof(diagnosis) ), "drmaa_init", diagnosis );
+	if( conf_path[0] != '\0' )
+		unlink( conf_path );
+
+	for( i = 0;  scenarios[i].name != NULL;  i++ )
+		if( selected( scenario_list, scenarios[i].name ) )
+			scenarios[i].run();
+
+	check( drmaa_exit( diagnosis, sizeof(diagnosis) ), "drmaa_exit", diagnosis );
+	if( output != stdout )
+		fclose( output );
+	return 0;
+}
@@ -48,6 +48,8 @@ typedef struct fsd_drmaa_session_s     fsd_drmaa_session_t;
 typedef struct fsd_job_set_s           fsd_job_set_t;
 typedef struct fsd_job_s               fsd_job_t;
 typedef struct fsd_expand_drmaa_ph_s   fsd_expand_drmaa_ph_t;
+typedef struct fsd_submit_queue_s      fsd_submit_queue_t;
+typedef struct fsd_state_dispatcher_s  fsd_state_dispatcher_t;
 
 #endif /* __DRMAA_UTILS__COMMON_H */
 
@@ -0,0 +1,277 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <string.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/dispatch.h>
+#include <drmaa_utils/drmaa_util.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+
+struct fsd_state_event_s {
+	char *job_id;
+	int old_state;
+	int new_state;
+	fsd_state_event_t *next;
+};
+
+
+static void
+fsd_state_dispatcher_post(
+		fsd_state_dispatcher_t *self,
+		const char *job_id, int old_state, int new_state );
+
+static void
+fsd_state_dispatcher_flush( fsd_state_dispatcher_t *self );
+
+static void
+fsd_state_dispatcher_set_callback(
+		fsd_state_dispatcher_t *self,
+		fsd_state_callback_t callback, void *arg );
+
+static void
+fsd_state_dispatcher_destroy( fsd_state_dispatcher_t *self );
+
+static void
+fsd_state_dispatcher_free( fsd_state_dispatcher_t *self );
+
+static void *
+fsd_state_dispatcher_thread( fsd_state_dispatcher_t *self );
+
+static void
+fsd_state_event_free_list( fsd_state_event_t *event );
+
+
+fsd_state_dispatcher_t *
+fsd_state_dispatcher_new( fsd_state_callback_t callback, void *arg )
+{
+	fsd_state_dispatcher_t *volatile self = NULL;
+
+	fsd_log_enter(( "" ));
+	TRY
+	 {
+		fsd_malloc( self, fsd_state_dispatcher_t );
+		self->post = fsd_state_dispatcher_post;
+		self->flush = fsd_state_dispatcher_flush;
+		self->set_callback = fsd_state_dispatcher_set_callback;
+		self->destroy = fsd_state_dispatcher_destroy;
+		self->callback = callback;
+		self->callback_arg = arg;
+		self->pending_head = self->pending_tail = NULL;
+		self->ready_head = self->ready_tail = NULL;
+		self->thread_started = false;
+		self->run_flag = true;
+		fsd_mutex_init( &self->mutex );
+		fsd_mutex_set_name( &self->mutex, "state_dispatcher" );
+		fsd_cond_init( &self->ready );
+
+		fsd_thread_create( &self->thread,
+				(void*(*)(void*))fsd_state_dispatcher_thread, self );
+		self->thread_started = true;
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( self )
+			self->destroy( self );
+		fsd_exc_reraise();
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%p", (void*)self ));
+	return self;
+}
+
+
+/*
+ * Callback may be just calling DRMAA function blocked by drmaa_exit()
+ * which destroys dispatcher, so dispatch thread is not joined
+ * but detached and frees dispatcher itself.
+ */
+void
+fsd_state_dispatcher_destroy( fsd_state_dispatcher_t *self )
+{
+	fsd_log_enter(( "" ));
+	if( self->thread_started )
+	 {
+		fsd_thread_t thread = self->thread;
+		fsd_mutex_lock( &self->mutex );
+		self->run_flag = false;
+		self->callback = NULL;
+		fsd_state_event_free_list( self->pending_head );
+		fsd_state_event_free_list( self->ready_head );
+		self->pending_head = self->pending_tail = NULL;
+		self->ready_head = self->ready_tail = NULL;
+		fsd_cond_broadcast( &self->ready );
+		fsd_mutex_unlock( &self->mutex );
+		fsd_thread_detach( thread );
+	 }
+	else
+		fsd_state_dispatcher_free( self );
+	fsd_log_return(( "" ));
+}
+
+
+void
+fsd_state_dispatcher_free( fsd_state_dispatcher_t *self )
+{
+	fsd_state_event_free_list( self->pending_head );
+	fsd_state_event_free_list( self->ready_head );
+	fsd_mutex_destroy( &self->mutex );
+	fsd_cond_destroy( &self->ready );
+	fsd_free( self );
+}
+
+
+void
+fsd_state_dispatcher_post(
+		fsd_state_dispatcher_t *self,
+		const char *job_id, int old_state, int new_state )
+{
+	fsd_state_event_t *volatile event = NULL;
+
+	TRY
+	 {
+		fsd_malloc( event, fsd_state_event_t );
+		event->job_id = NULL;
+		event->old_state = old_state;
+		event->new_state = new_state;
+		event->next = NULL;
+		event->job_id = fsd_strdup( job_id );
+
+		fsd_mutex_lock( &self->mutex );
+		if( self->callback != NULL )
+		 {
+			if( self->pending_tail )
+				self->pending_tail->next = event;
+			else
+				self->pending_head = event;
+			self->pending_tail = event;
+			event = NULL;
+		 }
+		fsd_mutex_unlock( &self->mutex );
+	 }
+	FINALLY
+	 {
+		if( event )
+			fsd_state_event_free_list( event );
+	 }
+	END_TRY
+}
+
+
+void
+fsd_state_dispatcher_flush( fsd_state_dispatcher_t *self )
+{
+	fsd_mutex_lock( &self->mutex );
+	if( self->pending_head != NULL )
+	 {
+		if( self->ready_tail )
+			self->ready_tail->next = self->pending_head;
+		else
+			self->ready_head = self->pending_head;
+		self->ready_tail = self->pending_tail;
+		self->pending_head = self->pending_tail = NULL;
+		fsd_cond_signal( &self->ready );
+	 }
+	fsd_mutex_unlock( &self->mutex );
+}
+
+
+void
+fsd_state_dispatcher_set_callback(
+		fsd_state_dispatcher_t *self,
+		fsd_state_callback_t callback, void *arg )
+{
+	fsd_mutex_lock( &self->mutex );
+	self->callback = callback;
+	self->callback_arg = arg;
+	fsd_mutex_unlock( &self->mutex );
+}
+
+
+/**
+ * Dispatch thread.  Takes whole flushed batches and delivers
+ * them outside of dispatcher mutex.  Frees dispatcher when stopped.
+ */
+void *
+fsd_state_dispatcher_thread( fsd_state_dispatcher_t *self )
+{
+	fsd_timeline_thread_name( "state dispatcher" );
+	fsd_log_enter(( "" ));
+	fsd_mutex_lock( &self->mutex );
+	while( true )
+	 {
+		fsd_state_event_t *batch = NULL;
+		fsd_state_event_t *event = NULL;
+		fsd_state_callback_t callback = NULL;
+		void *arg = NULL;
+
+		while( self->run_flag  &&  self->ready_head == NULL )
+			fsd_cond_wait( &self->ready, &self->mutex );
+		if( self->ready_head == NULL )
+			break;
+
+		batch = self->ready_head;
+		self->ready_head = self->ready_tail = NULL;
+		callback = self->callback;
+		arg = self->callback_arg;
+		fsd_mutex_unlock( &self->mutex );
+
+		for( event = batch;  callback != NULL  &&  event != NULL;  event = event->next )
+		 {
+			fsd_log_debug(( "dispatching %s: %s -> %s", event->job_id,
+						drmaa_job_ps_to_str(event->old_state),
+						drmaa_job_ps_to_str(event->new_state) ));
+			callback( event->job_id, event->old_state, event->new_state, arg );
+		 }
+		fsd_state_event_free_list( batch );
+
+		fsd_mutex_lock( &self->mutex );
+	 }
+	fsd_mutex_unlock( &self->mutex );
+	fsd_state_dispatcher_free( self );
+
+	fsd_log_return(( " =NULL" ));
+	return NULL;
+}
+
+
+void
+fsd_state_event_free_list( fsd_state_event_t *event )
+{
+	while( event != NULL )
+	 {
+		fsd_state_event_t *next = event->next;
+		fsd_free( event->job_id );
+		fsd_free( event );
+		event = next;
+	 }
+}
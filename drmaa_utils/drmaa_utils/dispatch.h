@@ -0,0 +1,100 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file dispatch.h
+ * Delivery of job state transitions to client callback.
+ */
+
+#ifndef __DRMAA_UTILS__DISPATCH_H
+#define __DRMAA_UTILS__DISPATCH_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/thread.h>
+
+typedef struct fsd_state_event_s fsd_state_event_t;
+
+/** Client callback (same signature as drmaa_job_state_callback_t). */
+typedef void (*fsd_state_callback_t)(
+		const char *job_id, int old_state, int new_state, void *arg );
+
+/**
+ * Creates dispatcher with its own dispatch thread.
+ */
+fsd_state_dispatcher_t *
+fsd_state_dispatcher_new( fsd_state_callback_t callback, void *arg );
+
+/**
+ * Queue of job state transitions.
+ *
+ * Transitions are collected by #post during poll cycle and handed
+ * over at once to dispatch thread by #flush.  Dispatch thread calls
+ * client callback without holding any library lock so slow callback
+ * never stalls polling.
+ */
+struct fsd_state_dispatcher_s {
+	/** Record state transition of job (cheap, never blocks on callback). */
+	void (*
+	post)(
+			fsd_state_dispatcher_t *self,
+			const char *job_id, int old_state, int new_state
+			);
+
+	/** Hand over transitions posted so far to dispatch thread. */
+	void (*
+	flush)( fsd_state_dispatcher_t *self );
+
+	/**
+	 * Replace callback (\c NULL disables delivery).  Batch being
+	 * delivered at the moment still goes to previous callback.
+	 */
+	void (*
+	set_callback)(
+			fsd_state_dispatcher_t *self,
+			fsd_state_callback_t callback, void *arg
+			);
+
+	/**
+	 * Drop undelivered transitions and stop dispatch thread
+	 * (which frees dispatcher after current callback returns).
+	 */
+	void (*
+	destroy)( fsd_state_dispatcher_t *self );
+
+	fsd_state_callback_t callback;
+	void *callback_arg;
+
+	/** Transitions of current poll cycle. */
+	fsd_state_event_t *pending_head, *pending_tail;
+	/** Transitions waiting for dispatch thread. */
+	fsd_state_event_t *ready_head, *ready_tail;
+
+	fsd_thread_t thread;
+	bool thread_started;
+	bool run_flag;
+
+	fsd_mutex_t mutex;
+	fsd_cond_t ready; /**< Signaled when transitions are flushed. */
+};
+
+#endif /* __DRMAA_UTILS__DISPATCH_H */
@@ -559,6 +559,157 @@ drmaa_read_configuration(
 		char *error_diagnosis, size_t error_diag_len
 		);
 
+/** Ticket matching any pending submission in drmaa_collect_job_id(). */
+#define DRMAA_SUBMIT_TICKET_ANY (-1)
+
+/**
+ * Queues job for submission and returns immediately with @a ticket
+ * which identifies the submission in drmaa_collect_job_id().
+ * Jobs are submitted by a pool of background threads in order
+ * of tickets.  Blocks only while the submission queue is full.
+ * The job template may be deleted right after the call.
+ */
+int
+drmaa_run_job_async(
+		int *ticket, const drmaa_job_template_t *jt,
+		char *error_diagnosis, size_t error_diag_len
+		);
+
+/**
+ * Waits up to @a timeout seconds until submission identified by
+ * @a ticket (or any, with #DRMAA_SUBMIT_TICKET_ANY) is resolved.
+ * Each ticket may be collected exactly once.  When the submission
+ * failed its error code and diagnosis are returned.
+ * Outcomes are kept until collected, so every ticket should be
+ * collected (they do not count against submit_queue_size).
+ */
+int
+drmaa_collect_job_id(
+		int ticket, int *ticket_out,
+		char *job_id, size_t job_id_len, signed long timeout,
+		char *error_diagnosis, size_t error_diag_len
+		);
+
+/**
+ * Like drmaa_job_ps() but for \c NULL terminated vector of job
+ * identifiers.  States are stored in @a remote_ps (which must have
+ * room for all jobs) in order of @a job_ids.  Jobs whose cached state
+ * is not fresh enough are refreshed together.
+ */
+int
+drmaa_job_ps_multi(
+		const char **job_ids, int *remote_ps,
+		char *error_diagnosis, size_t error_diag_len
+		);
+
+
+/**
+ * Like drmaa_wait(DRMAA_JOB_IDS_SESSION_ANY, ...) but reaps up to
+ * @a max_jobs terminated jobs in one call.  Blocks (up to @a timeout)
+ * until at least one job terminates.
+ * @param job_ids  Identifiers of reaped jobs (release with
+ *   drmaa_release_job_ids()).
+ * @param stats  Array (of @a max_jobs length) of job statuses
+ *   (in order of @a job_ids).
+ * @param rusage  If not \c NULL array (of @a max_jobs length)
+ *   of resource usage lists.
+ * @param n_jobs  Number of reaped jobs.
+ */
+int
+drmaa_wait_any_n(
+		size_t max_jobs, signed long timeout,
+		drmaa_job_ids_t **job_ids, int *stats, drmaa_attr_values_t **rusage,
+		size_t *n_jobs,
+		char *error_diagnosis, size_t error_diag_len
+		);
+
+
+/**
+ * Return file descriptor which becomes readable whenever any job
+ * of session reaches terminal state, for use with poll()/epoll
+ * in client event loop.  Descriptor is owned by session (do not
+ * close it nor read from it).  After it becomes readable call
+ * drmaa_clear_completion_fd() and then reap jobs with
+ * drmaa_wait() or drmaa_wait_any_n() using #DRMAA_TIMEOUT_NO_WAIT
+ * until no terminated job is left.
+ */
+int
+drmaa_get_completion_fd(
+		int *fd,
+		char *error_diagnosis, size_t error_diag_len
+		);
+
+/** Make completion descriptor not readable until next job terminates. */
+int
+drmaa_clear_completion_fd(
+		char *error_diagnosis, size_t error_diag_len
+		);
+/**
+ * Job state transition callback.
+ * @param job_id  Identifier of job (valid only during call).
+ * @param old_state  Previous state (DRMAA_PS_*).
+ * @param new_state  Current state (DRMAA_PS_*).
+ */
+typedef void (*drmaa_job_state_callback_t)(
+		const char *job_id, int old_state, int new_state, void *arg );
+
+/**
+ * Register @a callback invoked whenever state of session job changes
+ * (\c NULL unregisters).  Transitions noticed during poll cycle of wait
+ * thread are delivered together from separate dispatch thread so slow
+ * callback does not delay polling.  Callback must not call
+ * drmaa_exit().
+ */
+int
+drmaa_set_job_state_callback(
+		drmaa_job_state_callback_t callback, void *arg,
+		char *error_diagnosis, size_t error_diag_len
+		);
+/**
+ * Adopt jobs submitted before (e.g. by previous instance of client)
+ * into session with their current state, so they can be waited for,
+ * controlled and queried without being recreated one by one.
+ * @param job_ids  \c NULL terminated vector of job identifiers
+ *   or \c NULL to adopt all jobs of user.
+ * @param n_adopted  If not \c NULL number of adopted jobs is stored here.
+ */
+int
+drmaa_adopt_jobs(
+		const char **job_ids, size_t *n_adopted,
+		char *error_diagnosis, size_t error_diag_len
+		);
+
+#define DRMAA_METRICS_JSON        0
+#define DRMAA_METRICS_PROMETHEUS  1
+/**
+ * Performance counters and latency histograms (in microseconds)
+ * of the library, e.g. time spent in DRM calls and on lock contention.
+ * Does not require active session.
+ * @param format  #DRMAA_METRICS_JSON or #DRMAA_METRICS_PROMETHEUS
+ *   (text exposition format).
+ * @param buffer  Receives \c NULL terminated text;
+ *   #DRMAA_ERRNO_INVALID_ARGUMENT is returned if it is too small.
+ */
+int
+drmaa_get_metrics(
+		int format, char *buffer, size_t buffer_len,
+		char *error_diagnosis, size_t error_diag_len
+		);
+/** Subsequent drmaa_get_metrics() calls report values since now. */
+int
+drmaa_reset_metrics( char *error_diagnosis, size_t error_diag_len );
+/**
+ * Mutex contention report: acquisitions, contended acquisitions,
+ * wait and hold times per lock (session, job set, DRM connection,
+ * jobs in aggregate, ...).  Profiling is enabled by setting
+ * \c DRMAA_LOCK_PROFILE environment variable to file where report
+ * is appended at drmaa_exit() (\c - for standard error).
+ */
+int
+drmaa_get_lock_profile(
+		char *buffer, size_t buffer_len,
+		char *error_diagnosis, size_t error_diag_len
+		);
 
 #if defined(__cplusplus)
 } /* extern "C" */
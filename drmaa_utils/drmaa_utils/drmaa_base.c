@@ -36,9 +36,12 @@
 #include <drmaa_utils/drmaa_util.h>
 #include <drmaa_utils/iter.h>
 #include <drmaa_utils/job.h>
+#include <drmaa_utils/lockprof.h>
 #include <drmaa_utils/logging.h>
 #include <drmaa_utils/lookup3.h>
+#include <drmaa_utils/metrics.h>
 #include <drmaa_utils/session.h>
+#include <drmaa_utils/submit_queue.h>
 #include <drmaa_utils/template.h>
 #include <drmaa_utils/util.h>
 
@@ -82,6 +85,8 @@ drmaa_init(
 {
 	DRMAA_API_BEGIN
 	fsd_drmaa_singletone_t *global = &_fsd_drmaa_singletone;
+	fsd_log_check_verbosity();
+	fsd_timeline_init();
 	fsd_log_enter(( "(contact=%s)", contact ));
 
 	fsd_mutex_lock( &global->session_mutex );
@@ -114,6 +119,7 @@ drmaa_exit( char *error_diagnosis, size_t error_diag_len )
 		 {
 			global->session->destroy( global->session );
 			global->session = NULL;
+			fsd_lockprof_report_at_exit();
 		 }
 		else
 		 {
@@ -125,6 +131,8 @@ drmaa_exit( char *error_diagnosis, size_t error_diag_len )
 	END_TRY
 
 	fsd_log_return(( " =0" ));
+	fsd_log_flush();
+	fsd_timeline_flush();
 	DRMAA_API_END
 }
 
@@ -363,6 +371,36 @@ drmaa_job_ps(
 }
 
 
+int
+drmaa_job_ps_multi(
+		const char **job_ids, int *remote_ps,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	fsd_drmaa_session_t *volatile session = NULL;
+
+	fsd_log_enter(( "(job_ids={...})" ));
+	if( job_ids == NULL  ||  remote_ps == NULL )
+		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
+
+	TRY
+	 {
+		session = fsd_drmaa_session_get();
+		session->job_ps_multi( session, job_ids, remote_ps );
+	 }
+	FINALLY
+	 {
+		if( session )
+			session->release( session );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =0" ));
+	DRMAA_API_END
+}
+
+
 
 int
 drmaa_run_job(
@@ -459,6 +497,72 @@ drmaa_timeout_time( signed long timeout, struct timespec *ts )
 }
 
 
+int
+drmaa_run_job_async(
+		int *ticket, const drmaa_job_template_t *jt,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	fsd_drmaa_session_t *volatile session = NULL;
+	fsd_log_enter(( "(jt=%p)", (void*)jt ));
+	if( ticket == NULL  ||  jt == NULL )
+		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
+	TRY
+	 {
+		session = fsd_drmaa_session_get();
+		*ticket = session->run_job_async( session, (fsd_template_t*)jt );
+	 }
+	FINALLY
+	 {
+		if( session )
+			session->release( session );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =0: ticket=%d", *ticket ));
+	DRMAA_API_END
+}
+
+
+int
+drmaa_collect_job_id(
+		int ticket, int *ticket_out,
+		char *job_id, size_t job_id_len, signed long timeout,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	fsd_drmaa_session_t *volatile session = NULL;
+	struct timespec ts;
+	char *volatile job_id_buf = NULL;
+
+	fsd_log_enter(( "(ticket=%d, timeout=%ld)", ticket, timeout ));
+	if( job_id == NULL
+			||  (ticket <= 0  &&  ticket != DRMAA_SUBMIT_TICKET_ANY) )
+		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
+
+	TRY
+	 {
+		session = fsd_drmaa_session_get();
+		job_id_buf = session->collect_job_id( session,
+				ticket == DRMAA_SUBMIT_TICKET_ANY ? FSD_SUBMIT_TICKET_ANY : ticket,
+				ticket_out, drmaa_timeout_time(timeout, &ts) );
+		strlcpy( job_id, job_id_buf, job_id_len );
+	 }
+	FINALLY
+	 {
+		fsd_free( job_id_buf );
+		if( session )
+			session->release( session );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =0: job_id=%s", job_id ));
+	DRMAA_API_END
+}
+
+
 int
 drmaa_synchronize(
 		const char **job_ids, signed long timeout,
@@ -469,6 +573,7 @@ drmaa_synchronize(
 	DRMAA_API_BEGIN
 	fsd_drmaa_session_t *volatile session = NULL;
 	struct timespec ts;
+	struct timespec start;
 
 	fsd_log_enter(( "(job_ids={...}, timeout=%ld, dispose=%d)",
 			timeout, dispose ));
@@ -476,6 +581,7 @@ drmaa_synchronize(
 	if( job_ids == NULL )
 		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
 
+	fsd_metric_start( &start );
 	TRY
 	 {
 		session = fsd_drmaa_session_get();
@@ -486,6 +592,7 @@ drmaa_synchronize(
 	 {
 		if( session )
 			session->release( session );
+		fsd_metric_observe_since( FSD_METRIC_WAIT, &start );
 	 }
 	END_TRY
 
@@ -504,10 +611,12 @@ drmaa_wait(
 	DRMAA_API_BEGIN
 	fsd_drmaa_session_t *volatile session = NULL;
 	struct timespec ts;
+	struct timespec start;
 	char *result_job_id = NULL;
 
 	fsd_log_enter(( "(job_id=%s, timeout=%ld)", job_id, timeout ));
 
+	fsd_metric_start( &start );
 	TRY
 	 {
 		session = fsd_drmaa_session_get();
@@ -516,12 +625,14 @@ drmaa_wait(
 				stat, (fsd_iter_t**)rusage
 				);
 		strlcpy( job_id_out, result_job_id, job_id_out_len );
+		fsd_metric_add( FSD_METRIC_JOBS_REAPED, 1 );
 	 }
 	FINALLY
 	 {
 		fsd_free( result_job_id );
 		if( session )
 			session->release( session );
+		fsd_metric_observe_since( FSD_METRIC_WAIT, &start );
 	 }
 	END_TRY
 
@@ -530,6 +641,240 @@ drmaa_wait(
 }
 
 
+int
+drmaa_wait_any_n(
+		size_t max_jobs, signed long timeout,
+		drmaa_job_ids_t **job_ids, int *stats, drmaa_attr_values_t **rusage,
+		size_t *n_jobs,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	fsd_drmaa_session_t *volatile session = NULL;
+	char **volatile result_job_ids = NULL;
+	struct timespec ts;
+	struct timespec start;
+
+	fsd_log_enter(( "(max_jobs=%u, timeout=%ld)", (unsigned)max_jobs, timeout ));
+	if( max_jobs == 0  ||  job_ids == NULL  ||  stats == NULL  ||  n_jobs == NULL )
+		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
+
+	fsd_metric_start( &start );
+	TRY
+	 {
+		fsd_calloc( result_job_ids, max_jobs + 1, char* );
+		session = fsd_drmaa_session_get();
+		*n_jobs = session->reap_jobs(
+				session, max_jobs, drmaa_timeout_time(timeout, &ts),
+				result_job_ids, stats, (fsd_iter_t**)rusage
+				);
+		*job_ids = (drmaa_job_ids_t*)fsd_iter_new( result_job_ids, *n_jobs );
+		result_job_ids = NULL;
+		fsd_metric_add( FSD_METRIC_JOBS_REAPED, *n_jobs );
+	 }
+	FINALLY
+	 {
+		fsd_free_vector( result_job_ids );
+		if( session )
+			session->release( session );
+		fsd_metric_observe_since( FSD_METRIC_WAIT, &start );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =0: n_jobs=%u", (unsigned)*n_jobs ));
+	DRMAA_API_END
+}
+
+
+int
+drmaa_get_completion_fd(
+		int *fd,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	fsd_drmaa_session_t *volatile session = NULL;
+
+	fsd_log_enter(( "" ));
+	if( fd == NULL )
+		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
+
+	TRY
+	 {
+		session = fsd_drmaa_session_get();
+		*fd = session->get_completion_fd( session );
+	 }
+	FINALLY
+	 {
+		if( session )
+			session->release( session );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =0: fd=%d", *fd ));
+	DRMAA_API_END
+}
+
+
+int
+drmaa_clear_completion_fd(
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	fsd_drmaa_session_t *volatile session = NULL;
+
+	fsd_log_enter(( "" ));
+	TRY
+	 {
+		session = fsd_drmaa_session_get();
+		session->clear_completion_fd( session );
+	 }
+	FINALLY
+	 {
+		if( session )
+			session->release( session );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =0" ));
+	DRMAA_API_END
+}
+
+
+int
+drmaa_set_job_state_callback(
+		drmaa_job_state_callback_t callback, void *arg,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	fsd_drmaa_session_t *volatile session = NULL;
+
+	fsd_log_enter(( "(callback=%p)", (void*)callback ));
+	TRY
+	 {
+		session = fsd_drmaa_session_get();
+		session->set_state_callback( session,
+				(fsd_state_callback_t)callback, arg );
+	 }
+	FINALLY
+	 {
+		if( session )
+			session->release( session );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =0" ));
+	DRMAA_API_END
+}
+
+
+int
+drmaa_adopt_jobs(
+		const char **job_ids, size_t *n_adopted,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	fsd_drmaa_session_t *volatile session = NULL;
+	size_t result = 0;
+
+	fsd_log_enter(( "(job_ids=%s)", job_ids ? "{...}" : "(null)" ));
+	TRY
+	 {
+		session = fsd_drmaa_session_get();
+		result = session->adopt_jobs( session, job_ids, false );
+		if( n_adopted )
+			*n_adopted = result;
+	 }
+	FINALLY
+	 {
+		if( session )
+			session->release( session );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =0: n_adopted=%u", (unsigned)result ));
+	DRMAA_API_END
+}
+
+
+int
+drmaa_get_metrics(
+		int format, char *buffer, size_t buffer_len,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	char *volatile text = NULL;
+
+	fsd_log_enter(( "(format=%d)", format ));
+	if( buffer == NULL  ||  (format != DRMAA_METRICS_JSON
+				&&  format != DRMAA_METRICS_PROMETHEUS) )
+		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
+
+	TRY
+	 {
+		text = fsd_metrics_format( format == DRMAA_METRICS_PROMETHEUS
+				? FSD_METRICS_PROMETHEUS : FSD_METRICS_JSON );
+		if( strlen( text ) >= buffer_len )
+			fsd_exc_raise_fmt( FSD_ERRNO_INVALID_ARGUMENT,
+					"metrics need %u bytes of buffer",
+					(unsigned)strlen( text ) + 1 );
+		strlcpy( buffer, text, buffer_len );
+	 }
+	FINALLY
+	 { fsd_free( text ); }
+	END_TRY
+
+	fsd_log_return(( " =0" ));
+	DRMAA_API_END
+}
+
+
+int
+drmaa_reset_metrics( char *error_diagnosis, size_t error_diag_len )
+{
+	DRMAA_API_BEGIN
+	fsd_log_enter(( "" ));
+	fsd_metrics_reset();
+	fsd_log_return(( " =0" ));
+	DRMAA_API_END
+}
+
+
+int
+drmaa_get_lock_profile(
+		char *buffer, size_t buffer_len,
+		char *error_diagnosis, size_t error_diag_len
+		)
+{
+	DRMAA_API_BEGIN
+	char *volatile text = NULL;
+
+	fsd_log_enter(( "" ));
+	if( buffer == NULL )
+		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
+
+	TRY
+	 {
+		text = fsd_lockprof_format();
+		if( strlen( text ) >= buffer_len )
+			fsd_exc_raise_fmt( FSD_ERRNO_INVALID_ARGUMENT,
+					"lock profile needs %u bytes of buffer",
+					(unsigned)strlen( text ) + 1 );
+		strlcpy( buffer, text, buffer_len );
+	 }
+	FINALLY
+	 { fsd_free( text ); }
+	END_TRY
+
+	fsd_log_return(( " =0" ));
+	DRMAA_API_END
+}
+
+
 #if 0
 int
 drmaa_get_contact(
@@ -696,12 +1041,13 @@ fsd_drmaa_session_t *
 fsd_drmaa_session_get(void)
 {
 	fsd_drmaa_session_t *self = NULL;
-	fsd_mutex_lock( &_fsd_drmaa_singletone.session_mutex );
+	fsd_metric_lock( &_fsd_drmaa_singletone.session_mutex,
+			FSD_METRIC_SESSION_LOCK_WAIT );
 	self = _fsd_drmaa_singletone.session;
 	fsd_mutex_unlock( &_fsd_drmaa_singletone.session_mutex );
 	if( self != NULL )
 	 {
-		fsd_mutex_lock( &self->mutex );
+		fsd_metric_lock( &self->mutex, FSD_METRIC_SESSION_LOCK_WAIT );
 		self->ref_cnt ++;
 		fsd_mutex_unlock( &self->mutex );
 	 }
@@ -0,0 +1,436 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * drmaa-log-decode - prints binary log (written with DRMAA_LOG_BINARY)
+ * in the same form as text log.
+ *
+ * Usage: drmaa-log-decode [FILE]   (standard input when FILE is not given)
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <drmaa_utils/logrec.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+#define DECODE_EXIT_OK (0)
+#define DECODE_EXIT_ERROR (1)
+
+typedef struct {
+	char *function;
+	char *format;
+} decode_site_t;
+
+/* kinds of messages as in logging.h */
+enum { KIND_MSG, KIND_ENTER, KIND_RETURN };
+
+static decode_site_t *sites = NULL;
+static uint32_t n_sites = 0;
+static uint64_t start_us = 0;
+
+/* levels as in fsd_verbose_level_t */
+static char
+level_char( int level )
+{
+	static const char chars[] = "?tdIWEF";
+	if( level < 0  ||  level >= (int)sizeof(chars) - 1 )
+		return '?';
+	return chars[level];
+}
+
+
+static void
+forget_sites( void )
+{
+	uint32_t i;
+	for( i = 0;  i < n_sites;  i++ )
+	 {
+		free( sites[i].function );
+		free( sites[i].format );
+	 }
+	free( sites );
+	sites = NULL;
+	n_sites = 0;
+}
+
+
+static char *
+copy_string( const char *s, size_t len )
+{
+	char *result = malloc( len + 1 );
+	if( result == NULL )
+	 {
+		perror( "malloc" );
+		exit( DECODE_EXIT_ERROR );
+	 }
+	memcpy( result, s, len );
+	result[len] = '\0';
+	return result;
+}
+
+
+static void
+read_site( const char *data, size_t size )
+{
+	fsd_logrec_site_t site;
+
+	if( size < sizeof(site) )
+		return;
+	memcpy( &site, data, sizeof(site) );
+	if( sizeof(site) + site.function_len + site.format_len > size )
+		return;
+
+	if( site.site >= n_sites )
+	 {
+		uint32_t n = site.site + 64;
+		decode_site_t *grown = realloc( sites, n * sizeof(decode_site_t) );
+		if( grown == NULL )
+		 {
+			perror( "realloc" );
+			exit( DECODE_EXIT_ERROR );
+		 }
+		memset( grown + n_sites, 0, (n - n_sites) * sizeof(decode_site_t) );
+		sites = grown;
+		n_sites = n;
+	 }
+	free( sites[site.site].function );
+	free( sites[site.site].format );
+	data += sizeof(site);
+	sites[site.site].function = copy_string( data, site.function_len );
+	data += site.function_len;
+	sites[site.site].format = copy_string( data, site.format_len );
+}
+
+
+static int
+take( const char **p, const char *end, void *value, size_t len )
+{
+	if( *p + len > end )
+		return 0;
+	memcpy( value, *p, len );
+	*p += len;
+	return 1;
+}
+
+
+static char *
+take_string( const char **p, const char *end )
+{
+	uint16_t len;
+	if( !take( p, end, &len, sizeof(len) ) )
+		return NULL;
+	if( *p + len > end )
+		len = end - *p;
+	*p += len;
+	return copy_string( *p - len, len );
+}
+
+
+#define PRINT_ARG( value ) \
+	do { \
+		if( spec.width_star  &&  spec.precision_star ) \
+			fprintf( out, conv, (int)width, (int)precision, value ); \
+		else if( spec.width_star ) \
+			fprintf( out, conv, (int)width, value ); \
+		else if( spec.precision_star ) \
+			fprintf( out, conv, (int)precision, value ); \
+		else \
+			fprintf( out, conv, value ); \
+	} while(0)
+
+/* Format message from format string and raw arguments. */
+static void
+format_message( FILE *out, const char *fmt, const char *args,
+		const char *end, int truncated )
+{
+	const char *p = fmt;
+	fsd_logarg_spec_t spec;
+
+	while( 1 )
+	 {
+		const char *literal = p;
+		char conv[64];
+		int64_t width = 0, precision = 0;
+		int64_t i;
+		double d;
+		char *s;
+
+		if( !fsd_logarg_next( &p, &spec ) )
+		 {
+			fputs( literal, out );
+			break;
+		 }
+		fwrite( literal, 1, spec.begin - literal, out );
+
+		if( spec.type == FSD_LOGARG_NONE )
+		 {
+			if( spec.conversion == '%' )
+				fputc( '%', out );
+			else
+				fwrite( spec.begin, 1, p - spec.begin, out );
+			continue;
+		 }
+		if( spec.type == FSD_LOGARG_POINTER  &&  spec.conversion == 'n' )
+			continue;
+		if( spec.flags_len > sizeof(conv) - 8 )
+			spec.flags_len = sizeof(conv) - 8;
+
+		if( (spec.width_star  &&  !take( &args, end, &width, sizeof(width) ))
+				||  (spec.precision_star
+					&&  !take( &args, end, &precision, sizeof(precision) )) )
+			goto cut;
+
+		switch( spec.type )
+		 {
+			case FSD_LOGARG_INT:
+			case FSD_LOGARG_UINT:
+				if( !take( &args, end, &i, sizeof(i) ) )
+					goto cut;
+				if( spec.conversion == 'c' )
+				 {
+					snprintf( conv, sizeof(conv), "%%%.*sc",
+							(int)spec.flags_len, spec.flags );
+					PRINT_ARG( (int)i );
+				 }
+				else
+				 {
+					snprintf( conv, sizeof(conv), "%%%.*sll%c",
+							(int)spec.flags_len, spec.flags, spec.conversion );
+					if( spec.type == FSD_LOGARG_INT )
+						PRINT_ARG( (long long)i );
+					else
+						PRINT_ARG( (unsigned long long)i );
+				 }
+				break;
+			case FSD_LOGARG_DOUBLE:
+				if( !take( &args, end, &d, sizeof(d) ) )
+					goto cut;
+				snprintf( conv, sizeof(conv), "%%%.*s%c",
+						(int)spec.flags_len, spec.flags, spec.conversion );
+				PRINT_ARG( d );
+				break;
+			case FSD_LOGARG_POINTER:
+				if( !take( &args, end, &i, sizeof(i) ) )
+					goto cut;
+				snprintf( conv, sizeof(conv), "%%%.*sp",
+						(int)spec.flags_len, spec.flags );
+				PRINT_ARG( (void*)(uintptr_t)i );
+				break;
+			case FSD_LOGARG_STRING:
+			case FSD_LOGARG_ERRNO:
+				if( (s = take_string( &args, end )) == NULL )
+					goto cut;
+				snprintf( conv, sizeof(conv), "%%%.*ss",
+						(int)spec.flags_len, spec.flags );
+				PRINT_ARG( s );
+				free( s );
+				break;
+			case FSD_LOGARG_NONE:
+				break;
+		 }
+
+		if( truncated  &&  args == end )
+			goto cut;
+	 }
+	return;
+
+cut:
+	fputs( "...", out );
+}
+
+
+static void
+print_event( const char *data, size_t size )
+{
+	fsd_logrec_event_t event;
+	const decode_site_t *site = NULL;
+	char *message = NULL;
+	size_t message_len = 0;
+	FILE *stream = NULL;
+	const char *prefix;
+	const char *function;
+	const char *p;
+	long seconds, microseconds;
+
+	if( size < sizeof(event) )
+		return;
+	memcpy( &event, data, sizeof(event) );
+	if( event.site < n_sites  &&  sites[event.site].format != NULL )
+		site = &sites[event.site];
+
+	stream = open_memstream( &message, &message_len );
+	if( stream == NULL )
+	 {
+		perror( "open_memstream" );
+		exit( DECODE_EXIT_ERROR );
+	 }
+	if( site != NULL )
+		format_message( stream, site->format, data + sizeof(event),
+				data + size, event.flags & FSD_LOGREC_TRUNCATED );
+	else
+		fprintf( stream, "<unknown log site %u>", (unsigned)event.site );
+	fclose( stream );
+
+	seconds = (long)((event.time_us - start_us) / 1000000);
+	microseconds = (long)((event.time_us - start_us) % 1000000);
+
+	switch( event.kind )
+	 {
+		case KIND_ENTER:   prefix = "->";  break;
+		case KIND_RETURN:  prefix = "<-";  break;
+		default:
+			prefix = " *";
+			break;
+	 }
+	if( site != NULL  &&  (event.kind == KIND_ENTER  ||  event.kind == KIND_RETURN) )
+		function = site->function;
+	else
+		function = "";
+
+	p = message;
+	do {
+		if( *p == '\n' )
+		 {
+			prefix = " |";
+			function = "";
+			p++;
+		 }
+		else
+		 {
+			const char *line_end = strchr( p, '\n' );
+			if( line_end == NULL )
+				line_end = p + strlen(p);
+			printf( "%c #%04x [%6ld.%02ld] %s %s%.*s\n",
+					level_char(event.level), (unsigned)event.tid,
+					seconds, microseconds/10000, prefix, function,
+					(int)(line_end-p), p );
+			p = line_end;
+		 }
+	} while( *p != '\0' );
+
+	free( message );
+}
+
+
+static int
+read_header( FILE *in, const char *magic_part, size_t magic_part_len )
+{
+	fsd_logrec_header_t header;
+
+	memcpy( &header, magic_part, magic_part_len );
+	if( fread( (char*)&header + magic_part_len, 1,
+				sizeof(header) - magic_part_len, in )
+			!= sizeof(header) - magic_part_len
+			||  memcmp( header.magic, FSD_LOGREC_MAGIC, sizeof(header.magic) ) )
+	 {
+		fprintf( stderr, "not a binary DRMAA log\n" );
+		return 0;
+	 }
+	if( header.byte_order != FSD_LOGREC_BYTE_ORDER )
+	 {
+		fprintf( stderr, "log was written on host with different byte order\n" );
+		return 0;
+	 }
+	if( header.version != FSD_LOGREC_VERSION )
+	 {
+		fprintf( stderr, "unsupported log version: %u\n", (unsigned)header.version );
+		return 0;
+	 }
+	/* appended log of next process */
+	forget_sites();
+	start_us = header.start_us;
+	return 1;
+}
+
+
+int
+main( int argc, char **argv )
+{
+	static char data[0x10000];
+	FILE *in = stdin;
+	fsd_logrec_head_t head;
+
+	if( argc > 2  ||  (argc == 2  &&  argv[1][0] == '-'  &&  argv[1][1] != '\0') )
+	 {
+		fprintf( stderr, "Usage: %s [FILE]\n", argv[0] );
+		exit( DECODE_EXIT_ERROR );
+	 }
+	if( argc == 2  &&  strcmp( argv[1], "-" ) != 0 )
+	 {
+		in = fopen( argv[1], "rb" );
+		if( in == NULL )
+		 {
+			perror( argv[1] );
+			exit( DECODE_EXIT_ERROR );
+		 }
+	 }
+
+	if( fread( &head, sizeof(head), 1, in ) != 1
+			||  !read_header( in, (const char*)&head, sizeof(head) ) )
+		exit( DECODE_EXIT_ERROR );
+
+	while( fread( &head, sizeof(head), 1, in ) == 1 )
+	 {
+		if( !memcmp( &head, FSD_LOGREC_MAGIC, sizeof(head) ) )
+		 {
+			if( !read_header( in, (const char*)&head, sizeof(head) ) )
+				exit( DECODE_EXIT_ERROR );
+			continue;
+		 }
+		if( head.size < sizeof(head) )
+		 {
+			fprintf( stderr, "corrupted log record\n" );
+			exit( DECODE_EXIT_ERROR );
+		 }
+		memcpy( data, &head, sizeof(head) );
+		if( fread( data + sizeof(head), 1, head.size - sizeof(head), in )
+				!= head.size - sizeof(head) )
+			break; /* log cut off in the middle of record */
+		switch( head.type )
+		 {
+			case FSD_LOGREC_SITE:
+				read_site( data, head.size );
+				break;
+			case FSD_LOGREC_EVENT:
+				print_event( data, head.size );
+				break;
+			default: /* unknown records are skipped */
+				break;
+		 }
+	 }
+
+	if( in != stdin )
+		fclose( in );
+	forget_sites();
+	return DECODE_EXIT_OK;
+}
@@ -25,8 +25,6 @@
 #include <string.h>
 #include <stdlib.h>
 
-#include <pthread.h>
-
 #include <drmaa_utils/common.h>
 #include <drmaa_utils/exception.h>
 
@@ -55,128 +53,33 @@ static const fsd_exc_t no_memory_exception \
 
 
 /**
- * Thread specific stack of restore points
+ * Innermost try block of thread (top of thread specific stack
+ * of restore points linked by fsd_exc_try_block_t::upper).
  * @see fsd_exc_try_block_t
  */
-typedef struct fsd_exc_stack_s {
-	fsd_exc_try_block_t **restore_points;
-	int n_restore_points;
-} fsd_exc_stack_t;
-
-
-static pthread_key_t fsd_exc_stack;
-static pthread_once_t fsd_exc_init_once = PTHREAD_ONCE_INIT;
-
-
-static void
-fsd_exc_stack_destroy( fsd_exc_stack_t *stack );
-
-
-void
-fsd_exc_init(void)
-{
-	int rc;
-	fsd_log_enter((""));
-	rc = pthread_key_create(
-			&fsd_exc_stack,
-			(void (*)(void*))fsd_exc_stack_destroy
-			);
-	if( rc )
-	 {
-		char errbuf[256] = "InternalError";
-		(void)strerror_r(errno, errbuf, 256);
-		fsd_log_fatal(( "pthread_key_create: %s",errbuf ));
-		abort();
-	 }
-	fsd_log_return((""));
-}
-
-
-fsd_exc_stack_t *
-fsd_exc_get_stack( bool create )
-{
-	fsd_exc_stack_t *stack = NULL;
-	int rc;
-
-	rc = pthread_once( &fsd_exc_init_once, fsd_exc_init );
-	if( rc )
-	 {
-		char errbuf[256] = "InternalError";
-		(void)strerror_r(errno, errbuf, 256);
-		fsd_log_fatal(( "pthread_once: %s",errbuf));
-		abort();
-	 }
-	stack = (fsd_exc_stack_t*)pthread_getspecific( fsd_exc_stack );
-	if( stack == NULL  &&  create )
-	 {
-		rc = fsd_malloc_noraise( stack, fsd_exc_stack_t );
-		if( rc )  return NULL;
-		stack->restore_points = NULL;
-		stack->n_restore_points = 0;
-		rc = pthread_setspecific( fsd_exc_stack, stack );
-		if( rc  &&  errno != ENOMEM )
-		 {
-			char errbuf[256] = "InternalError";
-			(void)strerror_r(errno, errbuf, 256);
-			fsd_log_fatal(( "pthread_setspecific: %s",errbuf ));
-			abort();
-		 }
-		else if( rc )
-		 {
-			fsd_exc_stack_destroy( stack );
-		 }
-	 }
-	else
-		fsd_assert( stack != NULL );
-	return stack;
-}
+static __thread fsd_exc_try_block_t *fsd_exc_top = NULL;
 
 
-void
-fsd_exc_stack_destroy( fsd_exc_stack_t *stack )
+static fsd_exc_try_block_t *
+fsd_exc_get_top(void)
 {
-	int i;
-	fsd_log_enter((""));
-	for( i = 0;  i < stack->n_restore_points;  i++ )
-	 {
-		fsd_exc_try_block_t *b = stack->restore_points[i];
-		if( b->handled_exc != NULL )
-			b->handled_exc->destroy( b->handled_exc );
-		fsd_free( b );
-	 }
-	fsd_free( stack->restore_points );
-	fsd_free( stack );
-	fsd_log_return((""));
+	fsd_assert( fsd_exc_top != NULL );
+	return fsd_exc_top;
 }
 
 
 fsd_exc_try_block_t *
-fsd_exc_try( const char *function, int lineno )
+fsd_exc_try( fsd_exc_try_block_t *block, const char *function, int lineno )
 {
-	fsd_exc_stack_t *stack = NULL;
-	fsd_exc_try_block_t *p = NULL;
-	int rc;
-
 	/* fsd_log_enter(( "(%s, %d)", function, lineno )); */
-	stack = fsd_exc_get_stack( true );
-	if( stack == NULL )
-		return NULL;
-
-	rc = fsd_realloc_noraise(
-			stack->restore_points, stack->n_restore_points+1,
-			fsd_exc_try_block_t* );
-	if( rc )
-		return NULL;
-	rc = fsd_malloc_noraise( p, fsd_exc_try_block_t );
-	if( rc )
-		return NULL;
-	p->handled_exc = NULL;
-	p->state = FSD_EXC_ENTER;
-	p->function = function;
-	p->lineno = lineno;
-	stack->restore_points[ stack->n_restore_points++ ] = p;
-	/* fsd_log_return(( " =%p", (void*)p )); */
-	return p;
+	block->handled_exc = NULL;
+	block->state = FSD_EXC_ENTER;
+	block->function = function;
+	block->lineno = lineno;
+	block->upper = fsd_exc_top;
+	fsd_exc_top = block;
+	/* fsd_log_return(( " =%p", (void*)block )); */
+	return block;
 }
 
 
@@ -184,7 +87,7 @@ void
 fsd_exc_control( fsd_exc_try_block_t *block, int *rc )
 {
 	/* fsd_log_enter(( "(block=%p, rc=%d)", (void*)block, *rc )); */
-	if( block == NULL  ||  *rc == FSD_ERRNO_EXC_END )
+	if( *rc == FSD_ERRNO_EXC_END )
 		return;
 
 	switch( block->state )
@@ -226,16 +129,13 @@ fsd_exc_control( fsd_exc_try_block_t *block, int *rc )
 		 {
 			fsd_exc_try_block_t *current = NULL;
 			fsd_exc_try_block_t *upper = NULL;
-			fsd_exc_stack_t *stack = NULL;
 
 			block->state = FSD_EXC_LEAVE;
 
-			stack = fsd_exc_get_stack( false );
-			current = stack->restore_points[ stack->n_restore_points-1 ];
+			current = fsd_exc_get_top();
 			fsd_assert( block == current );
-			if( stack->n_restore_points > 1 )
-				upper = stack->restore_points[ stack->n_restore_points-2 ];
-			stack->n_restore_points --;
+			upper = current->upper;
+			fsd_exc_top = upper;
 
 			if( current->handled_exc  &&  upper )
 			 {
@@ -250,8 +150,7 @@ fsd_exc_control( fsd_exc_try_block_t *block, int *rc )
 					upper->handled_exc->destroy( upper->handled_exc );
 				 }
 				upper->handled_exc = current->handled_exc;
-				/* current->handled_exc = NULL; */
-				fsd_free_noraise( current );
+				current->handled_exc = NULL;
 				/* fsd_log_return(( ": longjmp(..., %d) => %s:%d",
 							upper->handled_exc->_code, upper->function, upper->lineno )); */
 				longjmp( upper->env, upper->handled_exc->_code );
@@ -260,7 +159,7 @@ fsd_exc_control( fsd_exc_try_block_t *block, int *rc )
 			 {
 				if( current->handled_exc )
 					current->handled_exc->destroy( current->handled_exc );
-				fsd_free_noraise( current );
+				current->handled_exc = NULL;
 				/* fsd_log_return(( ": rc=FSD_ERRNO_EXC_END => %s:%d",
 							block->function, block->lineno )); */
 				*rc = FSD_ERRNO_EXC_END;
@@ -279,24 +178,16 @@ fsd_exc_control( fsd_exc_try_block_t *block, int *rc )
 const fsd_exc_t *
 fsd_exc_get(void)
 {
-	fsd_exc_stack_t *stack;
-	fsd_exc_try_block_t *block;
-	stack = fsd_exc_get_stack( false );
-	fsd_assert( stack->n_restore_points > 0 );
-	block = stack->restore_points[ stack->n_restore_points-1 ];
-	return block->handled_exc;
+	return fsd_exc_get_top()->handled_exc;
 }
 
 
 void
 fsd_exc_clear(void)
 {
-	fsd_exc_stack_t *stack;
 	fsd_exc_try_block_t *block;
 	fsd_log_enter((""));
-	stack = fsd_exc_get_stack( false );
-	fsd_assert( stack->n_restore_points > 0 );
-	block = stack->restore_points[ stack->n_restore_points-1 ];
+	block = fsd_exc_get_top();
 	if( block->handled_exc )
 		block->handled_exc->destroy( block->handled_exc );
 	block->handled_exc = NULL;
@@ -363,12 +254,9 @@ fsd_exc_destroy( fsd_exc_t *self )
 void
 fsd_exc_raise( fsd_exc_t *exc )
 {
-	fsd_exc_stack_t *stack = NULL;
 	fsd_exc_try_block_t *block = NULL;
 	fsd_assert(( exc->_code > 0 ));
-	stack = fsd_exc_get_stack( false );
-	fsd_assert(( stack->n_restore_points > 0 ));
-	block = stack->restore_points[ stack->n_restore_points - 1 ];
+	block = fsd_exc_get_top();
 	if( block->handled_exc )
 		block->handled_exc->destroy( block->handled_exc );
 	block->handled_exc = exc;
@@ -462,11 +350,8 @@ fsd_exc_raise_sys( int errno_code )
 void
 fsd_exc_reraise(void)
 {
-	fsd_exc_stack_t *stack = NULL;
 	fsd_exc_try_block_t *block = NULL;
-	stack = fsd_exc_get_stack( false );
-	fsd_assert(( stack->n_restore_points > 0 ));
-	block = stack->restore_points[ stack->n_restore_points - 1 ];
+	block = fsd_exc_get_top();
 	fsd_assert(( block->handled_exc->_code > 0 ));
 	longjmp( block->env, block->handled_exc->_code );
 }
@@ -90,13 +90,11 @@ fsd_exc_clear(void);
 
 #define TRY \
 	 { \
+		fsd_exc_try_block_t _fsd_exc_frame; \
 		fsd_exc_try_block_t* volatile _fsd_exc_try_block = NULL; \
 		int _fsd_exc_rc; \
-		_fsd_exc_try_block = fsd_exc_try( __FUNCTION__, __LINE__ ); \
-		if( _fsd_exc_try_block != NULL ) \
-			_fsd_exc_rc = setjmp( _fsd_exc_try_block->env ); \
-		else \
-			_fsd_exc_rc = FSD_ERRNO_EXC_END; \
+		_fsd_exc_try_block = fsd_exc_try( &_fsd_exc_frame, __FUNCTION__, __LINE__ ); \
+		_fsd_exc_rc = setjmp( _fsd_exc_try_block->env ); \
 		while(1) \
 		 { \
 			bool _fsd_exc_handled = false; \
@@ -153,18 +151,24 @@ typedef enum {
  * It also represents a point on the stack and other state of
  * thread to wich it can be restored during "stack rollback"
  * process after exception is raised.
+ *
+ * Blocks live in stack frame of function (declared by #TRY)
+ * and are linked into thread local stack of restore points,
+ * so entering block does not touch heap.
  */
-typedef struct fsd_exc_try_block_s {
+typedef struct fsd_exc_try_block_s fsd_exc_try_block_t;
+struct fsd_exc_try_block_s {
 	jmp_buf env;  /**< Stack restore point for \c longjmp. */
 	fsd_exc_t *handled_exc; /**< Exception handled within block */
 	fsd_exc_try_block_state_t state;
 	const char *function; /**< Name of function */
 	int lineno; /**< Line number where try-block starts */
-} fsd_exc_try_block_t;
+	fsd_exc_try_block_t *upper; /**< Enclosing block (\c NULL for outermost). */
+};
 
 
 fsd_exc_try_block_t *
-fsd_exc_try( const char *function, int lineno );
+fsd_exc_try( fsd_exc_try_block_t *block, const char *function, int lineno );
 
 void
 fsd_exc_control( fsd_exc_try_block_t *block, int *rc );
@@ -74,6 +74,7 @@ fsd_job_new( char *job_id )
 		self->queue				= NULL;
 		self->project			= NULL;
 		fsd_mutex_init( &self->mutex );
+		fsd_mutex_set_name( &self->mutex, "job" );
 		fsd_cond_init( &self->status_cond );
 		fsd_cond_init( &self->destroy_cond );
 		fsd_mutex_lock( &self->mutex );
@@ -215,6 +216,8 @@ static bool
 fsd_job_set_empty( fsd_job_set_t *self );
 static fsd_job_t *
 fsd_job_set_find_terminated( fsd_job_set_t *self );
+static size_t
+fsd_job_set_detach_terminated( fsd_job_set_t *self, fsd_job_t **jobs, size_t max_jobs );
 static char **
 fsd_job_set_get_all_job_ids( fsd_job_set_t *self );
 static void fsd_job_set_signal_all( fsd_job_set_t *self );
@@ -237,6 +240,7 @@ fsd_job_set_new(void)
 		self->get = fsd_job_set_get;
 		self->empty = fsd_job_set_empty;
 		self->find_terminated = fsd_job_set_find_terminated;
+		self->detach_terminated = fsd_job_set_detach_terminated;
 		self->get_all_job_ids = fsd_job_set_get_all_job_ids;
 		self->signal_all = fsd_job_set_signal_all;
 		self->tab = NULL;
@@ -245,6 +249,7 @@ fsd_job_set_new(void)
 		self->tab_size = initial_size;
 		self->tab_mask = self->tab_size - 1;
 		fsd_mutex_init( &self->mutex );
+		fsd_mutex_set_name( &self->mutex, "job_set" );
 	 }
 	EXCEPT_DEFAULT
 	 {
@@ -456,6 +461,41 @@ found:
 }
 
 
+size_t
+fsd_job_set_detach_terminated( fsd_job_set_t *self, fsd_job_t **jobs, size_t max_jobs )
+{
+	size_t n_jobs = 0;
+	size_t i;
+
+	fsd_log_enter(( "(max_jobs=%u)", (unsigned)max_jobs ));
+	fsd_mutex_lock( &self->mutex );
+	for( i = 0;  i < self->tab_size  &&  n_jobs < max_jobs;  i++ )
+	 {
+		fsd_job_t **pjob = &self->tab[ i ];
+		while( *pjob  &&  n_jobs < max_jobs )
+		 {
+			fsd_job_t *job = *pjob;
+			if( job->state < DRMAA_PS_DONE )
+			 {
+				pjob = &job->next;
+				continue;
+			 }
+			fsd_mutex_lock( &job->mutex );
+			*pjob = job->next;
+			job->next = NULL;
+			job->flags |= FSD_JOB_DISPOSED;
+			fsd_mutex_unlock( &job->mutex );
+			self->n_jobs--;
+			jobs[ n_jobs++ ] = job; /* reference of set goes to caller */
+		 }
+	 }
+	fsd_mutex_unlock( &self->mutex );
+	fsd_log_info(( "#%d of jobs after detaching %u", self->n_jobs, (unsigned)n_jobs ));
+	fsd_log_return(( " =%u", (unsigned)n_jobs ));
+	return n_jobs;
+}
+
+
 char **
 fsd_job_set_get_all_job_ids( fsd_job_set_t *self )
 {
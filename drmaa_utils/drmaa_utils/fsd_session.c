@@ -18,14 +18,22 @@
  */
 
 #include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_EVENTFD_H
+#	include <sys/eventfd.h>
+#endif
 
 #include <drmaa_utils/conf.h>
 #include <drmaa_utils/drmaa.h>
 #include <drmaa_utils/iter.h>
 #include <drmaa_utils/job.h>
+#include <drmaa_utils/probes.h>
 #include <drmaa_utils/session.h>
+#include <drmaa_utils/submit_queue.h>
 
 #ifndef lint
 static char rcsid[]
@@ -59,6 +67,19 @@ fsd_drmaa_session_run_bulk(
 		int start, int end, int incr
 		);
 
+static int
+fsd_drmaa_session_run_job_async(
+		fsd_drmaa_session_t *self,
+		const fsd_template_t *jt
+		);
+
+static char*
+fsd_drmaa_session_collect_job_id(
+		fsd_drmaa_session_t *self,
+		int ticket, int *ticket_out,
+		const struct timespec *timeout
+		);
+
 static void
 fsd_drmaa_session_control_job(
 		fsd_drmaa_session_t *self,
@@ -71,6 +92,18 @@ fsd_drmaa_session_job_ps(
 		const char *job_id, int *remote_ps
 		);
 
+static void
+fsd_drmaa_session_job_ps_multi(
+		fsd_drmaa_session_t *self,
+		const char **job_ids, int *remote_ps
+		);
+
+static size_t
+fsd_drmaa_session_adopt_jobs(
+		fsd_drmaa_session_t *self,
+		const char **job_ids, bool session_only
+		);
+
 static void
 fsd_drmaa_session_synchronize(
 		fsd_drmaa_session_t *self,
@@ -112,6 +145,34 @@ fsd_drmaa_session_wait_for_any_job(
 		bool dispose
 		);
 
+static size_t
+fsd_drmaa_session_reap_jobs(
+		fsd_drmaa_session_t *self,
+		size_t max_jobs, const struct timespec *timeout,
+		char **job_ids, int *status, fsd_iter_t **rusage
+		);
+
+static int
+fsd_drmaa_session_get_completion_fd( fsd_drmaa_session_t *self );
+
+static void
+fsd_drmaa_session_clear_completion_fd( fsd_drmaa_session_t *self );
+
+static void
+fsd_drmaa_session_notify_completion( fsd_drmaa_session_t *self );
+
+static void
+fsd_drmaa_session_job_state_changed(
+		fsd_drmaa_session_t *self,
+		fsd_job_t *job, int previous_state
+		);
+
+static void
+fsd_drmaa_session_set_state_callback(
+		fsd_drmaa_session_t *self,
+		fsd_state_callback_t callback, void *arg
+		);
+
 static void
 fsd_drmaa_session_wait_for_job_status_change(
 		fsd_drmaa_session_t *self,
@@ -173,14 +234,24 @@ fsd_drmaa_session_new( const char *contact )
 		self->destroy_nowait = fsd_drmaa_session_destroy_nowait;
 		self->run_job = fsd_drmaa_session_run_job;
 		self->run_bulk = fsd_drmaa_session_run_bulk;
+		self->run_job_async = fsd_drmaa_session_run_job_async;
+		self->collect_job_id = fsd_drmaa_session_collect_job_id;
 		self->control_job = fsd_drmaa_session_control_job;
 		self->job_ps = fsd_drmaa_session_job_ps;
+		self->job_ps_multi = fsd_drmaa_session_job_ps_multi;
+		self->adopt_jobs = fsd_drmaa_session_adopt_jobs;
 		self->synchronize = fsd_drmaa_session_synchronize;
 		self->wait = fsd_drmaa_session_wait;
 		self->new_job = fsd_drmaa_session_new_job;
 		self->run_impl = fsd_drmaa_session_run_impl;
 		self->wait_for_single_job = fsd_drmaa_session_wait_for_single_job;
 		self->wait_for_any_job = fsd_drmaa_session_wait_for_any_job;
+		self->reap_jobs = fsd_drmaa_session_reap_jobs;
+		self->get_completion_fd = fsd_drmaa_session_get_completion_fd;
+		self->clear_completion_fd = fsd_drmaa_session_clear_completion_fd;
+		self->notify_completion = fsd_drmaa_session_notify_completion;
+		self->job_state_changed = fsd_drmaa_session_job_state_changed;
+		self->set_state_callback = fsd_drmaa_session_set_state_callback;
 		self->wait_for_job_status_change =
 			fsd_drmaa_session_wait_for_job_status_change;
 		self->wait_thread = fsd_drmaa_session_wait_thread;
@@ -203,13 +274,21 @@ fsd_drmaa_session_new( const char *contact )
 		self->enable_wait_thread = false;
 		self->job_categories = NULL;
 		self->missing_jobs = FSD_REVEAL_MISSING_JOBS;
+		self->submit_queue = NULL;
+		self->submit_threads = 4;
+		self->submit_queue_size = 1024;
+		self->state_dispatcher = NULL;
 		self->wait_thread_started = false;
 		self->wait_thread_run_flag = false;
+		self->completion_fd[0] = self->completion_fd[1] = -1;
+		self->metrics_dumper = NULL;
 
 		fsd_mutex_init( &self->mutex );
+		fsd_mutex_set_name( &self->mutex, "session" );
 		fsd_cond_init( &self->wait_condition );
 		fsd_cond_init( &self->destroy_condition );
 		fsd_mutex_init( &self->drm_connection_mutex );
+		fsd_mutex_set_name( &self->drm_connection_mutex, "drm_connection" );
 		self->jobs = fsd_job_set_new();
 		self->contact = fsd_strdup( contact );
 		
@@ -268,6 +347,10 @@ fsd_drmaa_session_destroy( fsd_drmaa_session_t *self )
 
 	self->jobs->signal_all( self->jobs );
 
+	/* no new queue may be created since destroy_requested is set */
+	if( self->submit_queue )
+		self->submit_queue->stop( self->submit_queue );
+
 	fsd_mutex_lock( &self->mutex );
 	TRY
 	 {
@@ -290,12 +373,27 @@ void
 fsd_drmaa_session_destroy_nowait( fsd_drmaa_session_t *self )
 {
 	fsd_log_enter(( "" ));
+	/* dumper takes no session lock - safe to join here */
+	if( self->metrics_dumper )
+		fsd_metrics_dumper_stop( self->metrics_dumper );
+
 	fsd_conf_dict_destroy( self->configuration );
 	fsd_free( self->contact );
 
+	if( self->submit_queue )
+		self->submit_queue->destroy( self->submit_queue );
+
+	if( self->state_dispatcher )
+		self->state_dispatcher->destroy( self->state_dispatcher );
+
 	if( self->jobs )
 		self->jobs->destroy( self->jobs );
 
+	if( self->completion_fd[0] != -1 )
+		close( self->completion_fd[0] );
+	if( self->completion_fd[1] != self->completion_fd[0] )
+		close( self->completion_fd[1] );
+
 	fsd_mutex_destroy( &self->mutex );
 	fsd_cond_destroy( &self->wait_condition );
 	fsd_cond_destroy( &self->destroy_condition );
@@ -349,6 +447,51 @@ fsd_drmaa_session_run_bulk(
 }
 
 
+int
+fsd_drmaa_session_run_job_async(
+		fsd_drmaa_session_t *self,
+		const fsd_template_t *jt )
+{
+	fsd_submit_queue_t *volatile queue = NULL;
+
+	fsd_mutex_lock( &self->mutex );
+	TRY
+	 {
+		if( self->destroy_requested )
+			fsd_exc_raise_code( FSD_DRMAA_ERRNO_NO_ACTIVE_SESSION );
+		if( self->submit_queue == NULL )
+			self->submit_queue = fsd_submit_queue_new( self,
+					self->submit_threads, self->submit_queue_size );
+		queue = self->submit_queue;
+	 }
+	FINALLY
+	 { fsd_mutex_unlock( &self->mutex ); }
+	END_TRY
+
+	/* may block when queue is full - session mutex must not be held */
+	return queue->submit( queue, jt );
+}
+
+
+char *
+fsd_drmaa_session_collect_job_id(
+		fsd_drmaa_session_t *self,
+		int ticket, int *ticket_out,
+		const struct timespec *timeout )
+{
+	fsd_submit_queue_t *queue = NULL;
+
+	fsd_mutex_lock( &self->mutex );
+	queue = self->submit_queue;
+	fsd_mutex_unlock( &self->mutex );
+
+	if( queue == NULL )
+		fsd_exc_raise_msg( FSD_DRMAA_ERRNO_INVALID_JOB,
+				"No submission to be collected" );
+	return queue->collect( queue, ticket, ticket_out, timeout );
+}
+
+
 void
 fsd_drmaa_session_control_job(
 		fsd_drmaa_session_t *self,
@@ -431,6 +574,55 @@ fsd_drmaa_session_job_ps(
 }
 
 
+void
+fsd_drmaa_session_job_ps_multi(
+		fsd_drmaa_session_t *self,
+		const char **job_ids, int *remote_ps
+		)
+{
+	const char **i;
+	for( i = job_ids;  *i != NULL;  i++ )
+		self->job_ps( self, *i, &remote_ps[ i - job_ids ] );
+}
+
+
+size_t
+fsd_drmaa_session_adopt_jobs(
+		fsd_drmaa_session_t *self,
+		const char **job_ids, bool session_only
+		)
+{
+	const char **i;
+	size_t n_adopted = 0;
+
+	if( job_ids == NULL )
+		fsd_exc_raise_code( FSD_ERRNO_NOT_IMPLEMENTED );
+
+	for( i = job_ids;  *i != NULL;  i++ )
+	 {
+		fsd_job_t *volatile job = NULL;
+		TRY
+		 {
+			job = self->get_job( self, *i );
+			if( job == NULL )
+			 {
+				job = self->new_job( self, *i );
+				job->update_status( job );
+				self->jobs->add( self->jobs, job );
+				n_adopted++;
+			 }
+		 }
+		FINALLY
+		 {
+			if( job )
+				job->release( job );
+		 }
+		END_TRY
+	 }
+	return n_adopted;
+}
+
+
 void
 fsd_drmaa_session_synchronize(
 		fsd_drmaa_session_t *self,
@@ -440,6 +632,9 @@ fsd_drmaa_session_synchronize(
 {
 	volatile bool wait_for_all = false;
 	char **volatile job_ids_buf = NULL;
+	const char **volatile pending = NULL;
+	int *volatile states = NULL;
+	volatile bool locked = false;
 	const char **job_ids = NULL;
 	const char **i;
 
@@ -451,6 +646,8 @@ fsd_drmaa_session_synchronize(
 
 	TRY
 	 {
+		size_t n_pending = 0;
+
 		for( i = input_job_ids;  *i != NULL;  i++ )
 			if( !strcmp(*i, DRMAA_JOB_IDS_SESSION_ALL) )
 				wait_for_all = true;
@@ -464,19 +661,94 @@ fsd_drmaa_session_synchronize(
 			job_ids = input_job_ids;
 
 		for( i = job_ids;  *i != NULL;  i++ )
-			TRY
+			n_pending++;
+		fsd_calloc( pending, n_pending + 1, const char* );
+		fsd_calloc( states, n_pending + 1, int );
+
+		/* register interest in all jobs at once */
+		n_pending = 0;
+		for( i = job_ids;  *i != NULL;  i++ )
+		 {
+			fsd_job_t *job = self->get_job( self, *i );
+			if( job == NULL )
 			 {
-				self->wait_for_single_job( self, *i, timeout, NULL, NULL, dispose );
+				fsd_log_info(("Job %s is not known to DRMAA. Creating job object.", *i));
+				job = self->new_job( self, *i );
+				self->jobs->add( self->jobs, job );
 			 }
-			EXCEPT( FSD_DRMAA_ERRNO_INVALID_JOB )
-			 { /* job was ripped by another thread */ }
-			END_TRY
+			job->release( job );
+			pending[ n_pending++ ] = *i;
+		 }
+
+		/* jobs complete in any order; each cycle refreshes
+		   all not yet terminated jobs together */
+		while( n_pending > 0 )
+		 {
+			size_t k, n_left = 0;
+			bool signaled = true;
+
+			if( !self->enable_wait_thread )
+				self->job_ps_multi( self, pending, states );
+
+			for( k = 0;  k < n_pending;  k++ )
+			 {
+				fsd_job_t *job = self->get_job( self, pending[k] );
+				if( job == NULL )
+					continue; /* job was ripped by another thread */
+				if( job->state < DRMAA_PS_DONE )
+				 {
+					job->release( job );
+					pending[ n_left++ ] = pending[k];
+					continue;
+				 }
+				/* release mutex in order to ensure proper order of locking: first job_set mutex then job mutex */
+				job->release( job );
+				if( dispose )
+				 {
+					locked = fsd_mutex_lock( &self->mutex );
+					self->jobs->remove_by_id( self->jobs, pending[k] );
+					locked = fsd_mutex_unlock( &self->mutex );
+				 }
+			 }
+			pending[ n_left ] = NULL;
+			fsd_log_debug(( "synchronize: %u of %u jobs left",
+						(unsigned)n_left, (unsigned)n_pending ));
+			n_pending = n_left;
+			if( n_pending == 0 )
+				break;
+
+			if( self->destroy_requested )
+				fsd_exc_raise_code( FSD_DRMAA_ERRNO_EXIT_TIMEOUT );
+
+			locked = fsd_mutex_lock( &self->mutex );
+			if( self->enable_wait_thread )
+			 {
+				if( timeout )
+					signaled = fsd_cond_timedwait(
+							&self->wait_condition, &self->mutex, timeout );
+				else
+					fsd_cond_wait( &self->wait_condition, &self->mutex );
+			 }
+			else
+				self->wait_for_job_status_change( self,
+						&self->wait_condition, &self->mutex, timeout );
+			locked = fsd_mutex_unlock( &self->mutex );
+
+			if( !signaled )
+				fsd_exc_raise_code( FSD_DRMAA_ERRNO_EXIT_TIMEOUT );
+		 }
 	 }
 	FINALLY
 	 {
+		if( locked )
+			fsd_mutex_unlock( &self->mutex );
+		fsd_free( pending );
+		fsd_free( states );
 		fsd_free_vector( job_ids_buf );
 	 }
 	END_TRY
+
+	fsd_log_return(( "" ));
 }
 
 
@@ -543,6 +815,7 @@ fsd_drmaa_session_wait_for_single_job(
 			bool signaled = true;
 			fsd_log_debug(( "fsd_drmaa_session_wait_for_single_job: "
 						"waiting for %s to terminate", job_id ));
+			FSD_PROBE1( wait_block, job_id );
 			if( self->enable_wait_thread )
 			 {
 				if( timeout )
@@ -552,6 +825,7 @@ fsd_drmaa_session_wait_for_single_job(
 				 {
 					fsd_cond_wait( &job->status_cond, &job->mutex );
 				 }
+				FSD_PROBE2( wait_unblock, job_id, signaled );
 				if( !signaled )
 					fsd_exc_raise_code( FSD_DRMAA_ERRNO_EXIT_TIMEOUT );
 			 }
@@ -559,6 +833,7 @@ fsd_drmaa_session_wait_for_single_job(
 			 {
 				self->wait_for_job_status_change(
 						self, &job->status_cond, &job->mutex, timeout );
+				FSD_PROBE2( wait_unblock, job_id, signaled );
 			 }
 
 			fsd_log_debug(( "fsd_drmaa_session_wait_for_single_job: woken up" ));
@@ -637,6 +912,7 @@ fsd_drmaa_session_wait_for_any_job(
 
 			if( self->destroy_requested )
 				fsd_exc_raise_code( FSD_DRMAA_ERRNO_NO_ACTIVE_SESSION );
+			FSD_PROBE1( wait_block, NULL );
 			if( self->enable_wait_thread )
 			 {
 				fsd_log_debug(( "wait_for_any_job: waiting for wait thread" ));
@@ -652,6 +928,7 @@ fsd_drmaa_session_wait_for_any_job(
 				self->wait_for_job_status_change( self,
 						&self->wait_condition, &self->mutex, timeout );
 			 }
+			FSD_PROBE2( wait_unblock, NULL, signaled );
 			locked = fsd_mutex_unlock( &self->mutex );
 			fsd_log_debug((
 						"wait_for_any_job: woken up; signaled=%d", signaled ));
@@ -691,6 +968,263 @@ fsd_drmaa_session_wait_for_any_job(
 }
 
 
+size_t
+fsd_drmaa_session_reap_jobs(
+		fsd_drmaa_session_t *self,
+		size_t max_jobs, const struct timespec *timeout,
+		char **job_ids, int *status, fsd_iter_t **rusage
+		)
+{
+	fsd_job_set_t *set = self->jobs;
+	fsd_job_t **volatile jobs = NULL;
+	volatile size_t n_jobs = 0;
+	volatile size_t n_reaped = 0;
+	volatile bool locked = false;
+
+	fsd_log_enter(( "(max_jobs=%u)", (unsigned)max_jobs ));
+
+	TRY
+	 {
+		size_t i;
+
+		fsd_calloc( jobs, max_jobs, fsd_job_t* );
+		for( i = 0;  i < max_jobs;  i++ )
+		 {
+			job_ids[i] = NULL;
+			if( rusage )
+				rusage[i] = NULL;
+		 }
+
+		while( n_jobs == 0 )
+		 {
+			bool signaled = true;
+
+			if( self->destroy_requested )
+				fsd_exc_raise_code( FSD_DRMAA_ERRNO_NO_ACTIVE_SESSION );
+
+			if( !self->enable_wait_thread )
+				self->update_all_jobs_status( self );
+
+			locked = fsd_mutex_lock( &self->mutex );
+			if( set->empty( set ) )
+				fsd_exc_raise_msg( FSD_DRMAA_ERRNO_INVALID_JOB,
+						"No job found to be waited for" );
+
+			n_jobs = set->detach_terminated( set, jobs, max_jobs );
+			if( n_jobs > 0 )
+				break;
+
+			if( self->destroy_requested )
+				fsd_exc_raise_code( FSD_DRMAA_ERRNO_NO_ACTIVE_SESSION );
+			FSD_PROBE1( wait_block, NULL );
+			if( self->enable_wait_thread )
+			 {
+				fsd_log_debug(( "reap_jobs: waiting for wait thread" ));
+				if( timeout )
+					signaled = fsd_cond_timedwait(
+							&self->wait_condition, &self->mutex, timeout );
+				else
+					fsd_cond_wait( &self->wait_condition, &self->mutex );
+			 }
+			else
+			 {
+				fsd_log_debug(( "reap_jobs: waiting for next check" ));
+				self->wait_for_job_status_change( self,
+						&self->wait_condition, &self->mutex, timeout );
+			 }
+			FSD_PROBE2( wait_unblock, NULL, signaled );
+			locked = fsd_mutex_unlock( &self->mutex );
+			fsd_log_debug(( "reap_jobs: woken up; signaled=%d", signaled ));
+
+			if( !signaled )
+				fsd_exc_raise_code( FSD_DRMAA_ERRNO_EXIT_TIMEOUT );
+		 }
+		locked = fsd_mutex_unlock( &self->mutex );
+
+		/* jobs are already out of set - lock them one at a time */
+		for( ;  n_reaped < n_jobs;  n_reaped++ )
+		 {
+			fsd_job_t *job = jobs[ n_reaped ];
+			fsd_mutex_lock( &job->mutex );
+			jobs[ n_reaped ] = NULL;
+			TRY
+			 {
+				job_ids[ n_reaped ] = fsd_strdup( job->job_id );
+				job->get_termination_status( job, &status[ n_reaped ],
+						rusage ? &rusage[ n_reaped ] : NULL );
+			 }
+			FINALLY
+			 { job->release( job ); }
+			END_TRY
+		 }
+	 }
+	EXCEPT_DEFAULT
+	 {
+		size_t i;
+		for( i = 0;  i < n_jobs;  i++ )
+		 {
+			fsd_free( job_ids[i] );
+			job_ids[i] = NULL;
+			if( rusage  &&  rusage[i] )
+			 {
+				rusage[i]->destroy( rusage[i] );
+				rusage[i] = NULL;
+			 }
+		 }
+		fsd_exc_reraise();
+	 }
+	FINALLY
+	 {
+		if( locked )
+			fsd_mutex_unlock( &self->mutex );
+		if( jobs )
+		 {
+			size_t i;
+			for( i = 0;  i < n_jobs;  i++ )
+				if( jobs[i] )
+				 {
+					fsd_mutex_lock( &jobs[i]->mutex );
+					jobs[i]->release( jobs[i] );
+				 }
+			fsd_free( jobs );
+		 }
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%u", (unsigned)n_jobs ));
+	return n_jobs;
+}
+
+
+int
+fsd_drmaa_session_get_completion_fd( fsd_drmaa_session_t *self )
+{
+	volatile int fd = -1;
+
+	fsd_mutex_lock( &self->mutex );
+	TRY
+	 {
+		if( self->completion_fd[0] == -1 )
+		 {
+#ifdef HAVE_SYS_EVENTFD_H
+			int efd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+			if( efd == -1 )
+				fsd_exc_raise_sys( 0 );
+			self->completion_fd[1] = efd;
+			self->completion_fd[0] = efd;
+#else
+			int fds[2];
+			int i;
+			if( pipe( fds ) == -1 )
+				fsd_exc_raise_sys( 0 );
+			for( i = 0;  i < 2;  i++ )
+			 {
+				fcntl( fds[i], F_SETFL, fcntl( fds[i], F_GETFL ) | O_NONBLOCK );
+				fcntl( fds[i], F_SETFD, FD_CLOEXEC );
+			 }
+			self->completion_fd[1] = fds[1];
+			self->completion_fd[0] = fds[0];
+#endif
+			fsd_log_debug(( "completion fd: %d", self->completion_fd[0] ));
+			 { /* jobs which terminated before fd was created */
+				fsd_job_t *job = self->jobs->find_terminated( self->jobs );
+				if( job )
+				 {
+					job->release( job );
+					self->notify_completion( self );
+				 }
+			 }
+		 }
+		fd = self->completion_fd[0];
+	 }
+	FINALLY
+	 { fsd_mutex_unlock( &self->mutex ); }
+	END_TRY
+
+	return fd;
+}
+
+
+void
+fsd_drmaa_session_clear_completion_fd( fsd_drmaa_session_t *self )
+{
+	char buf[64];
+	int fd = self->completion_fd[0];
+
+	if( fd == -1 )
+		return;
+	while( read( fd, buf, sizeof(buf) ) > 0 )
+		;
+}
+
+
+void
+fsd_drmaa_session_notify_completion( fsd_drmaa_session_t *self )
+{
+	int fd = self->completion_fd[1];
+	int saved_errno = errno;
+
+	if( fd == -1 )
+		return;
+#ifdef HAVE_SYS_EVENTFD_H
+	 {
+		uint64_t one = 1;
+		if( write( fd, &one, sizeof(one) ) == -1  &&  errno != EAGAIN )
+			fsd_log_warning(( "completion fd: write: %s", strerror(errno) ));
+	 }
+#else
+	/* full pipe is readable anyway */
+	if( write( fd, "", 1 ) == -1  &&  errno != EAGAIN )
+		fsd_log_warning(( "completion fd: write: %s", strerror(errno) ));
+#endif
+	errno = saved_errno;
+}
+
+
+void
+fsd_drmaa_session_job_state_changed(
+		fsd_drmaa_session_t *self,
+		fsd_job_t *job, int previous_state
+		)
+{
+	if( job->state == previous_state )
+		return;
+	if( job->state >= DRMAA_PS_DONE  &&  previous_state < DRMAA_PS_DONE )
+		self->notify_completion( self );
+	if( self->state_dispatcher != NULL )
+	 {
+		self->state_dispatcher->post( self->state_dispatcher,
+				job->job_id, previous_state, job->state );
+		/* without wait thread there is no poll cycle to batch in */
+		if( !self->enable_wait_thread )
+			self->state_dispatcher->flush( self->state_dispatcher );
+	 }
+}
+
+
+void
+fsd_drmaa_session_set_state_callback(
+		fsd_drmaa_session_t *self,
+		fsd_state_callback_t callback, void *arg
+		)
+{
+	fsd_mutex_lock( &self->mutex );
+	TRY
+	 {
+		if( self->state_dispatcher == NULL )
+		 {
+			if( callback != NULL )
+				self->state_dispatcher = fsd_state_dispatcher_new( callback, arg );
+		 }
+		else
+			self->state_dispatcher->set_callback( self->state_dispatcher, callback, arg );
+	 }
+	FINALLY
+	 { fsd_mutex_unlock( &self->mutex ); }
+	END_TRY
+}
+
+
 void
 fsd_drmaa_session_wait_for_job_status_change(
 		fsd_drmaa_session_t *self,
@@ -731,6 +1265,7 @@ fsd_drmaa_session_wait_thread( fsd_drmaa_session_t *self )
 	struct timespec ts, *next_check = &ts;
 	bool volatile locked = false;
 
+	fsd_timeline_thread_name( "wait thread" );
 	fsd_log_enter(( "" ));
 	locked = fsd_mutex_lock( &self->mutex );
 	TRY
@@ -739,8 +1274,12 @@ fsd_drmaa_session_wait_thread( fsd_drmaa_session_t *self )
 			TRY
 			 {
 				fsd_log_debug(( "wait thread: next iteration" ));
+				FSD_PROBE0( wait_thread_cycle_start );
 				self->update_all_jobs_status( self );
 				fsd_cond_broadcast( &self->wait_condition );
+				if( self->state_dispatcher )
+					self->state_dispatcher->flush( self->state_dispatcher );
+				FSD_PROBE0( wait_thread_cycle_end );
 				
 				fsd_get_time( next_check );
 				fsd_ts_add( next_check, &self->pool_delay );
@@ -919,6 +1458,13 @@ fsd_drmaa_session_apply_configuration( fsd_drmaa_session_t *self )
 	fsd_conf_option_t *wait_thread = NULL;
 	fsd_conf_option_t *job_categories = NULL;
 	fsd_conf_option_t *missing_jobs = NULL;
+	fsd_conf_option_t *submit_threads = NULL;
+	fsd_conf_option_t *submit_queue_size = NULL;
+	fsd_conf_option_t *metrics_file = NULL;
+	fsd_conf_option_t *metrics_interval = NULL;
+	fsd_conf_option_t *metrics_format = NULL;
+	int interval = 60;
+	fsd_metrics_format_t format = FSD_METRICS_JSON;
 
 	fsd_log_enter((""));
 	if( self->configuration  !=  NULL ) {
@@ -933,6 +1479,16 @@ fsd_drmaa_session_apply_configuration( fsd_drmaa_session_t *self )
 				self->configuration, "job_categories" );
 		missing_jobs = fsd_conf_dict_get(
 				self->configuration, "missing_jobs" );
+		submit_threads = fsd_conf_dict_get(
+				self->configuration, "submit_threads" );
+		submit_queue_size = fsd_conf_dict_get(
+				self->configuration, "submit_queue_size" );
+		metrics_file = fsd_conf_dict_get(
+				self->configuration, "metrics_file" );
+		metrics_interval = fsd_conf_dict_get(
+				self->configuration, "metrics_interval" );
+		metrics_format = fsd_conf_dict_get(
+				self->configuration, "metrics_format" );
 	}
 
 	if( pool_delay )
@@ -1013,6 +1569,76 @@ fsd_drmaa_session_apply_configuration( fsd_drmaa_session_t *self )
 					);
 	 }
 
+	if( submit_threads )
+	 {
+		if( submit_threads->type == FSD_CONF_INTEGER
+				&&  submit_threads->val.integer > 0 )
+		 {
+			fsd_log_debug(("submit_threads=%d", submit_threads->val.integer));
+			self->submit_threads = submit_threads->val.integer;
+		 }
+		else
+			fsd_exc_raise_msg(
+					FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'submit_threads' must be positive integer"
+					);
+	 }
+	if( submit_queue_size )
+	 {
+		if( submit_queue_size->type == FSD_CONF_INTEGER
+				&&  submit_queue_size->val.integer > 0 )
+		 {
+			fsd_log_debug(("submit_queue_size=%d",
+						submit_queue_size->val.integer));
+			self->submit_queue_size = submit_queue_size->val.integer;
+		 }
+		else
+			fsd_exc_raise_msg(
+					FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'submit_queue_size' must be positive integer"
+					);
+	 }
+
+	if( metrics_file  &&  metrics_file->type != FSD_CONF_STRING )
+		fsd_exc_raise_msg(
+				FSD_ERRNO_INTERNAL_ERROR,
+				"configuration: 'metrics_file' should be string"
+				);
+	if( metrics_interval )
+	 {
+		if( metrics_interval->type == FSD_CONF_INTEGER
+				&&  metrics_interval->val.integer > 0 )
+			interval = metrics_interval->val.integer;
+		else
+			fsd_exc_raise_msg(
+					FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'metrics_interval' must be positive integer"
+					);
+	 }
+	if( metrics_format )
+	 {
+		if( metrics_format->type == FSD_CONF_STRING
+				&&  !strcmp( metrics_format->val.string, "json" ) )
+			format = FSD_METRICS_JSON;
+		else if( metrics_format->type == FSD_CONF_STRING
+				&&  !strcmp( metrics_format->val.string, "prometheus" ) )
+			format = FSD_METRICS_PROMETHEUS;
+		else
+			fsd_exc_raise_msg(
+					FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'metrics_format' should be one of: "
+					"'json' or 'prometheus'"
+					);
+	 }
+
+	if( metrics_file  &&  self->metrics_dumper == NULL )
+	 {
+		fsd_log_debug(( "metrics_file=%s metrics_interval=%d",
+					metrics_file->val.string, interval ));
+		self->metrics_dumper = fsd_metrics_dumper_start(
+				metrics_file->val.string, format, interval );
+	 }
+
 	if( self->enable_wait_thread  &&  !self->wait_thread_started )
 	 {
 		fsd_log_debug(("Starting wait thread"));
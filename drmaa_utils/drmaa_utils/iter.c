@@ -18,6 +18,8 @@
  */
 
 
+#include <string.h>
+
 #include <drmaa_utils/iter.h>
 
 #ifndef lint
@@ -110,6 +112,12 @@ fsd_iter_new_impl( char **list, int length, bool own )
 			self->_length = cnt;
 		 }
 		self->_own_list = own;
+		self->_ranges = NULL;
+		self->_n_ranges = 0;
+		self->_range = 0;
+		self->_task = 0;
+		self->_buffer = NULL;
+		self->_buffer_size = 0;
 	 }
 	EXCEPT_DEFAULT
 	 {
@@ -143,3 +151,98 @@ fsd_iter_new_const( const char *const *list, int length )
 	return fsd_iter_new_impl( (char**)list, length, false );
 }
 
+
+
+static const char *
+fsd_iter_range_next( fsd_iter_t *self )
+{
+	fsd_iter_range_t *range = NULL;
+
+	if( self->_position >= self->_length )
+		fsd_exc_raise_code( FSD_ERRNO_STOP_ITERATION );
+
+	range = &self->_ranges[ self->_range ];
+	if( self->_task > range->last )
+	 {
+		range = &self->_ranges[ ++self->_range ];
+		self->_task = range->first;
+	 }
+
+	fsd_snprintf( NULL, self->_buffer, self->_buffer_size,
+			"%s%u", range->prefix, self->_task );
+	self->_task += range->incr;
+	self->_position++;
+	return self->_buffer;
+}
+
+static void
+fsd_iter_range_reset( fsd_iter_t *self )
+{
+	self->_position = 0;
+	self->_range = 0;
+	self->_task = self->_n_ranges > 0 ? self->_ranges[0].first : 0;
+}
+
+static void
+fsd_iter_range_append( fsd_iter_t *self, char *string )
+{
+	fsd_free( string );
+	fsd_exc_raise_msg(
+			FSD_ERRNO_INTERNAL_ERROR,
+			"iter::append called on range iterator" );
+}
+
+static void
+fsd_iter_range_destroy( fsd_iter_t *self )
+{
+	int i;
+	for( i = 0;  i < self->_n_ranges;  i++ )
+		fsd_free( self->_ranges[i].prefix );
+	fsd_free( self->_ranges );
+	fsd_free( self->_buffer );
+	fsd_free( self );
+}
+
+fsd_iter_t *
+fsd_iter_new_range(void)
+{
+	fsd_iter_t *self = NULL;
+	self = fsd_iter_new_impl( NULL, 0, false );
+	self->next = fsd_iter_range_next;
+	self->reset = fsd_iter_range_reset;
+	self->append = fsd_iter_range_append;
+	self->destroy = fsd_iter_range_destroy;
+	return self;
+}
+
+void
+fsd_iter_append_range(
+		fsd_iter_t *self, const char *prefix,
+		unsigned first, unsigned last, unsigned incr
+		)
+{
+	fsd_iter_range_t *range = NULL;
+	size_t size;
+
+	if( first > last  ||  (incr == 0  &&  first != last) )
+		fsd_exc_raise_code( FSD_ERRNO_INVALID_ARGUMENT );
+	if( incr == 0 )
+		incr = 1;
+
+	size = strlen(prefix) + 11; /* digits of unsigned and '\0' */
+	if( size > self->_buffer_size )
+	 {
+		fsd_realloc( self->_buffer, size, char );
+		self->_buffer_size = size;
+	 }
+
+	fsd_realloc( self->_ranges, self->_n_ranges+1, fsd_iter_range_t );
+	range = &self->_ranges[ self->_n_ranges ];
+	range->prefix = fsd_strdup( prefix );
+	range->first = first;
+	range->last = first + (last - first) / incr * incr;
+	range->incr = incr;
+	self->_n_ranges++;
+	self->_length += (range->last - range->first) / incr + 1;
+	self->reset( self );
+}
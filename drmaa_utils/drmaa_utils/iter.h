@@ -32,6 +32,32 @@ fsd_iter_new( char **list, int length );
 fsd_iter_t *
 fsd_iter_new_const( const char *const *list, int length );
 
+/**
+ * Creates empty iterator over ranges of numbered identifiers
+ * (e.g. tasks of array jobs) added by fsd_iter_append_range().
+ * Identifiers are formatted on demand - string returned by
+ * @c next is valid until subsequent call.
+ */
+fsd_iter_t *
+fsd_iter_new_range(void);
+
+/**
+ * Appends identifiers <prefix><first>, <prefix><first+incr>, ...
+ * (up to @a last) to iterator created by fsd_iter_new_range().
+ */
+void
+fsd_iter_append_range(
+		fsd_iter_t *self, const char *prefix,
+		unsigned first, unsigned last, unsigned incr
+		);
+
+typedef struct fsd_iter_range_s {
+	char *prefix;
+	unsigned first;
+	unsigned last;
+	unsigned incr;
+} fsd_iter_range_t;
+
 struct fsd_iter_s {
 	const char* (*next)( fsd_iter_t *self );
 	void (*reset)( fsd_iter_t *self );
@@ -43,6 +69,13 @@ struct fsd_iter_s {
 	int _position;
 	int _length;
 	bool _own_list;
+
+	fsd_iter_range_t *_ranges;
+	int _n_ranges;
+	int _range;
+	unsigned _task;
+	char *_buffer;
+	size_t _buffer_size;
 };
 
 #endif /* __DRMAA_UTILS__ITER_H */
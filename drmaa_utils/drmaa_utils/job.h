@@ -226,6 +226,16 @@ struct fsd_job_set_s {
 	fsd_job_t* (*
 	find_terminated)( fsd_job_set_t *self );
 
+	/**
+	 * Remove up to @a max_jobs terminated jobs from set in single pass.
+	 * @param jobs  Array (of @a max_jobs length) filled with removed jobs.
+	 *   Their references are handed over to caller but they are
+	 *   @b not locked (lock job mutex before #fsd_job_s.release).
+	 * @return Number of removed jobs.
+	 */
+	size_t (*
+	detach_terminated)( fsd_job_set_t *self, fsd_job_t **jobs, size_t max_jobs );
+
 	/**
 	 * Return idenetifiers of all jobs in set.
 	 * @param job_set Set of jobs.
@@ -0,0 +1,399 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/exception.h>
+#include <drmaa_utils/lockprof.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+/*
+ * Profiler is called from inside of fsd_mutex_* so it must not use them:
+ * name registry is guarded by plain rwlock and statistics are updated
+ * with atomic operations.
+ */
+
+#define FSD_LOCKPROF_CLASSES 32
+#define FSD_LOCKPROF_BUCKETS 1024 /* power of 2 */
+#define FSD_LOCKPROF_HELD 16
+
+typedef struct {
+	const char *name;
+	volatile uint64_t acquired;
+	volatile uint64_t contended;
+	volatile uint64_t wait_ns;
+	volatile uint64_t wait_max_ns;
+	volatile uint64_t hold_ns;
+	volatile uint64_t hold_max_ns;
+} fsd_lockprof_class_t;
+
+typedef struct fsd_lockprof_name_s fsd_lockprof_name_t;
+struct fsd_lockprof_name_s {
+	const fsd_mutex_t *mutex;
+	int class_id;
+	fsd_lockprof_name_t *next;
+};
+
+/* mutex held by current thread */
+typedef struct {
+	const fsd_mutex_t *mutex;
+	int class_id;
+	int depth;
+	uint64_t since;
+} fsd_lockprof_held_t;
+
+bool fsd_lockprof_enabled = false;
+
+static const char *fsd_lockprof_path = NULL;
+static pthread_once_t fsd_lockprof_once = PTHREAD_ONCE_INIT;
+static pthread_rwlock_t fsd_lockprof_names_lock = PTHREAD_RWLOCK_INITIALIZER;
+static fsd_lockprof_name_t *fsd_lockprof_names[FSD_LOCKPROF_BUCKETS];
+static fsd_lockprof_class_t fsd_lockprof_classes[FSD_LOCKPROF_CLASSES] = {
+	{ "other", 0, 0, 0, 0, 0, 0 }
+};
+static volatile int fsd_lockprof_n_classes = 1;
+
+static __thread fsd_lockprof_held_t fsd_lockprof_held[FSD_LOCKPROF_HELD];
+static __thread int fsd_lockprof_n_held = 0;
+
+
+static void
+fsd_lockprof_do_init( void )
+{
+	const char *value = getenv( "DRMAA_LOCK_PROFILE" );
+	if( value != NULL  &&  value[0] != '\0' )
+	 {
+		fsd_lockprof_path = value;
+		fsd_lockprof_enabled = true;
+	 }
+}
+
+
+void
+fsd_lockprof_init( void )
+{
+	pthread_once( &fsd_lockprof_once, fsd_lockprof_do_init );
+}
+
+
+static uint64_t
+fsd_lockprof_ns( const struct timespec *ts )
+{
+	return (uint64_t)ts->tv_sec * 1000000000u + (uint64_t)ts->tv_nsec;
+}
+
+
+static uint64_t
+fsd_lockprof_now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return fsd_lockprof_ns( &ts );
+}
+
+
+static void
+fsd_lockprof_update_max( volatile uint64_t *max, uint64_t value )
+{
+	uint64_t current = *max;
+	while( value > current )
+	 {
+		if( __sync_bool_compare_and_swap( max, current, value ) )
+			break;
+		current = *max;
+	 }
+}
+
+
+static unsigned
+fsd_lockprof_hash( const fsd_mutex_t *mutex )
+{
+	uintptr_t p = (uintptr_t)mutex;
+	return (unsigned)((p >> 4) ^ (p >> 14)) & (FSD_LOCKPROF_BUCKETS - 1);
+}
+
+
+static int
+fsd_lockprof_class_of( const fsd_mutex_t *mutex )
+{
+	const fsd_lockprof_name_t *i;
+	int result = 0;
+
+	pthread_rwlock_rdlock( &fsd_lockprof_names_lock );
+	for( i = fsd_lockprof_names[ fsd_lockprof_hash( mutex ) ];  i;  i = i->next )
+		if( i->mutex == mutex )
+		 {
+			result = i->class_id;
+			break;
+		 }
+	pthread_rwlock_unlock( &fsd_lockprof_names_lock );
+	return result;
+}
+
+
+void
+fsd_mutex_set_name( fsd_mutex_t *mutex, const char *name )
+{
+	fsd_lockprof_name_t *i;
+	int class_id;
+	unsigned h;
+
+	if( !fsd_lockprof_enabled )
+		return;
+	if( name == NULL )
+	 {
+		fsd_lockprof_forget( mutex );
+		return;
+	 }
+
+	h = fsd_lockprof_hash( mutex );
+	pthread_rwlock_wrlock( &fsd_lockprof_names_lock );
+	for( class_id = 0;  class_id < fsd_lockprof_n_classes;  class_id++ )
+		if( !strcmp( fsd_lockprof_classes[class_id].name, name ) )
+			break;
+	if( class_id == fsd_lockprof_n_classes )
+	 {
+		if( class_id < FSD_LOCKPROF_CLASSES )
+		 {
+			fsd_lockprof_classes[class_id].name = name;
+			fsd_lockprof_n_classes++;
+		 }
+		else
+			class_id = 0;
+	 }
+
+	for( i = fsd_lockprof_names[h];  i;  i = i->next )
+		if( i->mutex == mutex )
+			break;
+	if( i == NULL  &&  (i = malloc( sizeof(fsd_lockprof_name_t) )) != NULL )
+	 {
+		i->mutex = mutex;
+		i->next = fsd_lockprof_names[h];
+		fsd_lockprof_names[h] = i;
+	 }
+	if( i != NULL )
+		i->class_id = class_id;
+	pthread_rwlock_unlock( &fsd_lockprof_names_lock );
+}
+
+
+void
+fsd_lockprof_forget( fsd_mutex_t *mutex )
+{
+	fsd_lockprof_name_t **i;
+
+	pthread_rwlock_wrlock( &fsd_lockprof_names_lock );
+	for( i = &fsd_lockprof_names[ fsd_lockprof_hash( mutex ) ];  *i;  i = &(*i)->next )
+		if( (*i)->mutex == mutex )
+		 {
+			fsd_lockprof_name_t *found = *i;
+			*i = found->next;
+			free( found );
+			break;
+		 }
+	pthread_rwlock_unlock( &fsd_lockprof_names_lock );
+}
+
+
+void
+fsd_lockprof_wait_start( struct timespec *start )
+{
+	clock_gettime( CLOCK_MONOTONIC, start );
+}
+
+
+static fsd_lockprof_held_t *
+fsd_lockprof_find_held( const fsd_mutex_t *mutex )
+{
+	int i;
+	for( i = fsd_lockprof_n_held - 1;  i >= 0;  i-- )
+		if( fsd_lockprof_held[i].mutex == mutex )
+			return &fsd_lockprof_held[i];
+	return NULL;
+}
+
+
+void
+fsd_lockprof_acquired( fsd_mutex_t *mutex, const struct timespec *wait_start )
+{
+	fsd_lockprof_held_t *held = fsd_lockprof_find_held( mutex );
+	fsd_lockprof_class_t *c = NULL;
+	uint64_t now;
+
+	if( held != NULL )
+	 { /* recursive acquisition */
+		held->depth++;
+		return;
+	 }
+
+	now = fsd_lockprof_now();
+	if( fsd_lockprof_n_held < FSD_LOCKPROF_HELD )
+	 {
+		held = &fsd_lockprof_held[ fsd_lockprof_n_held++ ];
+		held->mutex = mutex;
+		held->class_id = fsd_lockprof_class_of( mutex );
+		held->depth = 1;
+		held->since = now;
+		c = &fsd_lockprof_classes[ held->class_id ];
+	 }
+	else
+		c = &fsd_lockprof_classes[ fsd_lockprof_class_of( mutex ) ];
+
+	__sync_fetch_and_add( &c->acquired, 1 );
+	if( wait_start != NULL )
+	 {
+		uint64_t waited = now - fsd_lockprof_ns( wait_start );
+		__sync_fetch_and_add( &c->contended, 1 );
+		__sync_fetch_and_add( &c->wait_ns, waited );
+		fsd_lockprof_update_max( &c->wait_max_ns, waited );
+	 }
+}
+
+
+static void
+fsd_lockprof_account_hold( fsd_lockprof_held_t *held )
+{
+	fsd_lockprof_class_t *c = &fsd_lockprof_classes[ held->class_id ];
+	uint64_t held_ns = fsd_lockprof_now() - held->since;
+	__sync_fetch_and_add( &c->hold_ns, held_ns );
+	fsd_lockprof_update_max( &c->hold_max_ns, held_ns );
+}
+
+
+void
+fsd_lockprof_released( fsd_mutex_t *mutex, bool all )
+{
+	fsd_lockprof_held_t *held = fsd_lockprof_find_held( mutex );
+
+	/* not found when lock was taken before profiling or table was full */
+	if( held == NULL )
+		return;
+	if( !all  &&  --held->depth > 0 )
+		return;
+
+	fsd_lockprof_account_hold( held );
+	*held = fsd_lockprof_held[ --fsd_lockprof_n_held ];
+}
+
+
+void
+fsd_lockprof_suspend( fsd_mutex_t *mutex )
+{
+	fsd_lockprof_held_t *held = fsd_lockprof_find_held( mutex );
+	if( held != NULL )
+		fsd_lockprof_account_hold( held );
+}
+
+
+void
+fsd_lockprof_resume( fsd_mutex_t *mutex )
+{
+	fsd_lockprof_held_t *held = fsd_lockprof_find_held( mutex );
+	if( held != NULL )
+		held->since = fsd_lockprof_now();
+}
+
+
+void
+fsd_lockprof_report( FILE *stream )
+{
+	int i;
+
+	if( !fsd_lockprof_enabled )
+	 {
+		fprintf( stream, "# lock profiling disabled (set DRMAA_LOCK_PROFILE)\n" );
+		return;
+	 }
+
+	fprintf( stream, "%-20s %12s %12s %14s %12s %14s %12s\n",
+			"lock", "acquired", "contended", "wait_total_ms", "wait_max_ms",
+			"hold_total_ms", "hold_max_ms" );
+	for( i = 0;  i < fsd_lockprof_n_classes;  i++ )
+	 {
+		const fsd_lockprof_class_t *c = &fsd_lockprof_classes[i];
+		if( c->acquired == 0 )
+			continue;
+		fprintf( stream, "%-20s %12llu %12llu %14.3f %12.3f %14.3f %12.3f\n",
+				c->name,
+				(unsigned long long)c->acquired,
+				(unsigned long long)c->contended,
+				c->wait_ns / 1e6, c->wait_max_ns / 1e6,
+				c->hold_ns / 1e6, c->hold_max_ns / 1e6 );
+	 }
+}
+
+
+char *
+fsd_lockprof_format( void )
+{
+	char *volatile result = NULL;
+	size_t size = 0;
+	FILE *stream = NULL;
+
+	stream = open_memstream( (char**)&result, &size );
+	if( stream == NULL )
+		fsd_exc_raise_sys( 0 );
+	fsd_lockprof_report( stream );
+	fclose( stream );
+
+	if( result == NULL )
+		fsd_exc_raise_code( FSD_ERRNO_NO_MEMORY );
+	return result;
+}
+
+
+void
+fsd_lockprof_report_at_exit( void )
+{
+	FILE *stream = NULL;
+
+	if( !fsd_lockprof_enabled )
+		return;
+
+	if( !strcmp( fsd_lockprof_path, "-" ) )
+		stream = stderr;
+	else
+		stream = fopen( fsd_lockprof_path, "a" );
+	if( stream == NULL )
+		return;
+
+	fprintf( stream, "# lock profile of process %d\n", (int)getpid() );
+	fsd_lockprof_report( stream );
+	if( stream != stderr )
+		fclose( stream );
+	else
+		fflush( stream );
+}
@@ -0,0 +1,89 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file lockprof.h
+ * Mutex contention profiler.
+ *
+ * Enabled by setting @c DRMAA_LOCK_PROFILE environment variable
+ * before first mutex is created.  Then every mutex operation
+ * of thread.c is accounted to lock class named with
+ * fsd_mutex_set_name() (mutexes with the same name are aggregated,
+ * not named ones fall to "other"): number of acquisitions, contended
+ * acquisitions, total and maximal time spent waiting and holding lock.
+ * Report is written at drmaa_exit() to file named by the variable
+ * (@c - means standard error) and is available on demand
+ * with fsd_lockprof_format().
+ *
+ * When disabled mutex operations only test #fsd_lockprof_enabled.
+ */
+
+#ifndef __DRMAA_UTILS__LOCKPROF_H
+#define __DRMAA_UTILS__LOCKPROF_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <stdio.h>
+#include <time.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/thread.h>
+
+/** Whether profiling is on (set once from environment). */
+extern bool fsd_lockprof_enabled;
+
+/** Reads @c DRMAA_LOCK_PROFILE (called once by fsd_mutex_init). */
+void fsd_lockprof_init( void );
+
+/** Start of waiting for contended mutex. */
+void fsd_lockprof_wait_start( struct timespec *start );
+
+/**
+ * Mutex was acquired by current thread.
+ * @param wait_start  Start of waiting or @c NULL when not contended.
+ */
+void fsd_lockprof_acquired( fsd_mutex_t *mutex, const struct timespec *wait_start );
+
+/**
+ * Mutex is going to be released by current thread
+ * (@a all - every recursive acquisition at once).
+ */
+void fsd_lockprof_released( fsd_mutex_t *mutex, bool all );
+
+/** Mutex is going to be released by condition wait. */
+void fsd_lockprof_suspend( fsd_mutex_t *mutex );
+
+/** Mutex was reacquired after condition wait. */
+void fsd_lockprof_resume( fsd_mutex_t *mutex );
+
+/** Mutex is destroyed - forget its name. */
+void fsd_lockprof_forget( fsd_mutex_t *mutex );
+
+/** Write report table to stream. */
+void fsd_lockprof_report( FILE *stream );
+
+/** Format report (free result with fsd_free). */
+char *fsd_lockprof_format( void );
+
+/** Write report where @c DRMAA_LOCK_PROFILE points (if enabled). */
+void fsd_lockprof_report_at_exit( void );
+
+#endif /* __DRMAA_UTILS__LOCKPROF_H */
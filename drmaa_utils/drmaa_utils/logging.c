@@ -22,18 +22,24 @@
 #endif
 
 #include <sys/time.h>
+#include <sys/uio.h>
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
 #ifdef HAVE_EXECINFO_H
 #	include <execinfo.h>
 #endif
 
 #include <drmaa_utils/common.h>
 #include <drmaa_utils/logging.h>
+#include <drmaa_utils/logrec.h>
 #include <drmaa_utils/lookup3.h>
 #include <drmaa_utils/thread.h>
 
@@ -58,7 +64,340 @@ fsd_verbose_level_t fsd_verbose_level =
 
 static struct timeval fsd_logging_start = {0, 0};
 
-static void fsd_log_check_verbosity( void );
+static pthread_once_t fsd_log_check_once = PTHREAD_ONCE_INIT;
+
+bool fsd_log_binary = false;
+
+typedef union {
+	fsd_logrec_event_t event;
+	char data[FSD_LOGREC_MAX];
+} fsd_log_bin_record_t;
+
+static size_t fsd_log_bin_text( fsd_log_bin_record_t *record,
+		int level, const char *message );
+
+
+/*
+ * Asynchronous mode: lines are formatted by calling thread into bounded
+ * ring of fixed size records and written by background thread in
+ * batches.  Producers reserve records with compare-and-swap on
+ * enqueue position; each record carries sequence number telling whether
+ * it is free (pos), filled (pos+1) or not yet consumed in previous lap.
+ * When ring is full lines below warning level are dropped (and counted),
+ * more severe ones are written directly.
+ */
+#define FSD_LOG_RING_SIZE   2048 /* power of 2 */
+#define FSD_LOG_RECORD_MAX  512
+#define FSD_LOG_BATCH       64
+
+typedef struct {
+	volatile size_t seq;
+	size_t len;
+	char data[FSD_LOG_RECORD_MAX];
+} fsd_log_record_t;
+
+static volatile bool fsd_log_async = false;
+static fsd_log_record_t *fsd_log_ring = NULL;
+static volatile size_t fsd_log_enqueue_pos = 0;
+static volatile size_t fsd_log_dequeue_pos = 0;
+static volatile unsigned long fsd_log_dropped = 0;
+static volatile bool fsd_log_writer_idle = false;
+
+/* plain mutex - logging must not depend on fsd_mutex_* */
+static pthread_mutex_t fsd_log_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fsd_log_writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t fsd_log_drained_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t fsd_log_writer;
+static bool fsd_log_writer_started = false;
+static bool fsd_log_writer_stop = false;
+
+
+static void
+fsd_log_deadline( struct timespec *ts, long ms )
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	ts->tv_sec = tv.tv_sec + ms / 1000;
+	ts->tv_nsec = tv.tv_usec * 1000 + (ms % 1000) * 1000000;
+	if( ts->tv_nsec >= 1000000000 )
+	 {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	 }
+}
+
+
+static void
+fsd_log_write_all( const char *data, size_t len )
+{
+	while( len > 0 )
+	 {
+		ssize_t rc = write( fsd_logging_output, data, len );
+		if( rc == -1  &&  errno == EINTR )
+			continue;
+		if( rc <= 0 )
+			return;
+		data += rc;
+		len -= rc;
+	 }
+}
+
+
+static void
+fsd_log_writev_all( struct iovec *iov, int n )
+{
+	while( n > 0 )
+	 {
+		ssize_t rc = writev( fsd_logging_output, iov, n );
+		if( rc == -1  &&  errno == EINTR )
+			continue;
+		if( rc <= 0 )
+			return;
+		/* skip fully written lines and continue after partial write */
+		while( n > 0  &&  (size_t)rc >= iov->iov_len )
+		 {
+			rc -= iov->iov_len;
+			iov++;
+			n--;
+		 }
+		if( n > 0 )
+		 {
+			iov->iov_base = (char*)iov->iov_base + rc;
+			iov->iov_len -= rc;
+		 }
+	 }
+}
+
+
+/* Writes batch of consecutive filled records.  Returns their number. */
+static int
+fsd_log_drain( void )
+{
+	struct iovec iov[FSD_LOG_BATCH];
+	size_t pos = fsd_log_dequeue_pos;
+	unsigned long dropped;
+	int i, n = 0;
+
+	while( n < FSD_LOG_BATCH )
+	 {
+		fsd_log_record_t *record = &fsd_log_ring[ (pos + n) & (FSD_LOG_RING_SIZE-1) ];
+		if( record->seq != pos + n + 1 )
+			break;
+		iov[n].iov_base = record->data;
+		iov[n].iov_len = record->len;
+		n++;
+	 }
+	if( n == 0 )
+		return 0;
+
+	__sync_synchronize();
+	fsd_log_writev_all( iov, n );
+	dropped = __sync_lock_test_and_set( &fsd_log_dropped, 0 );
+	if( dropped > 0 )
+	 {
+		char note[64];
+		int len;
+		if( fsd_log_binary )
+		 {
+			fsd_log_bin_record_t record;
+			snprintf( note, sizeof(note),
+					"%lu log lines dropped (queue full)", dropped );
+			fsd_log_write_all( record.data,
+					fsd_log_bin_text( &record, FSD_LOG_WARNING, note ) );
+		 }
+		else
+		 {
+			len = snprintf( note, sizeof(note),
+					"W #---- %lu log lines dropped (queue full)\n", dropped );
+			fsd_log_write_all( note, len );
+		 }
+	 }
+	__sync_synchronize();
+	for( i = 0;  i < n;  i++ )
+		fsd_log_ring[ (pos + i) & (FSD_LOG_RING_SIZE-1) ].seq
+				= pos + i + FSD_LOG_RING_SIZE;
+	fsd_log_dequeue_pos = pos + n;
+	return n;
+}
+
+
+static void *
+fsd_log_writer_thread( void *arg )
+{
+	while( true )
+	 {
+		size_t pos;
+
+		if( fsd_log_drain() > 0 )
+		 {
+			pthread_mutex_lock( &fsd_log_writer_mutex );
+			pthread_cond_broadcast( &fsd_log_drained_cond );
+			pthread_mutex_unlock( &fsd_log_writer_mutex );
+			continue;
+		 }
+
+		pthread_mutex_lock( &fsd_log_writer_mutex );
+		if( fsd_log_writer_stop )
+		 {
+			pthread_mutex_unlock( &fsd_log_writer_mutex );
+			break;
+		 }
+		fsd_log_writer_idle = true;
+		__sync_synchronize();
+		pos = fsd_log_dequeue_pos;
+		if( fsd_log_ring[ pos & (FSD_LOG_RING_SIZE-1) ].seq != pos + 1 )
+		 {
+			struct timespec ts;
+			fsd_log_deadline( &ts, 100 );
+			pthread_cond_timedwait( &fsd_log_writer_cond, &fsd_log_writer_mutex, &ts );
+		 }
+		fsd_log_writer_idle = false;
+		pthread_mutex_unlock( &fsd_log_writer_mutex );
+	 }
+	return arg;
+}
+
+
+static bool
+fsd_log_start_writer( void )
+{
+	pthread_mutex_lock( &fsd_log_writer_mutex );
+	if( !fsd_log_writer_started  &&  fsd_log_async )
+	 {
+		size_t i;
+		if( fsd_log_ring == NULL )
+			fsd_log_ring = (fsd_log_record_t*)calloc(
+					FSD_LOG_RING_SIZE, sizeof(fsd_log_record_t) );
+		if( fsd_log_ring != NULL )
+		 {
+			for( i = 0;  i < FSD_LOG_RING_SIZE;  i++ )
+				fsd_log_ring[i].seq = fsd_log_dequeue_pos + i;
+			fsd_log_enqueue_pos = fsd_log_dequeue_pos;
+			fsd_log_writer_stop = false;
+			if( pthread_create( &fsd_log_writer, NULL, fsd_log_writer_thread, NULL ) == 0 )
+				fsd_log_writer_started = true;
+		 }
+		if( !fsd_log_writer_started )
+			fsd_log_async = false;
+	 }
+	pthread_mutex_unlock( &fsd_log_writer_mutex );
+	return fsd_log_writer_started;
+}
+
+
+/* Returns false when ring is full. */
+static bool
+fsd_log_enqueue( const char *line, size_t len )
+{
+	fsd_log_record_t *record = NULL;
+	size_t pos = fsd_log_enqueue_pos;
+
+	while( true )
+	 {
+		intptr_t diff;
+		record = &fsd_log_ring[ pos & (FSD_LOG_RING_SIZE-1) ];
+		diff = (intptr_t)record->seq - (intptr_t)pos;
+		if( diff == 0 )
+		 {
+			if( __sync_bool_compare_and_swap( &fsd_log_enqueue_pos, pos, pos + 1 ) )
+				break;
+		 }
+		else if( diff < 0 )
+			return false;
+		pos = fsd_log_enqueue_pos;
+	 }
+
+	memcpy( record->data, line, len );
+	record->len = len;
+	__sync_synchronize();
+	record->seq = pos + 1;
+
+	__sync_synchronize();
+	if( fsd_log_writer_idle )
+	 {
+		pthread_mutex_lock( &fsd_log_writer_mutex );
+		pthread_cond_signal( &fsd_log_writer_cond );
+		pthread_mutex_unlock( &fsd_log_writer_mutex );
+	 }
+	return true;
+}
+
+
+static void
+fsd_log_output_line( int level, const char *line, size_t len )
+{
+	if( fsd_log_async  &&  (fsd_log_writer_started  ||  fsd_log_start_writer()) )
+	 {
+		if( fsd_log_enqueue( line, len ) )
+			return;
+		if( level < FSD_LOG_WARNING )
+		 {
+			__sync_fetch_and_add( &fsd_log_dropped, 1 );
+			return;
+		 }
+	 }
+	fsd_log_write_all( line, len );
+}
+
+
+void
+fsd_log_flush( void )
+{
+	size_t target = fsd_log_enqueue_pos;
+
+	pthread_mutex_lock( &fsd_log_writer_mutex );
+	while( fsd_log_writer_started  &&  (intptr_t)(target - fsd_log_dequeue_pos) > 0 )
+	 {
+		struct timespec ts;
+		pthread_cond_signal( &fsd_log_writer_cond );
+		fsd_log_deadline( &ts, 100 );
+		pthread_cond_timedwait( &fsd_log_drained_cond, &fsd_log_writer_mutex, &ts );
+	 }
+	pthread_mutex_unlock( &fsd_log_writer_mutex );
+}
+
+
+void
+fsd_log_set_async( bool enable )
+{
+	if( enable )
+	 {
+		fsd_log_async = true;
+		return;
+	 }
+
+	fsd_log_async = false;
+	fsd_log_flush();
+	pthread_mutex_lock( &fsd_log_writer_mutex );
+	if( fsd_log_writer_started )
+	 {
+		fsd_log_writer_stop = true;
+		pthread_cond_signal( &fsd_log_writer_cond );
+		pthread_mutex_unlock( &fsd_log_writer_mutex );
+		pthread_join( fsd_log_writer, NULL );
+		pthread_mutex_lock( &fsd_log_writer_mutex );
+		/* lines queued by threads which did not notice switch yet */
+		while( fsd_log_drain() > 0 ) {}
+		fsd_log_writer_started = false;
+	 }
+	pthread_mutex_unlock( &fsd_log_writer_mutex );
+}
+
+
+/*
+ * Queue is flushed and writer thread stopped when library is unloaded
+ * (or process exits).  atexit() handler would outlive dlclose()
+ * of library and jump into unmapped code at exit.
+ */
+#ifdef __GNUC__
+static void fsd_log_at_unload( void ) __attribute__ ((destructor));
+#endif
+
+static void
+fsd_log_at_unload( void )
+{
+	fsd_log_set_async( false );
+}
 
 void
 fsd_set_verbosity_level( fsd_verbose_level_t level )
@@ -73,6 +412,295 @@ fsd_set_logging_fd( int fd )
 }
 
 
+/*
+ * Binary mode: instead of formatting message each call site writes
+ * (once) its format string and then only raw arguments (see logrec.h).
+ * Site identifiers are kept in static variables of call sites
+ * (_log_bin macro) and assigned under mutex; site record is written
+ * directly (before any event of site could be queued).
+ */
+typedef struct {
+	volatile uint32_t *site;
+	int level;
+	const char *function;
+	int kind;
+} fsd_log_bin_site_t;
+
+static pthread_mutex_t fsd_log_bin_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t fsd_log_bin_n_sites = FSD_LOGREC_TEXT_SITE;
+static __thread fsd_log_bin_site_t fsd_log_bin_site;
+
+
+static uint64_t
+fsd_log_bin_now( void )
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (uint64_t)tv.tv_sec * 1000000u + tv.tv_usec;
+}
+
+
+static void
+fsd_log_bin_write_site( uint32_t id, const char *function, const char *fmt )
+{
+	fsd_logrec_site_t site;
+	struct iovec iov[3];
+	size_t function_len = function ? strlen( function ) : 0;
+	size_t fmt_len = strlen( fmt );
+
+	if( function_len > 1024 )
+		function_len = 1024;
+	if( fmt_len > 0xffff - sizeof(site) - function_len )
+		fmt_len = 0xffff - sizeof(site) - function_len;
+	memset( &site, 0, sizeof(site) );
+	site.head.type = FSD_LOGREC_SITE;
+	site.head.size = sizeof(site) + function_len + fmt_len;
+	site.site = id;
+	site.function_len = function_len;
+	site.format_len = fmt_len;
+	iov[0].iov_base = &site;
+	iov[0].iov_len = sizeof(site);
+	iov[1].iov_base = (char*)function;
+	iov[1].iov_len = function_len;
+	iov[2].iov_base = (char*)fmt;
+	iov[2].iov_len = fmt_len;
+	fsd_log_writev_all( iov, 3 );
+}
+
+
+static void
+fsd_log_bin_register( volatile uint32_t *site, const char *function,
+		const char *fmt )
+{
+	pthread_mutex_lock( &fsd_log_bin_mutex );
+	if( *site == 0 )
+	 {
+		uint32_t id = ++fsd_log_bin_n_sites;
+		fsd_log_bin_write_site( id, function, fmt );
+		__sync_synchronize();
+		*site = id;
+	 }
+	pthread_mutex_unlock( &fsd_log_bin_mutex );
+}
+
+
+static size_t
+fsd_log_bin_event( fsd_log_bin_record_t *record, uint32_t site,
+		int level, int kind )
+{
+	memset( &record->event, 0, sizeof(fsd_logrec_event_t) );
+	record->event.head.type = FSD_LOGREC_EVENT;
+	record->event.site = site;
+	record->event.tid = fsd_thread_id();
+	record->event.level = level;
+	record->event.kind = kind;
+	record->event.time_us = fsd_log_bin_now();
+	return sizeof(fsd_logrec_event_t);
+}
+
+
+static bool
+fsd_log_bin_put( fsd_log_bin_record_t *record, size_t *size,
+		const void *data, size_t len )
+{
+	if( *size + len > FSD_LOGREC_MAX )
+		return false;
+	memcpy( record->data + *size, data, len );
+	*size += len;
+	return true;
+}
+
+
+/* Puts string cut off to space left - returns false when it was cut. */
+static bool
+fsd_log_bin_put_string( fsd_log_bin_record_t *record, size_t *size,
+		const char *s )
+{
+	size_t len = strlen( s );
+	uint16_t len16;
+
+	if( *size + sizeof(len16) > FSD_LOGREC_MAX )
+		return false;
+	if( *size + sizeof(len16) + len > FSD_LOGREC_MAX )
+		len16 = FSD_LOGREC_MAX - *size - sizeof(len16);
+	else
+		len16 = len;
+	fsd_log_bin_put( record, size, &len16, sizeof(len16) );
+	fsd_log_bin_put( record, size, s, len16 );
+	return len16 == len;
+}
+
+
+static size_t
+fsd_log_bin_finish( fsd_log_bin_record_t *record, size_t size, bool complete )
+{
+	if( !complete )
+		record->event.flags |= FSD_LOGREC_TRUNCATED;
+	record->event.head.size = size;
+	return size;
+}
+
+
+static size_t
+fsd_log_bin_text( fsd_log_bin_record_t *record, int level, const char *message )
+{
+	size_t size = fsd_log_bin_event( record, FSD_LOGREC_TEXT_SITE,
+			level, _FSD_LOG_MSG );
+	bool complete = fsd_log_bin_put_string( record, &size, message );
+	return fsd_log_bin_finish( record, size, complete );
+}
+
+
+static int64_t
+fsd_log_bin_int_arg( const fsd_logarg_spec_t *spec, va_list *args )
+{
+	if( spec->type == FSD_LOGARG_INT )
+		switch( spec->length )
+		 {
+			case FSD_LOGARG_LONG:       return va_arg( *args, long );
+			case FSD_LOGARG_LONG_LONG:  return va_arg( *args, long long );
+			case FSD_LOGARG_SIZE:       return va_arg( *args, ssize_t );
+			case FSD_LOGARG_INTMAX:     return va_arg( *args, intmax_t );
+			case FSD_LOGARG_PTRDIFF:    return va_arg( *args, ptrdiff_t );
+			default:                    return va_arg( *args, int );
+		 }
+	else
+		switch( spec->length )
+		 {
+			case FSD_LOGARG_LONG:       return va_arg( *args, unsigned long );
+			case FSD_LOGARG_LONG_LONG:  return va_arg( *args, unsigned long long );
+			case FSD_LOGARG_SIZE:       return va_arg( *args, size_t );
+			case FSD_LOGARG_INTMAX:     return va_arg( *args, uintmax_t );
+			case FSD_LOGARG_PTRDIFF:    return va_arg( *args, ptrdiff_t );
+			default:                    return va_arg( *args, unsigned );
+		 }
+}
+
+
+void
+_fsd_log_bin_begin( volatile uint32_t *site, int level,
+		const char *function, int kind )
+{
+	fsd_log_bin_site.site = site;
+	fsd_log_bin_site.level = level;
+	fsd_log_bin_site.function = function;
+	fsd_log_bin_site.kind = kind;
+}
+
+
+void
+_fsd_log_bin( const char *fmt, ... )
+{
+	const fsd_log_bin_site_t *ctx = &fsd_log_bin_site;
+	fsd_log_bin_record_t record;
+	fsd_logarg_spec_t spec;
+	const char *p = fmt;
+	int saved_errno = errno;
+	bool complete = true;
+	size_t size;
+	va_list args;
+
+	if( *ctx->site == 0 )
+		fsd_log_bin_register( ctx->site, ctx->function, fmt );
+	size = fsd_log_bin_event( &record, *ctx->site, ctx->level, ctx->kind );
+
+	va_start( args, fmt );
+	while( complete  &&  fsd_logarg_next( &p, &spec ) )
+	 {
+		int64_t i;
+		double d;
+		void *ptr;
+		uint64_t u;
+
+		if( spec.width_star )
+		 {
+			i = va_arg( args, int );
+			if( !(complete = fsd_log_bin_put( &record, &size, &i, sizeof(i) )) )
+				break;
+		 }
+		if( spec.precision_star )
+		 {
+			i = va_arg( args, int );
+			if( !(complete = fsd_log_bin_put( &record, &size, &i, sizeof(i) )) )
+				break;
+		 }
+
+		switch( spec.type )
+		 {
+			case FSD_LOGARG_INT:
+			case FSD_LOGARG_UINT:
+				i = fsd_log_bin_int_arg( &spec, &args );
+				complete = fsd_log_bin_put( &record, &size, &i, sizeof(i) );
+				break;
+			case FSD_LOGARG_DOUBLE:
+				if( spec.length == FSD_LOGARG_LONG_DOUBLE )
+					d = va_arg( args, long double );
+				else
+					d = va_arg( args, double );
+				complete = fsd_log_bin_put( &record, &size, &d, sizeof(d) );
+				break;
+			case FSD_LOGARG_STRING:
+				ptr = va_arg( args, char* );
+				complete = fsd_log_bin_put_string( &record, &size,
+						ptr ? (const char*)ptr : "(null)" );
+				break;
+			case FSD_LOGARG_POINTER:
+				ptr = va_arg( args, void* );
+				if( spec.conversion == 'n' )
+					break;
+				u = (uintptr_t)ptr;
+				complete = fsd_log_bin_put( &record, &size, &u, sizeof(u) );
+				break;
+			case FSD_LOGARG_ERRNO:
+			 {
+				char buf[256];
+				complete = fsd_log_bin_put_string( &record, &size,
+						fsd_strerror_r( saved_errno, buf, sizeof(buf) ) );
+				break;
+			 }
+			case FSD_LOGARG_NONE:
+				break;
+		 }
+	 }
+	va_end( args );
+
+	size = fsd_log_bin_finish( &record, size, complete );
+	fsd_log_output_line( ctx->level, record.data, size );
+	errno = saved_errno;
+}
+
+
+bool
+fsd_log_set_binary( const char *path )
+{
+	fsd_logrec_header_t header;
+	bool result = false;
+	int fd;
+
+	fsd_log_flush();
+	pthread_mutex_lock( &fsd_log_bin_mutex );
+	if( !fsd_log_binary )
+	 {
+		fd = open( path, O_WRONLY | O_CREAT | O_APPEND, 0600 );
+		if( fd != -1 )
+		 {
+			memset( &header, 0, sizeof(header) );
+			memcpy( header.magic, FSD_LOGREC_MAGIC, sizeof(header.magic) );
+			header.version = FSD_LOGREC_VERSION;
+			header.byte_order = FSD_LOGREC_BYTE_ORDER;
+			header.start_us = fsd_log_bin_now();
+			fsd_logging_output = fd;
+			fsd_log_write_all( (const char*)&header, sizeof(header) );
+			fsd_log_bin_write_site( FSD_LOGREC_TEXT_SITE, "", "%s" );
+			fsd_log_binary = true;
+			result = true;
+		 }
+	 }
+	pthread_mutex_unlock( &fsd_log_bin_mutex );
+	return result;
+}
+
+
 void
 fsd_color( char *output, size_t len, int n )
 {
@@ -119,6 +747,15 @@ _fsd_log( int level, const char *file, const char *function,
 	if( message == NULL )
 		return;
 
+	if( fsd_log_binary )
+	 { /* start time is in file header */
+		fsd_log_bin_record_t record;
+		fsd_log_output_line( level, record.data,
+				fsd_log_bin_text( &record, level, message ) );
+		free( message );
+		return;
+	 }
+
 	tid = fsd_thread_id();
 	if( color )
 	 {
@@ -186,20 +823,30 @@ _fsd_log( int level, const char *file, const char *function,
 		else
 		 {
 			const char *end;
+			char buf[FSD_LOG_RECORD_MAX];
 			char *line = NULL;
 			int rc;
 			end = strchr( p, '\n' );
 			if( end == NULL )
 				end = p + strlen(p);
-			rc = asprintf( &line, "%c #%s%04x%s [%6ld.%02ld] %s %s%.*s\n",
+			rc = snprintf( buf, sizeof(buf), "%c #%s%04x%s [%6ld.%02ld] %s %s%.*s\n",
 					fsd_log_level_char(level), colorbeg, tid, colorend,
 					seconds, microseconds/10000, prefix, function, (int)(end-p), p
 					);
-			if( rc != -1 )
-				write( fsd_logging_output, line, strlen(line) );
+			if( rc >= 0  &&  rc < (int)sizeof(buf) )
+				fsd_log_output_line( level, buf, rc );
 			else
-				return;
-			free( line );
+			 { /* too long for ring record - written directly */
+				rc = asprintf( &line, "%c #%s%04x%s [%6ld.%02ld] %s %s%.*s\n",
+						fsd_log_level_char(level), colorbeg, tid, colorend,
+						seconds, microseconds/10000, prefix, function, (int)(end-p), p
+						);
+				if( rc != -1 )
+					fsd_log_write_all( line, rc );
+				else
+					return;
+				free( line );
+			 }
 			p = end;
 		 }
 	} while( *p != '\0' );
@@ -208,10 +855,23 @@ _fsd_log( int level, const char *file, const char *function,
 }
 
 
-void 
-fsd_log_check_verbosity( void )
+static void
+fsd_log_do_check_verbosity( void )
 {
 	const char *log_level_str = getenv("DRMAA_LOG_LEVEL");
+	const char *log_async_str = getenv("DRMAA_LOG_ASYNC");
+	const char *log_binary_str = getenv("DRMAA_LOG_BINARY");
+
+	if( log_binary_str != NULL  &&  log_binary_str[0] != '\0' )
+	 {
+		if( !fsd_log_set_binary( log_binary_str ) )
+			fprintf( stderr, "Could not open DRMAA_LOG_BINARY=%s: %s\n",
+					log_binary_str, strerror(errno) );
+	 }
+
+	if( log_async_str != NULL  &&  log_async_str[0] != '\0'
+			&&  strcmp( log_async_str, "0" ) != 0 )
+		fsd_log_set_async( true );
 
 	if (log_level_str == NULL) 
 	 {
@@ -248,6 +908,13 @@ fsd_log_check_verbosity( void )
 }
 
 
+void
+fsd_log_check_verbosity( void )
+{
+	pthread_once( &fsd_log_check_once, fsd_log_do_check_verbosity );
+}
+
+
 void
 fsd_log_fmt( int level, const char *fmt, ... )
 {
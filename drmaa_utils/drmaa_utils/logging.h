@@ -24,16 +24,31 @@
 #	include <config.h>
 #endif
 
+#include <stdint.h>
 #include <stdio.h>
 
 #include <drmaa_utils/compat.h>
+#include <drmaa_utils/timeline.h>
 #include <drmaa_utils/util.h>
 
 #define _log_fmt(level, kind, args) \
 	do { \
 		if( (int)fsd_verbose_level <= level ) \
-			_fsd_log( level, __FILE__, __FUNCTION__, kind, \
-					fsd_asprintf args ); \
+		 { \
+			if( fsd_log_binary ) \
+				_log_bin(level, kind, args); \
+			else \
+				_fsd_log( level, __FILE__, __FUNCTION__, kind, \
+						fsd_asprintf args ); \
+		 } \
+	} while(0)
+
+/* arguments are captured into binary record - message is not formatted */
+#define _log_bin(level, kind, args) \
+	do { \
+		static volatile uint32_t _fsd_log_site = 0; \
+		_fsd_log_bin_begin( &_fsd_log_site, level, __FUNCTION__, kind ); \
+		_fsd_log_bin args; \
 	} while(0)
 
 #define _log_empty(level, kind) \
@@ -45,16 +60,44 @@
 #define _log_nop \
 	do { /* nothing */ } while(0)
 
+#define _timeline_enter() \
+	do { \
+		if( fsd_timeline_enabled ) \
+			fsd_timeline_enter( __FUNCTION__ ); \
+	} while(0)
+
+#define _timeline_return() \
+	do { \
+		if( fsd_timeline_enabled ) \
+			fsd_timeline_return( __FUNCTION__ ); \
+	} while(0)
+
 #ifdef DEBUGGING
 #	define fsd_log_trace(args)   _log_fmt(FSD_LOG_TRACE, _FSD_LOG_MSG, args)
 #	define fsd_log_debug(args)   _log_fmt(FSD_LOG_DEBUG, _FSD_LOG_MSG, args)
-#	define fsd_log_enter(args)   _log_fmt(FSD_LOG_TRACE, _FSD_LOG_ENTER, args)
-#	define fsd_log_return(args)   _log_fmt(FSD_LOG_TRACE, _FSD_LOG_RETURN, args)
+#	define fsd_log_enter(args) \
+	do { \
+		_timeline_enter(); \
+		_log_fmt(FSD_LOG_TRACE, _FSD_LOG_ENTER, args); \
+	} while(0)
+#	define fsd_log_return(args) \
+	do { \
+		_log_fmt(FSD_LOG_TRACE, _FSD_LOG_RETURN, args); \
+		_timeline_return(); \
+	} while(0)
+#	define fsd_log_hot(args)     _log_fmt(FSD_LOG_DEBUG, _FSD_LOG_MSG, args)
 #else /* ! DEBUGGING */
 #	define fsd_log_trace(args)   _log_nop
 #	define fsd_log_debug(args)   _log_nop
-#	define fsd_log_enter(args)   _log_nop
-#	define fsd_log_return(args)  _log_nop
+#	define fsd_log_enter(args)   _timeline_enter()
+#	define fsd_log_return(args)  _timeline_return()
+/* debug messages on hot paths (never with job environment nor script)
+   - kept in production build for binary log */
+#	define fsd_log_hot(args) \
+	do { \
+		if( fsd_log_binary  &&  (int)fsd_verbose_level <= FSD_LOG_DEBUG ) \
+			_log_bin(FSD_LOG_DEBUG, _FSD_LOG_MSG, args); \
+	} while(0)
 #endif
 
 #define fsd_log_info(args)     _log_fmt(FSD_LOG_INFO, _FSD_LOG_MSG, args)
@@ -66,6 +109,11 @@ enum{ _FSD_LOG_MSG, _FSD_LOG_ENTER, _FSD_LOG_RETURN };
 void _fsd_log( int level, const char *file, const char *function,
 	int kind, char *message );
 
+void _fsd_log_bin_begin( volatile uint32_t *site, int level,
+		const char *function, int kind );
+void _fsd_log_bin( const char *fmt, ... )
+	__attribute__(( format( printf, 1, 2 ) ));
+
 void fsd_log_fmt( int level, const char *fmt, ... )
 	__attribute__(( format( printf, 2, 3 ) ));
 
@@ -81,6 +129,43 @@ void fsd_log_stacktrace( int skip, int limit );
 void
 fsd_set_logging_fd( int fd );
 
+/**
+ * Switch asynchronous logging on or off (also enabled by setting
+ * \c DRMAA_LOG_ASYNC environment variable).  In asynchronous mode
+ * lines are queued in memory and written in batches by background
+ * thread.  When queue is full lines below warning level are dropped
+ * (number of dropped lines is logged), others are written directly.
+ * Switching off writes all queued lines and stops the thread.
+ */
+void
+fsd_log_set_async( bool enable );
+
+/**
+ * Write log in binary format (also enabled by setting
+ * \c DRMAA_LOG_BINARY environment variable to file name).
+ * Messages are not formatted by logging thread - format string is
+ * written once per call site and each message records only raw
+ * arguments (see logrec.h).  Log is read with \c drmaa-log-decode.
+ * Debug messages of hot paths (fsd_log_hot()) are logged in binary mode
+ * also by production build (when level is set to DEBUG).  Log file is
+ * created readable by owner only.  Binary log may be opened only once.
+ * @param path  File to append log to.
+ * @return \c false when file could not be opened.
+ */
+bool
+fsd_log_set_binary( const char *path );
+
+/**
+ * Read \c DRMAA_LOG_* environment variables.  Done once - at library
+ * initialization or before first message is logged.
+ */
+void
+fsd_log_check_verbosity( void );
+
+/** Wait until lines queued in asynchronous mode are written. */
+void
+fsd_log_flush( void );
+
 typedef enum {
 	FSD_LOG_ALL,
 	FSD_LOG_TRACE,
@@ -96,5 +181,8 @@ void fsd_set_verbosity_level( fsd_verbose_level_t level );
 
 extern fsd_verbose_level_t fsd_verbose_level;
 
+/** Whether log is written in binary format. */
+extern bool fsd_log_binary;
+
 #endif /* __DRMAA_UTILS__LOGGING_H */
 
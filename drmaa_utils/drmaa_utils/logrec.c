@@ -0,0 +1,135 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <string.h>
+
+#include <drmaa_utils/logrec.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+
+bool
+fsd_logarg_next( const char **p, fsd_logarg_spec_t *spec )
+{
+	const char *i = strchr( *p, '%' );
+
+	if( i == NULL )
+	 {
+		*p += strlen( *p );
+		return false;
+	 }
+
+	memset( spec, 0, sizeof(fsd_logarg_spec_t) );
+	spec->begin = i++;
+	spec->flags = i;
+	while( *i != '\0'  &&  strchr( "#0- +'I", *i ) )
+		i++;
+	if( *i == '*' )
+	 {
+		spec->width_star = true;
+		i++;
+	 }
+	while( *i >= '0'  &&  *i <= '9' )
+		i++;
+	if( *i == '.' )
+	 {
+		i++;
+		if( *i == '*' )
+		 {
+			spec->precision_star = true;
+			i++;
+		 }
+		while( *i >= '0'  &&  *i <= '9' )
+			i++;
+	 }
+	spec->flags_len = i - spec->flags;
+
+	switch( *i )
+	 {
+		case 'h':
+			i++;
+			if( *i == 'h' )
+			 {
+				spec->length = FSD_LOGARG_CHAR;
+				i++;
+			 }
+			else
+				spec->length = FSD_LOGARG_SHORT;
+			break;
+		case 'l':
+			i++;
+			if( *i == 'l' )
+			 {
+				spec->length = FSD_LOGARG_LONG_LONG;
+				i++;
+			 }
+			else
+				spec->length = FSD_LOGARG_LONG;
+			break;
+		case 'q':  spec->length = FSD_LOGARG_LONG_LONG;    i++;  break;
+		case 'z':  spec->length = FSD_LOGARG_SIZE;         i++;  break;
+		case 'j':  spec->length = FSD_LOGARG_INTMAX;       i++;  break;
+		case 't':  spec->length = FSD_LOGARG_PTRDIFF;      i++;  break;
+		case 'L':  spec->length = FSD_LOGARG_LONG_DOUBLE;  i++;  break;
+		default:  break;
+	 }
+
+	spec->conversion = *i;
+	switch( *i )
+	 {
+		case 'd':  case 'i':
+			spec->type = FSD_LOGARG_INT;
+			break;
+		case 'u':  case 'o':  case 'x':  case 'X':  case 'c':
+			spec->type = FSD_LOGARG_UINT;
+			break;
+		case 'e':  case 'E':  case 'f':  case 'F':
+		case 'g':  case 'G':  case 'a':  case 'A':
+			spec->type = FSD_LOGARG_DOUBLE;
+			break;
+		case 's':
+			spec->type = FSD_LOGARG_STRING;
+			break;
+		case 'p':  case 'n':
+			spec->type = FSD_LOGARG_POINTER;
+			break;
+		case 'm':
+			spec->type = FSD_LOGARG_ERRNO;
+			break;
+		case '\0':
+			spec->conversion = '%';
+			*p = i;
+			return true;
+		default: /* %% and unknown ones */
+			spec->type = FSD_LOGARG_NONE;
+			break;
+	 }
+	*p = i + 1;
+	return true;
+}
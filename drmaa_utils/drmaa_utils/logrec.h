@@ -0,0 +1,136 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file logrec.h
+ * Binary log file format.
+ *
+ * File starts with #fsd_logrec_header_t followed by records
+ * (in byte order of writing host):
+ *  - site record - defines identifier of log statement:
+ *    #fsd_logrec_site_t followed by function name and format string
+ *    (without terminating zeros); written before first event of site,
+ *  - event record - #fsd_logrec_event_t followed by raw arguments
+ *    in order of conversions in format: integers, pointers and
+ *    @c * width/precision as 8 byte integers, floating point numbers
+ *    as @c double, strings (also @c %m) as 2 byte length and characters.
+ *    Arguments which do not fit in #FSD_LOGREC_MAX bytes are cut off.
+ *
+ * Messages are formatted only when decoded (drmaa-log-decode).
+ */
+
+#ifndef __DRMAA_UTILS__LOGREC_H
+#define __DRMAA_UTILS__LOGREC_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <stdint.h>
+
+#include <drmaa_utils/compat.h>
+
+#define FSD_LOGREC_MAGIC       "FSDLOGB"
+#define FSD_LOGREC_VERSION     1
+#define FSD_LOGREC_BYTE_ORDER  0x01020304u
+/** Maximal size of event record (including header). */
+#define FSD_LOGREC_MAX         512
+/** Site of messages logged as preformatted text (format is @c "%s"). */
+#define FSD_LOGREC_TEXT_SITE   1
+/** Event flag: arguments did not fit in record. */
+#define FSD_LOGREC_TRUNCATED   0x1
+
+typedef enum {
+	FSD_LOGREC_SITE = 1,
+	FSD_LOGREC_EVENT = 2
+} fsd_logrec_type_t;
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint64_t start_us; /**< Logging start (microseconds since the Epoch). */
+} fsd_logrec_header_t;
+
+typedef struct {
+	uint16_t type;
+	uint16_t size; /**< Whole record size. */
+} fsd_logrec_head_t;
+
+typedef struct {
+	fsd_logrec_head_t head;
+	uint32_t site;
+	uint16_t function_len;
+	uint16_t format_len;
+} fsd_logrec_site_t;
+
+typedef struct {
+	fsd_logrec_head_t head;
+	uint32_t site;
+	uint32_t tid;
+	uint8_t level;
+	uint8_t kind;
+	uint16_t flags;
+	uint64_t time_us; /**< Microseconds since the Epoch. */
+} fsd_logrec_event_t;
+
+/** Kind of argument consumed by conversion. */
+typedef enum {
+	FSD_LOGARG_NONE,    /**< @c %% */
+	FSD_LOGARG_INT,
+	FSD_LOGARG_UINT,
+	FSD_LOGARG_DOUBLE,
+	FSD_LOGARG_STRING,
+	FSD_LOGARG_POINTER,
+	FSD_LOGARG_ERRNO    /**< @c %m - message of errno (stored as string) */
+} fsd_logarg_type_t;
+
+/** Length modifiers. */
+typedef enum {
+	FSD_LOGARG_DEFAULT,
+	FSD_LOGARG_CHAR,       /**< hh */
+	FSD_LOGARG_SHORT,      /**< h */
+	FSD_LOGARG_LONG,       /**< l */
+	FSD_LOGARG_LONG_LONG,  /**< ll, q */
+	FSD_LOGARG_SIZE,       /**< z */
+	FSD_LOGARG_INTMAX,     /**< j */
+	FSD_LOGARG_PTRDIFF,    /**< t */
+	FSD_LOGARG_LONG_DOUBLE /**< L */
+} fsd_logarg_length_t;
+
+/** Parsed printf conversion specification. */
+typedef struct {
+	const char *begin;    /**< Points at '%'. */
+	const char *flags;    /**< Flags, width and precision (till length modifier). */
+	size_t flags_len;
+	bool width_star;      /**< Width given by argument. */
+	bool precision_star;  /**< Precision given by argument. */
+	fsd_logarg_length_t length;
+	char conversion;
+	fsd_logarg_type_t type;
+} fsd_logarg_spec_t;
+
+/**
+ * Find next conversion in format.
+ * @param p  Position in format; advanced past found conversion.
+ * @return @c false when there are no more conversions.
+ */
+bool fsd_logarg_next( const char **p, fsd_logarg_spec_t *spec );
+
+#endif /* __DRMAA_UTILS__LOGREC_H */
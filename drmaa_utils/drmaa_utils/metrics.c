@@ -0,0 +1,560 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/exception.h>
+#include <drmaa_utils/logging.h>
+#include <drmaa_utils/metrics.h>
+#include <drmaa_utils/util.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+
+/**
+ * Metrics of one thread.  Written only by owning thread.
+ * Shards are never freed: shard of finished thread is taken over
+ * by next new thread so totals are preserved.
+ */
+typedef struct fsd_metrics_shard_s fsd_metrics_shard_t;
+struct fsd_metrics_shard_s {
+	volatile uint64_t count[FSD_METRICS_MAX];
+	volatile uint64_t sum[FSD_METRICS_MAX];
+	volatile uint64_t buckets[FSD_METRICS_MAX][FSD_METRIC_BUCKETS];
+	volatile int in_use;
+	fsd_metrics_shard_t *next;
+};
+
+/** Sum of all shards. */
+typedef struct {
+	uint64_t count[FSD_METRICS_MAX];
+	uint64_t sum[FSD_METRICS_MAX];
+	uint64_t buckets[FSD_METRICS_MAX][FSD_METRIC_BUCKETS];
+} fsd_metrics_totals_t;
+
+static const char *fsd_metric_names[FSD_METRICS_MAX] = {
+	"session_lock_wait_us",
+	"drm_lock_wait_us",
+	"poll_cycle_us",
+	"poll_cycle_jobs",
+	"wait_us",
+	"jobs_submitted",
+	"jobs_reaped"
+};
+static fsd_metric_kind_t fsd_metric_kinds[FSD_METRICS_MAX] = {
+	FSD_METRIC_HISTOGRAM,
+	FSD_METRIC_HISTOGRAM,
+	FSD_METRIC_HISTOGRAM,
+	FSD_METRIC_HISTOGRAM,
+	FSD_METRIC_HISTOGRAM,
+	FSD_METRIC_COUNTER,
+	FSD_METRIC_COUNTER
+};
+static volatile int fsd_n_metrics = FSD_METRIC__PREDEFINED;
+
+static fsd_metrics_shard_t *volatile fsd_metrics_shards = NULL;
+static __thread fsd_metrics_shard_t *fsd_metrics_own_shard = NULL;
+
+/* guards registration and baseline */
+static pthread_mutex_t fsd_metrics_mutex = PTHREAD_MUTEX_INITIALIZER;
+static fsd_metrics_totals_t *fsd_metrics_baseline = NULL;
+
+static pthread_key_t fsd_metrics_key;
+static pthread_once_t fsd_metrics_once = PTHREAD_ONCE_INIT;
+
+
+static void
+fsd_metrics_shard_release( void *shard )
+{
+	((fsd_metrics_shard_t*)shard)->in_use = 0;
+}
+
+static void
+fsd_metrics_init( void )
+{
+	pthread_key_create( &fsd_metrics_key, fsd_metrics_shard_release );
+}
+
+
+static fsd_metrics_shard_t *
+fsd_metrics_get_shard( void )
+{
+	fsd_metrics_shard_t *shard = fsd_metrics_own_shard;
+
+	if( shard != NULL )
+		return shard;
+
+	pthread_once( &fsd_metrics_once, fsd_metrics_init );
+	for( shard = fsd_metrics_shards;  shard != NULL;  shard = shard->next )
+		if( !shard->in_use  &&  __sync_bool_compare_and_swap( &shard->in_use, 0, 1 ) )
+			break;
+	if( shard == NULL )
+	 {
+		shard = calloc( 1, sizeof(fsd_metrics_shard_t) );
+		if( shard == NULL )
+			return NULL;
+		shard->in_use = 1;
+		do {
+			shard->next = fsd_metrics_shards;
+		} while( !__sync_bool_compare_and_swap( &fsd_metrics_shards, shard->next, shard ) );
+	 }
+	pthread_setspecific( fsd_metrics_key, shard );
+	fsd_metrics_own_shard = shard;
+	return shard;
+}
+
+
+int
+fsd_metric_register( const char *name, fsd_metric_kind_t kind )
+{
+	int id;
+
+	pthread_mutex_lock( &fsd_metrics_mutex );
+	for( id = 0;  id < fsd_n_metrics;  id++ )
+		if( !strcmp( fsd_metric_names[id], name ) )
+			break;
+	if( id == fsd_n_metrics )
+	 {
+		if( id < FSD_METRICS_MAX )
+		 {
+			fsd_metric_names[id] = strdup( name );
+			fsd_metric_kinds[id] = kind;
+			if( fsd_metric_names[id] != NULL )
+				fsd_n_metrics++;
+			else
+				id = -1;
+		 }
+		else
+			id = -1;
+	 }
+	pthread_mutex_unlock( &fsd_metrics_mutex );
+	return id;
+}
+
+
+void
+fsd_metric_add( int id, uint64_t value )
+{
+	fsd_metrics_shard_t *shard = fsd_metrics_get_shard();
+	if( shard != NULL  &&  id >= 0 )
+		shard->count[id] += value;
+}
+
+
+void
+fsd_metric_observe( int id, uint64_t value )
+{
+	fsd_metrics_shard_t *shard = fsd_metrics_get_shard();
+	int bucket;
+
+	if( shard == NULL  ||  id < 0 )
+		return;
+	bucket = value ? 64 - __builtin_clzll( value ) : 0;
+	if( bucket >= FSD_METRIC_BUCKETS )
+		bucket = FSD_METRIC_BUCKETS - 1;
+	shard->buckets[id][bucket]++;
+	shard->sum[id] += value;
+	shard->count[id]++;
+}
+
+
+void
+fsd_metric_start( struct timespec *start )
+{
+	clock_gettime( CLOCK_MONOTONIC, start );
+}
+
+
+void
+fsd_metric_observe_since( int id, const struct timespec *start )
+{
+	struct timespec now;
+	int64_t us;
+
+	clock_gettime( CLOCK_MONOTONIC, &now );
+	us = (int64_t)(now.tv_sec - start->tv_sec) * 1000000
+		+ (now.tv_nsec - start->tv_nsec) / 1000;
+	fsd_metric_observe( id, us > 0 ? (uint64_t)us : 0 );
+	if( fsd_timeline_enabled  &&  id >= 0 )
+		fsd_timeline_span( fsd_metric_names[id], "metric", start, &now );
+}
+
+
+bool
+fsd_metric_lock( fsd_mutex_t *mutex, int id )
+{
+	struct timespec start;
+
+	if( fsd_mutex_trylock( mutex ) )
+		return true;
+	fsd_metric_start( &start );
+	fsd_mutex_lock( mutex );
+	fsd_metric_observe_since( id, &start );
+	return true;
+}
+
+
+static void
+fsd_metrics_sum( fsd_metrics_totals_t *totals )
+{
+	fsd_metrics_shard_t *shard;
+	int id, b;
+
+	memset( totals, 0, sizeof(fsd_metrics_totals_t) );
+	for( shard = fsd_metrics_shards;  shard != NULL;  shard = shard->next )
+		for( id = 0;  id < fsd_n_metrics;  id++ )
+		 {
+			totals->count[id] += shard->count[id];
+			totals->sum[id] += shard->sum[id];
+			for( b = 0;  b < FSD_METRIC_BUCKETS;  b++ )
+				totals->buckets[id][b] += shard->buckets[id][b];
+		 }
+}
+
+
+/* totals since last reset; called with fsd_metrics_mutex held */
+static void
+fsd_metrics_read( fsd_metrics_totals_t *totals )
+{
+	int id, b;
+
+	fsd_metrics_sum( totals );
+	if( fsd_metrics_baseline == NULL )
+		return;
+	for( id = 0;  id < fsd_n_metrics;  id++ )
+	 {
+		totals->count[id] -= fsd_metrics_baseline->count[id];
+		totals->sum[id] -= fsd_metrics_baseline->sum[id];
+		for( b = 0;  b < FSD_METRIC_BUCKETS;  b++ )
+			totals->buckets[id][b] -= fsd_metrics_baseline->buckets[id][b];
+	 }
+}
+
+
+void
+fsd_metrics_reset( void )
+{
+	pthread_mutex_lock( &fsd_metrics_mutex );
+	if( fsd_metrics_baseline == NULL )
+		fsd_metrics_baseline = calloc( 1, sizeof(fsd_metrics_totals_t) );
+	if( fsd_metrics_baseline != NULL )
+		fsd_metrics_sum( fsd_metrics_baseline );
+	pthread_mutex_unlock( &fsd_metrics_mutex );
+}
+
+
+static unsigned long long
+fsd_metrics_bucket_bound( int bucket )
+{
+	return bucket == 0 ? 0 : (1ULL << bucket) - 1;
+}
+
+
+static void
+fsd_metrics_write_json( FILE *stream, const fsd_metrics_totals_t *t )
+{
+	int id, b;
+	const char *sep = "";
+
+	fprintf( stream, "{\"counters\": {" );
+	for( id = 0;  id < fsd_n_metrics;  id++ )
+		if( fsd_metric_kinds[id] == FSD_METRIC_COUNTER )
+		 {
+			fprintf( stream, "%s\"%s\": %llu", sep, fsd_metric_names[id],
+					(unsigned long long)t->count[id] );
+			sep = ", ";
+		 }
+	fprintf( stream, "}, \"histograms\": {" );
+	sep = "";
+	for( id = 0;  id < fsd_n_metrics;  id++ )
+		if( fsd_metric_kinds[id] == FSD_METRIC_HISTOGRAM )
+		 {
+			const char *bsep = "";
+			fprintf( stream, "%s\"%s\": {\"count\": %llu, \"sum\": %llu, \"buckets\": [",
+					sep, fsd_metric_names[id],
+					(unsigned long long)t->count[id], (unsigned long long)t->sum[id] );
+			for( b = 0;  b < FSD_METRIC_BUCKETS;  b++ )
+				if( t->buckets[id][b] != 0 )
+				 {
+					if( b < FSD_METRIC_BUCKETS - 1 )
+						fprintf( stream, "%s[%llu, %llu]", bsep,
+								fsd_metrics_bucket_bound( b ), (unsigned long long)t->buckets[id][b] );
+					else
+						fprintf( stream, "%s[null, %llu]", bsep,
+								(unsigned long long)t->buckets[id][b] );
+					bsep = ", ";
+				 }
+			fprintf( stream, "]}" );
+			sep = ", ";
+		 }
+	fprintf( stream, "}}\n" );
+}
+
+
+static void
+fsd_metrics_write_prometheus( FILE *stream, const fsd_metrics_totals_t *t )
+{
+	int id, b;
+
+	for( id = 0;  id < fsd_n_metrics;  id++ )
+	 {
+		const char *name = fsd_metric_names[id];
+		if( fsd_metric_kinds[id] == FSD_METRIC_COUNTER )
+		 {
+			fprintf( stream, "# TYPE drmaa_%s counter\n", name );
+			fprintf( stream, "drmaa_%s %llu\n", name, (unsigned long long)t->count[id] );
+		 }
+		else
+		 {
+			uint64_t cumulative = 0;
+			fprintf( stream, "# TYPE drmaa_%s histogram\n", name );
+			for( b = 0;  b < FSD_METRIC_BUCKETS - 1;  b++ )
+			 {
+				cumulative += t->buckets[id][b];
+				if( t->buckets[id][b] != 0 )
+					fprintf( stream, "drmaa_%s_bucket{le=\"%llu\"} %llu\n", name,
+							fsd_metrics_bucket_bound( b ), (unsigned long long)cumulative );
+			 }
+			fprintf( stream, "drmaa_%s_bucket{le=\"+Inf\"} %llu\n", name,
+					(unsigned long long)t->count[id] );
+			fprintf( stream, "drmaa_%s_sum %llu\n", name, (unsigned long long)t->sum[id] );
+			fprintf( stream, "drmaa_%s_count %llu\n", name, (unsigned long long)t->count[id] );
+		 }
+	 }
+}
+
+
+void
+fsd_metrics_write( FILE *stream, fsd_metrics_format_t format )
+{
+	fsd_metrics_totals_t *volatile totals = NULL;
+
+	TRY
+	 {
+		fsd_malloc( totals, fsd_metrics_totals_t );
+		pthread_mutex_lock( &fsd_metrics_mutex );
+		fsd_metrics_read( totals );
+		if( format == FSD_METRICS_PROMETHEUS )
+			fsd_metrics_write_prometheus( stream, totals );
+		else
+			fsd_metrics_write_json( stream, totals );
+		pthread_mutex_unlock( &fsd_metrics_mutex );
+	 }
+	FINALLY
+	 {
+		fsd_free( totals );
+	 }
+	END_TRY
+}
+
+
+char *
+fsd_metrics_format( fsd_metrics_format_t format )
+{
+	char *volatile result = NULL;
+	size_t size = 0;
+	FILE *volatile stream = NULL;
+
+	TRY
+	 {
+		stream = open_memstream( (char**)&result, &size );
+		if( stream == NULL )
+			fsd_exc_raise_sys( 0 );
+		fsd_metrics_write( stream, format );
+	 }
+	FINALLY
+	 {
+		if( stream != NULL )
+			fclose( stream );
+		if( fsd_exc_get() )
+		 {
+			free( result );
+			result = NULL;
+		 }
+	 }
+	END_TRY
+
+	if( result == NULL )
+		fsd_exc_raise_code( FSD_ERRNO_NO_MEMORY );
+	return result;
+}
+
+
+void
+fsd_metrics_dump( const char *path, fsd_metrics_format_t format )
+{
+	char *volatile tmp_path = NULL;
+	FILE *volatile stream = NULL;
+
+	TRY
+	 {
+		tmp_path = fsd_asprintf( "%s.%d.tmp", path, (int)getpid() );
+		stream = fopen( tmp_path, "w" );
+		if( stream == NULL )
+			fsd_exc_raise_sys( 0 );
+		fsd_metrics_write( stream, format );
+		if( fclose( stream ) != 0 )
+		 {
+			stream = NULL;
+			fsd_exc_raise_sys( 0 );
+		 }
+		stream = NULL;
+		if( rename( tmp_path, path ) == -1 )
+			fsd_exc_raise_sys( 0 );
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( stream != NULL )
+			fclose( stream );
+		unlink( tmp_path );
+		fsd_exc_reraise();
+	 }
+	FINALLY
+	 {
+		fsd_free( tmp_path );
+	 }
+	END_TRY
+}
+
+
+struct fsd_metrics_dumper_s {
+	char *path;
+	fsd_metrics_format_t format;
+	int interval;
+	bool run_flag;
+	fsd_thread_t thread;
+	fsd_mutex_t mutex;
+	fsd_cond_t cond;
+};
+
+
+static void
+fsd_metrics_dumper_dump( fsd_metrics_dumper_t *self )
+{
+	TRY
+	 { fsd_metrics_dump( self->path, self->format ); }
+	EXCEPT_DEFAULT
+	 {
+		const fsd_exc_t *e = fsd_exc_get();
+		fsd_log_error(( "dumping metrics to %s: %s", self->path, e->message(e) ));
+	 }
+	END_TRY
+}
+
+
+/* takes no library lock but its own so joining it never deadlocks */
+static void *
+fsd_metrics_dumper_thread( fsd_metrics_dumper_t *self )
+{
+	fsd_timeline_thread_name( "metrics dumper" );
+	fsd_log_enter(( "" ));
+	fsd_mutex_lock( &self->mutex );
+	while( self->run_flag )
+	 {
+		struct timespec ts;
+		fsd_get_time( &ts );
+		ts.tv_sec += self->interval;
+		if( !fsd_cond_timedwait( &self->cond, &self->mutex, &ts )  &&  self->run_flag )
+		 {
+			fsd_mutex_unlock( &self->mutex );
+			fsd_metrics_dumper_dump( self );
+			fsd_mutex_lock( &self->mutex );
+		 }
+	 }
+	fsd_mutex_unlock( &self->mutex );
+	fsd_log_return(( " =NULL" ));
+	return NULL;
+}
+
+
+fsd_metrics_dumper_t *
+fsd_metrics_dumper_start( const char *path, fsd_metrics_format_t format, int interval )
+{
+	fsd_metrics_dumper_t *volatile self = NULL;
+	volatile bool initialized = false;
+
+	fsd_log_enter(( "(path=%s, interval=%d)", path, interval ));
+	TRY
+	 {
+		fsd_malloc( self, fsd_metrics_dumper_t );
+		self->path = NULL;
+		self->format = format;
+		self->interval = interval > 0 ? interval : 1;
+		self->run_flag = true;
+		fsd_mutex_init( &self->mutex );
+		fsd_cond_init( &self->cond );
+		initialized = true;
+		self->path = fsd_strdup( path );
+		fsd_thread_create( &self->thread,
+				(void*(*)(void*))fsd_metrics_dumper_thread, self );
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( self )
+		 {
+			if( initialized )
+			 {
+				fsd_mutex_destroy( &self->mutex );
+				fsd_cond_destroy( &self->cond );
+			 }
+			fsd_free( self->path );
+			fsd_free( self );
+		 }
+		fsd_exc_reraise();
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%p", (void*)self ));
+	return self;
+}
+
+
+void
+fsd_metrics_dumper_stop( fsd_metrics_dumper_t *self )
+{
+	fsd_log_enter(( "" ));
+	fsd_mutex_lock( &self->mutex );
+	self->run_flag = false;
+	fsd_cond_broadcast( &self->cond );
+	fsd_mutex_unlock( &self->mutex );
+	fsd_thread_join( self->thread, NULL );
+
+	fsd_metrics_dumper_dump( self );
+	fsd_mutex_destroy( &self->mutex );
+	fsd_cond_destroy( &self->cond );
+	fsd_free( self->path );
+	fsd_free( self );
+	fsd_log_return(( "" ));
+}
@@ -0,0 +1,128 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file metrics.h
+ * Process wide performance counters and latency histograms.
+ *
+ * Every thread updates its own shard of counters without locking
+ * or atomic instructions; readers sum shards of all threads.
+ * Histograms have logarithmic buckets: bucket @c i counts values
+ * of bit length @c i (0, 1, 2-3, 4-7, ...).
+ */
+
+#ifndef __DRMAA_UTILS__METRICS_H
+#define __DRMAA_UTILS__METRICS_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/thread.h>
+
+/** Maximal number of registered metrics. */
+#define FSD_METRICS_MAX 64
+/** Number of histogram buckets (last one is unbounded). */
+#define FSD_METRIC_BUCKETS 40
+
+typedef enum {
+	FSD_METRIC_COUNTER,
+	FSD_METRIC_HISTOGRAM
+} fsd_metric_kind_t;
+
+typedef enum {
+	FSD_METRICS_JSON,
+	FSD_METRICS_PROMETHEUS
+} fsd_metrics_format_t;
+
+/** Metrics of DRM independent code (registered in advance). */
+typedef enum {
+	FSD_METRIC_SESSION_LOCK_WAIT, /**< Waiting for contended session mutex [us]. */
+	FSD_METRIC_DRM_LOCK_WAIT, /**< Waiting for contended DRM connection mutex [us]. */
+	FSD_METRIC_POLL_CYCLE, /**< Duration of status refresh of all jobs [us]. */
+	FSD_METRIC_POLL_JOBS, /**< Jobs touched by single poll cycle. */
+	FSD_METRIC_WAIT, /**< Duration of drmaa_wait / drmaa_synchronize [us]. */
+	FSD_METRIC_JOBS_SUBMITTED, /**< Jobs (and array tasks) submitted. */
+	FSD_METRIC_JOBS_REAPED, /**< Terminated jobs reaped by wait functions. */
+	FSD_METRIC__PREDEFINED
+} fsd_metric_id_t;
+
+/**
+ * Register metric (or find already registered one with the same name).
+ * @return Metric identifier or -1 when there is no room for new metric.
+ */
+int fsd_metric_register( const char *name, fsd_metric_kind_t kind );
+
+/** Increment counter. */
+void fsd_metric_add( int id, uint64_t value );
+
+/** Record value in histogram. */
+void fsd_metric_observe( int id, uint64_t value );
+
+/** Start of measured interval (monotonic clock). */
+void fsd_metric_start( struct timespec *start );
+
+/** Record microseconds elapsed since @a start in histogram. */
+void fsd_metric_observe_since( int id, const struct timespec *start );
+
+/** Evaluate @a statement recording its duration in histogram @a id. */
+#define FSD_METRIC_TIME( id, statement ) \
+	do { \
+		struct timespec _fsd_metric_start; \
+		fsd_metric_start( &_fsd_metric_start ); \
+		statement; \
+		fsd_metric_observe_since( (id), &_fsd_metric_start ); \
+	} while(0)
+
+/**
+ * Lock mutex recording time spent waiting in histogram @a id
+ * (only when mutex was contended).
+ */
+bool fsd_metric_lock( fsd_mutex_t *mutex, int id );
+
+/** Write all metrics to stream. */
+void fsd_metrics_write( FILE *stream, fsd_metrics_format_t format );
+
+/** Format all metrics (free result with fsd_free). */
+char *fsd_metrics_format( fsd_metrics_format_t format );
+
+/** Atomically replace file @a path with current metrics. */
+void fsd_metrics_dump( const char *path, fsd_metrics_format_t format );
+
+/** Start counting from zero (subsequent reads report change since reset). */
+void fsd_metrics_reset( void );
+
+typedef struct fsd_metrics_dumper_s fsd_metrics_dumper_t;
+
+/**
+ * Start thread replacing file @a path with current metrics
+ * every @a interval seconds.
+ */
+fsd_metrics_dumper_t *
+fsd_metrics_dumper_start( const char *path, fsd_metrics_format_t format, int interval );
+
+/** Write final dump and stop dumping thread. */
+void fsd_metrics_dumper_stop( fsd_metrics_dumper_t *dumper );
+
+#endif /* __DRMAA_UTILS__METRICS_H */
@@ -0,0 +1,65 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file probes.h
+ * Statically defined tracepoints (USDT) of provider @c slurm_drmaa.
+ *
+ * Probes are compiled in only with <tt>configure --enable-usdt</tt>.
+ * Each of them is then a single @c nop instruction (plus notes
+ * describing arguments) until tracer (bpftrace, perf, systemtap)
+ * attaches to it.  Otherwise they expand to nothing and arguments
+ * are not evaluated - so they must be free of side effects.
+ *
+ * Probes:
+ *  - submit_start(n_jobs), submit_end(n_jobs)
+ *  - job_refresh_start(job_id), job_refresh_end(job_id, state)
+ *  - job_state(job_id, previous_state, state)
+ *  - wait_thread_cycle_start(), wait_thread_cycle_end()
+ *  - wait_block(job_id), wait_unblock(job_id, signaled)
+ *    (job_id is @c NULL when waiting for any job; wait_unblock is not
+ *    fired when waiting ends with timeout without wait thread)
+ *  - mutex_contended(mutex), mutex_acquired(mutex)
+ */
+
+#ifndef __DRMAA_UTILS__PROBES_H
+#define __DRMAA_UTILS__PROBES_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#ifdef ENABLE_USDT
+#	include <sys/sdt.h>
+#	define FSD_PROBE0( name ) \
+		DTRACE_PROBE( slurm_drmaa, name )
+#	define FSD_PROBE1( name, a1 ) \
+		DTRACE_PROBE1( slurm_drmaa, name, a1 )
+#	define FSD_PROBE2( name, a1, a2 ) \
+		DTRACE_PROBE2( slurm_drmaa, name, a1, a2 )
+#	define FSD_PROBE3( name, a1, a2, a3 ) \
+		DTRACE_PROBE3( slurm_drmaa, name, a1, a2, a3 )
+#else
+#	define FSD_PROBE0( name )                  do{}while(0)
+#	define FSD_PROBE1( name, a1 )              do{}while(0)
+#	define FSD_PROBE2( name, a1, a2 )          do{}while(0)
+#	define FSD_PROBE3( name, a1, a2, a3 )      do{}while(0)
+#endif
+
+#endif /* __DRMAA_UTILS__PROBES_H */
@@ -28,6 +28,8 @@
 #include <sys/time.h>
 
 #include <drmaa_utils/common.h>
+#include <drmaa_utils/dispatch.h>
+#include <drmaa_utils/metrics.h>
 #include <drmaa_utils/thread.h>
 
 /** Creates new DRMAA session. */
@@ -103,6 +105,32 @@ struct fsd_drmaa_session_s {
 			int start, int end, int incr
 			);
 
+	/**
+	 * Queue job for submission by background submitter threads.
+	 * Template is copied so it may be altered or freed right after call.
+	 * @return Ticket to be passed to #collect_job_id.
+	 */
+	int (*
+	run_job_async)(
+			fsd_drmaa_session_t *self,
+			const fsd_template_t *jt
+			);
+
+	/**
+	 * Wait until job queued by #run_job_async is submitted.
+	 * @param ticket  Ticket returned by #run_job_async
+	 *   or #FSD_SUBMIT_TICKET_ANY.
+	 * @param ticket_out  Ticket of collected submission (output only).
+	 * @param timeout  Absolute timeout or \c NULL.
+	 * @return Identifier of submitted job.
+	 */
+	char* (*
+	collect_job_id)(
+			fsd_drmaa_session_t *self,
+			int ticket, int *ticket_out,
+			const struct timespec *timeout
+			);
+
 	/** Implements drmaa_control(). */
 	void (*
 	control_job)(
@@ -117,6 +145,33 @@ struct fsd_drmaa_session_s {
 			const char *job_id, int *remote_ps
 			);
 
+	/**
+	 * Add jobs submitted outside of this session (e.g. before restart
+	 * of client) to session with their current state.
+	 * @param job_ids  \c NULL terminated vector of job identifiers
+	 *   or \c NULL to adopt all jobs of user (DRM specific).
+	 * @param session_only  With \c NULL @a job_ids adopt only jobs
+	 *   recognized as submitted by session with the same contact.
+	 * @return Number of adopted jobs (jobs already known are
+	 *   refreshed but not counted).
+	 */
+	size_t (*
+	adopt_jobs)(
+			fsd_drmaa_session_t *self,
+			const char **job_ids, bool session_only
+			);
+
+	/**
+	 * Implements drmaa_job_ps_multi().
+	 * @param job_ids  \c NULL terminated vector of job identifiers.
+	 * @param remote_ps  Array (of job_ids length) filled with states.
+	 */
+	void (*
+	job_ps_multi)(
+			fsd_drmaa_session_t *self,
+			const char **job_ids, int *remote_ps
+			);
+
 	/** Implements drmaa_synchronize(). */
 	void (*
 	synchronize)(
@@ -191,6 +246,64 @@ struct fsd_drmaa_session_s {
 			bool dispose
 			);
 
+	/**
+	 * Wait until any job left in session terminates and dispose
+	 * up to @a max_jobs terminated jobs at once.
+	 * @param job_ids  Array (of @a max_jobs length) filled with
+	 *   identifiers of reaped jobs (to be freed by caller).
+	 * @param status   Array (of @a max_jobs length) of job status codes.
+	 * @param rusage   If not \c NULL array (of @a max_jobs length)
+	 *   of resource usage lists.
+	 * @return Number of reaped jobs.
+	 */
+	size_t (*
+	reap_jobs)(
+			fsd_drmaa_session_t *self,
+			size_t max_jobs, const struct timespec *timeout,
+			char **job_ids, int *status, fsd_iter_t **rusage
+			);
+
+	/**
+	 * Return file descriptor which becomes readable whenever any job
+	 * of session reaches terminal state (created on first call).
+	 */
+	int (*
+	get_completion_fd)( fsd_drmaa_session_t *self );
+
+	/** Make #get_completion_fd descriptor not readable again. */
+	void (*
+	clear_completion_fd)( fsd_drmaa_session_t *self );
+
+	/**
+	 * Signal #get_completion_fd descriptor (if created).
+	 * Called by DRM specific code when job reaches terminal state.
+	 */
+	void (*
+	notify_completion)( fsd_drmaa_session_t *self );
+
+	/**
+	 * Called by DRM specific code whenever job state was updated.
+	 * Signals completion descriptor when job reached terminal state
+	 * and posts transition to #state_dispatcher.
+	 * @param previous_state  State of job before update.
+	 */
+	void (*
+	job_state_changed)(
+			fsd_drmaa_session_t *self,
+			fsd_job_t *job, int previous_state
+			);
+
+	/**
+	 * Register callback invoked (on dispatch thread) on every job
+	 * state transition or unregister it with \c NULL.
+	 * Transitions are delivered in batches once per poll cycle.
+	 */
+	void (*
+	set_state_callback)(
+			fsd_drmaa_session_t *self,
+			fsd_state_callback_t callback, void *arg
+			);
+
 	void (*
 	wait_for_job_status_change)(
 			fsd_drmaa_session_t *self,
@@ -300,6 +413,34 @@ struct fsd_drmaa_session_s {
 	 */
 	fsd_missing_jobs_behaviour_t missing_jobs;
 
+	/**
+	 * Queue of asynchronous submissions
+	 * (created on first #run_job_async call).
+	 */
+	fsd_submit_queue_t *submit_queue;
+	/** Number of submitter threads serving #submit_queue. */
+	int submit_threads;
+	/** Maximal number of not yet submitted jobs in #submit_queue. */
+	int submit_queue_size;
+
+	/**
+	 * Delivers job state transitions to client callback
+	 * (created on first #set_state_callback call).
+	 */
+	fsd_state_dispatcher_t *state_dispatcher;
+
+	/**
+	 * Descriptors (read, write) signaled on job completion
+	 * (both -1 until #get_completion_fd is called; equal with eventfd).
+	 */
+	int completion_fd[2];
+
+	/**
+	 * Periodically writes performance metrics to file
+	 * (\c NULL unless \c metrics_file is configured).
+	 */
+	fsd_metrics_dumper_t *metrics_dumper;
+
 	fsd_mutex_t mutex; /**< Mutex for accessing session data. */
 	fsd_cond_t wait_condition;  /**< Conditional for drmaa_wait() */
 	fsd_cond_t destroy_condition;  /**< Conditional for ref_cnt==1 */
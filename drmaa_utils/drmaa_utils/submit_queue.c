@@ -0,0 +1,460 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <string.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/session.h>
+#include <drmaa_utils/submit_queue.h>
+#include <drmaa_utils/template.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+
+struct fsd_submit_request_s {
+	int ticket;
+	fsd_template_t *jt; /**< Copy of template (until submitted). */
+	char *job_id; /**< Identifier of submitted job. */
+	int error_code; /**< Error code when submission failed. */
+	char *error_message;
+	bool resolved;
+	fsd_submit_request_t *next_in_tab;
+	fsd_submit_request_t *next; /**< Next in pending or resolved list. */
+	fsd_submit_request_t *prev; /**< Previous in resolved list. */
+};
+
+
+static int
+fsd_submit_queue_submit( fsd_submit_queue_t *self, const fsd_template_t *jt );
+
+static char *
+fsd_submit_queue_collect(
+		fsd_submit_queue_t *self, int ticket, int *ticket_out,
+		const struct timespec *timeout );
+
+static void
+fsd_submit_queue_stop( fsd_submit_queue_t *self );
+
+static void
+fsd_submit_queue_destroy( fsd_submit_queue_t *self );
+
+static void *
+fsd_submit_queue_thread( fsd_submit_queue_t *self );
+
+static void
+fsd_submit_request_free( fsd_submit_request_t *req );
+
+static void
+fsd_submit_queue_grow( fsd_submit_queue_t *self );
+
+
+fsd_submit_queue_t *
+fsd_submit_queue_new(
+		fsd_drmaa_session_t *session,
+		unsigned n_threads, unsigned capacity )
+{
+	fsd_submit_queue_t *volatile self = NULL;
+	const size_t initial_size = 1024;
+
+	fsd_log_enter(( "(n_threads=%u, capacity=%u)", n_threads, capacity ));
+	fsd_assert( n_threads > 0  &&  capacity > 0 );
+	TRY
+	 {
+		unsigned i;
+
+		fsd_malloc( self, fsd_submit_queue_t );
+		self->submit = fsd_submit_queue_submit;
+		self->collect = fsd_submit_queue_collect;
+		self->stop = fsd_submit_queue_stop;
+		self->destroy = fsd_submit_queue_destroy;
+		self->session = session;
+		self->tab = NULL;
+		self->pending_head = self->pending_tail = NULL;
+		self->resolved_head = self->resolved_tail = NULL;
+		self->n_outstanding = 0;
+		self->n_uncollected = 0;
+		self->capacity = capacity;
+		self->last_ticket = 0;
+		self->threads = NULL;
+		self->n_threads = 0;
+		self->run_flag = true;
+		self->stopped = false;
+		fsd_calloc( self->tab, initial_size, fsd_submit_request_t* );
+		self->tab_size = initial_size;
+		self->tab_mask = self->tab_size - 1;
+		fsd_mutex_init( &self->mutex );
+		fsd_mutex_set_name( &self->mutex, "submit_queue" );
+		fsd_cond_init( &self->not_empty );
+		fsd_cond_init( &self->not_full );
+		fsd_cond_init( &self->resolved );
+
+		fsd_calloc( self->threads, n_threads, fsd_thread_t );
+		for( i = 0;  i < n_threads;  i++ )
+		 {
+			fsd_thread_create( &self->threads[i],
+					(void*(*)(void*))fsd_submit_queue_thread, self );
+			self->n_threads++;
+		 }
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( self )
+			self->destroy( self );
+		fsd_exc_reraise();
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%p", (void*)self ));
+	return self;
+}
+
+
+void
+fsd_submit_queue_destroy( fsd_submit_queue_t *self )
+{
+	unsigned i;
+	fsd_submit_request_t *r;
+
+	fsd_log_enter(( "" ));
+	if( !self->stopped )
+		self->stop( self );
+	for( i = 0;  i < self->tab_size;  i++ )
+		for( r = self->tab[i];  r != NULL;  )
+		 {
+			fsd_submit_request_t *req = r;
+			r = r->next_in_tab;
+			fsd_submit_request_free( req );
+		 }
+	fsd_free( self->tab );
+	fsd_free( self->threads );
+	fsd_mutex_destroy( &self->mutex );
+	fsd_cond_destroy( &self->not_empty );
+	fsd_cond_destroy( &self->not_full );
+	fsd_cond_destroy( &self->resolved );
+	fsd_free( self );
+	fsd_log_return(( "" ));
+}
+
+
+int
+fsd_submit_queue_submit( fsd_submit_queue_t *self, const fsd_template_t *jt )
+{
+	fsd_submit_request_t *volatile req = NULL;
+	volatile bool locked = false;
+	int ticket = 0;
+
+	fsd_log_enter(( "(jt=%p)", (void*)jt ));
+	TRY
+	 {
+		size_t h;
+
+		fsd_malloc( req, fsd_submit_request_t );
+		memset( req, 0, sizeof(fsd_submit_request_t) );
+		req->jt = jt->copy( jt );
+
+		locked = fsd_mutex_lock( &self->mutex );
+		while( self->run_flag  &&  self->n_outstanding >= self->capacity )
+		 {
+			fsd_log_debug(( "submit queue full, waiting" ));
+			fsd_cond_wait( &self->not_full, &self->mutex );
+		 }
+		if( !self->run_flag )
+			fsd_exc_raise_code( FSD_DRMAA_ERRNO_NO_ACTIVE_SESSION );
+
+		/* keep chains short when results are collected late */
+		if( self->n_uncollected >= self->tab_size )
+			fsd_submit_queue_grow( self );
+
+		ticket = req->ticket = ++self->last_ticket;
+		h = (size_t)ticket & self->tab_mask;
+		req->next_in_tab = self->tab[h];
+		self->tab[h] = req;
+
+		if( self->pending_tail )
+			self->pending_tail->next = req;
+		else
+			self->pending_head = req;
+		self->pending_tail = req;
+		req = NULL;
+
+		self->n_outstanding++;
+		self->n_uncollected++;
+		fsd_cond_signal( &self->not_empty );
+	 }
+	FINALLY
+	 {
+		if( locked )
+			fsd_mutex_unlock( &self->mutex );
+		if( req )
+			fsd_submit_request_free( req );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%d", ticket ));
+	return ticket;
+}
+
+
+char *
+fsd_submit_queue_collect(
+		fsd_submit_queue_t *self, int ticket, int *ticket_out,
+		const struct timespec *timeout )
+{
+	fsd_submit_request_t *volatile req = NULL;
+	volatile bool locked = false;
+	char *job_id = NULL;
+
+	fsd_log_enter(( "(ticket=%d)", ticket ));
+	TRY
+	 {
+		fsd_submit_request_t **preq = NULL;
+
+		locked = fsd_mutex_lock( &self->mutex );
+		while( true )
+		 {
+			bool signaled = true;
+
+			if( ticket == FSD_SUBMIT_TICKET_ANY )
+			 {
+				if( self->n_uncollected == 0 )
+					fsd_exc_raise_msg( FSD_DRMAA_ERRNO_INVALID_JOB,
+							"No submission to be collected" );
+				if( self->resolved_head != NULL )
+				 {
+					req = self->resolved_head;
+					break;
+				 }
+			 }
+			else
+			 {
+				for( req = self->tab[ (size_t)ticket & self->tab_mask ];
+						req != NULL;  req = req->next_in_tab )
+					if( req->ticket == ticket )
+						break;
+				if( req == NULL )
+					fsd_exc_raise_fmt( FSD_DRMAA_ERRNO_INVALID_JOB,
+							"Unknown submission ticket: %d", ticket );
+				if( req->resolved )
+					break;
+				req = NULL;
+			 }
+
+			if( self->stopped )
+				fsd_exc_raise_code( FSD_DRMAA_ERRNO_NO_ACTIVE_SESSION );
+			if( timeout )
+				signaled = fsd_cond_timedwait(
+						&self->resolved, &self->mutex, timeout );
+			else
+				fsd_cond_wait( &self->resolved, &self->mutex );
+			if( !signaled )
+				fsd_exc_raise_code( FSD_DRMAA_ERRNO_EXIT_TIMEOUT );
+		 }
+
+		/* unlink collected request */
+		for( preq = &self->tab[ (size_t)req->ticket & self->tab_mask ];
+				*preq != req;  preq = &(*preq)->next_in_tab ) {}
+		*preq = req->next_in_tab;
+		if( req->prev )
+			req->prev->next = req->next;
+		else
+			self->resolved_head = req->next;
+		if( req->next )
+			req->next->prev = req->prev;
+		else
+			self->resolved_tail = req->prev;
+		self->n_uncollected--;
+
+		locked = fsd_mutex_unlock( &self->mutex );
+
+		if( ticket_out )
+			*ticket_out = req->ticket;
+		if( req->job_id == NULL  &&  req->error_message != NULL )
+			fsd_exc_raise_msg( req->error_code, req->error_message );
+		else if( req->job_id == NULL )
+			fsd_exc_raise_code( req->error_code );
+		job_id = req->job_id;
+		req->job_id = NULL;
+	 }
+	FINALLY
+	 {
+		if( locked )
+			fsd_mutex_unlock( &self->mutex );
+		if( req )
+			fsd_submit_request_free( req );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%s", job_id ));
+	return job_id;
+}
+
+
+void
+fsd_submit_queue_stop( fsd_submit_queue_t *self )
+{
+	volatile int lock_count = 0;
+
+	fsd_log_enter(( "" ));
+	fsd_mutex_lock( &self->mutex );
+	TRY
+	 {
+		self->run_flag = false;
+		fsd_cond_broadcast( &self->not_empty );
+		fsd_cond_broadcast( &self->not_full );
+		TRY
+		 {
+			unsigned i;
+			lock_count = fsd_mutex_unlock_times( &self->mutex );
+			for( i = 0;  i < self->n_threads;  i++ )
+				fsd_thread_join( self->threads[i], NULL );
+		 }
+		FINALLY
+		 {
+			int i;
+			for( i = 0;  i < lock_count;  i++ )
+				fsd_mutex_lock( &self->mutex );
+		 }
+		END_TRY
+		self->n_threads = 0;
+		self->stopped = true;
+		fsd_cond_broadcast( &self->resolved );
+	 }
+	FINALLY
+	 { fsd_mutex_unlock( &self->mutex ); }
+	END_TRY
+	fsd_log_return(( "" ));
+}
+
+
+/**
+ * Submitter thread.  Takes requests in FIFO order until queue
+ * is stopped and drained.
+ */
+void *
+fsd_submit_queue_thread( fsd_submit_queue_t *self )
+{
+	fsd_drmaa_session_t *session = self->session;
+
+	fsd_timeline_thread_name( "submit worker" );
+	fsd_log_enter(( "" ));
+	fsd_mutex_lock( &self->mutex );
+	while( true )
+	 {
+		fsd_submit_request_t *req = NULL;
+		char *volatile job_id = NULL;
+		volatile int error_code = 0;
+		char *volatile error_message = NULL;
+
+		while( self->run_flag  &&  self->pending_head == NULL )
+			fsd_cond_wait( &self->not_empty, &self->mutex );
+		if( self->pending_head == NULL )
+			break;
+
+		req = self->pending_head;
+		self->pending_head = req->next;
+		if( self->pending_head == NULL )
+			self->pending_tail = NULL;
+		req->next = NULL;
+		fsd_mutex_unlock( &self->mutex );
+
+		TRY
+		 {
+			fsd_log_debug(( "submitting request %d", req->ticket ));
+			job_id = session->run_job( session, req->jt );
+		 }
+		EXCEPT_DEFAULT
+		 {
+			const fsd_exc_t *e = fsd_exc_get();
+			fsd_log_error(( "submission %d failed: <%d:%s>",
+						req->ticket, e->code(e), e->message(e) ));
+			error_code = e->code(e);
+			error_message = fsd_strdup( FSD_SAFE_STR(e->message(e)) );
+		 }
+		END_TRY
+
+		req->jt->destroy( req->jt );
+		req->jt = NULL;
+
+		fsd_mutex_lock( &self->mutex );
+		req->job_id = job_id;
+		req->error_code = error_code;
+		req->error_message = error_message;
+		req->resolved = true;
+		req->prev = self->resolved_tail;
+		if( self->resolved_tail )
+			self->resolved_tail->next = req;
+		else
+			self->resolved_head = req;
+		self->resolved_tail = req;
+		self->n_outstanding--;
+		fsd_cond_broadcast( &self->resolved );
+		fsd_cond_signal( &self->not_full );
+	 }
+	fsd_mutex_unlock( &self->mutex );
+
+	fsd_log_return(( " =NULL" ));
+	return NULL;
+}
+
+
+/** Doubles ticket table (called with mutex held). */
+void
+fsd_submit_queue_grow( fsd_submit_queue_t *self )
+{
+	fsd_submit_request_t **tab = NULL;
+	size_t tab_size = 2 * self->tab_size;
+	size_t i;
+
+	fsd_log_debug(( "growing submit queue table to %lu", (unsigned long)tab_size ));
+	fsd_calloc( tab, tab_size, fsd_submit_request_t* );
+	for( i = 0;  i < self->tab_size;  i++ )
+		while( self->tab[i] != NULL )
+		 {
+			fsd_submit_request_t *req = self->tab[i];
+			size_t h = (size_t)req->ticket & (tab_size - 1);
+			self->tab[i] = req->next_in_tab;
+			req->next_in_tab = tab[h];
+			tab[h] = req;
+		 }
+	fsd_free( self->tab );
+	self->tab = tab;
+	self->tab_size = tab_size;
+	self->tab_mask = tab_size - 1;
+}
+
+
+void
+fsd_submit_request_free( fsd_submit_request_t *req )
+{
+	if( req->jt )
+		req->jt->destroy( req->jt );
+	fsd_free( req->job_id );
+	fsd_free( req->error_message );
+	fsd_free( req );
+}
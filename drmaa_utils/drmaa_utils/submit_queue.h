@@ -0,0 +1,133 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file submit_queue.h
+ * Asynchronous job submission queue.
+ */
+
+#ifndef __DRMAA_UTILS__SUBMIT_QUEUE_H
+#define __DRMAA_UTILS__SUBMIT_QUEUE_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <time.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/thread.h>
+
+typedef struct fsd_submit_request_s fsd_submit_request_t;
+
+/**
+ * Creates submission queue served by @a n_threads submitter threads
+ * which call @c session->run_job() for queued templates.
+ * @param session   DRMAA session jobs are submitted in.
+ * @param n_threads Number of submitter threads.
+ * @param capacity  Maximal number of requests waiting for submission
+ *   (or being submitted) at once.  When reached #submit blocks.
+ */
+fsd_submit_queue_t *
+fsd_submit_queue_new(
+		fsd_drmaa_session_t *session,
+		unsigned n_threads, unsigned capacity
+		);
+
+/** Ticket value which matches any submission request. */
+#define FSD_SUBMIT_TICKET_ANY  (-1)
+
+/**
+ * Bounded FIFO of job submission requests.
+ *
+ * Each accepted request gets a ticket (positive integer, increasing
+ * in order of acceptance).  Requests are taken by submitter threads
+ * in ticket order.  Outcome of every request (job identifier or error)
+ * is held until it is collected exactly once with #collect.
+ * Only pending and in-flight requests count against capacity -
+ * outcomes are kept until collected, so callers must collect
+ * every ticket or the queue grows without bound.
+ */
+struct fsd_submit_queue_s {
+	/**
+	 * Queue copy of job template for submission.
+	 * Blocks while queue is full.
+	 * @return Ticket identifying request.
+	 */
+	int (*
+	submit)( fsd_submit_queue_t *self, const fsd_template_t *jt );
+
+	/**
+	 * Wait for outcome of submission request.
+	 * @param ticket  Ticket returned by #submit
+	 *   or #FSD_SUBMIT_TICKET_ANY to collect any resolved request
+	 *   (in order of resolution).
+	 * @param ticket_out  If not \c NULL ticket of collected request
+	 *   is stored here.
+	 * @param timeout  Absolute time after which
+	 *   #FSD_DRMAA_ERRNO_EXIT_TIMEOUT is raised or \c NULL.
+	 * @return Job identifier of submitted job.  When submission failed
+	 *   the original error is raised instead.
+	 */
+	char* (*
+	collect)(
+			fsd_submit_queue_t *self, int ticket, int *ticket_out,
+			const struct timespec *timeout
+			);
+
+	/**
+	 * Stop accepting new requests, submit already queued ones
+	 * and join submitter threads.
+	 */
+	void (*
+	stop)( fsd_submit_queue_t *self );
+
+	/** Stop queue (if not stopped yet) and free it. */
+	void (*
+	destroy)( fsd_submit_queue_t *self );
+
+	fsd_drmaa_session_t *session;
+
+	/** Requests hashed by ticket (grows with uncollected requests). */
+	fsd_submit_request_t **tab;
+	size_t tab_size;
+	size_t tab_mask;
+
+	/** Requests waiting for submitter thread (FIFO). */
+	fsd_submit_request_t *pending_head, *pending_tail;
+	/** Resolved and not yet collected requests (in order of resolution). */
+	fsd_submit_request_t *resolved_head, *resolved_tail;
+
+	unsigned n_outstanding; /**< Pending and in-flight requests. */
+	unsigned n_uncollected; /**< All requests not collected yet. */
+	unsigned capacity;
+	int last_ticket;
+
+	fsd_thread_t *threads;
+	unsigned n_threads;
+	bool run_flag;
+	bool stopped;
+
+	fsd_mutex_t mutex;
+	fsd_cond_t not_empty; /**< Signaled when request is queued. */
+	fsd_cond_t not_full; /**< Signaled when request left submitters. */
+	fsd_cond_t resolved; /**< Signaled when request is resolved. */
+};
+
+#endif /* __DRMAA_UTILS__SUBMIT_QUEUE_H */
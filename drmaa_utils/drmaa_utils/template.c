@@ -130,6 +130,41 @@ fsd_template_set_v_attr( fsd_template_t *self,
 }
 
 
+static fsd_template_t *
+fsd_template_copy( const fsd_template_t *self )
+{
+	fsd_template_t *volatile copy = NULL;
+	TRY
+	 {
+		unsigned i;
+		copy = fsd_template_new( self->by_name, self->by_code,
+				self->n_attributes );
+		for( i = 0;  i < self->n_attributes;  i++ )
+			if( self->attributes[i] != NULL )
+			 {
+				const fsd_attribute_t *attr;
+				attr = self->by_code( self, i );
+				if( attr == NULL )
+					continue;
+				if( attr->is_vector )
+					copy->attributes[i] = fsd_copy_vector(
+							(const char *const*)self->attributes[i] );
+				else
+					copy->attributes[i] = fsd_strdup(
+							(const char*)self->attributes[i] );
+			 }
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( copy )
+			copy->destroy( copy );
+		fsd_exc_reraise();
+	 }
+	END_TRY
+	return copy;
+}
+
+
 static void
 fsd_template_destroy( fsd_template_t *self )
 {
@@ -171,6 +206,7 @@ fsd_template_new(
 		self->set_v_attr = fsd_template_set_v_attr;
 		self->by_name = by_name_method;
 		self->by_code = by_code_method;
+		self->copy = fsd_template_copy;
 		self->destroy = fsd_template_destroy;
 
 		fsd_calloc( self->attributes, n_attributes, void* );
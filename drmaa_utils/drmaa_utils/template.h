@@ -59,6 +59,10 @@ struct fsd_template_s {
 	const fsd_attribute_t* (*
 	by_code)( const fsd_template_t *self, int code );
 
+	/** Returns deep copy of template. */
+	fsd_template_t* (*
+	copy)( const fsd_template_t *self );
+
 	void (*
 	destroy)( fsd_template_t *self );
 
@@ -30,6 +30,8 @@
 
 #include <drmaa_utils/thread.h>
 #include <drmaa_utils/common.h>
+#include <drmaa_utils/lockprof.h>
+#include <drmaa_utils/probes.h>
 #include <errno.h>
 #include <unistd.h>
 
@@ -42,6 +44,12 @@ pid_t gettid(void)
 }
 #endif
 
+#ifdef ENABLE_USDT
+#	define FSD_MUTEX_WATCH_CONTENTION  true
+#else
+#	define FSD_MUTEX_WATCH_CONTENTION  fsd_lockprof_enabled
+#endif
+
 #ifndef lint
 static char rcsid[]
 #	ifdef __GNUC__
@@ -79,6 +87,39 @@ fsd_thread_detach( fsd_thread_t th )
 }
 
 
+/*
+ * Locks plain mutex.  When profiling or tracing, contended case
+ * is told apart by trying the lock first.
+ */
+static int
+fsd_mutex_lock_watched( pthread_mutex_t *plain, fsd_mutex_t *mutex )
+{
+	struct timespec wait_start;
+	int errno_ = 0;
+
+	if( !FSD_MUTEX_WATCH_CONTENTION )
+		return pthread_mutex_lock( plain );
+
+	errno_ = pthread_mutex_trylock( plain );
+	if( errno_ == EBUSY )
+	 {
+		FSD_PROBE1( mutex_contended, mutex );
+		if( fsd_lockprof_enabled )
+			fsd_lockprof_wait_start( &wait_start );
+		errno_ = pthread_mutex_lock( plain );
+		if( errno_ == 0 )
+		 {
+			FSD_PROBE1( mutex_acquired, mutex );
+			if( fsd_lockprof_enabled )
+				fsd_lockprof_acquired( mutex, &wait_start );
+		 }
+	 }
+	else if( errno_ == 0  &&  fsd_lockprof_enabled )
+		fsd_lockprof_acquired( mutex, NULL );
+	return errno_;
+}
+
+
 #if HAVE_RECURSIVE_MUTEXES
 
 void
@@ -97,12 +138,15 @@ fsd_mutex_init( fsd_mutex_t *mutex )
 	} while( false );
 	if( errno_ )
 		fsd_exc_raise_sys( errno_ );
+	fsd_lockprof_init();
 }
 
 void
 fsd_mutex_destroy( fsd_mutex_t *mutex )
 {
 	int errno_ = 0;
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_forget( mutex );
 	errno_ = pthread_mutex_destroy( mutex );
 	if( errno_ )
 		fsd_exc_raise_sys( errno_ );
@@ -112,7 +156,7 @@ bool
 fsd_mutex_lock( fsd_mutex_t *mutex )
 {
 	int errno_ = 0;
-	errno_ = pthread_mutex_lock( mutex );
+	errno_ = fsd_mutex_lock_watched( mutex, mutex );
 	if( errno_ )
 		fsd_exc_raise_sys( errno_ );
 	return true;
@@ -122,6 +166,8 @@ bool
 fsd_mutex_unlock( fsd_mutex_t *mutex )
 {
 	int errno_ = 0;
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_released( mutex, false );
 	errno_ = pthread_mutex_unlock( mutex );
 	if( errno_ )
 		fsd_exc_raise_sys( errno_ );
@@ -136,6 +182,8 @@ fsd_mutex_trylock( fsd_mutex_t *mutex )
 	switch( errno_ )
 	 {
 		case 0:
+			if( fsd_lockprof_enabled )
+				fsd_lockprof_acquired( mutex, NULL );
 			return true;
 		case EBUSY:
 			return false;
@@ -149,6 +197,8 @@ fsd_mutex_unlock_times( fsd_mutex_t *mutex )
 {
 	int count = 0;
 	int errno_ = 0;
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_released( mutex, true );
 	while( errno_ == 0 )
 	 {
 		errno_ = pthread_mutex_unlock( mutex );
@@ -200,7 +250,11 @@ void
 fsd_cond_wait( fsd_cond_t *cond, fsd_mutex_t *mutex )
 {
 	int errno_ = 0;
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_suspend( mutex );
 	errno_ = pthread_cond_wait( cond, mutex );
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_resume( mutex );
 	if( errno_ )
 		fsd_exc_raise_sys( errno_ );
 }
@@ -210,7 +264,11 @@ fsd_cond_timedwait( fsd_cond_t *cond, fsd_mutex_t *mutex,
 		const struct timespec *abstime )
 {
 	int errno_ = 0;
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_suspend( mutex );
 	errno_ = pthread_cond_timedwait( cond, mutex, abstime );
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_resume( mutex );
 	switch( errno_ )
 	 {
 		case 0:
@@ -233,12 +291,15 @@ fsd_mutex_init( fsd_mutex_t *mutex )
 	errno_ = pthread_mutex_init( &mutex->mutex, NULL );
 	if( errno_ )
 		fsd_exc_raise_sys( errno_ );
+	fsd_lockprof_init();
 }
 
 void
 fsd_mutex_destroy( fsd_mutex_t *mutex )
 {
 	int errno_ = 0;
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_forget( mutex );
 	errno_ = pthread_mutex_destroy( &mutex->mutex );
 	if( errno_ )
 		fsd_exc_raise_sys( errno_ );
@@ -253,7 +314,7 @@ fsd_mutex_lock( fsd_mutex_t *mutex )
 	else
 	 {
 		int errno_ = 0;
-		errno_ = pthread_mutex_lock( &mutex->mutex );
+		errno_ = fsd_mutex_lock_watched( &mutex->mutex, mutex );
 		if( errno_ == 0 )
 		 {
 			mutex->owner    = pthread_self();
@@ -273,6 +334,8 @@ fsd_mutex_unlock( fsd_mutex_t *mutex )
 	if( -- (mutex->acquired) == 0 )
 	 {
 		int errno_ = 0;
+		if( fsd_lockprof_enabled )
+			fsd_lockprof_released( mutex, false );
 		errno_ = pthread_mutex_unlock( &mutex->mutex );
 		if( errno_ )
 			fsd_exc_raise_sys( errno_ );
@@ -297,6 +360,8 @@ fsd_mutex_trylock( fsd_mutex_t *mutex )
 			case 0:
 				mutex->owner    = pthread_self();
 				mutex->acquired = 1;
+				if( fsd_lockprof_enabled )
+					fsd_lockprof_acquired( mutex, NULL );
 				return true;
 			case ETIMEDOUT:
 				return false;
@@ -315,6 +380,8 @@ fsd_mutex_unlock_times( fsd_mutex_t *mutex )
 			&&  pthread_equal( mutex->owner, pthread_self() ) );
 	count = mutex->acquired;
 	mutex->acquired = 0;
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_released( mutex, true );
 	errno_ = pthread_mutex_unlock( &mutex->mutex );
 	if( errno_ )
 		fsd_exc_raise_sys( errno_ );
@@ -364,7 +431,11 @@ fsd_cond_wait( fsd_cond_t *cond, fsd_mutex_t *mutex )
 	int acquired_save = mutex->acquired;
 	fsd_assert( mutex->acquired
 			&&  pthread_equal( mutex->owner, pthread_self() ) );
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_suspend( mutex );
 	errno_ = pthread_cond_wait( cond, &mutex->mutex );
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_resume( mutex );
 	if( errno_ == 0 )
 	 {
 		mutex->owner = pthread_self();
@@ -382,7 +453,11 @@ fsd_cond_timedwait( fsd_cond_t *cond, fsd_mutex_t *mutex,
 	int acquired_save = mutex->acquired;
 	fsd_assert( mutex->acquired
 			&&  pthread_equal( mutex->owner, pthread_self() ) );
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_suspend( mutex );
 	errno_ = pthread_cond_timedwait( cond, &mutex->mutex, abstime );
+	if( fsd_lockprof_enabled )
+		fsd_lockprof_resume( mutex );
 	switch( errno_ )
 	 {
 		case 0:
@@ -83,6 +83,16 @@ bool fsd_mutex_lock     ( fsd_mutex_t *mutex );
 bool fsd_mutex_unlock   ( fsd_mutex_t *mutex );
 bool fsd_mutex_trylock  ( fsd_mutex_t *mutex );
 
+/**
+ * Names mutex for lock profiling (see lockprof.h).
+ * Statistics of mutexes with the same name are aggregated.
+ * Names are kept by mutex address: object embedding named mutex
+ * must drop name (@c NULL @a name) before it is moved by fsd_realloc()
+ * and name it again afterwards.
+ * Does nothing unless profiling is enabled.
+ */
+void fsd_mutex_set_name ( fsd_mutex_t *mutex, const char *name );
+
 /**
  * Try to unlock mutex as many times as possible
  * returning the count of locks previously granted
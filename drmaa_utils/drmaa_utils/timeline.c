@@ -0,0 +1,389 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <drmaa_utils/logging.h>
+#include <drmaa_utils/thread.h>
+#include <drmaa_utils/timeline.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+/*
+ * Timeline is fed from fsd_log_enter/return and so also from inside
+ * of fsd_mutex_* - it uses plain pthread mutexes only.  Thread buffer
+ * mutex is taken by owner when appending event and by whoever writes
+ * buffer (so it is practically never contended).  Lock order:
+ * list of threads -> thread buffer -> file.  Names of events are
+ * not copied - they must be static strings (function names, metric
+ * names).
+ */
+
+#define FSD_TIMELINE_BUFFER 4096
+#define FSD_TIMELINE_DEPTH  128
+
+typedef struct {
+	const char *name;
+	const char *category;
+	uint64_t start_ns;
+	uint64_t duration_ns;
+} fsd_timeline_event_t;
+
+typedef struct {
+	const char *function;
+	uint64_t start_ns;
+} fsd_timeline_frame_t;
+
+typedef struct fsd_timeline_thread_s fsd_timeline_thread_t;
+struct fsd_timeline_thread_s {
+	pthread_mutex_t mutex;
+	int tid;
+	const char *name;
+	bool name_written;
+	int n_events;
+	fsd_timeline_event_t events[FSD_TIMELINE_BUFFER];
+	int depth; /**< may exceed FSD_TIMELINE_DEPTH (frames not recorded) */
+	fsd_timeline_frame_t stack[FSD_TIMELINE_DEPTH];
+	fsd_timeline_thread_t *prev, *next;
+};
+
+bool fsd_timeline_enabled = false;
+
+static pthread_once_t fsd_timeline_once = PTHREAD_ONCE_INIT;
+static pthread_key_t fsd_timeline_key;
+static pthread_mutex_t fsd_timeline_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t fsd_timeline_mutex = PTHREAD_MUTEX_INITIALIZER; /* file */
+static FILE *fsd_timeline_file = NULL;
+static bool fsd_timeline_first = true;
+static bool fsd_timeline_closed = false;
+static int fsd_timeline_pid = 0;
+static fsd_timeline_thread_t *fsd_timeline_threads = NULL;
+
+static __thread fsd_timeline_thread_t *fsd_timeline_self = NULL;
+static __thread bool fsd_timeline_self_failed = false;
+
+
+static uint64_t
+fsd_timeline_ns( const struct timespec *ts )
+{
+	return (uint64_t)ts->tv_sec * 1000000000u + (uint64_t)ts->tv_nsec;
+}
+
+
+static uint64_t
+fsd_timeline_now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return fsd_timeline_ns( &ts );
+}
+
+
+/* Called with fsd_timeline_mutex held. */
+static void
+fsd_timeline_separator( void )
+{
+	fputs( fsd_timeline_first ? "\n" : ",\n", fsd_timeline_file );
+	fsd_timeline_first = false;
+}
+
+
+/* Writes and empties buffer (its mutex must be held). */
+static void
+fsd_timeline_write( fsd_timeline_thread_t *t )
+{
+	int i;
+
+	pthread_mutex_lock( &fsd_timeline_mutex );
+	if( fsd_timeline_closed )
+		t->n_events = 0; /* events of threads still running at exit */
+	if( t->name != NULL  &&  !t->name_written  &&  !fsd_timeline_closed )
+	 {
+		fsd_timeline_separator();
+		fprintf( fsd_timeline_file, "{\"name\":\"thread_name\",\"ph\":\"M\","
+				"\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+				fsd_timeline_pid, t->tid, t->name );
+		t->name_written = true;
+	 }
+	for( i = 0;  i < t->n_events;  i++ )
+	 {
+		const fsd_timeline_event_t *e = &t->events[i];
+		fsd_timeline_separator();
+		fprintf( fsd_timeline_file, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+				"\"pid\":%d,\"tid\":%d,\"ts\":%llu.%03u,\"dur\":%llu.%03u}",
+				e->name, e->category, fsd_timeline_pid, t->tid,
+				(unsigned long long)(e->start_ns / 1000), (unsigned)(e->start_ns % 1000),
+				(unsigned long long)(e->duration_ns / 1000), (unsigned)(e->duration_ns % 1000) );
+	 }
+	pthread_mutex_unlock( &fsd_timeline_mutex );
+	t->n_events = 0;
+}
+
+
+static void
+fsd_timeline_thread_exit( void *arg )
+{
+	fsd_timeline_thread_t *t = (fsd_timeline_thread_t*)arg;
+
+	pthread_mutex_lock( &fsd_timeline_list_mutex );
+	if( t->prev )
+		t->prev->next = t->next;
+	else
+		fsd_timeline_threads = t->next;
+	if( t->next )
+		t->next->prev = t->prev;
+	pthread_mutex_lock( &t->mutex );
+	fsd_timeline_write( t );
+	pthread_mutex_unlock( &t->mutex );
+	pthread_mutex_unlock( &fsd_timeline_list_mutex );
+	pthread_mutex_destroy( &t->mutex );
+	free( t );
+	fsd_timeline_self = NULL;
+}
+
+
+/*
+ * Trace is closed when library is unloaded (or process exits).
+ * atexit() handler and thread key destructor would outlive dlclose()
+ * of library and jump into unmapped code.
+ */
+#ifdef __GNUC__
+static void fsd_timeline_at_unload( void ) __attribute__ ((destructor));
+#endif
+
+static void
+fsd_timeline_at_unload( void )
+{
+	if( !fsd_timeline_enabled )
+		return;
+	fsd_timeline_flush();
+	pthread_key_delete( fsd_timeline_key );
+	pthread_mutex_lock( &fsd_timeline_mutex );
+	fsd_timeline_enabled = false;
+	fsd_timeline_closed = true;
+	fputs( "\n]\n", fsd_timeline_file );
+	fclose( fsd_timeline_file );
+	fsd_timeline_file = NULL;
+	pthread_mutex_unlock( &fsd_timeline_mutex );
+}
+
+
+static void
+fsd_timeline_do_init( void )
+{
+	const char *path = getenv( "DRMAA_TRACE_FILE" );
+	int rc;
+
+	if( path == NULL  ||  path[0] == '\0' )
+		return;
+	fsd_timeline_file = fopen( path, "w" );
+	if( fsd_timeline_file == NULL )
+	 {
+		fsd_log_error(( "Could not open DRMAA_TRACE_FILE=%s: %s", path, strerror(errno) ));
+		return;
+	 }
+	rc = pthread_key_create( &fsd_timeline_key, fsd_timeline_thread_exit );
+	if( rc != 0 )
+	 {
+		fsd_log_error(( "DRMAA_TRACE_FILE=%s: %s - timeline disabled", path, strerror(rc) ));
+		fclose( fsd_timeline_file );
+		fsd_timeline_file = NULL;
+		return;
+	 }
+	fsd_timeline_pid = (int)getpid();
+	fputs( "[", fsd_timeline_file );
+	fsd_timeline_enabled = true;
+}
+
+
+void
+fsd_timeline_init( void )
+{
+	pthread_once( &fsd_timeline_once, fsd_timeline_do_init );
+}
+
+
+static fsd_timeline_thread_t *
+fsd_timeline_thread( void )
+{
+	fsd_timeline_thread_t *t = fsd_timeline_self;
+
+	if( t != NULL  ||  fsd_timeline_self_failed )
+		return t;
+
+	t = (fsd_timeline_thread_t*)malloc( sizeof(fsd_timeline_thread_t) );
+	if( t == NULL )
+	 {
+		fsd_timeline_self_failed = true;
+		return NULL;
+	 }
+	pthread_mutex_init( &t->mutex, NULL );
+	t->tid = fsd_thread_id();
+	t->name = NULL;
+	t->name_written = false;
+	t->n_events = 0;
+	t->depth = 0;
+	t->prev = NULL;
+
+	pthread_mutex_lock( &fsd_timeline_list_mutex );
+	t->next = fsd_timeline_threads;
+	if( t->next )
+		t->next->prev = t;
+	fsd_timeline_threads = t;
+	pthread_mutex_unlock( &fsd_timeline_list_mutex );
+
+	pthread_setspecific( fsd_timeline_key, t );
+	fsd_timeline_self = t;
+	return t;
+}
+
+
+static void
+fsd_timeline_add( fsd_timeline_thread_t *t, const char *name,
+		const char *category, uint64_t start_ns, uint64_t end_ns )
+{
+	fsd_timeline_event_t *e;
+
+	pthread_mutex_lock( &t->mutex );
+	if( t->n_events == FSD_TIMELINE_BUFFER )
+		fsd_timeline_write( t );
+	e = &t->events[ t->n_events++ ];
+	e->name = name;
+	e->category = category;
+	e->start_ns = start_ns;
+	e->duration_ns = end_ns > start_ns ? end_ns - start_ns : 0;
+	pthread_mutex_unlock( &t->mutex );
+}
+
+
+void
+fsd_timeline_enter( const char *function )
+{
+	fsd_timeline_thread_t *t = fsd_timeline_thread();
+
+	if( t == NULL )
+		return;
+	if( t->depth < FSD_TIMELINE_DEPTH )
+	 {
+		t->stack[t->depth].function = function;
+		t->stack[t->depth].start_ns = fsd_timeline_now();
+	 }
+	t->depth++;
+}
+
+
+void
+fsd_timeline_return( const char *function )
+{
+	fsd_timeline_thread_t *t = fsd_timeline_thread();
+	uint64_t now;
+	int i;
+
+	if( t == NULL  ||  t->depth == 0 )
+		return;
+	if( t->depth > FSD_TIMELINE_DEPTH )
+	 { /* frame was not recorded */
+		t->depth--;
+		return;
+	 }
+
+	for( i = t->depth - 1;  i >= 0;  i-- )
+		if( t->stack[i].function == function )
+			break;
+	if( i < 0 )
+		return; /* return without enter */
+
+	now = fsd_timeline_now();
+	while( t->depth > i )
+	 {
+		const fsd_timeline_frame_t *frame = &t->stack[ --t->depth ];
+		fsd_timeline_add( t, frame->function, "function",
+				frame->start_ns, now );
+	 }
+}
+
+
+void
+fsd_timeline_span( const char *name, const char *category,
+		const struct timespec *start, const struct timespec *end )
+{
+	fsd_timeline_thread_t *t = fsd_timeline_thread();
+
+	if( t != NULL )
+		fsd_timeline_add( t, name, category,
+				fsd_timeline_ns( start ), fsd_timeline_ns( end ) );
+}
+
+
+void
+fsd_timeline_thread_name( const char *name )
+{
+	fsd_timeline_thread_t *t;
+
+	if( !fsd_timeline_enabled )
+		return;
+	t = fsd_timeline_thread();
+	if( t != NULL )
+	 {
+		pthread_mutex_lock( &t->mutex );
+		t->name = name;
+		t->name_written = false;
+		pthread_mutex_unlock( &t->mutex );
+	 }
+}
+
+
+void
+fsd_timeline_flush( void )
+{
+	fsd_timeline_thread_t *t;
+
+	if( !fsd_timeline_enabled )
+		return;
+
+	pthread_mutex_lock( &fsd_timeline_list_mutex );
+	for( t = fsd_timeline_threads;  t;  t = t->next )
+	 {
+		pthread_mutex_lock( &t->mutex );
+		fsd_timeline_write( t );
+		pthread_mutex_unlock( &t->mutex );
+	 }
+	pthread_mutex_lock( &fsd_timeline_mutex );
+	if( fsd_timeline_file != NULL )
+		fflush( fsd_timeline_file );
+	pthread_mutex_unlock( &fsd_timeline_mutex );
+	pthread_mutex_unlock( &fsd_timeline_list_mutex );
+}
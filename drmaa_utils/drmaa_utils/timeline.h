@@ -0,0 +1,72 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA utilities library
+ * Copyright (C) 2011-2012 Poznan Supercomputing and Networking Center
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file timeline.h
+ * Timeline of function calls in Chrome trace format.
+ *
+ * Enabled by setting @c DRMAA_TRACE_FILE environment variable to name
+ * of file (read by drmaa_init()).  Then each fsd_log_enter() /
+ * fsd_log_return() pair (also in production build, regardless of log
+ * level) becomes complete event ("ph":"X") with thread identifier
+ * and microsecond timestamps, as well as every interval measured
+ * for metrics (DRM calls, waits, poll cycles and lock waits).
+ * File can be opened in chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Events are collected in per thread buffers and written when buffer
+ * fills up, thread exits, at drmaa_exit() and when library is unloaded
+ * (or process exits).
+ * Frames left without fsd_log_return() (by exception) are closed
+ * when some calling function returns.
+ */
+
+#ifndef __DRMAA_UTILS__TIMELINE_H
+#define __DRMAA_UTILS__TIMELINE_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <time.h>
+
+#include <drmaa_utils/compat.h>
+
+/** Whether timeline is recorded (set once from environment). */
+extern bool fsd_timeline_enabled;
+
+/** Reads @c DRMAA_TRACE_FILE and opens trace file (done once). */
+void fsd_timeline_init( void );
+
+/** Function was entered by current thread. */
+void fsd_timeline_enter( const char *function );
+
+/** Function is going to return (closes its frame and unclosed inner ones). */
+void fsd_timeline_return( const char *function );
+
+/** Record interval from @a start to @a end (monotonic clock). */
+void fsd_timeline_span( const char *name, const char *category,
+		const struct timespec *start, const struct timespec *end );
+
+/** Name current thread in timeline. */
+void fsd_timeline_thread_name( const char *name );
+
+/** Write events buffered by all threads. */
+void fsd_timeline_flush( void );
+
+#endif /* __DRMAA_UTILS__TIMELINE_H */
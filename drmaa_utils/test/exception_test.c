@@ -164,6 +164,37 @@ void test_4(void)
 }
 
 
+/* blocks entered repeatedly must be unwound every time
+   (timing of TRY blocks is measured by utils_bench -s try) */
+static int volatile repeated_counter = 0;
+
+static void
+repeated_inner( void )
+{
+	TRY
+	 { repeated_counter++; }
+	FINALLY
+	 { repeated_counter++; }
+	END_TRY
+}
+
+void test_repeated(void)
+{
+	const int n_iterations = 1000;
+	int i;
+
+	for( i = 0;  i < n_iterations;  i++ )
+	 {
+		TRY
+		 { repeated_inner(); }
+		EXCEPT_DEFAULT
+		 { assert(0); }
+		END_TRY
+	 }
+	assert( repeated_counter == 2 * n_iterations );
+}
+
+
 int
 main( int argc, char *argv[] )
 {
@@ -177,6 +208,8 @@ main( int argc, char *argv[] )
 	runner( test_3 );
 	printf("Running Test 4\n");
 	runner( test_4 );
+	printf("Running Test 5\n");
+	test_repeated();
 	printf("All tests done.\n");
 
 	return 0;
@@ -0,0 +1,824 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/conf.h>
+#include <drmaa_utils/drmaa.h>
+#include <drmaa_utils/drmaa_util.h>
+#include <drmaa_utils/environ.h>
+#include <drmaa_utils/iter.h>
+#include <drmaa_utils/job.h>
+#include <drmaa_utils/util.h>
+
+/*
+ * Microbenchmarks of drmaa_utils containers and helpers: job set
+ * (fsd_job.c), environment dictionary (environ.c), configuration
+ * dictionary (conf.c), iterators (iter.c), placeholder expansion
+ * and TRY/EXCEPT blocks.
+ *
+ * Usage: utils_bench [-m MAX_SIZE] [-T THREADS,...] [-n MIN_OPS]
+ *                    [-b BUDGET_SECONDS] [-s BENCH[.MIX],...] [-o FILE]
+ *
+ * Every benchmark is run for sizes 1, 10, 100, ... up to MAX_SIZE
+ * (default 1000000) - number of entries in container, placeholders
+ * in expanded string or nesting depth of TRY blocks - and for each
+ * number of THREADS (default 1,4) where it makes sense (shared job set,
+ * read only lookups, independent objects per thread).  Each case does
+ * at least MIN_OPS operations (default 100000).  When case takes
+ * longer than BUDGET_SECONDS (default 1) larger sizes are skipped.
+ * One line of JSON is written per case.
+ */
+
+typedef struct bench_thread_s bench_thread_t;
+struct bench_thread_s {
+	pthread_t thread;
+	unsigned index;
+	unsigned threads;
+	unsigned size;
+	unsigned long min_ops;
+	void *fixture;
+	unsigned seed;
+	/* result */
+	unsigned long ops;
+	double seconds;
+	double started;
+};
+
+typedef struct {
+	const char *name;
+	const char *mix;
+	unsigned max_size; /* 0 - MAX_SIZE */
+	bool threaded;
+	/* shared data prepared before measurement (may be NULL) */
+	void *(*setup)( unsigned size );
+	/* measures operations with timer_start / timer_stop */
+	void (*run)( bench_thread_t *t );
+	void (*teardown)( void *fixture, unsigned size );
+} bench_t;
+
+static pthread_barrier_t barrier;
+
+
+static double
+now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void
+timer_start( bench_thread_t *t )
+{
+	t->started = now();
+}
+
+static void
+timer_stop( bench_thread_t *t )
+{
+	t->seconds += now() - t->started;
+}
+
+/* Number of repetitions of size-long round giving at least min_ops. */
+static unsigned long
+rounds( bench_thread_t *t )
+{
+	return (t->min_ops + t->size - 1) / t->size;
+}
+
+/* Visits every index below size once (7919 is prime, sizes are powers of 10). */
+static unsigned
+scatter( unsigned i, unsigned size )
+{
+	return (unsigned)(((unsigned long long)i * 7919) % size);
+}
+
+
+static char **
+make_keys( const char *prefix, unsigned size )
+{
+	char **keys = calloc( size + 1, sizeof(char*) );
+	unsigned i;
+
+	assert( keys != NULL );
+	for( i = 0;  i < size;  i++ )
+	 {
+		char key[64];
+		if( prefix == NULL ) /* job identifiers of bulk jobs */
+			sprintf( key, "%u_%u", 1000u + i / 1000, i % 1000 );
+		else
+			sprintf( key, "%s%u", prefix, i );
+		keys[i] = fsd_strdup( key );
+	 }
+	return keys;
+}
+
+
+/* ---- job set ----------------------------------------------------- */
+
+typedef struct {
+	char **keys;
+	fsd_job_set_t *set;
+} job_set_fixture_t;
+
+static fsd_job_set_t *
+job_set_fill( char **keys, unsigned size )
+{
+	fsd_job_set_t *set = fsd_job_set_new();
+	unsigned i;
+
+	for( i = 0;  i < size;  i++ )
+	 {
+		fsd_job_t *job = fsd_job_new( fsd_strdup(keys[i]) );
+		set->add( set, job );
+		job->release( job );
+	 }
+	return set;
+}
+
+static void *
+job_set_setup_keys( unsigned size )
+{
+	job_set_fixture_t *f = calloc( 1, sizeof(job_set_fixture_t) );
+	f->keys = make_keys( NULL, size );
+	return f;
+}
+
+static void *
+job_set_setup( unsigned size )
+{
+	job_set_fixture_t *f = job_set_setup_keys( size );
+	f->set = job_set_fill( f->keys, size );
+	return f;
+}
+
+static void
+job_set_teardown( void *fixture, unsigned size )
+{
+	job_set_fixture_t *f = fixture;
+	if( f->set )
+		f->set->destroy( f->set );
+	fsd_free_vector( f->keys );
+	free( f );
+}
+
+static void
+job_set_insert( bench_thread_t *t )
+{
+	job_set_fixture_t *f = t->fixture;
+	fsd_job_t **jobs = calloc( t->size, sizeof(fsd_job_t*) );
+	unsigned long r;
+	unsigned i;
+
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		fsd_job_set_t *set;
+		for( i = 0;  i < t->size;  i++ )
+			jobs[i] = fsd_job_new( fsd_strdup(f->keys[i]) );
+		timer_start( t );
+		set = fsd_job_set_new();
+		for( i = 0;  i < t->size;  i++ )
+			set->add( set, jobs[i] );
+		timer_stop( t );
+		for( i = 0;  i < t->size;  i++ )
+			jobs[i]->release( jobs[i] );
+		set->destroy( set );
+		t->ops += t->size;
+	 }
+	free( jobs );
+}
+
+static void
+job_set_lookup( bench_thread_t *t )
+{
+	job_set_fixture_t *f = t->fixture;
+	unsigned long n = t->min_ops > t->size ? t->min_ops : t->size;
+	unsigned long i;
+
+	timer_start( t );
+	for( i = 0;  i < n;  i++ )
+	 {
+		fsd_job_t *job = f->set->get( f->set, f->keys[ rand_r( &t->seed ) % t->size ] );
+		if( job == NULL )
+			abort();
+		job->release( job );
+	 }
+	timer_stop( t );
+	t->ops += n;
+}
+
+static void
+job_set_lookup_miss( bench_thread_t *t )
+{
+	job_set_fixture_t *f = t->fixture;
+	unsigned long n = t->min_ops > t->size ? t->min_ops : t->size;
+	unsigned long i;
+
+	timer_start( t );
+	for( i = 0;  i < n;  i++ )
+	 {
+		char job_id[32];
+		sprintf( job_id, "%lu", i );
+		if( f->set->get( f->set, job_id ) != NULL )
+			abort();
+	 }
+	timer_stop( t );
+	t->ops += n;
+}
+
+static void
+job_set_remove( bench_thread_t *t )
+{
+	job_set_fixture_t *f = t->fixture;
+	unsigned long r;
+	unsigned i;
+
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		fsd_job_set_t *set = job_set_fill( f->keys, t->size );
+		timer_start( t );
+		for( i = 0;  i < t->size;  i++ )
+			set->remove_by_id( set, f->keys[ scatter( i, t->size ) ] );
+		timer_stop( t );
+		assert( set->empty( set ) );
+		set->destroy( set );
+		t->ops += t->size;
+	 }
+}
+
+/* 8 lookups, removal and insertion of job (of own partition) - size is kept. */
+static void
+job_set_mixed( bench_thread_t *t )
+{
+	job_set_fixture_t *f = t->fixture;
+	unsigned long n = (t->min_ops > t->size ? t->min_ops : t->size) / 10 + 1;
+	unsigned long i;
+	unsigned j;
+
+	if( t->size < t->threads )
+		return;
+	timer_start( t );
+	for( i = 0;  i < n;  i++ )
+	 {
+		unsigned k = rand_r( &t->seed ) % (t->size / t->threads) * t->threads + t->index;
+		fsd_job_t *job;
+		for( j = 0;  j < 8;  j++ )
+		 {
+			job = f->set->get( f->set, f->keys[ rand_r( &t->seed ) % t->size ] );
+			if( job != NULL )
+				job->release( job );
+		 }
+		f->set->remove_by_id( f->set, f->keys[k] );
+		job = fsd_job_new( fsd_strdup(f->keys[k]) );
+		f->set->add( f->set, job );
+		job->release( job );
+	 }
+	timer_stop( t );
+	t->ops += 10 * n;
+}
+
+
+/* ---- environ (fixed number of buckets, no removal) --------------- */
+
+typedef struct {
+	char **keys;
+	fsd_environ_t *env;
+} environ_fixture_t;
+
+static void *
+environ_setup_keys( unsigned size )
+{
+	environ_fixture_t *f = calloc( 1, sizeof(environ_fixture_t) );
+	f->keys = make_keys( "VARIABLE_", size );
+	return f;
+}
+
+static void *
+environ_setup( unsigned size )
+{
+	environ_fixture_t *f = environ_setup_keys( size );
+	unsigned i;
+	f->env = fsd_environ_new( NULL );
+	for( i = 0;  i < size;  i++ )
+		f->env->set( f->env, fsd_strdup(f->keys[i]), fsd_strdup("value") );
+	return f;
+}
+
+static void
+environ_teardown( void *fixture, unsigned size )
+{
+	environ_fixture_t *f = fixture;
+	if( f->env )
+		f->env->destroy( f->env );
+	fsd_free_vector( f->keys );
+	free( f );
+}
+
+static void
+environ_insert( bench_thread_t *t )
+{
+	environ_fixture_t *f = t->fixture;
+	char **names = calloc( t->size, sizeof(char*) );
+	char **values = calloc( t->size, sizeof(char*) );
+	unsigned long r;
+	unsigned i;
+
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		fsd_environ_t *env;
+		for( i = 0;  i < t->size;  i++ )
+		 {
+			names[i] = fsd_strdup( f->keys[i] );
+			values[i] = fsd_strdup( "value" );
+		 }
+		timer_start( t );
+		env = fsd_environ_new( NULL );
+		for( i = 0;  i < t->size;  i++ )
+			env->set( env, names[i], values[i] );
+		timer_stop( t );
+		env->destroy( env );
+		t->ops += t->size;
+	 }
+	free( names );
+	free( values );
+}
+
+static void
+environ_lookup( bench_thread_t *t )
+{
+	environ_fixture_t *f = t->fixture;
+	unsigned long n = t->min_ops > t->size ? t->min_ops : t->size;
+	unsigned long i;
+
+	timer_start( t );
+	for( i = 0;  i < n;  i++ )
+		if( f->env->get( f->env, f->keys[ rand_r( &t->seed ) % t->size ] ) == NULL )
+			abort();
+	timer_stop( t );
+	t->ops += n;
+}
+
+
+/* ---- configuration dictionary (linked list) ---------------------- */
+
+typedef struct {
+	char **keys;
+	fsd_conf_dict_t *dict;
+} conf_fixture_t;
+
+static void *
+conf_setup_keys( unsigned size )
+{
+	conf_fixture_t *f = calloc( 1, sizeof(conf_fixture_t) );
+	f->keys = make_keys( "option_", size );
+	return f;
+}
+
+static void *
+conf_setup( unsigned size )
+{
+	conf_fixture_t *f = conf_setup_keys( size );
+	unsigned i;
+	f->dict = fsd_conf_dict_create();
+	for( i = 0;  i < size;  i++ )
+	 {
+		int value = (int)i;
+		fsd_conf_dict_set( f->dict, f->keys[i],
+				fsd_conf_option_create( FSD_CONF_INTEGER, &value ) );
+	 }
+	return f;
+}
+
+static void
+conf_teardown( void *fixture, unsigned size )
+{
+	conf_fixture_t *f = fixture;
+	if( f->dict )
+		fsd_conf_dict_destroy( f->dict );
+	fsd_free_vector( f->keys );
+	free( f );
+}
+
+static void
+conf_insert( bench_thread_t *t )
+{
+	conf_fixture_t *f = t->fixture;
+	fsd_conf_option_t **options = calloc( t->size, sizeof(fsd_conf_option_t*) );
+	unsigned long r;
+	unsigned i;
+
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		fsd_conf_dict_t *dict;
+		for( i = 0;  i < t->size;  i++ )
+		 {
+			int value = (int)i;
+			options[i] = fsd_conf_option_create( FSD_CONF_INTEGER, &value );
+		 }
+		timer_start( t );
+		dict = fsd_conf_dict_create();
+		for( i = 0;  i < t->size;  i++ )
+			fsd_conf_dict_set( dict, f->keys[i], options[i] );
+		timer_stop( t );
+		fsd_conf_dict_destroy( dict );
+		t->ops += t->size;
+	 }
+	free( options );
+}
+
+static void
+conf_lookup( bench_thread_t *t )
+{
+	conf_fixture_t *f = t->fixture;
+	unsigned long n = t->min_ops > t->size ? t->min_ops : t->size;
+	unsigned long i;
+
+	timer_start( t );
+	for( i = 0;  i < n;  i++ )
+		if( fsd_conf_dict_get( f->dict, f->keys[ rand_r( &t->seed ) % t->size ] ) == NULL )
+			abort();
+	timer_stop( t );
+	t->ops += n;
+}
+
+
+/* ---- iterators --------------------------------------------------- */
+
+static void *
+iter_setup( unsigned size )
+{
+	return make_keys( NULL, size );
+}
+
+static void
+iter_teardown( void *fixture, unsigned size )
+{
+	fsd_free_vector( (char**)fixture );
+}
+
+static void
+iter_append( bench_thread_t *t )
+{
+	char **keys = t->fixture;
+	char **copies = calloc( t->size, sizeof(char*) );
+	unsigned long r;
+	unsigned i;
+
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		fsd_iter_t *iter;
+		for( i = 0;  i < t->size;  i++ )
+			copies[i] = fsd_strdup( keys[i] );
+		timer_start( t );
+		iter = fsd_iter_new( NULL, 0 );
+		for( i = 0;  i < t->size;  i++ )
+			iter->append( iter, copies[i] );
+		timer_stop( t );
+		iter->destroy( iter );
+		t->ops += t->size;
+	 }
+	free( copies );
+}
+
+static void
+iter_next( bench_thread_t *t )
+{
+	fsd_iter_t *iter = fsd_iter_new_const( (const char *const*)t->fixture, t->size );
+	unsigned long r;
+	unsigned i;
+
+	timer_start( t );
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		iter->reset( iter );
+		for( i = 0;  i < t->size;  i++ )
+			iter->next( iter );
+		t->ops += t->size;
+	 }
+	timer_stop( t );
+	iter->destroy( iter );
+}
+
+static void
+iter_range( bench_thread_t *t )
+{
+	fsd_iter_t *iter = fsd_iter_new_range();
+	unsigned long r;
+	unsigned i;
+
+	fsd_iter_append_range( iter, "1000_", 0, t->size - 1, 1 );
+	timer_start( t );
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		iter->reset( iter );
+		for( i = 0;  i < t->size;  i++ )
+			iter->next( iter );
+		t->ops += t->size;
+	 }
+	timer_stop( t );
+	iter->destroy( iter );
+}
+
+
+/* ---- placeholder expansion --------------------------------------- */
+
+static void *
+expand_setup( unsigned size )
+{
+	static const char *const placeholders[] = {
+		DRMAA_PLACEHOLDER_WD, DRMAA_PLACEHOLDER_HD, DRMAA_PLACEHOLDER_INCR };
+	size_t len = 0;
+	char *input;
+	unsigned i;
+
+	for( i = 0;  i < size;  i++ )
+		len += strlen( placeholders[i % 3] ) + 1;
+	input = malloc( len + 1 );
+	assert( input != NULL );
+	input[0] = '\0';
+	for( i = 0, len = 0;  i < size;  i++ )
+	 {
+		strcpy( input + len, placeholders[i % 3] );
+		len += strlen( placeholders[i % 3] );
+		input[len++] = '/';
+		input[len] = '\0';
+	 }
+	return input;
+}
+
+static void
+expand_teardown( void *fixture, unsigned size )
+{
+	free( fixture );
+}
+
+static void
+expand( bench_thread_t *t )
+{
+	fsd_expand_drmaa_ph_t *expander = fsd_expand_drmaa_ph_new(
+			fsd_strdup("/home/user"), fsd_strdup("/scratch/work"), fsd_strdup("17") );
+	unsigned long r;
+
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		char *input = fsd_strdup( (const char*)t->fixture );
+		char *output;
+		timer_start( t );
+		output = expander->expand( expander, input,
+				FSD_DRMAA_PH_HD | FSD_DRMAA_PH_WD | FSD_DRMAA_PH_INCR );
+		timer_stop( t );
+		fsd_free( output );
+		t->ops += t->size;
+	 }
+	expander->destroy( expander );
+}
+
+
+/* ---- TRY/EXCEPT -------------------------------------------------- */
+
+static int try_sink = 0;
+
+static void
+try_nested( unsigned depth, bool raise )
+{
+	TRY
+	 {
+		if( depth > 1 )
+			try_nested( depth - 1, raise );
+		else if( raise ) /* as by iterator - not logged as error */
+			fsd_exc_raise_code( FSD_ERRNO_STOP_ITERATION );
+		else
+			try_sink++;
+	 }
+	FINALLY
+	 { try_sink++; }
+	END_TRY
+}
+
+static void
+try_enter( bench_thread_t *t )
+{
+	unsigned long r;
+
+	timer_start( t );
+	for( r = rounds( t );  r > 0;  r-- )
+		try_nested( t->size, false );
+	timer_stop( t );
+	t->ops += rounds( t ) * t->size;
+}
+
+static void
+try_raise( bench_thread_t *t )
+{
+	unsigned long r;
+
+	timer_start( t );
+	for( r = rounds( t );  r > 0;  r-- )
+	 {
+		TRY
+		 { try_nested( t->size, true ); }
+		EXCEPT_DEFAULT
+		 { try_sink++; }
+		END_TRY
+	 }
+	timer_stop( t );
+	t->ops += rounds( t ) * (t->size + 1);
+}
+
+
+/* ---- harness ----------------------------------------------------- */
+
+static const bench_t benches[] = {
+	{ "job_set", "insert", 0, false, job_set_setup_keys, job_set_insert, job_set_teardown },
+	{ "job_set", "lookup", 0, true, job_set_setup, job_set_lookup, job_set_teardown },
+	{ "job_set", "lookup_miss", 0, true, job_set_setup, job_set_lookup_miss, job_set_teardown },
+	{ "job_set", "remove", 0, false, job_set_setup_keys, job_set_remove, job_set_teardown },
+	{ "job_set", "mixed", 0, true, job_set_setup, job_set_mixed, job_set_teardown },
+	{ "environ", "insert", 0, false, environ_setup_keys, environ_insert, environ_teardown },
+	{ "environ", "lookup", 0, true, environ_setup, environ_lookup, environ_teardown },
+	{ "conf_dict", "insert", 0, false, conf_setup_keys, conf_insert, conf_teardown },
+	{ "conf_dict", "lookup", 0, true, conf_setup, conf_lookup, conf_teardown },
+	{ "iter", "append", 0, false, iter_setup, iter_append, iter_teardown },
+	{ "iter", "next", 0, false, iter_setup, iter_next, iter_teardown },
+	{ "iter", "range", 0, false, NULL, iter_range, NULL },
+	{ "expand", "placeholders", 0, true, expand_setup, expand, expand_teardown },
+	/* depth limited by stack (TRY blocks live there) */
+	{ "try", "enter", 10000, true, NULL, try_enter, NULL },
+	{ "try", "raise", 10000, true, NULL, try_raise, NULL },
+	{ NULL, NULL, 0, false, NULL, NULL, NULL }
+};
+
+
+typedef struct {
+	const bench_t *bench;
+	bench_thread_t *t;
+} bench_start_t;
+
+static void *
+bench_worker( void *arg )
+{
+	bench_start_t *start = arg;
+	pthread_barrier_wait( &barrier );
+	start->bench->run( start->t );
+	return NULL;
+}
+
+
+/* Runs case; returns elapsed time (of slowest thread). */
+static double
+run_case( FILE *output, const bench_t *bench, unsigned size,
+		unsigned threads, unsigned long min_ops )
+{
+	bench_thread_t *t = calloc( threads, sizeof(bench_thread_t) );
+	bench_start_t *starts = calloc( threads, sizeof(bench_start_t) );
+	void *fixture = bench->setup ? bench->setup( size ) : NULL;
+	unsigned long ops = 0;
+	double seconds = 0;
+	unsigned i;
+
+	pthread_barrier_init( &barrier, NULL, threads );
+	for( i = 0;  i < threads;  i++ )
+	 {
+		t[i].index = i;
+		t[i].threads = threads;
+		t[i].size = size;
+		t[i].min_ops = min_ops;
+		t[i].fixture = fixture;
+		t[i].seed = i + 1;
+		starts[i].bench = bench;
+		starts[i].t = &t[i];
+		if( pthread_create( &t[i].thread, NULL, bench_worker, &starts[i] ) != 0 )
+		 {
+			perror( "pthread_create" );
+			exit( 1 );
+		 }
+	 }
+	for( i = 0;  i < threads;  i++ )
+	 {
+		pthread_join( t[i].thread, NULL );
+		ops += t[i].ops;
+		if( t[i].seconds > seconds )
+			seconds = t[i].seconds;
+	 }
+	pthread_barrier_destroy( &barrier );
+	if( bench->teardown )
+		bench->teardown( fixture, size );
+
+	if( ops > 0 )
+		fprintf( output, "{\"bench\": \"%s\", \"mix\": \"%s\", \"size\": %u, "
+				"\"threads\": %u, \"ops\": %lu, \"seconds\": %.6f, "
+				"\"ops_per_s\": %.0f, \"ns_per_op\": %.2f}\n",
+				bench->name, bench->mix, size, threads, ops, seconds,
+				seconds > 0 ? ops / seconds : 0.0,
+				seconds * 1e9 * threads / ops );
+	fflush( output );
+	free( t );
+	free( starts );
+	return seconds;
+}
+
+
+static bool
+selected( const char *list, const bench_t *bench )
+{
+	char name[64];
+	const char *p;
+
+	if( list == NULL )
+		return true;
+	for( p = list;  *p;  )
+	 {
+		size_t len = strcspn( p, "," );
+		snprintf( name, sizeof(name), "%s.%s", bench->name, bench->mix );
+		if( (len == strlen(bench->name)  &&  !strncmp( p, bench->name, len ))
+				||  (len == strlen(name)  &&  !strncmp( p, name, len )) )
+			return true;
+		p += len;
+		if( *p == ',' )
+			p++;
+	 }
+	return false;
+}
+
+
+static void
+usage( const char *program )
+{
+	fprintf( stderr, "Usage: %s [-m MAX_SIZE] [-T THREADS,...] [-n MIN_OPS]\n"
+			"       [-b BUDGET_SECONDS] [-s BENCH[.MIX],...] [-o FILE]\n", program );
+	exit( 1 );
+}
+
+
+int
+main( int argc, char *argv[] )
+{
+	unsigned max_size = 1000000;
+	const char *threads_list = "1,4";
+	unsigned long min_ops = 100000;
+	double budget = 1.0;
+	const char *bench_list = NULL;
+	FILE *output = stdout;
+	const bench_t *bench;
+	int opt;
+
+	while( (opt = getopt( argc, argv, "m:T:n:b:s:o:" )) != -1 )
+		switch( opt )
+		 {
+			case 'm':  max_size = (unsigned)atoi( optarg );  break;
+			case 'T':  threads_list = optarg;  break;
+			case 'n':  min_ops = strtoul( optarg, NULL, 10 );  break;
+			case 'b':  budget = atof( optarg );  break;
+			case 's':  bench_list = optarg;  break;
+			case 'o':
+				if( (output = fopen( optarg, "a" )) == NULL )
+				 {
+					perror( optarg );
+					exit( 1 );
+				 }
+				break;
+			default:
+				usage( argv[0] );
+		 }
+	if( optind != argc  ||  max_size == 0  ||  min_ops == 0 )
+		usage( argv[0] );
+
+	fsd_set_verbosity_level( FSD_LOG_ERROR );
+
+	for( bench = benches;  bench->name != NULL;  bench++ )
+	 {
+		const char *p;
+		if( !selected( bench_list, bench ) )
+			continue;
+		for( p = threads_list;  *p;  )
+		 {
+			unsigned threads = (unsigned)strtoul( p, (char**)&p, 10 );
+			unsigned limit = bench->max_size && bench->max_size < max_size
+				? bench->max_size : max_size;
+			unsigned size;
+
+			if( *p == ',' )
+				p++;
+			else if( *p != '\0' )
+				usage( argv[0] );
+			if( threads == 0  ||  (threads > 1  &&  !bench->threaded) )
+				continue;
+			for( size = 1;  size <= limit;  size *= 10 )
+			 {
+				if( run_case( output, bench, size, threads, min_ops ) > budget )
+					break;
+				if( size > limit / 10 )
+					break;
+			 }
+		 }
+	 }
+
+	if( output != stdout )
+		fclose( output );
+	return 0;
+}
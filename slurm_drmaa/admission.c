@@ -0,0 +1,220 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/util.h>
+
+#include <slurm_drmaa/admission.h>
+
+#include <slurm/slurm.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+static void
+slurmdrmaa_sleep_ms( double ms )
+{
+	struct timespec ts;
+	if( ms <= 0 )
+		return;
+	ts.tv_sec = (time_t)(ms / 1000);
+	ts.tv_nsec = (long)((ms - ts.tv_sec * 1000.0) * 1000000);
+	while( nanosleep( &ts, &ts ) == -1  &&  errno == EINTR )
+		;
+}
+
+void
+slurmdrmaa_admission_init( slurmdrmaa_admission_t *self )
+{
+	self->rate = 0;
+	self->burst = 10;
+	self->tokens = self->burst;
+	fsd_get_time( &self->last_refill );
+	self->max_retries = 3;
+	self->backoff_initial = 100;
+	self->backoff_max = 10000;
+	self->breaker_threshold = 0;
+	self->breaker_cooldown = 30000;
+	self->consecutive_failures = 0;
+	self->open_until.tv_sec = 0;
+	self->open_until.tv_nsec = 0;
+	self->seed = (unsigned)time(NULL) ^ (unsigned)getpid();
+	fsd_mutex_init( &self->mutex );
+	fsd_mutex_set_name( &self->mutex, "admission" );
+}
+
+void
+slurmdrmaa_admission_destroy( slurmdrmaa_admission_t *self )
+{
+	fsd_mutex_destroy( &self->mutex );
+}
+
+void
+slurmdrmaa_admission_acquire( slurmdrmaa_admission_t *self )
+{
+	struct timespec now;
+	double wait_ms = 0;
+
+	fsd_get_time( &now );
+	fsd_mutex_lock( &self->mutex );
+
+	if( self->breaker_threshold > 0  &&  fsd_ts_cmp( &now, &self->open_until ) < 0 )
+	 {
+		fsd_mutex_unlock( &self->mutex );
+		fsd_exc_raise_msg( FSD_ERRNO_TRY_LATER,
+				"slurmctld does not respond, circuit breaker is open" );
+	 }
+
+	if( self->rate > 0 )
+	 {
+		double elapsed = (now.tv_sec - self->last_refill.tv_sec)
+				+ (now.tv_nsec - self->last_refill.tv_nsec) / 1e9;
+		if( elapsed > 0 )
+		 {
+			self->tokens += elapsed * self->rate;
+			if( self->tokens > self->burst )
+				self->tokens = self->burst;
+			self->last_refill = now;
+		 }
+		/* take token in advance and sleep off the deficit,
+		   so waiting threads are served in order */
+		self->tokens -= 1;
+		if( self->tokens < 0 )
+			wait_ms = -self->tokens * 1000.0 / self->rate;
+	 }
+
+	fsd_mutex_unlock( &self->mutex );
+
+	if( wait_ms > 0 )
+	 {
+		fsd_log_debug(( "rate limit: waiting %.1f ms", wait_ms ));
+		slurmdrmaa_sleep_ms( wait_ms );
+	 }
+}
+
+bool
+slurmdrmaa_admission_retry( slurmdrmaa_admission_t *self, int rc, int *attempt,
+		slurmdrmaa_retryable_t *retryable )
+{
+	int _slurm_errno;
+	double backoff_ms = 0;
+	bool retry = false;
+
+	if( rc == SLURM_SUCCESS )
+	 {
+		fsd_mutex_lock( &self->mutex );
+		self->consecutive_failures = 0;
+		fsd_mutex_unlock( &self->mutex );
+		return false;
+	 }
+
+	_slurm_errno = slurm_get_errno();
+	if( !slurmdrmaa_is_transient_error( _slurm_errno ) )
+		return false;
+
+	fsd_mutex_lock( &self->mutex );
+	self->consecutive_failures++;
+	if( self->breaker_threshold > 0
+			&&  self->consecutive_failures >= self->breaker_threshold )
+	 {
+		struct timespec cooldown;
+		fsd_get_time( &self->open_until );
+		cooldown.tv_sec = self->breaker_cooldown / 1000;
+		cooldown.tv_nsec = (self->breaker_cooldown % 1000) * 1000000;
+		fsd_ts_add( &self->open_until, &cooldown );
+		fsd_log_warning(( "%d consecutive failures of slurmctld RPCs, "
+					"suspending communication for %d ms",
+					self->consecutive_failures, self->breaker_cooldown ));
+	 }
+	else if( *attempt < self->max_retries  &&  retryable( _slurm_errno ) )
+	 {
+		double max = self->backoff_initial;
+		int i;
+		for( i = 0;  i < *attempt  &&  max < self->backoff_max;  i++ )
+			max *= 2;
+		if( max > self->backoff_max )
+			max = self->backoff_max;
+		/* equal jitter: [max/2, max) */
+		backoff_ms = max / 2 + (max / 2) * (rand_r( &self->seed ) / (RAND_MAX + 1.0));
+		retry = true;
+	 }
+	fsd_mutex_unlock( &self->mutex );
+
+	if( retry )
+	 {
+		++*attempt;
+		fsd_log_warning(( "transient slurm error: %s, retry %d in %.0f ms",
+					slurm_strerror(_slurm_errno), *attempt, backoff_ms ));
+		slurmdrmaa_sleep_ms( backoff_ms );
+	 }
+
+	errno = _slurm_errno;
+	return retry;
+}
+
+bool
+slurmdrmaa_is_transient_error( int slurm_errno )
+{
+	switch( slurm_errno )
+	 {
+		case EAGAIN:
+		case ETIMEDOUT:
+		case ECONNREFUSED:
+		case ESLURM_ERROR_ON_DESC_TO_RECORD_COPY:
+		case SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT:
+		case SLURM_COMMUNICATIONS_CONNECTION_ERROR:
+		case SLURM_COMMUNICATIONS_SEND_ERROR:
+		case SLURM_COMMUNICATIONS_RECEIVE_ERROR:
+		case SLURM_COMMUNICATIONS_SHUTDOWN_ERROR:
+		case SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR:
+		case SLURMCTLD_COMMUNICATIONS_SEND_ERROR:
+		case SLURMCTLD_COMMUNICATIONS_RECEIVE_ERROR:
+		case SLURMCTLD_COMMUNICATIONS_SHUTDOWN_ERROR:
+			return true;
+		default:
+			return false;
+	 }
+}
+
+bool
+slurmdrmaa_is_undelivered_error( int slurm_errno )
+{
+	switch( slurm_errno )
+	 {
+		case EAGAIN:
+		case ECONNREFUSED:
+		case ESLURM_ERROR_ON_DESC_TO_RECORD_COPY:
+		case SLURM_COMMUNICATIONS_CONNECTION_ERROR:
+		case SLURM_COMMUNICATIONS_SEND_ERROR:
+		case SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR:
+		case SLURMCTLD_COMMUNICATIONS_SEND_ERROR:
+			return true;
+		default:
+			return false;
+	 }
+}
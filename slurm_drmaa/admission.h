@@ -0,0 +1,137 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SLURM_DRMAA__ADMISSION_H
+#define __SLURM_DRMAA__ADMISSION_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <errno.h>
+#include <time.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/metrics.h>
+#include <drmaa_utils/thread.h>
+
+typedef struct slurmdrmaa_admission_s slurmdrmaa_admission_t;
+
+/*
+ * Admission control of RPCs sent to slurmctld, shared by all threads
+ * of session: token bucket rate limit, retries of transient errors
+ * with jittered exponential backoff and circuit breaker.
+ *
+ * Usage (or SLURMDRMAA_RPC below):
+ *   int attempt = 0, rc;
+ *   do {
+ *       slurmdrmaa_admission_acquire( adm );
+ *       lock DRM connection;
+ *       rc = slurm_...( ... );
+ *       unlock DRM connection (preserving errno);
+ *   } while( slurmdrmaa_admission_retry( adm, rc, &attempt, retryable ) );
+ *
+ * Retry set depends on RPC: queries may be repeated after any transient
+ * error (slurmdrmaa_is_transient_error), but submission is not idempotent
+ * - after timeout or lost reply controller may have already accepted job,
+ * so it is repeated only when request surely was not delivered
+ * (slurmdrmaa_is_undelivered_error).
+ *
+ * Both acquire and retry may sleep, so they must not be called with
+ * DRM connection lock held - otherwise one throttled thread would
+ * stall RPCs of all others.
+ */
+struct slurmdrmaa_admission_s {
+	/* RPCs per second (0 - unlimited) and bucket capacity */
+	int rate;
+	int burst;
+	double tokens;
+	struct timespec last_refill;
+
+	/* retries of transient errors (0 - none) */
+	int max_retries;
+	/* backoff before first retry and its upper bound (ms) */
+	int backoff_initial;
+	int backoff_max;
+
+	/* consecutive transient failures opening breaker (0 - disabled) */
+	int breaker_threshold;
+	/* how long breaker stays open (ms) */
+	int breaker_cooldown;
+	int consecutive_failures;
+	struct timespec open_until;
+
+	unsigned seed;
+	fsd_mutex_t mutex;
+};
+
+void slurmdrmaa_admission_init( slurmdrmaa_admission_t *self );
+
+void slurmdrmaa_admission_destroy( slurmdrmaa_admission_t *self );
+
+/*
+ * Wait for token of rate limiter.  Raises FSD_ERRNO_TRY_LATER
+ * when circuit breaker is open.
+ */
+void slurmdrmaa_admission_acquire( slurmdrmaa_admission_t *self );
+
+/* Whether RPC failed with given slurm errno may be repeated. */
+typedef bool slurmdrmaa_retryable_t( int slurm_errno );
+
+/*
+ * Account outcome (rc) of RPC.  Returns true (after backoff sleep)
+ * when RPC failed with error accepted by @a retryable and should be
+ * repeated.  Every transient error counts for circuit breaker.
+ * Otherwise slurm errno is preserved for the caller.
+ */
+bool slurmdrmaa_admission_retry( slurmdrmaa_admission_t *self, int rc, int *attempt,
+		slurmdrmaa_retryable_t *retryable );
+
+/*
+ * Execute @a call (statement assigning result of libslurm function
+ * to @a rc) with DRM connection @a mutex held only for the call
+ * itself, repeating it after errors accepted by @a retryable.
+ * Rate limit and retry backoff are waited out with mutex
+ * released.  Slurm errno of last attempt is preserved for the caller.
+ */
+#define SLURMDRMAA_RPC( admission, mutex, retryable, rc, call ) \
+	do { \
+		int _slurmdrmaa_attempt = 0; \
+		int _slurmdrmaa_errno; \
+		do { \
+			slurmdrmaa_admission_acquire( (admission) ); \
+			fsd_metric_lock( (mutex), FSD_METRIC_DRM_LOCK_WAIT ); \
+			call; \
+			_slurmdrmaa_errno = errno; \
+			fsd_mutex_unlock( (mutex) ); \
+			errno = _slurmdrmaa_errno; \
+		} while( slurmdrmaa_admission_retry( (admission), (rc), &_slurmdrmaa_attempt, (retryable) ) ); \
+	} while( 0 )
+
+/* Whether slurm errno denotes temporary controller overload or outage. */
+bool slurmdrmaa_is_transient_error( int slurm_errno );
+
+/*
+ * Whether slurm errno denotes transient error after which request
+ * surely did not reach (or was rejected by) controller - retry set
+ * of non-idempotent RPCs.
+ */
+bool slurmdrmaa_is_undelivered_error( int slurm_errno );
+
+#endif /* __SLURM_DRMAA__ADMISSION_H */
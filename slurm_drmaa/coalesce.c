@@ -0,0 +1,541 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Coalescing of single job submissions into job arrays.
+ *
+ * Every drmaa_run_job() call with coalescing enabled joins a batch of
+ * jobs whose templates differ only in command, arguments, job name,
+ * working directory and input/output/error paths.  The first job of
+ * a batch (leader) waits up to coalesce_window for others and then
+ * submits all of them as one job array.  Array script dispatches on
+ * $SLURM_ARRAY_TASK_ID to the command (with its own working directory
+ * and redirections) of every packed job.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/drmaa.h>
+#include <drmaa_utils/environ.h>
+#include <drmaa_utils/template.h>
+#include <drmaa_utils/util.h>
+
+#include <slurm_drmaa/coalesce.h>
+#include <slurm_drmaa/job.h>
+#include <slurm_drmaa/session.h>
+#include <slurm_drmaa/util.h>
+
+#include <slurm/slurm.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+struct slurmdrmaa_coalesce_batch_s {
+	char *key; /* serialized template attributes common to all jobs */
+	job_desc_msg_t **tasks; /* requests of packed jobs (owned by callers) */
+	char **job_ids; /* results (taken by callers) */
+	unsigned n_tasks;
+	unsigned max_tasks;
+	unsigned ref_cnt;
+	bool closed; /* no more jobs may join */
+	bool done; /* submitted (or failed) */
+	int error_code;
+	char *error_message;
+	fsd_cond_t cond;
+	slurmdrmaa_coalesce_batch_t *next;
+};
+
+/* attributes which may differ between jobs packed into one array */
+static const char *slurmdrmaa_coalesce_task_attrs[] = {
+	DRMAA_REMOTE_COMMAND,
+	DRMAA_V_ARGV,
+	DRMAA_JOB_NAME,
+	DRMAA_WD,
+	DRMAA_INPUT_PATH,
+	DRMAA_OUTPUT_PATH,
+	DRMAA_ERROR_PATH,
+	NULL
+};
+
+typedef struct {
+	char *data;
+	size_t len;
+	size_t size;
+} slurmdrmaa_buf_t;
+
+static void
+slurmdrmaa_buf_append( slurmdrmaa_buf_t *buf, const char *s, size_t len )
+{
+	if( buf->len + len + 1 > buf->size )
+	 {
+		size_t size = buf->size ? buf->size : 256;
+		while( buf->len + len + 1 > size )
+			size *= 2;
+		fsd_realloc( buf->data, size, char );
+		buf->size = size;
+	 }
+	memcpy( buf->data + buf->len, s, len );
+	buf->len += len;
+	buf->data[buf->len] = '\0';
+}
+
+static void
+slurmdrmaa_buf_append_str( slurmdrmaa_buf_t *buf, const char *s )
+{
+	slurmdrmaa_buf_append( buf, s, strlen(s) );
+}
+
+/* appends shell single quoted string */
+static void
+slurmdrmaa_buf_append_quoted( slurmdrmaa_buf_t *buf, const char *s )
+{
+	const char *q;
+
+	slurmdrmaa_buf_append_str( buf, "'" );
+	while( (q = strchr( s, '\'' )) != NULL )
+	 {
+		slurmdrmaa_buf_append( buf, s, q - s );
+		slurmdrmaa_buf_append_str( buf, "'\\''" );
+		s = q + 1;
+	 }
+	slurmdrmaa_buf_append_str( buf, s );
+	slurmdrmaa_buf_append_str( buf, "'" );
+}
+
+
+static char *
+slurmdrmaa_coalesce_key( const fsd_template_t *jt )
+{
+	slurmdrmaa_buf_t buf = { NULL, 0, 0 };
+	unsigned i;
+
+	TRY
+	 {
+		slurmdrmaa_buf_append_str( &buf, "" );
+		for( i = 0;  i < jt->n_attributes;  i++ )
+		 {
+			const fsd_attribute_t *attr = jt->by_code( jt, i );
+			const char **t;
+			bool per_task = false;
+
+			if( attr == NULL  ||  jt->attributes[i] == NULL )
+				continue;
+			for( t = slurmdrmaa_coalesce_task_attrs;  *t;  t++ )
+				if( !strcmp( *t, attr->name ) )
+					per_task = true;
+			if( per_task )
+				continue;
+
+			slurmdrmaa_buf_append_str( &buf, attr->name );
+			slurmdrmaa_buf_append_str( &buf, "=" );
+			if( attr->is_vector )
+			 {
+				const char *const *v;
+				for( v = (const char *const*)jt->attributes[i];  *v;  v++ )
+				 {
+					slurmdrmaa_buf_append_str( &buf, *v );
+					slurmdrmaa_buf_append_str( &buf, "\x1f" );
+				 }
+			 }
+			else
+				slurmdrmaa_buf_append_str( &buf, (const char*)jt->attributes[i] );
+			slurmdrmaa_buf_append_str( &buf, "\n" );
+		 }
+	 }
+	EXCEPT_DEFAULT
+	 {
+		fsd_free( buf.data );
+		fsd_exc_reraise();
+	 }
+	END_TRY
+
+	return buf.data;
+}
+
+
+/*
+ * Per job paths are applied in generated script so they must not use
+ * SLURM filename patterns (%j, %a, ...) which are expanded only by slurmd.
+ */
+static bool
+slurmdrmaa_coalesce_eligible( const job_desc_msg_t *job_desc )
+{
+	if( job_desc->array_inx != NULL )
+		return false;
+	if( job_desc->std_in && strchr( job_desc->std_in, '%' ) )
+		return false;
+	if( job_desc->std_out && strchr( job_desc->std_out, '%' ) )
+		return false;
+	if( job_desc->std_err && strchr( job_desc->std_err, '%' ) )
+		return false;
+	if( job_desc->work_dir && strchr( job_desc->work_dir, '%' ) )
+		return false;
+	return true;
+}
+
+
+static uint32_t
+slurmdrmaa_coalesce_submit( fsd_drmaa_session_t *self, job_desc_msg_t *job_desc )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+	submit_response_msg_t *submit_response = NULL;
+	uint32_t job_id;
+	int rc;
+
+	SLURMDRMAA_RPC( &slurm_self->admission, &self->drm_connection_mutex, slurmdrmaa_is_undelivered_error, rc,
+			FSD_METRIC_TIME( slurmdrmaa_metrics.submit_batch_job, rc = slurm_submit_batch_job( job_desc, &submit_response ) ) );
+	if( rc ){
+		fsd_exc_raise_fmt(
+			FSD_ERRNO_INTERNAL_ERROR,"slurm_submit_batch_job: %s",slurm_strerror(slurm_get_errno()));
+	}
+	job_id = submit_response->job_id;
+	slurm_free_submit_response_response_msg ( submit_response );
+
+	fsd_log_debug(("job %u submitted", job_id));
+	return job_id;
+}
+
+
+/* batch size: indices 0..n-1 of array must fit in limits of slurmctld */
+static unsigned
+slurmdrmaa_coalesce_max_tasks( slurmdrmaa_session_t *self )
+{
+	unsigned max_tasks = self->coalesce_max_tasks;
+
+	if( self->max_array_size != 0  &&  self->max_array_size < max_tasks )
+		max_tasks = self->max_array_size;
+	if( self->max_array_tasks != 0  &&  self->max_array_tasks < max_tasks )
+		max_tasks = self->max_array_tasks;
+	return max_tasks > 0 ? max_tasks : 1;
+}
+
+
+static char *
+slurmdrmaa_coalesce_register( fsd_drmaa_session_t *self, char *job_id )
+{
+	fsd_job_t *job = NULL;
+
+	job = slurmdrmaa_job_new( fsd_strdup(job_id) );
+	job->session = self;
+	job->submit_time = time(NULL);
+	self->jobs->add( self->jobs, job );
+	job->release( job );
+	fsd_metric_add( FSD_METRIC_JOBS_SUBMITTED, 1 );
+	return job_id;
+}
+
+
+/* builds script of job array dispatching to packed jobs */
+static char *
+slurmdrmaa_coalesce_script( slurmdrmaa_coalesce_batch_t *batch )
+{
+	slurmdrmaa_buf_t buf = { NULL, 0, 0 };
+	unsigned i;
+
+	TRY
+	 {
+		slurmdrmaa_buf_append_str( &buf, "#!/bin/bash\ncase \"$SLURM_ARRAY_TASK_ID\" in\n" );
+		for( i = 0;  i < batch->n_tasks;  i++ )
+		 {
+			const job_desc_msg_t *task = batch->tasks[i];
+			const char *body = strchr( task->script, '\n' );
+			char index[16];
+
+			body = body ? body + 1 : task->script;
+			fsd_snprintf( NULL, index, sizeof(index), "%u)\n", i );
+			slurmdrmaa_buf_append_str( &buf, index );
+			if( task->work_dir )
+			 {
+				slurmdrmaa_buf_append_str( &buf, "cd " );
+				slurmdrmaa_buf_append_quoted( &buf, task->work_dir );
+				slurmdrmaa_buf_append_str( &buf, " || exit 1\n" );
+			 }
+			/* array itself runs with /dev/null streams */
+			slurmdrmaa_buf_append_str( &buf, "exec" );
+			if( task->std_in )
+			 {
+				slurmdrmaa_buf_append_str( &buf, " <" );
+				slurmdrmaa_buf_append_quoted( &buf, task->std_in );
+			 }
+			if( task->std_out )
+			 {
+				slurmdrmaa_buf_append_str( &buf, " >" );
+				slurmdrmaa_buf_append_quoted( &buf, task->std_out );
+			 }
+			else /* default output file of SLURM for this task */
+				slurmdrmaa_buf_append_str( &buf, " >\"slurm-${SLURM_ARRAY_JOB_ID}_${SLURM_ARRAY_TASK_ID}.out\"" );
+			if( task->std_err == NULL
+					||  (task->std_out  &&  !strcmp( task->std_err, task->std_out )) )
+				slurmdrmaa_buf_append_str( &buf, " 2>&1" );
+			else
+			 {
+				slurmdrmaa_buf_append_str( &buf, " 2>" );
+				slurmdrmaa_buf_append_quoted( &buf, task->std_err );
+			 }
+			slurmdrmaa_buf_append_str( &buf, "\n" );
+			slurmdrmaa_buf_append_str( &buf, body );
+			slurmdrmaa_buf_append_str( &buf, ";;\n" );
+		 }
+		slurmdrmaa_buf_append_str( &buf, "esac\n" );
+	 }
+	EXCEPT_DEFAULT
+	 {
+		fsd_free( buf.data );
+		fsd_exc_reraise();
+	 }
+	END_TRY
+
+	return buf.data;
+}
+
+
+/* submits whole batch; never raises - errors are stored in batch */
+static void
+slurmdrmaa_coalesce_submit_batch( fsd_drmaa_session_t *self, slurmdrmaa_coalesce_batch_t *batch )
+{
+	fsd_log_enter(( "(n_tasks=%u)", batch->n_tasks ));
+	TRY
+	 {
+		if( batch->n_tasks == 1 )
+		 {
+			uint32_t job_id = slurmdrmaa_coalesce_submit( self, batch->tasks[0] );
+			batch->job_ids[0] = slurmdrmaa_coalesce_register( self, fsd_asprintf( "%u", job_id ) );
+		 }
+		else
+		 {
+			job_desc_msg_t *base = batch->tasks[0];
+			char *script = slurmdrmaa_coalesce_script( batch );
+			uint32_t array_job_id;
+			unsigned i;
+
+			/* leader's request becomes array request */
+			fsd_free( base->script );
+			base->script = script;
+			base->array_inx = fsd_asprintf( "0-%u", batch->n_tasks - 1 );
+			/* streams of tasks are redirected by script */
+			fsd_free( base->std_in );
+			fsd_free( base->std_out );
+			fsd_free( base->std_err );
+			base->std_in = base->std_out = base->std_err = NULL;
+			base->std_in = fsd_strdup( "/dev/null" );
+			base->std_out = fsd_strdup( "/dev/null" );
+			base->std_err = fsd_strdup( "/dev/null" );
+
+			array_job_id = slurmdrmaa_coalesce_submit( self, base );
+			fsd_log_info(( "%u jobs submitted as job array %u", batch->n_tasks, array_job_id ));
+			for( i = 0;  i < batch->n_tasks;  i++ )
+				batch->job_ids[i] = slurmdrmaa_coalesce_register( self,
+						fsd_asprintf( "%u_%u", array_job_id, i ) );
+		 }
+	 }
+	EXCEPT_DEFAULT
+	 {
+		const fsd_exc_t *e = fsd_exc_get();
+		batch->error_code = e->code(e);
+		batch->error_message = fsd_strdup( FSD_SAFE_STR(e->message(e)) );
+	 }
+	END_TRY
+	fsd_log_return(( "" ));
+}
+
+
+static void
+slurmdrmaa_coalesce_batch_free( slurmdrmaa_coalesce_batch_t *batch )
+{
+	unsigned i;
+
+	for( i = 0;  i < batch->n_tasks;  i++ )
+		fsd_free( batch->job_ids[i] );
+	fsd_free( batch->job_ids );
+	fsd_free( batch->tasks );
+	fsd_free( batch->key );
+	fsd_free( batch->error_message );
+	fsd_cond_destroy( &batch->cond );
+	fsd_free( batch );
+}
+
+
+static slurmdrmaa_coalesce_batch_t *
+slurmdrmaa_coalesce_batch_new( char *key, unsigned max_tasks )
+{
+	slurmdrmaa_coalesce_batch_t *volatile batch = NULL;
+
+	TRY
+	 {
+		fsd_malloc( batch, slurmdrmaa_coalesce_batch_t );
+		memset( batch, 0, sizeof(slurmdrmaa_coalesce_batch_t) );
+		fsd_cond_init( &batch->cond );
+		batch->max_tasks = max_tasks;
+		fsd_calloc( batch->tasks, max_tasks, job_desc_msg_t* );
+		fsd_calloc( batch->job_ids, max_tasks, char* );
+		batch->key = key;
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( batch )
+		 {
+			fsd_free( batch->tasks );
+			fsd_free( batch->job_ids );
+			fsd_free( batch );
+		 }
+		fsd_free( key );
+		fsd_exc_reraise();
+	 }
+	END_TRY
+
+	return batch;
+}
+
+
+static void
+slurmdrmaa_coalesce_unlink( slurmdrmaa_session_t *self, slurmdrmaa_coalesce_batch_t *batch )
+{
+	slurmdrmaa_coalesce_batch_t **b;
+
+	batch->closed = true;
+	for( b = &self->coalesce_batches;  *b;  b = &(*b)->next )
+		if( *b == batch )
+		 {
+			*b = batch->next;
+			break;
+		 }
+	batch->next = NULL;
+}
+
+
+char *
+slurmdrmaa_coalesce_run_job( fsd_drmaa_session_t *self, const fsd_template_t *jt )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+	fsd_environ_t *volatile env = NULL;
+	char *volatile key = NULL;
+	slurmdrmaa_coalesce_batch_t *volatile batch = NULL;
+	volatile bool locked = false;
+	volatile bool leader = false;
+	volatile unsigned index = 0;
+	char *volatile job_id = NULL;
+	job_desc_msg_t job_desc;
+
+	fsd_log_enter(( "" ));
+
+	slurm_init_job_desc_msg( &job_desc );
+
+	TRY
+	 {
+		slurmdrmaa_job_create_req( self, jt, (fsd_environ_t**)&env , &job_desc );
+
+		if( !slurmdrmaa_coalesce_eligible( &job_desc ) )
+		 {
+			fsd_log_debug(( "job not eligible for coalescing" ));
+			job_id = slurmdrmaa_coalesce_register( self,
+					fsd_asprintf( "%u", slurmdrmaa_coalesce_submit( self, &job_desc ) ) );
+		 }
+		else
+		 {
+			struct timespec deadline;
+
+			if( !slurm_self->array_limits_loaded )
+				slurmdrmaa_session_load_array_limits( slurm_self );
+			key = slurmdrmaa_coalesce_key( jt );
+
+			locked = fsd_mutex_lock( &slurm_self->coalesce_mutex );
+			for( batch = slurm_self->coalesce_batches;  batch;  batch = batch->next )
+				if( !strcmp( batch->key, key ) )
+					break;
+			if( batch == NULL )
+			 {
+				char *k = key;
+				key = NULL;
+				batch = slurmdrmaa_coalesce_batch_new( k, slurmdrmaa_coalesce_max_tasks( slurm_self ) );
+				batch->next = slurm_self->coalesce_batches;
+				slurm_self->coalesce_batches = batch;
+				leader = true;
+			 }
+			index = batch->n_tasks++;
+			batch->tasks[index] = &job_desc;
+			batch->ref_cnt++;
+			if( batch->n_tasks == batch->max_tasks )
+			 {
+				slurmdrmaa_coalesce_unlink( slurm_self, batch );
+				fsd_cond_broadcast( &batch->cond );
+			 }
+
+			if( leader )
+			 {
+				fsd_get_time( &deadline );
+				fsd_ts_add( &deadline, &slurm_self->coalesce_window );
+				while( !batch->closed
+						&&  fsd_cond_timedwait( &batch->cond, &slurm_self->coalesce_mutex, &deadline ) )
+				 { /* spurious wakeup or new job joined */ }
+				if( !batch->closed )
+					slurmdrmaa_coalesce_unlink( slurm_self, batch );
+
+				locked = fsd_mutex_unlock( &slurm_self->coalesce_mutex );
+				slurmdrmaa_coalesce_submit_batch( self, batch );
+				locked = fsd_mutex_lock( &slurm_self->coalesce_mutex );
+
+				batch->done = true;
+				fsd_cond_broadcast( &batch->cond );
+			 }
+			else
+			 {
+				while( !batch->done )
+					fsd_cond_wait( &batch->cond, &slurm_self->coalesce_mutex );
+			 }
+
+			job_id = batch->job_ids[index];
+			batch->job_ids[index] = NULL;
+			if( job_id == NULL )
+				fsd_exc_raise_msg( batch->error_code, batch->error_message );
+		 }
+	 }
+	FINALLY
+	 {
+		if( batch )
+		 {
+			if( !locked )
+				locked = fsd_mutex_lock( &slurm_self->coalesce_mutex );
+			if( leader  &&  !batch->done )
+			 { /* do not leave followers waiting forever */
+				if( !batch->closed )
+					slurmdrmaa_coalesce_unlink( slurm_self, batch );
+				batch->error_code = FSD_ERRNO_INTERNAL_ERROR;
+				batch->done = true;
+				fsd_cond_broadcast( &batch->cond );
+			 }
+			if( --batch->ref_cnt == 0 )
+				slurmdrmaa_coalesce_batch_free( batch );
+		 }
+		if( locked )
+			fsd_mutex_unlock( &slurm_self->coalesce_mutex );
+		fsd_free( key );
+		slurmdrmaa_free_job_desc( &job_desc );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%s", job_id ));
+	return job_id;
+}
@@ -0,0 +1,39 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SLURM_DRMAA__COALESCE_H
+#define __SLURM_DRMAA__COALESCE_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <drmaa_utils/session.h>
+
+typedef struct slurmdrmaa_coalesce_batch_s slurmdrmaa_coalesce_batch_t;
+
+/*
+ * Submit single job, possibly packed together with other single jobs
+ * with identical resource requests submitted concurrently
+ * (within coalesce_window) into one job array.
+ * Returns job id of form <array_job_id>_<task_id> when job was packed.
+ */
+char *slurmdrmaa_coalesce_run_job( fsd_drmaa_session_t *self, const fsd_template_t *jt );
+
+#endif /* __SLURM_DRMAA__COALESCE_H */
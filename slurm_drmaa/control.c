@@ -0,0 +1,443 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Session wide job control (drmaa_control(DRMAA_JOB_IDS_SESSION_ALL, ...)).
+ *
+ * Jobs of session are turned into list of SLURM job specifications:
+ * plain job ids, whole array jobs (arrays submitted by this session
+ * which still have tasks without job record) and <array_job_id>_[tasks]
+ * for remaining array tasks.  Each specification costs one RPC
+ * instead of one RPC per job.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/drmaa.h>
+#include <drmaa_utils/util.h>
+
+#include <slurm_drmaa/control.h>
+#include <slurm_drmaa/job.h>
+#include <slurm_drmaa/journal.h>
+#include <slurm_drmaa/session.h>
+#include <slurm_drmaa/util.h>
+
+#include <slurm/slurm.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+typedef struct slurmdrmaa_task_s {
+	uint32_t array_job_id;
+	uint32_t task_id;
+} slurmdrmaa_task_t;
+
+typedef struct slurmdrmaa_control_result_s {
+	unsigned n_failed;
+	int first_code;
+	char *first_message;
+	char **failed; /* job specifications (NULL terminated, n_failed) */
+} slurmdrmaa_control_result_t;
+
+static int
+slurmdrmaa_task_cmp( const void *a, const void *b )
+{
+	const slurmdrmaa_task_t *x = (const slurmdrmaa_task_t*)a;
+	const slurmdrmaa_task_t *y = (const slurmdrmaa_task_t*)b;
+	if( x->array_job_id != y->array_job_id )
+		return x->array_job_id < y->array_job_id ? -1 : 1;
+	if( x->task_id != y->task_id )
+		return x->task_id < y->task_id ? -1 : 1;
+	return 0;
+}
+
+static int
+slurmdrmaa_uint32_cmp( const void *a, const void *b )
+{
+	uint32_t x = *(const uint32_t*)a;
+	uint32_t y = *(const uint32_t*)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+static void
+slurmdrmaa_control_failed( slurmdrmaa_control_result_t *result,
+		const char *func, const char *job_id, int code )
+{
+	fsd_log_error(( "%s error: %s, job_id: %s", func, slurm_strerror(code), job_id ));
+	fsd_realloc( result->failed, result->n_failed + 2, char* );
+	result->failed[ result->n_failed ] = NULL;
+	result->failed[ result->n_failed + 1 ] = NULL;
+	result->failed[ result->n_failed ] = fsd_strdup( job_id );
+	if( result->n_failed++ == 0 )
+	 {
+		result->first_code = code;
+		result->first_message = fsd_asprintf( "%s error: %s, job_id: %s",
+				func, slurm_strerror(code), job_id );
+	 }
+}
+
+/*
+ * Whether SLURM job specification (<job_id>, <array_job_id> or
+ * <array_job_id>_<tasks>) covers job of given identifier.
+ */
+static bool
+slurmdrmaa_control_spec_covers( const char *spec, const char *job_id )
+{
+	uint32_t array_job_id, task_id;
+	char *end = NULL;
+
+	if( !slurmdrmaa_parse_array_job_id( job_id, &array_job_id, &task_id ) )
+		return !strcmp( spec, job_id );
+	if( strtoul( spec, &end, 10 ) != array_job_id  ||  end == spec )
+		return false;
+	if( *end == '\0' )
+		return true; /* whole array */
+	if( *end != '_' )
+		return false;
+	if( end[1] != '[' && (end[1] < '0' || end[1] > '9') )
+		return true; /* unknown form - assume it does */
+	return slurmdrmaa_array_task_str_contains( end + 1, task_id );
+}
+
+static bool
+slurmdrmaa_control_failed_for( const slurmdrmaa_control_result_t *result, const char *job_id )
+{
+	unsigned i;
+	for( i = 0;  i < result->n_failed;  i++ )
+		if( slurmdrmaa_control_spec_covers( result->failed[i], job_id ) )
+			return true;
+	return false;
+}
+
+static void
+slurmdrmaa_control_check_resp( slurmdrmaa_control_result_t *result,
+		const char *func, const char *job_id, job_array_resp_msg_t *resp )
+{
+	uint32_t i;
+	if( resp == NULL )
+		return;
+	for( i = 0;  i < resp->job_array_count;  i++ )
+		if( resp->error_code[i] != SLURM_SUCCESS )
+			slurmdrmaa_control_failed( result, func,
+					resp->job_array_id[i] ? resp->job_array_id[i] : job_id,
+					resp->error_code[i] );
+}
+
+/*
+ * Build SLURM job specifications of all jobs in session.
+ * Returns NULL terminated vector.
+ */
+static char **
+slurmdrmaa_control_job_specs( fsd_drmaa_session_t *self )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self->jobs;
+	char **volatile job_ids = NULL;
+	uint32_t *volatile arrays = NULL;
+	slurmdrmaa_task_t *volatile tasks = NULL;
+	char **volatile specs = NULL;
+
+	TRY
+	 {
+		unsigned n_ids = 0, n_arrays = 0, n_tasks = 0, n_specs = 0;
+		unsigned i, j;
+
+		arrays = set->get_array_job_ids( set );
+		while( arrays[n_arrays] )
+			n_arrays++;
+		qsort( arrays, n_arrays, sizeof(uint32_t), slurmdrmaa_uint32_cmp );
+
+		job_ids = set->super_get_all_job_ids( self->jobs );
+		while( job_ids[n_ids] )
+			n_ids++;
+
+		fsd_calloc( tasks, n_ids + 1, slurmdrmaa_task_t );
+		fsd_calloc( specs, n_ids + n_arrays + 1, char* );
+
+		for( i = 0;  i < n_arrays;  i++ )
+			specs[n_specs++] = fsd_asprintf( "%u", arrays[i] );
+
+		for( i = 0;  i < n_ids;  i++ )
+		 {
+			uint32_t array_job_id, task_id;
+			if( !slurmdrmaa_parse_array_job_id( job_ids[i], &array_job_id, &task_id ) )
+				specs[n_specs++] = fsd_strdup( job_ids[i] );
+			else if( bsearch( &array_job_id, arrays, n_arrays, sizeof(uint32_t),
+						slurmdrmaa_uint32_cmp ) == NULL )
+			 {
+				tasks[n_tasks].array_job_id = array_job_id;
+				tasks[n_tasks].task_id = task_id;
+				n_tasks++;
+			 }
+		 }
+
+		qsort( tasks, n_tasks, sizeof(slurmdrmaa_task_t), slurmdrmaa_task_cmp );
+		for( i = 0;  i < n_tasks;  i = j )
+		 {
+			char *spec = fsd_asprintf( "%u_[", tasks[i].array_job_id );
+			for( j = i;  j < n_tasks  &&  tasks[j].array_job_id == tasks[i].array_job_id; )
+			 {
+				unsigned k = j;
+				char *old = spec;
+				while( k+1 < n_tasks  &&  tasks[k+1].array_job_id == tasks[j].array_job_id
+						&&  tasks[k+1].task_id == tasks[k].task_id + 1 )
+					k++;
+				if( k == j )
+					spec = fsd_asprintf( "%s%s%u", old, j > i ? "," : "", tasks[j].task_id );
+				else
+					spec = fsd_asprintf( "%s%s%u-%u", old, j > i ? "," : "",
+							tasks[j].task_id, tasks[k].task_id );
+				fsd_free( old );
+				j = k+1;
+			 }
+			specs[n_specs] = fsd_asprintf( "%s]", spec );
+			fsd_free( spec );
+			n_specs++;
+		 }
+	 }
+	EXCEPT_DEFAULT
+	 {
+		fsd_free_vector( specs );
+		fsd_exc_reraise();
+	 }
+	FINALLY
+	 {
+		fsd_free_vector( job_ids );
+		fsd_free( arrays );
+		fsd_free( tasks );
+	 }
+	END_TRY
+
+	return specs;
+}
+
+/*
+ * Record user suspension of jobs and array tasks (also those without
+ * job record) which suspend/resume request did not fail for.
+ */
+static void
+slurmdrmaa_control_set_suspended( fsd_drmaa_session_t *self, bool suspended,
+		const slurmdrmaa_control_result_t *result )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self->jobs;
+	uint32_t *volatile arrays = NULL;
+	char **volatile job_ids = NULL;
+
+	TRY
+	 {
+		uint32_t *a;
+		char **i;
+
+		arrays = set->get_array_job_ids( set );
+		for( a = arrays;  *a;  a++ )
+		 {
+			unsigned j;
+			bool failed = false;
+
+			for( j = 0;  j < result->n_failed;  j++ )
+				if( strtoul( result->failed[j], NULL, 10 ) == *a )
+					failed = true;
+			if( failed ) /* (some) tasks failed - track them one by one */
+				set->materialize_array( set, *a );
+			else
+				set->set_array_suspended( set, *a, suspended );
+		 }
+
+		job_ids = set->super_get_all_job_ids( self->jobs );
+		for( i = job_ids;  *i;  i++ )
+		 {
+			fsd_job_t *job = NULL;
+			if( slurmdrmaa_control_failed_for( result, *i ) )
+				continue;
+			job = self->get_job( self, *i );
+			if( job )
+			 {
+				((slurmdrmaa_job_t*)job)->user_suspended = suspended;
+				slurmdrmaa_journal_job( self, job );
+				job->release( job );
+			 }
+		 }
+	 }
+	FINALLY
+	 {
+		fsd_free( arrays );
+		fsd_free_vector( job_ids );
+	 }
+	END_TRY
+}
+
+void
+slurmdrmaa_control_all( fsd_drmaa_session_t *self, int action )
+{
+	char **volatile specs = NULL;
+	job_array_resp_msg_t *volatile resp = NULL;
+	volatile bool connection_lock = false;
+	slurmdrmaa_control_result_t result;
+	unsigned n_specs = 0;
+
+	fsd_log_enter(( "(action=%d)", action ));
+
+	result.n_failed = 0;
+	result.first_code = SLURM_SUCCESS;
+	result.first_message = NULL;
+	result.failed = NULL;
+
+	TRY
+	 {
+		char **i;
+
+		specs = slurmdrmaa_control_job_specs( self );
+		for( i = specs;  *i;  i++ )
+			n_specs++;
+		fsd_log_info(( "controlling all jobs of session with %u requests", n_specs ));
+
+		connection_lock = fsd_metric_lock( &self->drm_connection_mutex, FSD_METRIC_DRM_LOCK_WAIT );
+		switch( action )
+		 {
+			case DRMAA_CONTROL_TERMINATE:
+			 {
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(23,2,0)
+				kill_jobs_msg_t kill_msg;
+				kill_jobs_resp_msg_t *kill_resp = NULL;
+				uint32_t j;
+
+				if( n_specs == 0 )
+					break;
+				memset( &kill_msg, 0, sizeof(kill_msg) );
+				kill_msg.jobs_array = specs;
+				kill_msg.jobs_cnt = n_specs;
+				kill_msg.signal = SIGKILL;
+				kill_msg.state = JOB_END;
+				kill_msg.user_id = getuid();
+				if( slurm_kill_jobs( &kill_msg, &kill_resp ) )
+					slurmdrmaa_control_failed( &result, "slurm_kill_jobs",
+							DRMAA_JOB_IDS_SESSION_ALL, slurm_get_errno() );
+				for( j = 0;  kill_resp != NULL && j < kill_resp->jobs_cnt;  j++ )
+				 {
+					kill_jobs_resp_job_t *job_resp = &kill_resp->job_responses[j];
+					char job_id[32];
+					if( job_resp->error_code == SLURM_SUCCESS
+							||  job_resp->error_code == ESLURM_ALREADY_DONE )
+						continue;
+					if( job_resp->array_task_id != NO_VAL )
+						fsd_snprintf( NULL, job_id, sizeof(job_id), "%u_%u",
+								job_resp->array_job_id, job_resp->array_task_id );
+					else
+						fsd_snprintf( NULL, job_id, sizeof(job_id), "%u",
+								job_resp->step_id.job_id );
+					slurmdrmaa_control_failed( &result, "slurm_kill_jobs",
+							job_id, job_resp->error_code );
+				 }
+				if( kill_resp )
+					slurm_free_kill_jobs_response_msg( kill_resp );
+#else
+				for( i = specs;  *i;  i++ )
+#	if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(17,11,0)
+					if( slurm_kill_job2( *i, SIGKILL, 0, NULL ) == -1
+#	else
+					if( slurm_kill_job2( *i, SIGKILL, 0 ) == -1
+#	endif
+							&&  slurm_get_errno() != ESLURM_ALREADY_DONE )
+						slurmdrmaa_control_failed( &result, "slurm_kill_job2", *i, slurm_get_errno() );
+#endif
+				break;
+			 }
+			case DRMAA_CONTROL_SUSPEND:
+			case DRMAA_CONTROL_RESUME:
+				for( i = specs;  *i;  i++ )
+				 {
+					const char *func = action == DRMAA_CONTROL_SUSPEND ? "slurm_suspend2" : "slurm_resume2";
+					int rc;
+					if( action == DRMAA_CONTROL_SUSPEND )
+						rc = slurm_suspend2( *i, (job_array_resp_msg_t**)&resp );
+					else
+						rc = slurm_resume2( *i, (job_array_resp_msg_t**)&resp );
+					if( rc == -1 )
+						slurmdrmaa_control_failed( &result, func, *i, slurm_get_errno() );
+					slurmdrmaa_control_check_resp( &result, func, *i, resp );
+					if( resp )
+						slurm_free_job_array_resp( resp );
+					resp = NULL;
+				 }
+				break;
+			case DRMAA_CONTROL_HOLD:
+			case DRMAA_CONTROL_RELEASE:
+				for( i = specs;  *i;  i++ )
+				 {
+					job_desc_msg_t job_desc;
+					slurm_init_job_desc_msg( &job_desc );
+					job_desc.job_id_str = *i;
+					if( action == DRMAA_CONTROL_HOLD )
+					 {
+						job_desc.priority = 0;
+						job_desc.alloc_sid = 0;
+					 }
+					else
+						job_desc.priority = INFINITE;
+					if( slurm_update_job2( &job_desc, (job_array_resp_msg_t**)&resp ) == -1 )
+						slurmdrmaa_control_failed( &result, "slurm_update_job2", *i, slurm_get_errno() );
+					slurmdrmaa_control_check_resp( &result, "slurm_update_job2", *i, resp );
+					if( resp )
+						slurm_free_job_array_resp( resp );
+					resp = NULL;
+				 }
+				break;
+			default:
+				fsd_exc_raise_fmt(
+						FSD_ERRNO_INVALID_ARGUMENT,
+						"control: unknown action %d", action );
+		 }
+		connection_lock = fsd_mutex_unlock( &self->drm_connection_mutex );
+
+		if( action == DRMAA_CONTROL_SUSPEND || action == DRMAA_CONTROL_RESUME )
+			slurmdrmaa_control_set_suspended( self, action == DRMAA_CONTROL_SUSPEND, &result );
+
+		if( result.n_failed > 0 )
+		 {
+			char *message = result.first_message;
+			if( result.n_failed > 1 )
+			 {
+				message = fsd_asprintf( "%s (and %u more failures)",
+						result.first_message, result.n_failed - 1 );
+				fsd_free( result.first_message );
+			 }
+			fsd_exc_raise( fsd_exc_new( FSD_ERRNO_INTERNAL_ERROR, message, true ) );
+		 }
+	 }
+	FINALLY
+	 {
+		if( resp )
+			slurm_free_job_array_resp( resp );
+		if( connection_lock )
+			fsd_mutex_unlock( &self->drm_connection_mutex );
+		fsd_free_vector( specs );
+		fsd_free_vector( result.failed );
+	 }
+	END_TRY
+
+	fsd_log_return(( "" ));
+}
@@ -0,0 +1,37 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SLURM_DRMAA__CONTROL_H
+#define __SLURM_DRMAA__CONTROL_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <drmaa_utils/session.h>
+
+/*
+ * Apply control action to all jobs of session.  Tasks are grouped
+ * by array job and each group is controlled with single RPC
+ * (all jobs are terminated with one RPC on SLURM >= 23.02).
+ * Failures are logged per job and reported as one error at the end.
+ */
+void slurmdrmaa_control_all( fsd_drmaa_session_t *self, int action );
+
+#endif /* __SLURM_DRMAA__CONTROL_H */
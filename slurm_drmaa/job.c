@@ -27,30 +27,52 @@
 #include <drmaa_utils/drmaa.h>
 #include <drmaa_utils/drmaa_util.h>
 #include <drmaa_utils/environ.h>
+#include <drmaa_utils/probes.h>
 #include <drmaa_utils/template.h>
 
 #include <slurm_drmaa/job.h>
+#include <slurm_drmaa/journal.h>
+#include <slurm_drmaa/shcache.h>
 #include <slurm_drmaa/session.h>
 #include <slurm_drmaa/util.h>
 
 #include <slurm/slurm.h>
 #include <stdint.h>
 
+static void
+slurmdrmaa_job_check_array_resp( fsd_job_t *self, const char *func, job_array_resp_msg_t *resp )
+{
+	if( resp != NULL  &&  resp->job_array_count > 0  &&  resp->error_code[0] != SLURM_SUCCESS )
+		fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR,"%s error: %s,job_id: %s", func, slurm_strerror(resp->error_code[0]), self->job_id );
+}
+
 static void
 slurmdrmaa_job_control( fsd_job_t *self, int action )
 {
 	slurmdrmaa_job_t *slurm_self = (slurmdrmaa_job_t*)self;
 	job_desc_msg_t job_desc;
+	job_array_resp_msg_t *volatile resp = NULL;
+	uint32_t array_job_id, task_id;
+	bool is_task;
+	struct timespec control_start;
 
 	fsd_log_enter(( "({job_id=%s}, action=%d)", self->job_id, action ));
 
-	fsd_mutex_lock( &self->session->drm_connection_mutex );
+	is_task = slurmdrmaa_parse_array_job_id( self->job_id, &array_job_id, &task_id );
+
+	fsd_metric_lock( &self->session->drm_connection_mutex, FSD_METRIC_DRM_LOCK_WAIT );
 	TRY
 	 {
+		fsd_metric_start( &control_start );
 		switch( action )
 		 {
 			case DRMAA_CONTROL_SUSPEND:
-				if(slurm_suspend(fsd_atoi(self->job_id)) == -1) {
+				if( is_task ) {
+					if(slurm_suspend2(self->job_id, (job_array_resp_msg_t **)&resp) == -1) {
+						fsd_exc_raise_fmt(	FSD_ERRNO_INTERNAL_ERROR,"slurm_suspend error: %s,job_id: %s",slurm_strerror(slurm_get_errno()),self->job_id);
+					}
+					slurmdrmaa_job_check_array_resp( self, "slurm_suspend", resp );
+				} else if(slurm_suspend(fsd_atoi(self->job_id)) == -1) {
 					fsd_exc_raise_fmt(	FSD_ERRNO_INTERNAL_ERROR,"slurm_suspend error: %s,job_id: %s",slurm_strerror(slurm_get_errno()),self->job_id);
 				}
 				slurm_self->user_suspended = true;
@@ -59,7 +81,10 @@ slurmdrmaa_job_control( fsd_job_t *self, int action )
 				/* change priority to 0*/
 				slurm_init_job_desc_msg(&job_desc);
 				slurm_self->old_priority = job_desc.priority;
-				job_desc.job_id = atoi(self->job_id);
+				if( is_task )
+					job_desc.job_id_str = self->job_id;
+				else
+					job_desc.job_id = atoi(self->job_id);
 				job_desc.priority = 0;
 				job_desc.alloc_sid = 0;
 				if(slurm_update_job(&job_desc) == -1) {
@@ -67,7 +92,12 @@ slurmdrmaa_job_control( fsd_job_t *self, int action )
 				}
 				break;
 			case DRMAA_CONTROL_RESUME:
-				if(slurm_resume(fsd_atoi(self->job_id)) == -1) {
+				if( is_task ) {
+					if(slurm_resume2(self->job_id, (job_array_resp_msg_t **)&resp) == -1) {
+						fsd_exc_raise_fmt(	FSD_ERRNO_INTERNAL_ERROR,"slurm_resume error: %s,job_id: %s",slurm_strerror(slurm_get_errno()),self->job_id);
+					}
+					slurmdrmaa_job_check_array_resp( self, "slurm_resume", resp );
+				} else if(slurm_resume(fsd_atoi(self->job_id)) == -1) {
 					fsd_exc_raise_fmt(	FSD_ERRNO_INTERNAL_ERROR,"slurm_resume error: %s,job_id: %s",slurm_strerror(slurm_get_errno()),self->job_id);
 				}
 				slurm_self->user_suspended = false;
@@ -76,13 +106,24 @@ slurmdrmaa_job_control( fsd_job_t *self, int action )
 			  /* change priority back*/
 			  	slurm_init_job_desc_msg(&job_desc);
 				job_desc.priority = INFINITE;
-				job_desc.job_id = atoi(self->job_id);
+				if( is_task )
+					job_desc.job_id_str = self->job_id;
+				else
+					job_desc.job_id = atoi(self->job_id);
 				if(slurm_update_job(&job_desc) == -1) {
 					fsd_exc_raise_fmt(	FSD_ERRNO_INTERNAL_ERROR,"slurm_update_job error: %s,job_id: %s",slurm_strerror(slurm_get_errno()),self->job_id);
 				}
 				break;
 			case DRMAA_CONTROL_TERMINATE:
-				if(slurm_kill_job(fsd_atoi(self->job_id),SIGKILL,0) == -1) {
+				if( is_task ) {
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(17,11,0)
+					if(slurm_kill_job2(self->job_id,SIGKILL,0,NULL) == -1) {
+#else
+					if(slurm_kill_job2(self->job_id,SIGKILL,0) == -1) {
+#endif
+						fsd_exc_raise_fmt(	FSD_ERRNO_INTERNAL_ERROR,"slurm_terminate_job error: %s,job_id: %s",slurm_strerror(slurm_get_errno()),self->job_id);
+					}
+				} else if(slurm_kill_job(fsd_atoi(self->job_id),SIGKILL,0) == -1) {
 					fsd_exc_raise_fmt(	FSD_ERRNO_INTERNAL_ERROR,"slurm_terminate_job error: %s,job_id: %s",slurm_strerror(slurm_get_errno()),self->job_id);
 				}
 				break;
@@ -92,10 +133,14 @@ slurmdrmaa_job_control( fsd_job_t *self, int action )
 						"job::control: unknown action %d", action );
 		 }
 					
+		fsd_metric_observe_since( slurmdrmaa_metrics.control, &control_start );
+		slurmdrmaa_journal_job( self->session, self );
 		fsd_log_debug(("job::control: successful"));
 	 }
 	FINALLY
 	 {
+		if( resp != NULL )
+			slurm_free_job_array_resp( resp );
 		fsd_mutex_unlock( &self->session->drm_connection_mutex );
 	 }
 	END_TRY
@@ -104,17 +149,170 @@ slurmdrmaa_job_control( fsd_job_t *self, int action )
 }
 
 
+/*
+ * Share state just obtained from slurmctld with other processes of user.
+ * USER/SYSTEM_SUSPENDED depend on whether this session suspended job,
+ * so suspended jobs are not shared (hold states come from slurmctld
+ * reason and are the same for every session).
+ */
+static void
+slurmdrmaa_job_publish( fsd_job_t *self )
+{
+	slurmdrmaa_shcache_t *cache = ((slurmdrmaa_session_t*)self->session)->shared_cache;
+
+	if( cache != NULL  &&  self->state != DRMAA_PS_UNDETERMINED
+			&&  self->state != DRMAA_PS_USER_SUSPENDED
+			&&  self->state != DRMAA_PS_SYSTEM_SUSPENDED )
+		slurmdrmaa_shcache_publish( cache, self->job_id,
+				self->state, self->exit_status, time(NULL) );
+}
+
+bool
+slurmdrmaa_job_update_from_cache( fsd_job_t *self )
+{
+	slurmdrmaa_shcache_t *cache = ((slurmdrmaa_session_t*)self->session)->shared_cache;
+	int previous_state = self->state;
+	int state, exit_status;
+	time_t update_time;
+
+	if( cache == NULL
+			||  !slurmdrmaa_shcache_lookup( cache, self->job_id, &state, &exit_status, &update_time )
+			||  time(NULL) - update_time >= self->session->cache_job_state
+			||  update_time <= self->last_update_time )
+		return false;
+
+	fsd_log_hot(( "job %s: state %s from shared cache", self->job_id, drmaa_job_ps_to_str(state) ));
+	self->state = state;
+	self->exit_status = exit_status;
+	self->last_update_time = update_time;
+	if( self->state >= DRMAA_PS_DONE )
+		fsd_cond_broadcast( &self->status_cond );
+	self->session->job_state_changed( self->session, self, previous_state );
+	return true;
+}
+
+
+void
+slurmdrmaa_job_update_from_info( fsd_job_t *self, slurm_job_info_t *info )
+{
+	slurmdrmaa_job_t * slurm_self = (slurmdrmaa_job_t *) self;
+	int previous_state = self->state;
+
+	fsd_log_hot(("state = %d, state_reason = %d", info->job_state, info->state_reason));
+
+	/* task with own record can be loaded without rest of the array */
+	if( info->array_job_id != 0  &&  info->job_id != info->array_job_id )
+		slurm_self->slurm_job_id = info->job_id;
+	
+	switch(info->job_state & JOB_STATE_BASE)
+	{
+
+		case JOB_PENDING:
+			switch(info->state_reason)
+			{
+				case WAIT_HELD_USER:   /* job is held by user */
+					fsd_log_hot(("interpreting as DRMAA_PS_USER_ON_HOLD"));
+					self->state = DRMAA_PS_USER_ON_HOLD;
+					break;
+				case WAIT_HELD:  /* job is held by administrator */
+					fsd_log_hot(("interpreting as DRMAA_PS_SYSTEM_ON_HOLD"));
+					self->state = DRMAA_PS_SYSTEM_ON_HOLD;
+					break;
+				default:
+					fsd_log_hot(("interpreting as DRMAA_PS_QUEUED_ACTIVE"));
+					self->state = DRMAA_PS_QUEUED_ACTIVE;
+			}
+			break;
+		case JOB_RUNNING:
+			fsd_log_hot(("interpreting as DRMAA_PS_RUNNING"));
+			self->state = DRMAA_PS_RUNNING;
+			break;
+		case JOB_SUSPENDED:
+			if(slurm_self->user_suspended == true) {
+				fsd_log_hot(("interpreting as DRMAA_PS_USER_SUSPENDED"));
+				self->state = DRMAA_PS_USER_SUSPENDED;
+			} else {
+				fsd_log_hot(("interpreting as DRMAA_PS_SYSTEM_SUSPENDED"));
+				self->state = DRMAA_PS_SYSTEM_SUSPENDED;
+			}
+			break;
+		case JOB_COMPLETE:
+			fsd_log_hot(("interpreting as DRMAA_PS_DONE"));
+			self->state = DRMAA_PS_DONE;
+			self->exit_status = info->exit_code;
+			fsd_log_hot(("exit_status = %d -> %d",self->exit_status, WEXITSTATUS(self->exit_status)));
+			break;
+		case JOB_CANCELLED:
+			fsd_log_hot(("interpreting as DRMAA_PS_FAILED (aborted)"));
+			self->state = DRMAA_PS_FAILED;
+			self->exit_status = -1;
+		case JOB_FAILED:
+		case JOB_TIMEOUT:
+		case JOB_NODE_FAIL:
+		case JOB_PREEMPTED:
+			fsd_log_hot(("interpreting as DRMAA_PS_FAILED"));
+			self->state = DRMAA_PS_FAILED;
+			self->exit_status = info->exit_code;
+			fsd_log_hot(("exit_status = %d -> %d",self->exit_status, WEXITSTATUS(self->exit_status)));
+			break;
+		default: /*unknown state */
+			fsd_log_error(("Unknown job state: %d. Please send bug report: http://apps.man.poznan.pl/trac/slurm-drmaa", info->job_state));
+	}
+
+	if (info->job_state & JOB_STATE_FLAGS & JOB_COMPLETING) {
+		fsd_log_hot(("Epilog completing"));
+	}
+
+	if (info->job_state & JOB_STATE_FLAGS & JOB_CONFIGURING) {
+		fsd_log_hot(("Nodes booting"));
+	}
+
+	if (self->exit_status == -1) /* input,output,error path failure etc*/
+		self->state = DRMAA_PS_FAILED;
+
+	self->last_update_time = time(NULL);
+	slurmdrmaa_job_publish( self );
+
+	if( self->state >= DRMAA_PS_DONE ) {
+		fsd_log_hot(("exit_status = %d, WEXITSTATUS(exit_status) = %d", self->exit_status, WEXITSTATUS(self->exit_status)));
+		fsd_cond_broadcast( &self->status_cond );
+	}
+	self->session->job_state_changed( self->session, self, previous_state );
+}
+
+
 static void
 slurmdrmaa_job_update_status( fsd_job_t *self )
 {
 	job_info_msg_t *job_info = NULL;
-	slurmdrmaa_job_t * slurm_self = (slurmdrmaa_job_t *) self;
+	uint32_t array_job_id, task_id;
+	uint32_t slurm_job_id;
 	fsd_log_enter(( "({job_id=%s})", self->job_id ));
+	FSD_PROBE1( job_refresh_start, self->job_id );
+
+	if( slurmdrmaa_job_update_from_cache( self ) )
+	 {
+		FSD_PROBE2( job_refresh_end, self->job_id, self->state );
+		fsd_log_return(( " (shared cache)" ));
+		return;
+	 }
+
+	if( ((slurmdrmaa_job_t*)self)->slurm_job_id != 0 )
+		slurm_job_id = ((slurmdrmaa_job_t*)self)->slurm_job_id;
+	else if( slurmdrmaa_parse_array_job_id( self->job_id, &array_job_id, &task_id ) )
+		slurm_job_id = array_job_id; /* whole array - task not split yet */
+	else
+		slurm_job_id = fsd_atoi(self->job_id);
 
-	fsd_mutex_lock( &self->session->drm_connection_mutex );
 	TRY
 	{
-		if ( slurm_load_job( &job_info, fsd_atoi(self->job_id), SHOW_ALL) ) {
+		slurmdrmaa_admission_t *admission = &((slurmdrmaa_session_t*)self->session)->admission;
+		int rc;
+
+		SLURMDRMAA_RPC( admission, &self->session->drm_connection_mutex, slurmdrmaa_is_transient_error, rc,
+				FSD_METRIC_TIME( slurmdrmaa_metrics.load_job, rc = slurm_load_job( &job_info, slurm_job_id, SHOW_ALL ) ) );
+
+		if ( rc ) {
 			int _slurm_errno = slurm_get_errno();
 
 			if (_slurm_errno == ESLURM_INVALID_JOB_ID) {
@@ -124,80 +322,12 @@ slurmdrmaa_job_update_status( fsd_job_t *self )
 			}
 		}
 		if (job_info) {
-			fsd_log_debug(("state = %d, state_reason = %d", job_info->job_array[0].job_state, job_info->job_array[0].state_reason));
-			
-			switch(job_info->job_array[0].job_state & JOB_STATE_BASE)
-			{
+			slurm_job_info_t *info = slurmdrmaa_find_job_info( job_info, self->job_id );
 
-				case JOB_PENDING:
-					switch(job_info->job_array[0].state_reason)
-					{
-						case WAIT_HELD_USER:   /* job is held by user */
-							fsd_log_debug(("interpreting as DRMAA_PS_USER_ON_HOLD"));
-							self->state = DRMAA_PS_USER_ON_HOLD;
-							break;
-						case WAIT_HELD:  /* job is held by administrator */
-							fsd_log_debug(("interpreting as DRMAA_PS_SYSTEM_ON_HOLD"));
-							self->state = DRMAA_PS_SYSTEM_ON_HOLD;
-							break;
-						default:
-							fsd_log_debug(("interpreting as DRMAA_PS_QUEUED_ACTIVE"));
-							self->state = DRMAA_PS_QUEUED_ACTIVE;
-					}
-					break;
-				case JOB_RUNNING:
-					fsd_log_debug(("interpreting as DRMAA_PS_RUNNING"));
-					self->state = DRMAA_PS_RUNNING;
-					break;
-				case JOB_SUSPENDED:
-					if(slurm_self->user_suspended == true) {
-						fsd_log_debug(("interpreting as DRMAA_PS_USER_SUSPENDED"));
-						self->state = DRMAA_PS_USER_SUSPENDED;
-					} else {
-						fsd_log_debug(("interpreting as DRMAA_PS_SYSTEM_SUSPENDED"));
-						self->state = DRMAA_PS_SYSTEM_SUSPENDED;
-					}
-					break;
-				case JOB_COMPLETE:
-					fsd_log_debug(("interpreting as DRMAA_PS_DONE"));
-					self->state = DRMAA_PS_DONE;
-					self->exit_status = job_info->job_array[0].exit_code;
-					fsd_log_debug(("exit_status = %d -> %d",self->exit_status, WEXITSTATUS(self->exit_status)));
-					break;
-				case JOB_CANCELLED:
-					fsd_log_debug(("interpreting as DRMAA_PS_FAILED (aborted)"));
-					self->state = DRMAA_PS_FAILED;
-					self->exit_status = -1;
-				case JOB_FAILED:
-				case JOB_TIMEOUT:
-				case JOB_NODE_FAIL:
-				case JOB_PREEMPTED:
-					fsd_log_debug(("interpreting as DRMAA_PS_FAILED"));
-					self->state = DRMAA_PS_FAILED;
-					self->exit_status = job_info->job_array[0].exit_code;
-					fsd_log_debug(("exit_status = %d -> %d",self->exit_status, WEXITSTATUS(self->exit_status)));
-					break;
-				default: /*unknown state */
-					fsd_log_error(("Unknown job state: %d. Please send bug report: http://apps.man.poznan.pl/trac/slurm-drmaa", job_info->job_array[0].job_state));
-			}
-
-			if (job_info->job_array[0].job_state & JOB_STATE_FLAGS & JOB_COMPLETING) {
-				fsd_log_debug(("Epilog completing"));
-			}
-
-			if (job_info->job_array[0].job_state & JOB_STATE_FLAGS & JOB_CONFIGURING) {
-				fsd_log_debug(("Nodes booting"));
-			}
-
-			if (self->exit_status == -1) /* input,output,error path failure etc*/
-				self->state = DRMAA_PS_FAILED;
-
-			self->last_update_time = time(NULL);
-		
-			if( self->state >= DRMAA_PS_DONE ) {
-				fsd_log_debug(("exit_status = %d, WEXITSTATUS(exit_status) = %d", self->exit_status, WEXITSTATUS(self->exit_status)));
-				fsd_cond_broadcast( &self->status_cond );
-			}
+			if (info != NULL)
+				slurmdrmaa_job_update_from_info( self, info );
+			else /* array task already purged */
+				self->on_missing(self);
 		}
 	}
 	FINALLY
@@ -205,7 +335,7 @@ slurmdrmaa_job_update_status( fsd_job_t *self )
 		if(job_info != NULL)
 			slurm_free_job_info_msg (job_info);
 
-		fsd_mutex_unlock( &self->session->drm_connection_mutex );
+		FSD_PROBE2( job_refresh_end, self->job_id, self->state );
 	}
 	END_TRY
 	
@@ -215,13 +345,17 @@ slurmdrmaa_job_update_status( fsd_job_t *self )
 static void
 slurmdrmaa_job_on_missing( fsd_job_t *self )
 {
+	int previous_state = self->state;
 
 	fsd_log_enter(( "({job_id=%s})", self->job_id ));
 	fsd_log_warning(( "Job %s missing from DRM queue", self->job_id ));
 
 	fsd_log_info(( "job_on_missing: last job_ps: %s (0x%02x)", drmaa_job_ps_to_str(self->state), self->state));
 
-	if( self->state >= DRMAA_PS_RUNNING ) { /*if the job ever entered running state assume finished */
+	if( self->state >= DRMAA_PS_DONE ) {
+		/* result already known (e.g. replayed from journal) */
+	}
+	else if( self->state >= DRMAA_PS_RUNNING ) { /*if the job ever entered running state assume finished */
 		self->state = DRMAA_PS_DONE;
 		self->exit_status = 0;
 	}
@@ -231,9 +365,11 @@ slurmdrmaa_job_on_missing( fsd_job_t *self )
 	}
 
 	fsd_log_info(("job_on_missing evaluation result: state=%d exit_status=%d", self->state, self->exit_status));
+	slurmdrmaa_job_publish( self );
 
 	fsd_cond_broadcast( &self->status_cond);
 	fsd_cond_broadcast( &self->session->wait_condition );
+	self->session->job_state_changed( self->session, self, previous_state );
 
 	fsd_log_return(( "; job_ps=%s, exit_status=%d", drmaa_job_ps_to_str(self->state), self->exit_status ));
 }
@@ -244,17 +380,431 @@ slurmdrmaa_job_new( char *job_id )
 	slurmdrmaa_job_t *self = NULL;
 	self = (slurmdrmaa_job_t*)fsd_job_new( job_id );
 
+	fsd_mutex_set_name( &self->super.mutex, NULL );
 	fsd_realloc( self, 1, slurmdrmaa_job_t );
+	fsd_mutex_set_name( &self->super.mutex, "job" );
 
 	self->super.control = slurmdrmaa_job_control;
 	self->super.update_status = slurmdrmaa_job_update_status;
 	self->super.on_missing = slurmdrmaa_job_on_missing;
 	self->old_priority = UINT32_MAX;
 	self->user_suspended = true;
+	self->slurm_job_id = 0;
 	return (fsd_job_t*)self;
 }
 
 
+struct slurmdrmaa_array_s {
+	slurmdrmaa_array_t *next;
+	uint32_t array_job_id;
+	uint32_t first, last, incr;
+	uint32_t n_tasks;
+	uint32_t n_remaining; /* tasks without job record */
+	unsigned char *materialized; /* bitmap of n_tasks */
+	time_t submit_time;
+	bool user_suspended; /* of tasks without job record */
+};
+
+static void
+slurmdrmaa_job_set_free_array( slurmdrmaa_array_t *array )
+{
+	fsd_free( array->materialized );
+	fsd_free( array );
+}
+
+/* create job record of i-th task of array, called with set mutex held */
+static void
+slurmdrmaa_job_set_materialize_nth( slurmdrmaa_job_set_t *self,
+		slurmdrmaa_array_t *array, uint32_t i )
+{
+	fsd_job_t *volatile job = NULL;
+	char *volatile job_id = NULL;
+
+	if( array->materialized[i/8] & (1 << (i%8)) )
+		return;
+
+	TRY
+	 {
+		job_id = fsd_asprintf( "%u_%u", array->array_job_id, array->first + i * array->incr );
+		job = self->session->new_job( self->session, job_id );
+		job->submit_time = array->submit_time;
+		((slurmdrmaa_job_t*)job)->user_suspended = array->user_suspended;
+		/* task is already journaled as part of its array */
+		self->super_add( &self->super, job );
+	 }
+	FINALLY
+	 {
+		if( job )
+			job->release( job );
+		fsd_free( job_id );
+	 }
+	END_TRY
+
+	array->materialized[i/8] |= 1 << (i%8);
+	array->n_remaining--;
+}
+
+/* unlink array from set when all its tasks have job records */
+static void
+slurmdrmaa_job_set_unlink_done( slurmdrmaa_job_set_t *self )
+{
+	slurmdrmaa_array_t **parray = &self->arrays;
+	while( *parray )
+	 {
+		slurmdrmaa_array_t *array = *parray;
+		if( array->n_remaining == 0 )
+		 {
+			*parray = array->next;
+			slurmdrmaa_job_set_free_array( array );
+		 }
+		else
+			parray = &array->next;
+	 }
+}
+
+static void
+slurmdrmaa_job_set_add_array( slurmdrmaa_job_set_t *self, uint32_t array_job_id,
+		uint32_t first, uint32_t last, uint32_t incr )
+{
+	slurmdrmaa_array_t *volatile array = NULL;
+
+	TRY
+	 {
+		fsd_malloc( array, slurmdrmaa_array_t );
+		array->materialized = NULL;
+		array->array_job_id = array_job_id;
+		array->first = first;
+		array->incr = incr > 0 ? incr : 1;
+		array->n_tasks = (last - first) / array->incr + 1;
+		array->last = first + (array->n_tasks - 1) * array->incr;
+		array->n_remaining = array->n_tasks;
+		array->submit_time = time(NULL);
+		array->user_suspended = true; /* as in slurmdrmaa_job_new() */
+		fsd_calloc( array->materialized, (array->n_tasks + 7) / 8, unsigned char );
+
+		fsd_mutex_lock( &self->super.mutex );
+		array->next = self->arrays;
+		self->arrays = array;
+		fsd_mutex_unlock( &self->super.mutex );
+
+		slurmdrmaa_journal_array( self->session, array_job_id, first, array->last, array->incr );
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( array )
+			slurmdrmaa_job_set_free_array( array );
+		fsd_exc_reraise();
+	 }
+	END_TRY
+}
+
+static void
+slurmdrmaa_job_set_materialize_task( slurmdrmaa_job_set_t *self,
+		uint32_t array_job_id, uint32_t task_id )
+{
+	fsd_mutex_t *volatile mutex = &self->super.mutex;
+
+	fsd_mutex_lock( mutex );
+	TRY
+	 {
+		slurmdrmaa_array_t *array = NULL;
+		for( array = self->arrays;  array;  array = array->next )
+			if( array->array_job_id == array_job_id
+					&&  array->first <= task_id  &&  task_id <= array->last
+					&&  (task_id - array->first) % array->incr == 0 )
+			 {
+				slurmdrmaa_job_set_materialize_nth( self, array,
+						(task_id - array->first) / array->incr );
+				break;
+			 }
+		slurmdrmaa_job_set_unlink_done( self );
+	 }
+	FINALLY
+	 { fsd_mutex_unlock( mutex ); }
+	END_TRY
+}
+
+static void
+slurmdrmaa_job_set_materialize_array( slurmdrmaa_job_set_t *self, uint32_t array_job_id )
+{
+	fsd_mutex_t *volatile mutex = &self->super.mutex;
+
+	fsd_mutex_lock( mutex );
+	TRY
+	 {
+		slurmdrmaa_array_t *array = NULL;
+		uint32_t i;
+		for( array = self->arrays;  array;  array = array->next )
+			if( array->array_job_id == array_job_id )
+				for( i = 0;  i < array->n_tasks;  i++ )
+					slurmdrmaa_job_set_materialize_nth( self, array, i );
+		slurmdrmaa_job_set_unlink_done( self );
+	 }
+	FINALLY
+	 { fsd_mutex_unlock( mutex ); }
+	END_TRY
+}
+
+/* array job is gone from slurmctld - resolve all its tasks without
+   querying them one by one */
+static void
+slurmdrmaa_job_set_missing_array( slurmdrmaa_job_set_t *self, uint32_t array_job_id )
+{
+	fsd_mutex_t *volatile mutex = &self->super.mutex;
+	volatile bool locked = false;
+	volatile uint32_t first = 0, incr = 1, n_tasks = 0;
+	time_t now = time(NULL);
+
+	locked = fsd_mutex_lock( mutex );
+	TRY
+	 {
+		slurmdrmaa_array_t *array = NULL;
+		uint32_t i;
+
+		for( array = self->arrays;  array;  array = array->next )
+			if( array->array_job_id == array_job_id )
+			 {
+				first = array->first;
+				incr = array->incr;
+				n_tasks = array->n_tasks;
+				for( i = 0;  i < array->n_tasks;  i++ )
+					slurmdrmaa_job_set_materialize_nth( self, array, i );
+				break;
+			 }
+		slurmdrmaa_job_set_unlink_done( self );
+		locked = fsd_mutex_unlock( mutex );
+
+		for( i = 0;  i < n_tasks;  i++ )
+		 {
+			fsd_job_t *volatile job = NULL;
+			char job_id[32];
+
+			fsd_snprintf( NULL, job_id, sizeof(job_id), "%u_%u", array_job_id, first + i * incr );
+			job = self->super_get( &self->super, job_id );
+			if( job == NULL )
+				continue;
+			TRY
+			 {
+				if( job->state < DRMAA_PS_DONE )
+					job->on_missing( job );
+				job->last_update_time = now;
+			 }
+			FINALLY
+			 { job->release( job ); }
+			END_TRY
+		 }
+	 }
+	FINALLY
+	 {
+		if( locked )
+			fsd_mutex_unlock( mutex );
+	 }
+	END_TRY
+}
+
+static void
+slurmdrmaa_job_set_set_array_suspended( slurmdrmaa_job_set_t *self,
+		uint32_t array_job_id, bool suspended )
+{
+	slurmdrmaa_array_t *array = NULL;
+
+	fsd_mutex_lock( &self->super.mutex );
+	for( array = self->arrays;  array;  array = array->next )
+		if( array->array_job_id == array_job_id )
+			array->user_suspended = suspended;
+	fsd_mutex_unlock( &self->super.mutex );
+}
+
+static uint32_t *
+slurmdrmaa_job_set_get_array_job_ids( slurmdrmaa_job_set_t *self )
+{
+	uint32_t *volatile result = NULL;
+	fsd_mutex_t *volatile mutex = &self->super.mutex;
+
+	fsd_mutex_lock( mutex );
+	TRY
+	 {
+		slurmdrmaa_array_t *array = NULL;
+		unsigned n = 0;
+		for( array = self->arrays;  array;  array = array->next )
+			n++;
+		fsd_calloc( result, n+1, uint32_t );
+		n = 0;
+		for( array = self->arrays;  array;  array = array->next )
+			result[n++] = array->array_job_id;
+	 }
+	FINALLY
+	 { fsd_mutex_unlock( mutex ); }
+	END_TRY
+	return result;
+}
+
+static void
+slurmdrmaa_job_set_foreach_array( slurmdrmaa_job_set_t *self,
+		void (*fn)( void *arg, uint32_t array_job_id, uint32_t first, uint32_t last,
+			uint32_t incr, const unsigned char *materialized ),
+		void *arg )
+{
+	fsd_mutex_t *volatile mutex = &self->super.mutex;
+
+	fsd_mutex_lock( mutex );
+	TRY
+	 {
+		slurmdrmaa_array_t *array = NULL;
+		for( array = self->arrays;  array;  array = array->next )
+			fn( arg, array->array_job_id, array->first, array->last,
+					array->incr, array->materialized );
+	 }
+	FINALLY
+	 { fsd_mutex_unlock( mutex ); }
+	END_TRY
+}
+
+static void
+slurmdrmaa_job_set_add( fsd_job_set_t *self, fsd_job_t *job )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self;
+	set->super_add( self, job );
+	slurmdrmaa_journal_job( set->session, job );
+}
+
+static void
+slurmdrmaa_job_set_remove_by_id( fsd_job_set_t *self, const char *job_id )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self;
+	set->super_remove_by_id( self, job_id );
+	slurmdrmaa_journal_dispose( set->session, job_id );
+}
+
+static size_t
+slurmdrmaa_job_set_detach_terminated( fsd_job_set_t *self, fsd_job_t **jobs, size_t max_jobs )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self;
+	size_t n_jobs, i;
+
+	n_jobs = set->super_detach_terminated( self, jobs, max_jobs );
+	for( i = 0;  i < n_jobs;  i++ )
+		slurmdrmaa_journal_dispose( set->session, jobs[i]->job_id );
+	return n_jobs;
+}
+
+static fsd_job_t *
+slurmdrmaa_job_set_get( fsd_job_set_t *self, const char *job_id )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self;
+	fsd_job_t *job = NULL;
+	uint32_t array_job_id, task_id;
+
+	job = set->super_get( self, job_id );
+	if( job == NULL  &&  slurmdrmaa_parse_array_job_id( job_id, &array_job_id, &task_id ) )
+	 {
+		set->materialize_task( set, array_job_id, task_id );
+		job = set->super_get( self, job_id );
+	 }
+	return job;
+}
+
+static bool
+slurmdrmaa_job_set_empty( fsd_job_set_t *self )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self;
+	bool result;
+
+	fsd_mutex_lock( &self->mutex );
+	result = set->super_empty( self )  &&  set->arrays == NULL;
+	fsd_mutex_unlock( &self->mutex );
+	return result;
+}
+
+static char **
+slurmdrmaa_job_set_get_all_job_ids( fsd_job_set_t *self )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self;
+	char **volatile job_ids = NULL;
+	fsd_mutex_t *volatile mutex = &self->mutex;
+
+	fsd_mutex_lock( mutex );
+	TRY
+	 {
+		slurmdrmaa_array_t *array = NULL;
+		unsigned n = 0;
+		uint32_t i;
+
+		job_ids = set->super_get_all_job_ids( self );
+		while( job_ids[n] != NULL )
+			n++;
+		for( array = set->arrays;  array;  array = array->next )
+		 {
+			fsd_realloc( job_ids, n + array->n_remaining + 1, char* );
+			for( i = 0;  i < array->n_tasks;  i++ )
+				if( !(array->materialized[i/8] & (1 << (i%8))) )
+				 {
+					job_ids[n++] = fsd_asprintf( "%u_%u", array->array_job_id,
+							array->first + i * array->incr );
+					job_ids[n] = NULL;
+				 }
+		 }
+	 }
+	FINALLY
+	 {
+		fsd_mutex_unlock( mutex );
+		if( fsd_exc_get() )
+			fsd_free_vector( job_ids );
+	 }
+	END_TRY
+	return job_ids;
+}
+
+static void
+slurmdrmaa_job_set_destroy( fsd_job_set_t *self )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self;
+	while( set->arrays )
+	 {
+		slurmdrmaa_array_t *array = set->arrays;
+		set->arrays = array->next;
+		slurmdrmaa_job_set_free_array( array );
+	 }
+	set->super_destroy( self );
+}
+
+fsd_job_set_t *
+slurmdrmaa_job_set_new( fsd_drmaa_session_t *session )
+{
+	slurmdrmaa_job_set_t *self = NULL;
+	self = (slurmdrmaa_job_set_t*)fsd_job_set_new();
+
+	fsd_mutex_set_name( &self->super.mutex, NULL );
+	fsd_realloc( self, 1, slurmdrmaa_job_set_t );
+	fsd_mutex_set_name( &self->super.mutex, "job_set" );
+
+	self->super_destroy = self->super.destroy;
+	self->super.destroy = slurmdrmaa_job_set_destroy;
+	self->super_get = self->super.get;
+	self->super.get = slurmdrmaa_job_set_get;
+	self->super_empty = self->super.empty;
+	self->super.empty = slurmdrmaa_job_set_empty;
+	self->super_get_all_job_ids = self->super.get_all_job_ids;
+	self->super.get_all_job_ids = slurmdrmaa_job_set_get_all_job_ids;
+	self->super_add = self->super.add;
+	self->super.add = slurmdrmaa_job_set_add;
+	self->super_remove_by_id = self->super.remove_by_id;
+	self->super.remove_by_id = slurmdrmaa_job_set_remove_by_id;
+	self->super_detach_terminated = self->super.detach_terminated;
+	self->super.detach_terminated = slurmdrmaa_job_set_detach_terminated;
+	self->foreach_array = slurmdrmaa_job_set_foreach_array;
+	self->add_array = slurmdrmaa_job_set_add_array;
+	self->materialize_task = slurmdrmaa_job_set_materialize_task;
+	self->materialize_array = slurmdrmaa_job_set_materialize_array;
+	self->missing_array = slurmdrmaa_job_set_missing_array;
+	self->set_array_suspended = slurmdrmaa_job_set_set_array_suspended;
+	self->get_array_job_ids = slurmdrmaa_job_set_get_array_job_ids;
+	self->session = session;
+	self->arrays = NULL;
+	return (fsd_job_set_t*)self;
+}
+
+
 void
 slurmdrmaa_job_create_req(
 		fsd_drmaa_session_t *session,
@@ -668,7 +1218,8 @@ slurmdrmaa_job_create(
 		fsd_log_debug(("# Native specification: %s\n", value));
 		slurmdrmaa_parse_native(job_desc, value);
 	}
-	
+
+	slurmdrmaa_session_tag_job( session, job_desc );
 }
 
 
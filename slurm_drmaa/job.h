@@ -40,6 +40,66 @@ struct slurmdrmaa_job_s {
 	/* job priority before hold */
 	uint32_t old_priority;
 	bool user_suspended;
+	/* own SLURM job id of array task split from array record
+	   (0 - unknown or not split yet) */
+	uint32_t slurm_job_id;
+};
+
+/* Interpret job record returned by slurm_load_job(s) */
+void slurmdrmaa_job_update_from_info( fsd_job_t *self, slurm_job_info_t *info );
+
+/* Take state published by other process if fresher than cache_job_state allows. */
+bool slurmdrmaa_job_update_from_cache( fsd_job_t *self );
+
+typedef struct slurmdrmaa_job_set_s slurmdrmaa_job_set_t;
+typedef struct slurmdrmaa_array_s slurmdrmaa_array_t;
+
+fsd_job_set_t *
+slurmdrmaa_job_set_new( fsd_drmaa_session_t *session );
+
+/*
+ * Job set which keeps tasks of submitted job arrays in compact form
+ * (array job id + range).  Job record of task is created when task
+ * is first looked up or reported by status polling.
+ */
+struct slurmdrmaa_job_set_s {
+	fsd_job_set_t super;
+
+	void (*super_destroy)( fsd_job_set_t *self );
+	fsd_job_t* (*super_get)( fsd_job_set_t *self, const char *job_id );
+	bool (*super_empty)( fsd_job_set_t *self );
+	/* identifiers of jobs having job record */
+	char** (*super_get_all_job_ids)( fsd_job_set_t *self );
+	/* add, remove and detach without journaling */
+	void (*super_add)( fsd_job_set_t *self, fsd_job_t *job );
+	void (*super_remove_by_id)( fsd_job_set_t *self, const char *job_id );
+	size_t (*super_detach_terminated)( fsd_job_set_t *self, fsd_job_t **jobs, size_t max_jobs );
+
+	/* register tasks first, first+incr, ..., last of array job */
+	void (*add_array)( slurmdrmaa_job_set_t *self, uint32_t array_job_id,
+			uint32_t first, uint32_t last, uint32_t incr );
+	/* create job record of task (if it was not created yet) */
+	void (*materialize_task)( slurmdrmaa_job_set_t *self,
+			uint32_t array_job_id, uint32_t task_id );
+	/* create job records of all remaining tasks of array job */
+	void (*materialize_array)( slurmdrmaa_job_set_t *self, uint32_t array_job_id );
+	/* array job purged by slurmctld - mark all its unfinished tasks missing */
+	void (*missing_array)( slurmdrmaa_job_set_t *self, uint32_t array_job_id );
+	/* set user_suspended flag of array tasks without job record
+	   (given to their job records when created) */
+	void (*set_array_suspended)( slurmdrmaa_job_set_t *self,
+			uint32_t array_job_id, bool suspended );
+	/* array jobs with tasks without job record (terminated by 0) */
+	uint32_t* (*get_array_job_ids)( slurmdrmaa_job_set_t *self );
+	/* call fn for every array with its bitmap of tasks having job record
+	   (called with set mutex held) */
+	void (*foreach_array)( slurmdrmaa_job_set_t *self,
+			void (*fn)( void *arg, uint32_t array_job_id, uint32_t first, uint32_t last,
+				uint32_t incr, const unsigned char *materialized ),
+			void *arg );
+
+	fsd_drmaa_session_t *session;
+	slurmdrmaa_array_t *arrays;
 };
 
 void slurmdrmaa_job_create_req(fsd_drmaa_session_t *session, const fsd_template_t *jt, fsd_environ_t **envp, job_desc_msg_t * job_desc );
@@ -0,0 +1,561 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/drmaa.h>
+#include <drmaa_utils/exception.h>
+#include <drmaa_utils/logging.h>
+#include <drmaa_utils/util.h>
+#include <slurm_drmaa/job.h>
+#include <slurm_drmaa/journal.h>
+#include <slurm_drmaa/session.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+#define SLURMDRMAA_JOURNAL_MAGIC "SDRMJNL"
+#define SLURMDRMAA_JOURNAL_VERSION 1
+#define SLURMDRMAA_JOURNAL_INITIAL_SIZE (64*1024)
+
+enum {
+	SLURMDRMAA_JOURNAL_JOB = 1, /* job added or changed (upsert) */
+	SLURMDRMAA_JOURNAL_ARRAY, /* tasks of array kept in compact form */
+	SLURMDRMAA_JOURNAL_DISPOSE /* job disposed */
+};
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	/* end of last complete record (set after record is written) */
+	uint64_t tail;
+} slurmdrmaa_journal_header_t;
+
+/* followed by job id (id_len bytes and '\0'), padded to 8 bytes */
+typedef struct {
+	uint32_t size;
+	uint16_t type;
+	uint16_t id_len;
+	int32_t state;
+	int32_t exit_status;
+	uint32_t old_priority;
+	uint32_t user_suspended;
+	int64_t submit_time;
+	int64_t update_time;
+	uint32_t first, last, incr;
+	uint32_t reserved;
+} slurmdrmaa_journal_record_t;
+
+struct slurmdrmaa_journal_s {
+	char *path;
+	int lock_fd; /* flock()ed for lifetime of journal */
+	int fd;
+	char *base;
+	size_t size;
+	bool failed;
+	fsd_mutex_t mutex;
+};
+
+
+static void
+slurmdrmaa_journal_map( slurmdrmaa_journal_t *self, size_t size )
+{
+	char *base = NULL;
+	int rc;
+
+	/* reserve blocks so full disk is reported here and not by SIGBUS */
+	rc = posix_fallocate( self->fd, 0, (off_t)size );
+	if( rc != 0 )
+		fsd_exc_raise_sys( rc );
+	base = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0 );
+	if( base == MAP_FAILED )
+		fsd_exc_raise_sys( 0 );
+	if( self->base )
+		munmap( self->base, self->size );
+	self->base = base;
+	self->size = size;
+}
+
+
+static void
+slurmdrmaa_journal_append( slurmdrmaa_journal_t *self, slurmdrmaa_journal_record_t *rec, const char *job_id )
+{
+	volatile bool locked = false;
+
+	if( self == NULL )
+		return;
+
+	TRY
+	 {
+		slurmdrmaa_journal_header_t *header = NULL;
+		size_t id_len = strlen( job_id );
+		size_t size = (sizeof(slurmdrmaa_journal_record_t) + id_len + 1 + 7) & ~(size_t)7;
+
+		rec->size = (uint32_t)size;
+		rec->id_len = (uint16_t)id_len;
+
+		locked = fsd_mutex_lock( &self->mutex );
+		if( !self->failed )
+		 {
+			header = (slurmdrmaa_journal_header_t*)self->base;
+			if( header->tail + size > self->size )
+			 {
+				size_t new_size = self->size * 2;
+				while( header->tail + size > new_size )
+					new_size *= 2;
+				slurmdrmaa_journal_map( self, new_size );
+				header = (slurmdrmaa_journal_header_t*)self->base;
+			 }
+			memcpy( self->base + header->tail, rec, sizeof(slurmdrmaa_journal_record_t) );
+			memcpy( self->base + header->tail + sizeof(slurmdrmaa_journal_record_t), job_id, id_len + 1 );
+			/* record must be complete before it becomes visible */
+			__sync_synchronize();
+			header->tail += size;
+		 }
+		locked = fsd_mutex_unlock( &self->mutex );
+	 }
+	EXCEPT_DEFAULT
+	 {
+		const fsd_exc_t *e = fsd_exc_get();
+		fsd_log_error(( "journal %s: %s - journaling disabled", self->path, e->message(e) ));
+		if( !locked )
+			locked = fsd_mutex_lock( &self->mutex );
+		self->failed = true;
+	 }
+	FINALLY
+	 {
+		if( locked )
+			fsd_mutex_unlock( &self->mutex );
+	 }
+	END_TRY
+}
+
+
+static slurmdrmaa_journal_t *
+slurmdrmaa_journal_of( fsd_drmaa_session_t *session )
+{
+	return ((slurmdrmaa_session_t*)session)->journal;
+}
+
+
+static void
+slurmdrmaa_journal_fill_job( slurmdrmaa_journal_record_t *rec, fsd_job_t *job )
+{
+	slurmdrmaa_job_t *slurm_job = (slurmdrmaa_job_t*)job;
+
+	memset( rec, 0, sizeof(slurmdrmaa_journal_record_t) );
+	rec->type = SLURMDRMAA_JOURNAL_JOB;
+	rec->state = job->state;
+	rec->exit_status = job->exit_status;
+	rec->old_priority = slurm_job->old_priority;
+	rec->user_suspended = slurm_job->user_suspended;
+	rec->submit_time = job->submit_time;
+	rec->update_time = job->last_update_time;
+}
+
+
+void
+slurmdrmaa_journal_job( fsd_drmaa_session_t *session, fsd_job_t *job )
+{
+	slurmdrmaa_journal_t *self = slurmdrmaa_journal_of( session );
+	slurmdrmaa_journal_record_t rec;
+
+	if( self == NULL )
+		return;
+	slurmdrmaa_journal_fill_job( &rec, job );
+	slurmdrmaa_journal_append( self, &rec, job->job_id );
+}
+
+
+static void
+slurmdrmaa_journal_write_array( slurmdrmaa_journal_t *self, uint32_t array_job_id,
+		uint32_t first, uint32_t last, uint32_t incr )
+{
+	slurmdrmaa_journal_record_t rec;
+	char job_id[16];
+
+	memset( &rec, 0, sizeof(rec) );
+	rec.type = SLURMDRMAA_JOURNAL_ARRAY;
+	rec.first = first;
+	rec.last = last;
+	rec.incr = incr;
+	rec.update_time = time(NULL);
+	snprintf( job_id, sizeof(job_id), "%u", array_job_id );
+	slurmdrmaa_journal_append( self, &rec, job_id );
+}
+
+
+void
+slurmdrmaa_journal_array( fsd_drmaa_session_t *session, uint32_t array_job_id,
+		uint32_t first, uint32_t last, uint32_t incr )
+{
+	slurmdrmaa_journal_t *self = slurmdrmaa_journal_of( session );
+
+	if( self != NULL )
+		slurmdrmaa_journal_write_array( self, array_job_id, first, last, incr );
+}
+
+
+static void
+slurmdrmaa_journal_write_dispose( slurmdrmaa_journal_t *self, const char *job_id )
+{
+	slurmdrmaa_journal_record_t rec;
+
+	memset( &rec, 0, sizeof(rec) );
+	rec.type = SLURMDRMAA_JOURNAL_DISPOSE;
+	rec.update_time = time(NULL);
+	slurmdrmaa_journal_append( self, &rec, job_id );
+}
+
+
+void
+slurmdrmaa_journal_dispose( fsd_drmaa_session_t *session, const char *job_id )
+{
+	slurmdrmaa_journal_t *self = slurmdrmaa_journal_of( session );
+
+	if( self != NULL )
+		slurmdrmaa_journal_write_dispose( self, job_id );
+}
+
+
+static void
+slurmdrmaa_journal_apply( fsd_drmaa_session_t *session,
+		const slurmdrmaa_journal_record_t *rec, const char *job_id )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)session->jobs;
+	fsd_job_t *volatile job = NULL;
+
+	TRY
+	 {
+		switch( rec->type )
+		 {
+			case SLURMDRMAA_JOURNAL_JOB:
+			 {
+				slurmdrmaa_job_t *slurm_job = NULL;
+				volatile bool added = false;
+
+				job = session->jobs->get( session->jobs, job_id );
+				if( job == NULL )
+				 {
+					job = session->new_job( session, job_id );
+					added = true;
+				 }
+				slurm_job = (slurmdrmaa_job_t*)job;
+				job->state = rec->state;
+				job->exit_status = rec->exit_status;
+				job->submit_time = (time_t)rec->submit_time;
+				job->last_update_time = (time_t)rec->update_time;
+				slurm_job->old_priority = rec->old_priority;
+				slurm_job->user_suspended = rec->user_suspended != 0;
+				if( added )
+					session->jobs->add( session->jobs, job );
+				break;
+			 }
+			case SLURMDRMAA_JOURNAL_ARRAY:
+				set->add_array( set, (uint32_t)fsd_atoi(job_id), rec->first, rec->last, rec->incr );
+				break;
+			case SLURMDRMAA_JOURNAL_DISPOSE:
+				/* task still in compact form needs job record to be disposed */
+				job = session->jobs->get( session->jobs, job_id );
+				if( job )
+				 {
+					job->release( job );
+					job = NULL;
+					session->jobs->remove_by_id( session->jobs, job_id );
+				 }
+				break;
+			default:
+				fsd_log_warning(( "journal: unknown record type %d", (int)rec->type ));
+				break;
+		 }
+	 }
+	FINALLY
+	 {
+		if( job )
+			job->release( job );
+	 }
+	END_TRY
+}
+
+
+/* Apply records of existing journal.  Returns number of records. */
+static unsigned
+slurmdrmaa_journal_replay( fsd_drmaa_session_t *session, const char *path )
+{
+	const char *volatile base = MAP_FAILED;
+	volatile size_t size = 0;
+	volatile int fd = -1;
+	volatile unsigned n_records = 0;
+
+	TRY
+	 {
+		const slurmdrmaa_journal_header_t *header = NULL;
+		struct stat st;
+		uint64_t offset, tail;
+
+		fd = open( path, O_RDONLY );
+		if( fd == -1 )
+		 {
+			if( errno != ENOENT )
+				fsd_log_error(( "journal %s: %s", path, strerror(errno) ));
+		 }
+		else if( fstat( fd, &st ) == -1 )
+			fsd_exc_raise_sys( 0 );
+		else if( (size_t)st.st_size < sizeof(slurmdrmaa_journal_header_t) )
+			fsd_log_warning(( "journal %s: truncated - ignored", path ));
+		else
+		 {
+			size = (size_t)st.st_size;
+			base = mmap( NULL, size, PROT_READ, MAP_SHARED, fd, 0 );
+			if( base == MAP_FAILED )
+				fsd_exc_raise_sys( 0 );
+			header = (const slurmdrmaa_journal_header_t*)base;
+			if( memcmp( header->magic, SLURMDRMAA_JOURNAL_MAGIC, sizeof(SLURMDRMAA_JOURNAL_MAGIC) )
+					||  header->version != SLURMDRMAA_JOURNAL_VERSION )
+				fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR,
+						"journal %s: not a journal or unsupported version", path );
+
+			tail = header->tail < size ? header->tail : size;
+			offset = sizeof(slurmdrmaa_journal_header_t);
+			while( offset + sizeof(slurmdrmaa_journal_record_t) <= tail )
+			 {
+				const slurmdrmaa_journal_record_t *rec =
+					(const slurmdrmaa_journal_record_t*)(base + offset);
+				if( rec->size < sizeof(slurmdrmaa_journal_record_t) + rec->id_len + 1
+						||  offset + rec->size > tail
+						||  base[ offset + sizeof(slurmdrmaa_journal_record_t) + rec->id_len ] != '\0' )
+				 {
+					fsd_log_warning(( "journal %s: corrupted record at %lu - rest ignored",
+								path, (unsigned long)offset ));
+					break;
+				 }
+				slurmdrmaa_journal_apply( session, rec,
+						base + offset + sizeof(slurmdrmaa_journal_record_t) );
+				n_records++;
+				offset += rec->size;
+			 }
+		 }
+	 }
+	FINALLY
+	 {
+		if( base != MAP_FAILED )
+			munmap( (void*)base, size );
+		if( fd != -1 )
+			close( fd );
+	 }
+	END_TRY
+
+	return n_records;
+}
+
+
+typedef struct {
+	slurmdrmaa_journal_t *journal;
+	slurmdrmaa_job_set_t *set;
+} slurmdrmaa_journal_snapshot_t;
+
+static void
+slurmdrmaa_journal_snapshot_array( void *arg, uint32_t array_job_id,
+		uint32_t first, uint32_t last, uint32_t incr, const unsigned char *materialized )
+{
+	slurmdrmaa_journal_snapshot_t *s = (slurmdrmaa_journal_snapshot_t*)arg;
+	uint32_t i, n_tasks = (last - first) / incr + 1;
+
+	slurmdrmaa_journal_write_array( s->journal, array_job_id, first, last, incr );
+	/* tasks which got job record and were disposed since */
+	for( i = 0;  i < n_tasks;  i++ )
+		if( materialized[i/8] & (1 << (i%8)) )
+		 {
+			char job_id[32];
+			fsd_job_t *job = NULL;
+			snprintf( job_id, sizeof(job_id), "%u_%u", array_job_id, first + i * incr );
+			job = s->set->super_get( &s->set->super, job_id );
+			if( job )
+				job->release( job );
+			else
+				slurmdrmaa_journal_write_dispose( s->journal, job_id );
+		 }
+}
+
+
+/* Write records describing current content of job set. */
+static void
+slurmdrmaa_journal_snapshot( slurmdrmaa_journal_t *self, fsd_drmaa_session_t *session )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)session->jobs;
+	char **volatile job_ids = NULL;
+	slurmdrmaa_journal_snapshot_t s;
+
+	s.journal = self;
+	s.set = set;
+	TRY
+	 {
+		char **i;
+
+		/* arrays first - replay of their job records needs them */
+		set->foreach_array( set, slurmdrmaa_journal_snapshot_array, &s );
+
+		job_ids = set->super_get_all_job_ids( session->jobs );
+		for( i = job_ids;  *i != NULL;  i++ )
+		 {
+			fsd_job_t *job = set->super_get( session->jobs, *i );
+			if( job )
+			 {
+				slurmdrmaa_journal_record_t rec;
+				slurmdrmaa_journal_fill_job( &rec, job );
+				job->release( job );
+				slurmdrmaa_journal_append( self, &rec, *i );
+			 }
+		 }
+	 }
+	FINALLY
+	 {
+		fsd_free_vector( job_ids );
+	 }
+	END_TRY
+}
+
+
+slurmdrmaa_journal_t *
+slurmdrmaa_journal_open( fsd_drmaa_session_t *session, const char *journal_dir )
+{
+	slurmdrmaa_journal_t *volatile self = NULL;
+	char *volatile new_path = NULL;
+	char *volatile lock_path = NULL;
+
+	fsd_log_enter(( "(%s)", journal_dir ));
+	TRY
+	 {
+		slurmdrmaa_journal_header_t *header = NULL;
+		unsigned n_records;
+		char *p;
+		char *name = fsd_strdup( session->contact );
+
+		for( p = name;  *p;  p++ )
+			if( !(('a' <= *p && *p <= 'z') || ('A' <= *p && *p <= 'Z')
+						|| ('0' <= *p && *p <= '9') || *p == '.' || *p == '-') )
+				*p = '_';
+
+		fsd_malloc( self, slurmdrmaa_journal_t );
+		self->path = NULL;
+		self->lock_fd = -1;
+		self->fd = -1;
+		self->base = NULL;
+		self->size = 0;
+		self->failed = false;
+		fsd_mutex_init( &self->mutex );
+		fsd_mutex_set_name( &self->mutex, "journal" );
+		self->path = fsd_asprintf( "%s/%s.journal", journal_dir, name );
+		fsd_free( name );
+
+		/*
+		 * Journal itself is replaced by rename() so lock is taken on
+		 * separate file which is never removed.  Second process with
+		 * the same contact would compact journal under the first one.
+		 */
+		lock_path = fsd_asprintf( "%s.lock", self->path );
+		self->lock_fd = open( lock_path, O_RDWR | O_CREAT, 0600 );
+		if( self->lock_fd == -1 )
+			fsd_exc_raise_sys( 0 );
+		fcntl( self->lock_fd, F_SETFD, FD_CLOEXEC );
+		if( flock( self->lock_fd, LOCK_EX | LOCK_NB ) == -1 )
+		 {
+			if( errno == EWOULDBLOCK )
+				fsd_exc_raise_fmt( FSD_DRMAA_ERRNO_ALREADY_ACTIVE_SESSION,
+						"journal %s is in use by another process", self->path );
+			fsd_exc_raise_sys( 0 );
+		 }
+
+		n_records = slurmdrmaa_journal_replay( session, self->path );
+		fsd_log_info(( "journal %s: %u records replayed", self->path, n_records ));
+
+		/* compacted journal replaces old one atomically */
+		new_path = fsd_asprintf( "%s.new", self->path );
+		self->fd = open( new_path, O_RDWR | O_CREAT | O_TRUNC, 0600 );
+		if( self->fd == -1 )
+			fsd_exc_raise_sys( 0 );
+		fcntl( self->fd, F_SETFD, FD_CLOEXEC );
+		slurmdrmaa_journal_map( self, SLURMDRMAA_JOURNAL_INITIAL_SIZE );
+		header = (slurmdrmaa_journal_header_t*)self->base;
+		memset( header, 0, sizeof(slurmdrmaa_journal_header_t) );
+		memcpy( header->magic, SLURMDRMAA_JOURNAL_MAGIC, sizeof(SLURMDRMAA_JOURNAL_MAGIC) );
+		header->version = SLURMDRMAA_JOURNAL_VERSION;
+		header->tail = sizeof(slurmdrmaa_journal_header_t);
+
+		slurmdrmaa_journal_snapshot( self, session );
+		if( self->failed )
+			fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR, "journal %s: snapshot failed", new_path );
+		msync( self->base, self->size, MS_SYNC );
+		if( rename( new_path, self->path ) == -1 )
+			fsd_exc_raise_sys( 0 );
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( self )
+		 {
+			if( new_path )
+				unlink( new_path );
+			slurmdrmaa_journal_close( self );
+		 }
+		fsd_exc_reraise();
+	 }
+	FINALLY
+	 {
+		fsd_free( new_path );
+		fsd_free( lock_path );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%p", (void*)self ));
+	return self;
+}
+
+
+void
+slurmdrmaa_journal_close( slurmdrmaa_journal_t *self )
+{
+	if( self->base )
+	 {
+		msync( self->base, self->size, MS_SYNC );
+		munmap( self->base, self->size );
+	 }
+	if( self->fd != -1 )
+		close( self->fd );
+	if( self->lock_fd != -1 )
+		close( self->lock_fd );
+	fsd_mutex_destroy( &self->mutex );
+	fsd_free( self->path );
+	fsd_free( self );
+}
@@ -0,0 +1,59 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SLURM_DRMAA__JOURNAL_H
+#define __SLURM_DRMAA__JOURNAL_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <drmaa_utils/session.h>
+
+typedef struct slurmdrmaa_journal_s slurmdrmaa_journal_t;
+
+/*
+ * Append-only, memory mapped journal of session jobs
+ * (<journal_dir>/<contact>.journal).  Records are written to mapping
+ * and survive crash of client process (not of the host).
+ *
+ * Replays existing journal into session job set, then starts new
+ * (compacted) journal with snapshot of session jobs.  Journal is locked
+ * (<contact>.journal.lock) until closed - raises
+ * FSD_DRMAA_ERRNO_ALREADY_ACTIVE_SESSION when other process holds it.
+ */
+slurmdrmaa_journal_t *slurmdrmaa_journal_open( fsd_drmaa_session_t *session, const char *journal_dir );
+
+void slurmdrmaa_journal_close( slurmdrmaa_journal_t *self );
+
+/*
+ * Record job (when first added or its state, exit status, hold/suspend
+ * data changed).  No-ops when session has no journal.  Write errors
+ * are logged and disable journal - they never fail job operations.
+ */
+void slurmdrmaa_journal_job( fsd_drmaa_session_t *session, fsd_job_t *job );
+
+/* Record tasks of job array kept in compact form. */
+void slurmdrmaa_journal_array( fsd_drmaa_session_t *session, uint32_t array_job_id,
+		uint32_t first, uint32_t last, uint32_t incr );
+
+/* Record disposal of job. */
+void slurmdrmaa_journal_dispose( fsd_drmaa_session_t *session, const char *job_id );
+
+#endif /* __SLURM_DRMAA__JOURNAL_H */
@@ -17,11 +17,17 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <signal.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <drmaa_utils/drmaa.h>
 #include <drmaa_utils/iter.h>
 #include <drmaa_utils/conf.h>
+#include <drmaa_utils/drmaa_util.h>
+#include <drmaa_utils/probes.h>
+#include <slurm_drmaa/control.h>
 #include <slurm_drmaa/job.h>
 #include <slurm_drmaa/session.h>
 #include <slurm_drmaa/util.h>
@@ -34,6 +40,21 @@ static fsd_iter_t *slurmdrmaa_session_run_bulk(	fsd_drmaa_session_t *self,const
 
 static fsd_job_t *slurmdrmaa_session_new_job( fsd_drmaa_session_t *self, const char *job_id );
 
+static void slurmdrmaa_session_apply_configuration( fsd_drmaa_session_t *self );
+
+static void slurmdrmaa_session_destroy_nowait( fsd_drmaa_session_t *self );
+
+static fsd_iter_t *slurmdrmaa_session_run_array( fsd_drmaa_session_t *self, const fsd_template_t *jt, uint32_t first, uint32_t last, uint32_t incr, uint32_t block );
+
+static void slurmdrmaa_session_update_all_jobs_status( fsd_drmaa_session_t *self );
+
+static void slurmdrmaa_session_control_job( fsd_drmaa_session_t *self, const char *job_id, int action );
+
+static void slurmdrmaa_session_job_ps_multi( fsd_drmaa_session_t *self, const char **job_ids, int *remote_ps );
+
+static size_t slurmdrmaa_session_adopt_jobs( fsd_drmaa_session_t *self, const char **job_ids, bool session_only );
+static void slurmdrmaa_session_job_state_changed( fsd_drmaa_session_t *self, fsd_job_t *job, int previous_state );
+
 fsd_drmaa_session_t *
 slurmdrmaa_session_new( const char *contact )
 {
@@ -42,13 +63,112 @@ slurmdrmaa_session_new( const char *contact )
 	 {
 		self = (slurmdrmaa_session_t*)fsd_drmaa_session_new(contact);
 
+		fsd_mutex_set_name( &self->super.mutex, NULL );
+		fsd_mutex_set_name( &self->super.drm_connection_mutex, NULL );
 		fsd_realloc( self, 1, slurmdrmaa_session_t );
+		fsd_mutex_set_name( &self->super.mutex, "session" );
+		fsd_mutex_set_name( &self->super.drm_connection_mutex, "drm_connection" );
 
 		self->super.run_job = slurmdrmaa_session_run_job;
 		self->super.run_bulk = slurmdrmaa_session_run_bulk;
 		self->super.new_job = slurmdrmaa_session_new_job;
+		self->super.update_all_jobs_status = slurmdrmaa_session_update_all_jobs_status;
+		self->super.job_ps_multi = slurmdrmaa_session_job_ps_multi;
+		self->super.adopt_jobs = slurmdrmaa_session_adopt_jobs;
+
+		self->super.jobs->destroy( self->super.jobs );
+		self->super.jobs = NULL;
+		self->super.jobs = slurmdrmaa_job_set_new( &self->super );
+
+		self->super_apply_configuration = self->super.apply_configuration;
+		self->super.apply_configuration = slurmdrmaa_session_apply_configuration;
+		self->super_destroy_nowait = self->super.destroy_nowait;
+		self->super.destroy_nowait = slurmdrmaa_session_destroy_nowait;
+		self->super_control_job = self->super.control_job;
+		self->super.control_job = slurmdrmaa_session_control_job;
+		self->super_job_state_changed = self->super.job_state_changed;
+		self->super.job_state_changed = slurmdrmaa_session_job_state_changed;
+
+		self->coalesce_window.tv_sec = 0;
+		self->coalesce_window.tv_nsec = 0;
+		self->coalesce_max_tasks = 1000;
+		self->coalesce_batches = NULL;
+		fsd_mutex_init( &self->coalesce_mutex );
+		fsd_mutex_set_name( &self->coalesce_mutex, "coalesce" );
+
+		self->max_array_size = 0;
+		self->max_array_tasks = 0;
+		self->array_limits_loaded = false;
+
+		slurmdrmaa_admission_init( &self->admission );
+		slurmdrmaa_metrics_register();
+
+		self->tag_field = SLURMDRMAA_TAG_NONE;
+		self->adopt = SLURMDRMAA_ADOPT_NONE;
+		self->journal_dir = NULL;
+		self->journal = NULL;
+		self->shared_cache_dir = NULL;
+		self->shared_cache = NULL;
+		if( contact != NULL  &&  contact[0] != '\0' )
+			self->session_tag = fsd_asprintf( "[drmaa:%s]", contact );
+		else
+		 {
+			char hostname[256];
+			if( gethostname( hostname, sizeof(hostname) ) != 0 )
+				strcpy( hostname, "localhost" );
+			hostname[sizeof(hostname)-1] = '\0';
+			self->session_tag = fsd_asprintf( "[drmaa:%s:%d:%ld]",
+					hostname, (int)getpid(), (long)time(NULL) );
+		 }
 
 		self->super.load_configuration( &self->super, "slurm_drmaa" );
+
+		if( self->shared_cache_dir != NULL )
+			TRY
+			 {
+				self->shared_cache = slurmdrmaa_shcache_open( self->shared_cache_dir );
+			 }
+			EXCEPT_DEFAULT
+			 {
+				const fsd_exc_t *e = fsd_exc_get();
+				fsd_log_error(( "opening shared cache failed: <%d:%s>", e->code(e), e->message(e) ));
+			 }
+			END_TRY
+
+		/* jobs of previous incarnation of session come back before adoption */
+		if( self->journal_dir != NULL )
+		 {
+			if( self->super.contact == NULL  ||  self->super.contact[0] == '\0' )
+				fsd_log_warning(( "journal_dir set but session has no contact - journaling disabled" ));
+			else
+				TRY
+				 {
+					self->journal = slurmdrmaa_journal_open( &self->super, self->journal_dir );
+				 }
+				EXCEPT_DEFAULT
+				 {
+					const fsd_exc_t *e = fsd_exc_get();
+					/* other process runs session with the same contact */
+					if( e->code(e) == FSD_DRMAA_ERRNO_ALREADY_ACTIVE_SESSION )
+						fsd_exc_reraise();
+					fsd_log_error(( "opening journal failed: <%d:%s>", e->code(e), e->message(e) ));
+				 }
+				END_TRY
+		 }
+
+		if( self->adopt != SLURMDRMAA_ADOPT_NONE )
+			TRY
+			 {
+				size_t n_adopted = self->super.adopt_jobs( &self->super, NULL,
+						self->adopt == SLURMDRMAA_ADOPT_SESSION );
+				fsd_log_info(( "adopted %u jobs", (unsigned)n_adopted ));
+			 }
+			EXCEPT_DEFAULT
+			 {
+				const fsd_exc_t *e = fsd_exc_get();
+				fsd_log_error(( "adopting jobs failed: <%d:%s>", e->code(e), e->message(e) ));
+			 }
+			END_TRY
 	 }
 	EXCEPT_DEFAULT
 	 {
@@ -66,9 +186,13 @@ slurmdrmaa_session_run_job(
 		const fsd_template_t *jt
 		)
 {
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
 	char *job_id = NULL;
 	fsd_iter_t *volatile job_ids = NULL;
 
+	if( slurm_self->coalesce_window.tv_sec != 0  ||  slurm_self->coalesce_window.tv_nsec != 0 )
+		return slurmdrmaa_coalesce_run_job( self, jt );
+
 	TRY
 	 {
 		job_ids = self->run_bulk( self, jt, 0, 0, 0 ); /* single job run as bulk job specialization */
@@ -90,77 +214,90 @@ slurmdrmaa_session_run_bulk(
 		const fsd_template_t *jt,
 		int start, int end, int incr )
 {
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
 	fsd_job_t *volatile job = NULL;
 	char **volatile job_ids = NULL;
-	unsigned n_jobs = 1;
 	volatile bool connection_lock = false;
+	int rc;
 	fsd_environ_t *volatile env = NULL;
 	job_desc_msg_t job_desc;
 	submit_response_msg_t *submit_response = NULL;
-	job_info_msg_t *job_info = NULL;
+	fsd_iter_t *result = NULL;
+
+	if( start != 0 || end != 0 || incr != 0 )
+	 {
+		uint32_t step = incr < 0 ? -incr : incr;
+		uint32_t n_jobs = start != end ? (end - start) / incr + 1 : 1;
+		uint32_t first = incr > 0 ? start : start + (int)(n_jobs - 1) * incr;
+		uint32_t last = first + (n_jobs - 1) * step;
+		uint32_t limit = UINT32_MAX;
+		uint32_t block = UINT32_MAX;
+		bool split = false;
+
+		if( !slurm_self->array_limits_loaded )
+			slurmdrmaa_session_load_array_limits( slurm_self );
+
+		if( slurm_self->max_array_size != 0 )
+		 {
+			split = split || last >= slurm_self->max_array_size;
+			limit = slurm_self->max_array_size;
+		 }
+		if( slurm_self->max_array_tasks != 0 )
+		 {
+			split = split || n_jobs > slurm_self->max_array_tasks;
+			if( slurm_self->max_array_tasks < limit )
+				limit = slurm_self->max_array_tasks;
+		 }
+
+		if( split )
+		 {
+			/* decimal blocks so %a based patterns can rebuild bulk index */
+			block = 1;
+			while( block <= limit / 10 )
+				block *= 10;
+		 }
+
+		FSD_PROBE1( submit_start, n_jobs );
+		result = slurmdrmaa_session_run_array( self, jt, first, last, step, block );
+		FSD_PROBE1( submit_end, n_jobs );
+		return result;
+	 }
 
     /* zero out the struct, and set default vaules */
 	slurm_init_job_desc_msg( &job_desc );
+	FSD_PROBE1( submit_start, 1 );
 	
 	TRY
 	 {
-        unsigned i;
-		if( start != end ) {
-			n_jobs = (end - start) / incr + 1;
-         } else {
-            n_jobs = 1;
-         }
+		fsd_calloc( job_ids, 2, char* );
 
-        fsd_calloc( job_ids, n_jobs+1, char* );
-
-		if ( start != 0 || end != 0 || incr != 0 ) {
-        	job_desc.array_inx = fsd_asprintf( "%d-%d:%d", start, end, incr );
-		}
-
-		connection_lock = fsd_mutex_lock( &self->drm_connection_mutex );
+		/* request is built without holding connection lock
+		   so concurrent submitters only serialize on the RPC itself */
 		slurmdrmaa_job_create_req( self, jt, (fsd_environ_t**)&env , &job_desc );
-		if(slurm_submit_batch_job(&job_desc,&submit_response)){
+
+		SLURMDRMAA_RPC( &slurm_self->admission, &self->drm_connection_mutex, slurmdrmaa_is_undelivered_error, rc,
+				FSD_METRIC_TIME( slurmdrmaa_metrics.submit_batch_job, rc = slurm_submit_batch_job( &job_desc, &submit_response ) ) );
+		if( rc ){
 			fsd_exc_raise_fmt(
 				FSD_ERRNO_INTERNAL_ERROR,"slurm_submit_batch_job: %s",slurm_strerror(slurm_get_errno()));
 		}
 
-		connection_lock = fsd_mutex_unlock( &self->drm_connection_mutex );
-
 		fsd_log_debug(("job %u submitted", submit_response->job_id));
 
-		if ( start != 0 || end != 0 || incr != 0 ) {
-			if ( SLURM_SUCCESS == slurm_load_job( &job_info, submit_response->job_id, 0) )
-			{
-				fsd_assert(  job_info->record_count == n_jobs );
-				for(i=0; i < job_info->record_count; i++)
-				{
-					job_ids[i] = fsd_asprintf( "%d", job_info->job_array[i].job_id);
-
-					job = slurmdrmaa_job_new( fsd_strdup(job_ids[i]) );
-					job->session = self;
-					job->submit_time = time(NULL);
-					self->jobs->add( self->jobs, job );
-					job->release( job );
-					job = NULL;
-				}
-			} else  {
-				fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR,"slurm_load_job: %s",slurm_strerror(slurm_get_errno()));
-			}
-		} else {
-			job_ids[0] = fsd_asprintf( "%d", submit_response->job_id); /* .0*/
-
-			job = slurmdrmaa_job_new( fsd_strdup(job_ids[0]) ); /* TODO: ??? */
-			job->session = self;
-			job->submit_time = time(NULL);
-			self->jobs->add( self->jobs, job );
-			job->release( job );
-			job = NULL;
-		}
+		job_ids[0] = fsd_asprintf( "%d", submit_response->job_id); /* .0*/
+
+		job = slurmdrmaa_job_new( fsd_strdup(job_ids[0]) ); /* TODO: ??? */
+		job->session = self;
+		job->submit_time = time(NULL);
+		self->jobs->add( self->jobs, job );
+		job->release( job );
+		job = NULL;
+		fsd_metric_add( FSD_METRIC_JOBS_SUBMITTED, 1 );
 	 }
 	 ELSE
 	{
 		if ( !connection_lock )
-			connection_lock = fsd_mutex_lock( &self->drm_connection_mutex );
+			connection_lock = fsd_metric_lock( &self->drm_connection_mutex, FSD_METRIC_DRM_LOCK_WAIT );
 
 		slurm_free_submit_response_response_msg ( submit_response );
 	}
@@ -178,10 +315,761 @@ slurmdrmaa_session_run_bulk(
 			fsd_free_vector( job_ids );
 			
 		slurmdrmaa_free_job_desc(&job_desc);
+		FSD_PROBE1( submit_end, 1 );
+	 }
+	END_TRY
+
+	return fsd_iter_new( job_ids, 1 );
+}
+
+
+/* sets SLURM_DRMAA_BULK_OFFSET replacing value taken from environment of submission host */
+static void
+slurmdrmaa_set_bulk_offset( job_desc_msg_t *job_desc, uint32_t offset )
+{
+	static const char name[] = "SLURM_DRMAA_BULK_OFFSET=";
+	char *value;
+	uint32_t i;
+
+	for( i = 0;  i < job_desc->env_size;  i++ )
+		if( strncmp( job_desc->environment[i], name, sizeof(name)-1 ) == 0 )
+			break;
+
+	if( i == job_desc->env_size )
+	 {
+		fsd_realloc( job_desc->environment, job_desc->env_size+2, char * );
+		job_desc->environment[ i ] = NULL;
+		job_desc->environment[ i+1 ] = NULL;
+		job_desc->env_size++;
+	 }
+	value = fsd_asprintf( "%s%u", name, offset );
+	fsd_free( job_desc->environment[i] );
+	job_desc->environment[i] = value;
+}
+
+/*
+ * Submit bulk job as job array(s).  When indices exceed array limits
+ * of controller they are split into decimal blocks of size block -
+ * each block is submitted as separate job array with task ids
+ * index % block.  Job records of tasks are created lazily by job set.
+ * Tasks get SLURM_DRMAA_BULK_OFFSET in their environment (start of
+ * their block, 0 when bulk job was not split) so bulk index of task
+ * is SLURM_DRMAA_BULK_OFFSET + SLURM_ARRAY_TASK_ID.
+ */
+fsd_iter_t *
+slurmdrmaa_session_run_array(
+		fsd_drmaa_session_t *self,
+		const fsd_template_t *jt,
+		uint32_t first, uint32_t last, uint32_t incr, uint32_t block )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self->jobs;
+	fsd_iter_t *volatile job_ids = NULL;
+	fsd_expand_drmaa_ph_t *volatile expand = NULL;
+	fsd_environ_t *volatile env = NULL;
+	uint32_t *volatile array_job_ids = NULL;
+	volatile unsigned n_arrays = 0;
+	volatile bool connection_lock = false;
+	volatile bool job_desc_valid = false;
+	job_desc_msg_t job_desc;
+	submit_response_msg_t *submit_response = NULL;
+	unsigned digits = 0;
+	int rc;
+	uint32_t i;
+
+	for( i = block;  i > 1;  i /= 10 )
+		digits++;
+
+	if( block <= last )
+		fsd_log_info(( "splitting bulk job %u-%u:%u into job arrays of at most %u tasks",
+				first, last, incr, block ));
+
+	TRY
+	 {
+		uint32_t index = first;
+
+		job_ids = fsd_iter_new_range();
+
+		while( index <= last )
+		 {
+			uint32_t prefix = index / block;
+			uint32_t chunk_last = prefix * block + (block - 1);
+			uint32_t task_first, task_last;
+			char *array_prefix = NULL;
+
+			if( chunk_last > last )
+				chunk_last = last;
+			chunk_last = index + (chunk_last - index) / incr * incr;
+			task_first = index - prefix * block;
+			task_last = chunk_last - prefix * block;
+
+			slurm_init_job_desc_msg( &job_desc );
+			job_desc_valid = true;
+			if( task_first == task_last )
+				job_desc.array_inx = fsd_asprintf( "%u", task_first );
+			else
+				job_desc.array_inx = fsd_asprintf( "%u-%u:%u", task_first, task_last, incr );
+
+			if( prefix == 0 )
+				expand = fsd_expand_drmaa_ph_new( NULL, NULL, fsd_strdup("%a") );
+			else if( digits > 0 )
+				expand = fsd_expand_drmaa_ph_new( NULL, NULL, fsd_asprintf("%u%%%ua", prefix, digits) );
+			else
+				expand = fsd_expand_drmaa_ph_new( NULL, NULL, fsd_asprintf("%u", prefix) );
+			slurmdrmaa_job_create( self, jt, (fsd_environ_t**)&env, expand, &job_desc );
+			expand->destroy( expand );
+			expand = NULL;
+			slurmdrmaa_set_bulk_offset( &job_desc, prefix * block );
+
+			fsd_realloc( array_job_ids, n_arrays + 1, uint32_t );
+
+			SLURMDRMAA_RPC( &slurm_self->admission, &self->drm_connection_mutex, slurmdrmaa_is_undelivered_error, rc,
+					FSD_METRIC_TIME( slurmdrmaa_metrics.submit_batch_job, rc = slurm_submit_batch_job( &job_desc, &submit_response ) ) );
+			if( rc )
+				fsd_exc_raise_fmt(
+						FSD_ERRNO_INTERNAL_ERROR,"slurm_submit_batch_job: %s",slurm_strerror(slurm_get_errno()));
+			array_job_ids[ n_arrays++ ] = submit_response->job_id;
+			slurm_free_submit_response_response_msg( submit_response );
+			submit_response = NULL;
+
+			fsd_log_debug(( "job %u submitted (bulk indices %u-%u)",
+					array_job_ids[ n_arrays-1 ], index, chunk_last ));
+
+			slurmdrmaa_free_job_desc( &job_desc );
+			job_desc_valid = false;
+
+			set->add_array( set, array_job_ids[ n_arrays-1 ], task_first, task_last, incr );
+			fsd_metric_add( FSD_METRIC_JOBS_SUBMITTED, (task_last - task_first) / incr + 1 );
+			array_prefix = fsd_asprintf( "%u_", array_job_ids[ n_arrays-1 ] );
+			TRY
+			 { fsd_iter_append_range( job_ids, array_prefix, task_first, task_last, incr ); }
+			FINALLY
+			 { fsd_free( array_prefix ); }
+			END_TRY
+
+			if( last - chunk_last < incr )
+				break;
+			index = chunk_last + incr;
+		 }
+	 }
+	EXCEPT_DEFAULT
+	 {
+		unsigned a;
+
+		if( !connection_lock )
+			connection_lock = fsd_metric_lock( &self->drm_connection_mutex, FSD_METRIC_DRM_LOCK_WAIT );
+
+		/* bulk submission is all or nothing */
+		for( a = 0;  a < n_arrays;  a++ )
+		 {
+			fsd_log_warning(( "cancelling job %u of failed bulk submission", array_job_ids[a] ));
+			if( slurm_kill_job( array_job_ids[a], SIGKILL, 0 ) == -1 )
+				fsd_log_error(( "slurm_kill_job: %s", slurm_strerror(slurm_get_errno()) ));
+		 }
+
+		if( submit_response )
+			slurm_free_submit_response_response_msg( submit_response );
+
+		if( job_ids )
+			job_ids->destroy( job_ids );
+
+		fsd_exc_reraise();
+	 }
+	FINALLY
+	 {
+		if( connection_lock )
+			fsd_mutex_unlock( &self->drm_connection_mutex );
+
+		if( expand )
+			expand->destroy( expand );
+
+		if( job_desc_valid )
+			slurmdrmaa_free_job_desc( &job_desc );
+
+		fsd_free( array_job_ids );
+	 }
+	END_TRY
+
+	return job_ids;
+}
+
+
+void
+slurmdrmaa_session_load_array_limits( slurmdrmaa_session_t *self )
+{
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(20,11,0)
+	slurm_conf_t *conf = NULL;
+#else
+	slurm_ctl_conf_t *conf = NULL;
+#endif
+	bool connection_lock = false;
+
+	connection_lock = fsd_metric_lock( &self->super.drm_connection_mutex, FSD_METRIC_DRM_LOCK_WAIT );
+
+	if( !self->array_limits_loaded )
+	 {
+		if( slurm_load_ctl_conf( (time_t) NULL, &conf ) == -1 )
+			fsd_log_error(( "slurm_load_ctl_conf error: %s", slurm_strerror(slurm_get_errno()) ));
+		else
+		 {
+			const char *max_array_tasks = NULL;
+
+			self->max_array_size = conf->max_array_sz;
+			if( conf->sched_params )
+				max_array_tasks = strstr( conf->sched_params, "max_array_tasks=" );
+			if( max_array_tasks )
+				self->max_array_tasks = strtoul( max_array_tasks + strlen("max_array_tasks="), NULL, 10 );
+
+			fsd_log_debug(( "MaxArraySize=%u max_array_tasks=%u",
+					self->max_array_size, self->max_array_tasks ));
+			slurm_free_ctl_conf( conf );
+		 }
+		/* do not retry on every submission when controller is unreachable */
+		self->array_limits_loaded = true;
+	 }
+
+	if( connection_lock )
+		fsd_mutex_unlock( &self->super.drm_connection_mutex );
+}
+
+
+/*
+ * Refresh all jobs tagged with session tag using single query
+ * for all jobs of user.  Returns false when query failed.
+ */
+static bool
+slurmdrmaa_session_refresh_tagged( fsd_drmaa_session_t *self )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self->jobs;
+	uint32_t *volatile array_job_ids = NULL;
+	bool *volatile array_seen = NULL;
+	job_info_msg_t *volatile job_info = NULL;
+	volatile bool refreshed = false;
+
+	TRY
+	 {
+		unsigned n_arrays = 0, i;
+		uint32_t r;
+		int rc;
+
+		SLURMDRMAA_RPC( &slurm_self->admission, &self->drm_connection_mutex, slurmdrmaa_is_transient_error, rc,
+				FSD_METRIC_TIME( slurmdrmaa_metrics.load_job_user, rc = slurm_load_job_user( (job_info_msg_t**)&job_info, getuid(), SHOW_ALL ) ) );
+		if( rc )
+			fsd_log_error(( "slurm_load_job_user: %s", slurm_strerror(slurm_get_errno()) ));
+
+		if( job_info != NULL )
+		 {
+			array_job_ids = set->get_array_job_ids( set );
+			while( array_job_ids[n_arrays] )
+				n_arrays++;
+			fsd_calloc( array_seen, n_arrays + 1, bool );
+
+			for( r = 0;  r < job_info->record_count;  r++ )
+			 {
+				slurm_job_info_t *info = &job_info->job_array[r];
+				fsd_job_t *volatile job = NULL;
+				char job_id[32];
+
+				if( !slurmdrmaa_session_is_tagged( self, info ) )
+					continue;
+
+				for( i = 0;  i < n_arrays;  i++ )
+					if( array_job_ids[i] == info->array_job_id )
+						array_seen[i] = true;
+
+				if( info->array_task_id != NO_VAL )
+				 {
+					fsd_snprintf( NULL, job_id, sizeof(job_id), "%u_%u",
+							info->array_job_id, info->array_task_id );
+					/* task reported separately gets job record */
+					job = self->jobs->get( self->jobs, job_id );
+				 }
+				else if( info->array_task_str == NULL )
+				 {
+					fsd_snprintf( NULL, job_id, sizeof(job_id), "%u", info->job_id );
+					job = set->super_get( self->jobs, job_id );
+				 }
+
+				if( job )
+				 {
+					TRY
+					 { slurmdrmaa_job_update_from_info( job, info ); }
+					FINALLY
+					 { job->release( job ); }
+					END_TRY
+				 }
+			 }
+
+			/* whole array is gone - let on_missing decide */
+			for( i = 0;  i < n_arrays;  i++ )
+				if( !array_seen[i] )
+					set->missing_array( set, array_job_ids[i] );
+
+			refreshed = true;
+		 }
+	 }
+	FINALLY
+	 {
+		if( job_info )
+			slurm_free_job_info_msg( job_info );
+		fsd_free( array_job_ids );
+		fsd_free( array_seen );
+	 }
+	END_TRY
+
+	return refreshed;
+}
+
+
+/* Number of job records and arrays kept in compact form. */
+static unsigned
+slurmdrmaa_session_n_tracked( fsd_drmaa_session_t *self )
+{
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self->jobs;
+	uint32_t *array_job_ids = NULL;
+	unsigned n = 0;
+
+	array_job_ids = set->get_array_job_ids( set );
+	while( array_job_ids[n] )
+		n++;
+	fsd_free( array_job_ids );
+
+	fsd_mutex_lock( &self->jobs->mutex );
+	n += self->jobs->n_jobs;
+	fsd_mutex_unlock( &self->jobs->mutex );
+	return n;
+}
+
+
+/*
+ * Tasks of job arrays get job records once slurmctld reports them
+ * as separate job records (i.e. they left pending state)
+ * or the whole array is gone.  Records of tasks returned by array
+ * query are applied right away.  With session tagging enabled (and more
+ * than one job) all jobs are refreshed with single query of all jobs of
+ * user.  Only jobs not found in
+ * replies are queried one by one.
+ */
+void
+slurmdrmaa_session_update_all_jobs_status( fsd_drmaa_session_t *self )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self->jobs;
+	uint32_t *volatile array_job_ids = NULL;
+	char **volatile job_ids = NULL;
+	job_info_msg_t *volatile job_info = NULL;
+	time_t poll_start = time(NULL);
+	bool refreshed = false;
+	volatile unsigned n_touched = 0;
+	struct timespec cycle_start;
+
+	fsd_log_enter(( "" ));
+	fsd_metric_start( &cycle_start );
+
+	/* query of all jobs of user pays off only for more than one job */
+	if( slurm_self->tag_field != SLURMDRMAA_TAG_NONE
+			&&  slurmdrmaa_session_n_tracked( self ) > 1 )
+		refreshed = slurmdrmaa_session_refresh_tagged( self );
+
+	TRY
+	 {
+		const char **i;
+		uint32_t *a;
+
+		if( refreshed )
+			array_job_ids = NULL;
+		else
+			array_job_ids = set->get_array_job_ids( set );
+		for( a = array_job_ids;  a != NULL && *a;  a++ )
+		 {
+			int _slurm_errno = 0;
+			int rc;
+
+			SLURMDRMAA_RPC( &slurm_self->admission, &self->drm_connection_mutex, slurmdrmaa_is_transient_error, rc,
+					FSD_METRIC_TIME( slurmdrmaa_metrics.load_job, rc = slurm_load_job( (job_info_msg_t**)&job_info, *a, SHOW_ALL ) ) );
+			if( rc )
+				_slurm_errno = slurm_get_errno();
+
+			if( job_info )
+			 {
+				uint32_t r;
+				for( r = 0;  r < job_info->record_count;  r++ )
+				 {
+					slurm_job_info_t *info = &job_info->job_array[r];
+					fsd_job_t *volatile job = NULL;
+					char job_id[32];
+
+					if( info->array_job_id != *a  ||  info->array_task_id == NO_VAL )
+						continue;
+					fsd_snprintf( NULL, job_id, sizeof(job_id), "%u_%u",
+							info->array_job_id, info->array_task_id );
+					/* task reported separately gets job record */
+					job = self->jobs->get( self->jobs, job_id );
+					if( job )
+					 {
+						TRY
+						 { slurmdrmaa_job_update_from_info( job, info ); }
+						FINALLY
+						 { job->release( job ); }
+						END_TRY
+					 }
+				 }
+				slurm_free_job_info_msg( job_info );
+				job_info = NULL;
+			 }
+			else if( _slurm_errno == ESLURM_INVALID_JOB_ID )
+				set->missing_array( set, *a ); /* let on_missing decide */
+			else
+				fsd_log_error(( "slurm_load_job(%u): %s", *a, slurm_strerror(_slurm_errno) ));
+		 }
+
+		job_ids = set->super_get_all_job_ids( self->jobs );
+		for( i = (const char **)job_ids;  *i;  i++ )
+		 {
+			fsd_job_t *volatile job = NULL;
+			TRY
+			 {
+				job = self->get_job( self, *i );
+				if( job )
+					n_touched++;
+				/* jobs updated above from array or tagged records are fresh */
+				if( job  &&  job->last_update_time < poll_start )
+					job->update_status( job );
+			 }
+			FINALLY
+			 {
+				if( job )
+					job->release( job );
+			 }
+			END_TRY
+		 }
+	 }
+	FINALLY
+	 {
+		if( job_info )
+			slurm_free_job_info_msg( job_info );
+		fsd_free( array_job_ids );
+		fsd_free_vector( job_ids );
+		fsd_metric_observe_since( FSD_METRIC_POLL_CYCLE, &cycle_start );
+		fsd_metric_observe( FSD_METRIC_POLL_JOBS, n_touched );
 	 }
 	END_TRY
+	fsd_log_return(( "" ));
+}
+
+
+/*
+ * Jobs which cached state is still valid are answered from cache.
+ * When more than one job is stale all jobs of user are loaded with single
+ * query and only jobs missing there are queried one by one.
+ */
+void
+slurmdrmaa_session_job_ps_multi( fsd_drmaa_session_t *self, const char **job_ids, int *remote_ps )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+	bool *volatile stale = NULL;
+	slurm_job_info_t **volatile index = NULL;
+	job_info_msg_t *volatile job_info = NULL;
 
-	return fsd_iter_new( job_ids, n_jobs );
+	fsd_log_enter(( "" ));
+	TRY
+	 {
+		size_t n_jobs = 0, n_stale = 0, i;
+		time_t now = time(NULL);
+
+		while( job_ids[n_jobs] != NULL )
+			n_jobs++;
+		fsd_calloc( stale, n_jobs + 1, bool );
+
+		for( i = 0;  i < n_jobs;  i++ )
+		 {
+			fsd_job_t *volatile job = NULL;
+			TRY
+			 {
+				job = self->get_job( self, job_ids[i] );
+				if( job != NULL  &&  now - job->last_update_time < self->cache_job_state
+						&&  job->state != DRMAA_PS_UNDETERMINED )
+					remote_ps[i] = job->state;
+				else if( job != NULL  &&  slurmdrmaa_job_update_from_cache( job ) )
+					remote_ps[i] = job->state;
+				else
+				 {
+					stale[i] = true;
+					n_stale++;
+				 }
+			 }
+			FINALLY
+			 {
+				if( job )
+					job->release( job );
+			 }
+			END_TRY
+		 }
+
+		if( n_stale > 1 )
+		 {
+			int rc;
+
+			SLURMDRMAA_RPC( &slurm_self->admission, &self->drm_connection_mutex, slurmdrmaa_is_transient_error, rc,
+					FSD_METRIC_TIME( slurmdrmaa_metrics.load_job_user, rc = slurm_load_job_user( (job_info_msg_t**)&job_info, getuid(), SHOW_ALL ) ) );
+			if( rc )
+				fsd_log_error(( "slurm_load_job_user: %s", slurm_strerror(slurm_get_errno()) ));
+
+			if( job_info != NULL )
+				index = slurmdrmaa_index_job_info( job_info );
+		 }
+
+		for( i = 0;  i < n_jobs;  i++ )
+		 {
+			fsd_job_t *volatile job = NULL;
+
+			if( !stale[i] )
+				continue;
+			TRY
+			 {
+				slurm_job_info_t *info = NULL;
+
+				job = self->get_job( self, job_ids[i] );
+				if( job == NULL )
+				 {
+					fsd_log_info(( "job_ps_multi: recreating job object: %s", job_ids[i] ));
+					job = self->new_job( self, job_ids[i] );
+				 }
+				if( index != NULL )
+					info = slurmdrmaa_lookup_job_info( index, job_info->record_count, job_ids[i] );
+				if( info != NULL )
+					slurmdrmaa_job_update_from_info( job, info );
+				else
+				 {
+					job->update_status( job );
+					job->last_update_time = time(NULL);
+				 }
+				remote_ps[i] = job->state;
+			 }
+			FINALLY
+			 {
+				if( job )
+					job->release( job );
+			 }
+			END_TRY
+		 }
+	 }
+	FINALLY
+	 {
+		fsd_free( index );
+		if( job_info )
+			slurm_free_job_info_msg( job_info );
+		fsd_free( stale );
+	 }
+	END_TRY
+	fsd_log_return(( "" ));
+}
+
+
+/* Add (or refresh) job with state from info (queried separately when NULL). */
+static bool
+slurmdrmaa_session_adopt_job( fsd_drmaa_session_t *self, const char *job_id, slurm_job_info_t *info )
+{
+	fsd_job_t *volatile job = NULL;
+	volatile bool adopted = false;
+
+	TRY
+	 {
+		job = self->jobs->get( self->jobs, job_id );
+		if( job == NULL )
+		 {
+			job = self->new_job( self, job_id );
+			adopted = true;
+		 }
+		if( info != NULL )
+			slurmdrmaa_job_update_from_info( job, info );
+		else
+			job->update_status( job );
+		if( adopted )
+			self->jobs->add( self->jobs, job );
+	 }
+	FINALLY
+	 {
+		if( job )
+			job->release( job );
+	 }
+	END_TRY
+
+	return adopted;
+}
+
+
+typedef struct {
+	slurmdrmaa_job_set_t *set;
+	uint32_t array_job_id;
+	size_t n_tasks;
+} slurmdrmaa_adopt_array_t;
+
+static bool
+slurmdrmaa_session_adopt_range( uint32_t first, uint32_t last, uint32_t step, void *arg )
+{
+	slurmdrmaa_adopt_array_t *a = (slurmdrmaa_adopt_array_t*)arg;
+	a->set->add_array( a->set, a->array_job_id, first, last, step );
+	a->n_tasks += (last - first) / step + 1;
+	return false;
+}
+
+
+/*
+ * All jobs of user are loaded with single query.  Pending tasks of job
+ * arrays (still described by single record) are adopted in compact form.
+ */
+size_t
+slurmdrmaa_session_adopt_jobs( fsd_drmaa_session_t *self, const char **job_ids, bool session_only )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+	slurmdrmaa_job_set_t *set = (slurmdrmaa_job_set_t*)self->jobs;
+	job_info_msg_t *volatile job_info = NULL;
+	slurm_job_info_t **volatile index = NULL;
+	uint32_t *volatile array_job_ids = NULL;
+	volatile size_t n_adopted = 0;
+
+	fsd_log_enter(( "(job_ids=%s, session_only=%d)",
+				job_ids ? "{...}" : "(null)", (int)session_only ));
+	if( job_ids == NULL  &&  session_only  &&  slurm_self->tag_field == SLURMDRMAA_TAG_NONE )
+		fsd_exc_raise_msg( FSD_ERRNO_INVALID_ARGUMENT,
+				"jobs of session can not be told without session_tag" );
+	TRY
+	 {
+		int rc;
+
+		SLURMDRMAA_RPC( &slurm_self->admission, &self->drm_connection_mutex, slurmdrmaa_is_transient_error, rc,
+				FSD_METRIC_TIME( slurmdrmaa_metrics.load_job_user, rc = slurm_load_job_user( (job_info_msg_t**)&job_info, getuid(), SHOW_ALL ) ) );
+		if( rc )
+			fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR, "slurm_load_job_user: %s",
+					slurm_strerror(slurm_get_errno()) );
+
+		if( job_ids != NULL )
+		 {
+			const char **i;
+			index = slurmdrmaa_index_job_info( job_info );
+			for( i = job_ids;  *i != NULL;  i++ )
+				if( slurmdrmaa_session_adopt_job( self, *i,
+							slurmdrmaa_lookup_job_info( index, job_info->record_count, *i ) ) )
+					n_adopted++;
+		 }
+		else
+		 {
+			uint32_t r;
+
+			array_job_ids = set->get_array_job_ids( set );
+			for( r = 0;  r < job_info->record_count;  r++ )
+			 {
+				slurm_job_info_t *info = &job_info->job_array[r];
+				char job_id[32];
+
+				if( session_only  &&  !slurmdrmaa_session_is_tagged( self, info ) )
+					continue;
+
+				if( info->array_task_id == NO_VAL  &&  info->array_task_str != NULL )
+				 {
+					slurmdrmaa_adopt_array_t a;
+					uint32_t *known;
+
+					for( known = array_job_ids;  *known;  known++ )
+						if( *known == info->array_job_id )
+							break;
+					if( *known )
+						continue; /* already tracked in compact form */
+					a.set = set;
+					a.array_job_id = info->array_job_id;
+					a.n_tasks = 0;
+					slurmdrmaa_array_task_str_foreach( info->array_task_str,
+							slurmdrmaa_session_adopt_range, &a );
+					n_adopted += a.n_tasks;
+					continue;
+				 }
+
+				if( info->array_task_id != NO_VAL )
+					fsd_snprintf( NULL, job_id, sizeof(job_id), "%u_%u",
+							info->array_job_id, info->array_task_id );
+				else
+					fsd_snprintf( NULL, job_id, sizeof(job_id), "%u", info->job_id );
+				if( slurmdrmaa_session_adopt_job( self, job_id, info ) )
+					n_adopted++;
+			 }
+		 }
+	 }
+	FINALLY
+	 {
+		fsd_free( index );
+		if( job_info )
+			slurm_free_job_info_msg( job_info );
+		fsd_free( array_job_ids );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%u", (unsigned)n_adopted ));
+	return n_adopted;
+}
+
+
+void
+slurmdrmaa_session_tag_job( fsd_drmaa_session_t *self, job_desc_msg_t *job_desc )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+
+	switch( slurm_self->tag_field )
+	 {
+		case SLURMDRMAA_TAG_COMMENT:
+			if( job_desc->comment == NULL )
+				job_desc->comment = fsd_strdup( slurm_self->session_tag );
+			else
+			 {
+				char *comment = job_desc->comment;
+				job_desc->comment = fsd_asprintf( "%s %s", comment, slurm_self->session_tag );
+				fsd_free( comment );
+			 }
+			break;
+		case SLURMDRMAA_TAG_WCKEY:
+			/* wckey is used for accounting - never replace one given by user */
+			if( job_desc->wckey != NULL )
+				fsd_exc_raise_msg( FSD_DRMAA_ERRNO_INVALID_ATTRIBUTE_VALUE,
+						"--wckey can not be given in native specification "
+						"when session_tag is 'wckey'" );
+			job_desc->wckey = fsd_strdup( slurm_self->session_tag );
+			break;
+		case SLURMDRMAA_TAG_NONE:
+			break;
+	 }
+}
+
+
+bool
+slurmdrmaa_session_is_tagged( fsd_drmaa_session_t *self, const slurm_job_info_t *info )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+
+	switch( slurm_self->tag_field )
+	 {
+		case SLURMDRMAA_TAG_COMMENT:
+			return info->comment != NULL  &&  strstr( info->comment, slurm_self->session_tag ) != NULL;
+		case SLURMDRMAA_TAG_WCKEY:
+			/* wckey may be reported with '*' prefix (default wckey) */
+			return info->wckey != NULL  &&  strstr( info->wckey, slurm_self->session_tag ) != NULL;
+		default:
+			return false;
+	 }
+}
+
+
+void
+slurmdrmaa_session_control_job(
+		fsd_drmaa_session_t *self,
+		const char *job_id, int action )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+
+	if( !strcmp( job_id, DRMAA_JOB_IDS_SESSION_ALL ) )
+		slurmdrmaa_control_all( self, action );
+	else
+		slurm_self->super_control_job( self, job_id, action );
 }
 
 
@@ -193,3 +1081,193 @@ slurmdrmaa_session_new_job( fsd_drmaa_session_t *self, const char *job_id )
 	job->session = self;
 	return job;
 }
+
+
+/* Journal every observed state transition. */
+void
+slurmdrmaa_session_job_state_changed( fsd_drmaa_session_t *self, fsd_job_t *job, int previous_state )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+
+	if( job->state != previous_state )
+	 {
+		FSD_PROBE3( job_state, job->job_id, previous_state, job->state );
+		slurmdrmaa_journal_job( self, job );
+	 }
+	slurm_self->super_job_state_changed( self, job, previous_state );
+}
+
+
+void
+slurmdrmaa_session_apply_configuration( fsd_drmaa_session_t *self )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+	fsd_conf_option_t *coalesce_window = NULL;
+	fsd_conf_option_t *coalesce_max_tasks = NULL;
+	fsd_conf_option_t *session_tag = NULL;
+	fsd_conf_option_t *adopt_jobs = NULL;
+	fsd_conf_option_t *journal_dir = NULL;
+	fsd_conf_option_t *shared_cache_dir = NULL;
+	struct {
+		const char *name;
+		int *value;
+		int min;
+	} rpc_options[] = {
+		{ "rpc_rate_limit", &slurm_self->admission.rate, 0 },
+		{ "rpc_burst", &slurm_self->admission.burst, 1 },
+		{ "rpc_retries", &slurm_self->admission.max_retries, 0 },
+		{ "rpc_backoff_initial", &slurm_self->admission.backoff_initial, 0 },
+		{ "rpc_backoff_max", &slurm_self->admission.backoff_max, 0 },
+		{ "rpc_breaker_threshold", &slurm_self->admission.breaker_threshold, 0 },
+		{ "rpc_breaker_cooldown", &slurm_self->admission.breaker_cooldown, 0 },
+		{ NULL, NULL, 0 }
+	};
+	int i;
+
+	if( self->configuration != NULL )
+	 {
+		coalesce_window = fsd_conf_dict_get( self->configuration, "coalesce_window" );
+		coalesce_max_tasks = fsd_conf_dict_get( self->configuration, "coalesce_max_tasks" );
+		session_tag = fsd_conf_dict_get( self->configuration, "session_tag" );
+		adopt_jobs = fsd_conf_dict_get( self->configuration, "adopt_jobs" );
+		journal_dir = fsd_conf_dict_get( self->configuration, "journal_dir" );
+		shared_cache_dir = fsd_conf_dict_get( self->configuration, "shared_cache_dir" );
+	 }
+
+	if( coalesce_window )
+	 {
+		if( coalesce_window->type == FSD_CONF_INTEGER && coalesce_window->val.integer >= 0 )
+		 {
+			fsd_log_debug(("coalesce_window=%d ms", coalesce_window->val.integer));
+			slurm_self->coalesce_window.tv_sec = coalesce_window->val.integer / 1000;
+			slurm_self->coalesce_window.tv_nsec = (coalesce_window->val.integer % 1000) * 1000000;
+		 }
+		else
+			fsd_exc_raise_msg( FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'coalesce_window' must be nonnegative integer" );
+	 }
+	if( coalesce_max_tasks )
+	 {
+		if( coalesce_max_tasks->type == FSD_CONF_INTEGER && coalesce_max_tasks->val.integer > 0 )
+		 {
+			fsd_log_debug(("coalesce_max_tasks=%d", coalesce_max_tasks->val.integer));
+			slurm_self->coalesce_max_tasks = coalesce_max_tasks->val.integer;
+		 }
+		else
+			fsd_exc_raise_msg( FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'coalesce_max_tasks' must be positive integer" );
+	 }
+
+	if( adopt_jobs )
+	 {
+		if( adopt_jobs->type == FSD_CONF_STRING  &&  !strcmp( adopt_jobs->val.string, "session" ) )
+			slurm_self->adopt = SLURMDRMAA_ADOPT_SESSION;
+		else if( adopt_jobs->type == FSD_CONF_STRING  &&  !strcmp( adopt_jobs->val.string, "user" ) )
+			slurm_self->adopt = SLURMDRMAA_ADOPT_USER;
+		else if( adopt_jobs->type == FSD_CONF_STRING  &&  !strcmp( adopt_jobs->val.string, "none" ) )
+			slurm_self->adopt = SLURMDRMAA_ADOPT_NONE;
+		else
+			fsd_exc_raise_msg( FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'adopt_jobs' should be one of: "
+					"'session', 'user' or 'none'" );
+		fsd_log_debug(("adopt_jobs=%s", adopt_jobs->val.string));
+	 }
+
+	if( journal_dir )
+	 {
+		if( journal_dir->type == FSD_CONF_STRING )
+		 {
+			fsd_free( slurm_self->journal_dir );
+			slurm_self->journal_dir = fsd_strdup( journal_dir->val.string );
+			fsd_log_debug(("journal_dir=%s", slurm_self->journal_dir));
+		 }
+		else
+			fsd_exc_raise_msg( FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'journal_dir' should be string" );
+	 }
+
+	if( shared_cache_dir )
+	 {
+		if( shared_cache_dir->type == FSD_CONF_STRING )
+		 {
+			fsd_free( slurm_self->shared_cache_dir );
+			slurm_self->shared_cache_dir = fsd_strdup( shared_cache_dir->val.string );
+			fsd_log_debug(("shared_cache_dir=%s", slurm_self->shared_cache_dir));
+		 }
+		else
+			fsd_exc_raise_msg( FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'shared_cache_dir' should be string" );
+	 }
+
+	if( session_tag )
+	 {
+		bool ok = false;
+		if( session_tag->type == FSD_CONF_STRING )
+		 {
+			const char *value = session_tag->val.string;
+			ok = true;
+			if( !strcmp( value, "comment" ) )
+				slurm_self->tag_field = SLURMDRMAA_TAG_COMMENT;
+			else if( !strcmp( value, "wckey" ) )
+				slurm_self->tag_field = SLURMDRMAA_TAG_WCKEY;
+			else if( !strcmp( value, "none" ) )
+				slurm_self->tag_field = SLURMDRMAA_TAG_NONE;
+			else
+				ok = false;
+		 }
+		if( !ok )
+			fsd_exc_raise_msg( FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: 'session_tag' should be one of: "
+					"'comment', 'wckey' or 'none'" );
+		fsd_log_debug(("session_tag=%s", session_tag->val.string));
+	 }
+
+	/* without tags jobs of session can not be told from other jobs of user */
+	if( slurm_self->adopt == SLURMDRMAA_ADOPT_SESSION  &&  slurm_self->tag_field == SLURMDRMAA_TAG_NONE )
+		fsd_exc_raise_msg( FSD_ERRNO_INTERNAL_ERROR,
+				"configuration: 'adopt_jobs' set to 'session' requires 'session_tag'" );
+
+	for( i = 0;  self->configuration != NULL && rpc_options[i].name != NULL;  i++ )
+	 {
+		fsd_conf_option_t *value = fsd_conf_dict_get( self->configuration, rpc_options[i].name );
+		if( value == NULL )
+			continue;
+		if( value->type == FSD_CONF_INTEGER && value->val.integer >= rpc_options[i].min )
+		 {
+			fsd_log_debug(("%s=%d", rpc_options[i].name, value->val.integer));
+			*rpc_options[i].value = value->val.integer;
+		 }
+		else
+			fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR,
+					"configuration: '%s' must be %s integer", rpc_options[i].name,
+					rpc_options[i].min > 0 ? "positive" : "nonnegative" );
+	 }
+	if( slurm_self->admission.tokens > slurm_self->admission.burst )
+		slurm_self->admission.tokens = slurm_self->admission.burst;
+
+	slurm_self->super_apply_configuration( self );
+}
+
+
+void
+slurmdrmaa_session_destroy_nowait( fsd_drmaa_session_t *self )
+{
+	slurmdrmaa_session_t *slurm_self = (slurmdrmaa_session_t*)self;
+
+	if( slurm_self->journal != NULL )
+	 {
+		slurmdrmaa_journal_close( slurm_self->journal );
+		slurm_self->journal = NULL;
+	 }
+	if( slurm_self->shared_cache != NULL )
+	 {
+		slurmdrmaa_shcache_close( slurm_self->shared_cache );
+		slurm_self->shared_cache = NULL;
+	 }
+	fsd_mutex_destroy( &slurm_self->coalesce_mutex );
+	slurmdrmaa_admission_destroy( &slurm_self->admission );
+	fsd_free( slurm_self->session_tag );
+	fsd_free( slurm_self->journal_dir );
+	fsd_free( slurm_self->shared_cache_dir );
+	slurm_self->super_destroy_nowait( self );
+}
@@ -25,13 +25,79 @@
 #endif
 
 #include <drmaa_utils/session.h>
+#include <slurm_drmaa/admission.h>
+#include <slurm_drmaa/coalesce.h>
+#include <slurm_drmaa/journal.h>
+#include <slurm_drmaa/shcache.h>
+
+#include <slurm/slurm.h>
 
 typedef struct slurmdrmaa_session_s slurmdrmaa_session_t;
 
 fsd_drmaa_session_t *slurmdrmaa_session_new( const char *contact );
 
+/* job field carrying session tag */
+typedef enum {
+	SLURMDRMAA_TAG_NONE,
+	SLURMDRMAA_TAG_COMMENT,
+	SLURMDRMAA_TAG_WCKEY
+} slurmdrmaa_tag_field_t;
+
+/* Stamp job request with tag of session. */
+void slurmdrmaa_session_tag_job( fsd_drmaa_session_t *self, job_desc_msg_t *job_desc );
+
+/* Whether job was submitted from session with the same tag. */
+bool slurmdrmaa_session_is_tagged( fsd_drmaa_session_t *self, const slurm_job_info_t *info );
+
+/* Load array limits of slurmctld (once per session). */
+void slurmdrmaa_session_load_array_limits( slurmdrmaa_session_t *self );
+
+/* jobs adopted at drmaa_init() */
+typedef enum {
+	SLURMDRMAA_ADOPT_NONE,
+	SLURMDRMAA_ADOPT_SESSION, /* jobs tagged by session with the same contact */
+	SLURMDRMAA_ADOPT_USER /* all jobs of user */
+} slurmdrmaa_adopt_t;
+
 struct slurmdrmaa_session_s {
 	fsd_drmaa_session_t super;
+
+	void (*super_apply_configuration)( fsd_drmaa_session_t *self );
+	void (*super_destroy_nowait)( fsd_drmaa_session_t *self );
+	void (*super_control_job)( fsd_drmaa_session_t *self, const char *job_id, int action );
+	void (*super_job_state_changed)( fsd_drmaa_session_t *self, fsd_job_t *job, int previous_state );
+
+	/* how long single submissions are collected into one job array (0 - disabled) */
+	struct timespec coalesce_window;
+	/* maximal number of jobs packed into one job array */
+	int coalesce_max_tasks;
+	/* batches still accepting jobs */
+	slurmdrmaa_coalesce_batch_t *coalesce_batches;
+	fsd_mutex_t coalesce_mutex;
+
+	/* MaxArraySize and max_array_tasks of slurmctld (0 - unknown),
+	   loaded on first bulk or coalesced submission */
+	uint32_t max_array_size;
+	uint32_t max_array_tasks;
+	bool array_limits_loaded;
+
+	/* rate limit, retries and circuit breaker of slurmctld RPCs */
+	slurmdrmaa_admission_t admission;
+
+	/* tag stamped on every job of session (derived from contact
+	   so reopened session finds its jobs) */
+	char *session_tag;
+	slurmdrmaa_tag_field_t tag_field;
+
+	slurmdrmaa_adopt_t adopt;
+
+	/* directory of session journal (NULL - journaling disabled) */
+	char *journal_dir;
+	slurmdrmaa_journal_t *journal;
+
+	/* job states shared with other processes of user (NULL - disabled) */
+	char *shared_cache_dir;
+	slurmdrmaa_shcache_t *shared_cache;
 };
 
 #endif /* __SLURM_DRMAA__SESSION_H */
@@ -0,0 +1,357 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <drmaa_utils/common.h>
+#include <drmaa_utils/exception.h>
+#include <drmaa_utils/logging.h>
+#include <slurm_drmaa/shcache.h>
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+#define SLURMDRMAA_SHCACHE_MAGIC "SDRMSHC"
+#define SLURMDRMAA_SHCACHE_VERSION 2
+#define SLURMDRMAA_SHCACHE_SLOTS 65536 /* power of 2 */
+#define SLURMDRMAA_SHCACHE_MAX_PROBE 16
+#define SLURMDRMAA_SHCACHE_ID_LEN 36
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t n_slots;
+} slurmdrmaa_shcache_header_t;
+
+typedef struct {
+	/* odd while slot is being written */
+	volatile uint32_t seq;
+	/* pid of writer (0 - none); slot of dead writer is taken over */
+	volatile int32_t owner;
+	uint32_t hash; /* 0 - empty slot */
+	int32_t state;
+	int32_t exit_status;
+	int64_t update_time;
+	char job_id[SLURMDRMAA_SHCACHE_ID_LEN];
+} slurmdrmaa_shcache_slot_t;
+
+struct slurmdrmaa_shcache_s {
+	char *path;
+	void *base;
+	size_t size;
+	slurmdrmaa_shcache_slot_t *slots;
+	uint32_t mask;
+};
+
+
+static uint32_t
+slurmdrmaa_shcache_hash( const char *job_id )
+{
+	uint32_t h = 2166136261u;
+	while( *job_id )
+	 {
+		h ^= (unsigned char)*job_id++;
+		h *= 16777619u;
+	 }
+	return h != 0 ? h : 1;
+}
+
+
+/* Consistent copy of slot.  Returns false when slot is being written. */
+static bool
+slurmdrmaa_shcache_read_slot( const slurmdrmaa_shcache_slot_t *slot, slurmdrmaa_shcache_slot_t *copy )
+{
+	int tries;
+
+	for( tries = 0;  tries < 8;  tries++ )
+	 {
+		uint32_t seq = slot->seq;
+		if( seq & 1 )
+			continue;
+		__sync_synchronize();
+		memcpy( copy, (const void*)slot, sizeof(slurmdrmaa_shcache_slot_t) );
+		__sync_synchronize();
+		if( slot->seq == seq )
+			return true;
+	 }
+	return false;
+}
+
+
+/* Slot was left in the middle of update by process which died. */
+static bool
+slurmdrmaa_shcache_abandoned( const slurmdrmaa_shcache_slot_t *slot )
+{
+	int32_t owner = slot->owner;
+	return owner != 0  &&  kill( (pid_t)owner, 0 ) == -1  &&  errno == ESRCH;
+}
+
+
+/*
+ * Take slot for writing (and make its sequence odd).  Returns false
+ * when other live process writes it.
+ */
+static bool
+slurmdrmaa_shcache_claim( slurmdrmaa_shcache_slot_t *slot )
+{
+	int32_t self = (int32_t)getpid();
+	int32_t owner = slot->owner;
+	uint32_t seq;
+
+	if( owner != 0 )
+	 {
+		if( !slurmdrmaa_shcache_abandoned( slot )
+				||  !__sync_bool_compare_and_swap( &slot->owner, owner, self ) )
+			return false;
+	 }
+	else if( !__sync_bool_compare_and_swap( &slot->owner, 0, self ) )
+		return false;
+
+	seq = slot->seq;
+	if( !(seq & 1) ) /* odd when taken over from dead writer */
+		slot->seq = seq + 1;
+	__sync_synchronize();
+	return true;
+}
+
+
+/*
+ * Create fully initialized table under temporary name and link it
+ * in place, so concurrent openers never see partial header.
+ */
+static void
+slurmdrmaa_shcache_create( const char *path )
+{
+	char *volatile tmp_path = NULL;
+	volatile int fd = -1;
+
+	TRY
+	 {
+		slurmdrmaa_shcache_header_t header;
+		size_t size = sizeof(slurmdrmaa_shcache_slot_t)
+				* (SLURMDRMAA_SHCACHE_SLOTS + 1);
+
+		tmp_path = fsd_asprintf( "%s.%d", path, (int)getpid() );
+		fd = open( tmp_path, O_RDWR | O_CREAT | O_EXCL, 0600 );
+		if( fd == -1 )
+			fsd_exc_raise_sys( 0 );
+		if( ftruncate( fd, (off_t)size ) == -1 )
+			fsd_exc_raise_sys( 0 );
+		memset( &header, 0, sizeof(header) );
+		memcpy( header.magic, SLURMDRMAA_SHCACHE_MAGIC, sizeof(SLURMDRMAA_SHCACHE_MAGIC) );
+		header.version = SLURMDRMAA_SHCACHE_VERSION;
+		header.n_slots = SLURMDRMAA_SHCACHE_SLOTS;
+		if( write( fd, &header, sizeof(header) ) != (ssize_t)sizeof(header) )
+			fsd_exc_raise_sys( 0 );
+		if( link( tmp_path, path ) == -1  &&  errno != EEXIST )
+			fsd_exc_raise_sys( 0 );
+	 }
+	FINALLY
+	 {
+		if( fd != -1 )
+		 {
+			close( fd );
+			unlink( tmp_path );
+		 }
+		fsd_free( tmp_path );
+	 }
+	END_TRY
+}
+
+
+slurmdrmaa_shcache_t *
+slurmdrmaa_shcache_open( const char *cache_dir )
+{
+	slurmdrmaa_shcache_t *volatile self = NULL;
+	volatile int fd = -1;
+
+	fsd_log_enter(( "(%s)", cache_dir ));
+	TRY
+	 {
+		const slurmdrmaa_shcache_header_t *header = NULL;
+		struct stat st;
+
+		fsd_malloc( self, slurmdrmaa_shcache_t );
+		self->base = MAP_FAILED;
+		self->path = fsd_asprintf( "%s/slurm_drmaa.%u.cache", cache_dir, (unsigned)getuid() );
+
+		fd = open( self->path, O_RDWR );
+		if( fd == -1  &&  errno == ENOENT )
+		 {
+			slurmdrmaa_shcache_create( self->path );
+			fd = open( self->path, O_RDWR );
+		 }
+		if( fd == -1 )
+			fsd_exc_raise_sys( 0 );
+		if( fstat( fd, &st ) == -1 )
+			fsd_exc_raise_sys( 0 );
+		if( st.st_uid != getuid() )
+			fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR,
+					"shared cache %s: not owned by user", self->path );
+
+		self->size = (size_t)st.st_size;
+		if( self->size >= sizeof(slurmdrmaa_shcache_slot_t) )
+			self->base = mmap( NULL, self->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+		if( self->base == MAP_FAILED )
+			fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR,
+					"shared cache %s: cannot map", self->path );
+
+		/* header occupies place of first slot */
+		header = (const slurmdrmaa_shcache_header_t*)self->base;
+		if( memcmp( header->magic, SLURMDRMAA_SHCACHE_MAGIC, sizeof(SLURMDRMAA_SHCACHE_MAGIC) )
+				||  header->version != SLURMDRMAA_SHCACHE_VERSION
+				||  header->n_slots == 0
+				||  (header->n_slots & (header->n_slots - 1)) != 0
+				||  self->size < sizeof(slurmdrmaa_shcache_slot_t) * ((size_t)header->n_slots + 1) )
+			fsd_exc_raise_fmt( FSD_ERRNO_INTERNAL_ERROR,
+					"shared cache %s: not a cache or unsupported version", self->path );
+		self->slots = (slurmdrmaa_shcache_slot_t*)self->base + 1;
+		self->mask = header->n_slots - 1;
+	 }
+	EXCEPT_DEFAULT
+	 {
+		if( self )
+			slurmdrmaa_shcache_close( self );
+		fsd_exc_reraise();
+	 }
+	FINALLY
+	 {
+		if( fd != -1 )
+			close( fd );
+	 }
+	END_TRY
+
+	fsd_log_return(( " =%p", (void*)self ));
+	return self;
+}
+
+
+void
+slurmdrmaa_shcache_close( slurmdrmaa_shcache_t *self )
+{
+	if( self->base != MAP_FAILED )
+		munmap( self->base, self->size );
+	fsd_free( self->path );
+	fsd_free( self );
+}
+
+
+bool
+slurmdrmaa_shcache_lookup( slurmdrmaa_shcache_t *self, const char *job_id,
+		int *state, int *exit_status, time_t *update_time )
+{
+	uint32_t h = slurmdrmaa_shcache_hash( job_id );
+	bool found = false;
+	int probe;
+
+	if( strlen( job_id ) >= SLURMDRMAA_SHCACHE_ID_LEN )
+		return false;
+
+	/* racing writers may have left older copy in other slot - take freshest */
+	for( probe = 0;  probe < SLURMDRMAA_SHCACHE_MAX_PROBE;  probe++ )
+	 {
+		slurmdrmaa_shcache_slot_t copy;
+		if( !slurmdrmaa_shcache_read_slot( &self->slots[(h + probe) & self->mask], &copy ) )
+			continue;
+		if( copy.hash == 0 )
+			break;
+		if( copy.hash == h  &&  !strncmp( copy.job_id, job_id, SLURMDRMAA_SHCACHE_ID_LEN )
+				&&  (!found  ||  copy.update_time > *update_time) )
+		 {
+			*state = copy.state;
+			*exit_status = copy.exit_status;
+			*update_time = (time_t)copy.update_time;
+			found = true;
+		 }
+	 }
+	return found;
+}
+
+
+void
+slurmdrmaa_shcache_publish( slurmdrmaa_shcache_t *self, const char *job_id,
+		int state, int exit_status, time_t update_time )
+{
+	uint32_t h = slurmdrmaa_shcache_hash( job_id );
+	slurmdrmaa_shcache_slot_t *target = NULL;
+	slurmdrmaa_shcache_slot_t *oldest = NULL;
+	int64_t oldest_time = INT64_MAX;
+	uint32_t seq;
+	int probe;
+
+	if( strlen( job_id ) >= SLURMDRMAA_SHCACHE_ID_LEN )
+		return;
+
+	for( probe = 0;  probe < SLURMDRMAA_SHCACHE_MAX_PROBE;  probe++ )
+	 {
+		slurmdrmaa_shcache_slot_t *slot = &self->slots[(h + probe) & self->mask];
+		slurmdrmaa_shcache_slot_t copy;
+		if( !slurmdrmaa_shcache_read_slot( slot, &copy ) )
+		 {
+			if( slurmdrmaa_shcache_abandoned( slot ) )
+			 { /* garbage - reuse it (lookup takes freshest copy of job) */
+				target = slot;
+				break;
+			 }
+			continue;
+		 }
+		if( copy.hash == 0
+				||  (copy.hash == h  &&  !strncmp( copy.job_id, job_id, SLURMDRMAA_SHCACHE_ID_LEN )) )
+		 {
+			if( copy.hash != 0  &&  copy.update_time > (int64_t)update_time )
+				return;
+			target = slot;
+			break;
+		 }
+		if( copy.update_time < oldest_time )
+		 {
+			oldest = slot;
+			oldest_time = copy.update_time;
+		 }
+	 }
+	if( target == NULL )
+		target = oldest; /* evict least recently refreshed job */
+	if( target == NULL )
+		return;
+
+	if( !slurmdrmaa_shcache_claim( target ) )
+		return;
+	seq = target->seq;
+	target->hash = h;
+	target->state = state;
+	target->exit_status = exit_status;
+	target->update_time = update_time;
+	memcpy( target->job_id, job_id, strlen(job_id) + 1 );
+	__sync_synchronize();
+	target->seq = seq + 1;
+	__sync_synchronize();
+	target->owner = 0;
+}
@@ -0,0 +1,57 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SLURM_DRMAA__SHCACHE_H
+#define __SLURM_DRMAA__SHCACHE_H
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <time.h>
+
+#include <drmaa_utils/common.h>
+
+typedef struct slurmdrmaa_shcache_s slurmdrmaa_shcache_t;
+
+/*
+ * Job state cache shared by all processes of user
+ * (<cache_dir>/slurm_drmaa.<uid>.cache).  Fixed size open addressing
+ * hash table in shared memory keyed by job id.  Every slot is guarded
+ * by its own sequence counter: readers never block, writer which finds
+ * slot busy skips publishing (cache is best effort).  Slot left busy
+ * by writer which died is taken over by next writer.
+ */
+slurmdrmaa_shcache_t *slurmdrmaa_shcache_open( const char *cache_dir );
+
+void slurmdrmaa_shcache_close( slurmdrmaa_shcache_t *self );
+
+/*
+ * Publish state of job observed at update_time (older data never replaces
+ * newer).  Only states which every session sees the same should be
+ * published (not ones derived from data of publishing session).
+ */
+void slurmdrmaa_shcache_publish( slurmdrmaa_shcache_t *self, const char *job_id,
+		int state, int exit_status, time_t update_time );
+
+/* Freshest published state of job.  Returns false when job is not in cache. */
+bool slurmdrmaa_shcache_lookup( slurmdrmaa_shcache_t *self, const char *job_id,
+		int *state, int *exit_status, time_t *update_time );
+
+#endif /* __SLURM_DRMAA__SHCACHE_H */
@@ -0,0 +1,305 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Rate limit, retries and circuit breaker of slurmctld RPCs
+ * (admission.c) exercised through DRMAA API against stand-in libslurm.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <drmaa_utils/drmaa.h>
+#include <slurm/slurm.h>
+
+#include "slurm_stub.h"
+
+#define RETRIES 3
+#define BREAKER_THRESHOLD 6
+#define BREAKER_COOLDOWN 300 /* ms */
+#define RATE 20 /* RPCs per second */
+
+static const char *configuration =
+	"pool_delay: 1,\n"
+	"rpc_retries: 3,\n"
+	"rpc_backoff_initial: 1,\n"
+	"rpc_backoff_max: 2,\n"
+	"rpc_breaker_threshold: 6,\n"
+	"rpc_breaker_cooldown: 300,\n";
+
+static const char *rate_limited_configuration =
+	"pool_delay: 1,\n"
+	"rpc_rate_limit: 20,\n"
+	"rpc_burst: 1,\n";
+
+static char errmsg[DRMAA_ERROR_STRING_BUFFER];
+
+
+static int
+run_job( char *job_id, size_t job_id_len )
+{
+	drmaa_job_template_t *jt = NULL;
+	int rc;
+
+	rc = drmaa_allocate_job_template( &jt, errmsg, sizeof(errmsg) );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	rc = drmaa_set_attribute( jt, DRMAA_REMOTE_COMMAND, "/bin/true", errmsg, sizeof(errmsg) );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	rc = drmaa_run_job( job_id, job_id_len, jt, errmsg, sizeof(errmsg) );
+	drmaa_delete_job_template( jt, NULL, 0 );
+	return rc;
+}
+
+
+static unsigned long
+submit_calls( void )
+{
+	return slurm_stub_calls( "slurm_submit_batch_job" );
+}
+
+
+static void
+init_session( const char *configuration )
+{
+	char conf_path[] = "/tmp/admission_test.XXXXXX";
+	FILE *conf;
+	int fd;
+	int rc;
+
+	fd = mkstemp( conf_path );
+	assert( fd >= 0 );
+	conf = fdopen( fd, "w" );
+	fputs( configuration, conf );
+	fclose( conf );
+	setenv( "SLURM_DRMAA_CONF", conf_path, 1 );
+
+	rc = drmaa_init( NULL, errmsg, sizeof(errmsg) );
+	unlink( conf_path );
+	if( rc != DRMAA_ERRNO_SUCCESS )
+		printf( "drmaa_init: %s\n", errmsg );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+}
+
+
+void test_run_and_wait(void)
+{
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	char job_id_out[DRMAA_JOBNAME_BUFFER];
+	int stat = -1, exited = 0, exit_status = -1;
+	int rc;
+
+	rc = run_job( job_id, sizeof(job_id) );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	rc = drmaa_wait( job_id, job_id_out, sizeof(job_id_out), &stat,
+			30, NULL, errmsg, sizeof(errmsg) );
+	printf( "job %s finished: rc=%d stat=%d\n", job_id_out, rc, stat );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	assert( !strcmp( job_id, job_id_out ) );
+	drmaa_wifexited( &exited, stat, NULL, 0 );
+	drmaa_wexitstatus( &exit_status, stat, NULL, 0 );
+	assert( exited  &&  exit_status == 0 );
+	printf( "test finished.\n" );
+}
+
+
+void test_transient_errors_retried(void)
+{
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	unsigned long calls = submit_calls();
+	int rc;
+
+	slurm_stub_fail_next( "slurm_submit_batch_job", 2, SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR );
+	rc = run_job( job_id, sizeof(job_id) );
+	printf( "run_job after 2 failures: rc=%d calls=%lu\n", rc, submit_calls() - calls );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	assert( submit_calls() - calls == 3 );
+	printf( "test finished.\n" );
+}
+
+
+void test_retries_exhausted(void)
+{
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	unsigned long calls = submit_calls();
+	int rc;
+
+	slurm_stub_fail_next( "slurm_submit_batch_job", RETRIES + 1, SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR );
+	rc = run_job( job_id, sizeof(job_id) );
+	printf( "run_job after %d failures: rc=%d calls=%lu: %s\n",
+			RETRIES + 1, rc, submit_calls() - calls, errmsg );
+	assert( rc != DRMAA_ERRNO_SUCCESS );
+	assert( submit_calls() - calls == RETRIES + 1 );
+
+	/* success resets count of consecutive failures */
+	rc = run_job( job_id, sizeof(job_id) );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	printf( "test finished.\n" );
+}
+
+
+void test_submit_not_repeated_after_timeout(void)
+{
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	unsigned long calls = submit_calls();
+	int rc;
+
+	/* job may have been accepted - repeating could duplicate it */
+	slurm_stub_fail_next( "slurm_submit_batch_job", 1, SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT );
+	rc = run_job( job_id, sizeof(job_id) );
+	printf( "run_job after timeout: rc=%d calls=%lu\n", rc, submit_calls() - calls );
+	assert( rc != DRMAA_ERRNO_SUCCESS );
+	assert( submit_calls() - calls == 1 );
+
+	calls = submit_calls();
+	slurm_stub_fail_next( "slurm_submit_batch_job", 1, SLURMCTLD_COMMUNICATIONS_RECEIVE_ERROR );
+	rc = run_job( job_id, sizeof(job_id) );
+	assert( rc != DRMAA_ERRNO_SUCCESS );
+	assert( submit_calls() - calls == 1 );
+	printf( "test finished.\n" );
+}
+
+
+void test_status_query_retried(void)
+{
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	unsigned long calls;
+	int remote_ps = -1;
+	int rc;
+
+	rc = run_job( job_id, sizeof(job_id) );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+
+	/* queries are idempotent - repeated also after timeout */
+	calls = slurm_stub_calls( "slurm_load_job" );
+	slurm_stub_fail_next( "slurm_load_job", 2, SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT );
+	rc = drmaa_job_ps( job_id, &remote_ps, errmsg, sizeof(errmsg) );
+	printf( "job_ps after 2 timeouts: rc=%d state=%d calls=%lu\n", rc, remote_ps,
+			slurm_stub_calls( "slurm_load_job" ) - calls );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	assert( slurm_stub_calls( "slurm_load_job" ) - calls == 3 );
+
+	calls = slurm_stub_calls( "slurm_load_job" );
+	slurm_stub_fail_next( "slurm_load_job", RETRIES + 1, SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT );
+	rc = drmaa_job_ps( job_id, &remote_ps, errmsg, sizeof(errmsg) );
+	printf( "job_ps after %d timeouts: rc=%d calls=%lu: %s\n", RETRIES + 1, rc,
+			slurm_stub_calls( "slurm_load_job" ) - calls, errmsg );
+	assert( rc != DRMAA_ERRNO_SUCCESS );
+	assert( slurm_stub_calls( "slurm_load_job" ) - calls == RETRIES + 1 );
+
+	/* success resets count of consecutive failures */
+	rc = drmaa_job_ps( job_id, &remote_ps, errmsg, sizeof(errmsg) );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	printf( "test finished.\n" );
+}
+
+
+void test_rate_limit(void)
+{
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	struct timespec start, end;
+	double elapsed;
+	int i, rc;
+
+	/* burst of 1: every next RPC waits 1/RATE s */
+	clock_gettime( CLOCK_MONOTONIC, &start );
+	for( i = 0;  i < 6;  i++ )
+	 {
+		rc = run_job( job_id, sizeof(job_id) );
+		assert( rc == DRMAA_ERRNO_SUCCESS );
+	 }
+	clock_gettime( CLOCK_MONOTONIC, &end );
+	elapsed = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf( "6 submissions at %d RPC/s: %.3f s\n", RATE, elapsed );
+	assert( elapsed >= 5.0 / RATE * 0.9 );
+	printf( "test finished.\n" );
+}
+
+
+void test_permanent_error_not_retried(void)
+{
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	unsigned long calls = submit_calls();
+	int rc;
+
+	slurm_stub_fail_next( "slurm_submit_batch_job", 1, ESLURM_INVALID_JOB_ID );
+	rc = run_job( job_id, sizeof(job_id) );
+	printf( "run_job after permanent error: rc=%d calls=%lu\n", rc, submit_calls() - calls );
+	assert( rc != DRMAA_ERRNO_SUCCESS );
+	assert( submit_calls() - calls == 1 );
+	printf( "test finished.\n" );
+}
+
+
+void test_circuit_breaker(void)
+{
+	char job_id[DRMAA_JOBNAME_BUFFER];
+	unsigned long calls = submit_calls();
+	int rc;
+
+	/* first call: RETRIES+1 failures, second one opens breaker */
+	slurm_stub_fail_next( "slurm_submit_batch_job", 1000, SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR );
+	rc = run_job( job_id, sizeof(job_id) );
+	assert( rc != DRMAA_ERRNO_SUCCESS  &&  rc != DRMAA_ERRNO_TRY_LATER );
+	rc = run_job( job_id, sizeof(job_id) );
+	assert( rc != DRMAA_ERRNO_SUCCESS );
+	assert( submit_calls() - calls == BREAKER_THRESHOLD );
+
+	calls = submit_calls();
+	rc = run_job( job_id, sizeof(job_id) );
+	printf( "run_job with open breaker: rc=%d calls=%lu: %s\n", rc, submit_calls() - calls, errmsg );
+	assert( rc == DRMAA_ERRNO_TRY_LATER );
+	assert( submit_calls() == calls );
+
+	slurm_stub_fail_next( NULL, 0, 0 );
+	usleep( 2 * BREAKER_COOLDOWN * 1000 );
+	rc = run_job( job_id, sizeof(job_id) );
+	printf( "run_job after cooldown: rc=%d calls=%lu\n", rc, submit_calls() - calls );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	assert( submit_calls() - calls == 1 );
+	printf( "test finished.\n" );
+}
+
+
+int main(void)
+{
+	int rc;
+
+	slurm_stub_reset();
+	init_session( configuration );
+	test_run_and_wait();
+	test_transient_errors_retried();
+	test_retries_exhausted();
+	test_submit_not_repeated_after_timeout();
+	test_status_query_retried();
+	test_permanent_error_not_retried();
+	test_circuit_breaker();
+	rc = drmaa_exit( errmsg, sizeof(errmsg) );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+
+	init_session( rate_limited_configuration );
+	test_rate_limit();
+	rc = drmaa_exit( errmsg, sizeof(errmsg) );
+	assert( rc == DRMAA_ERRNO_SUCCESS );
+	slurm_stub_report( stdout );
+	return 0;
+}
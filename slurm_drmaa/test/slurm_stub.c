@@ -0,0 +1,1269 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#	include <config.h>
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <slurm/slurm.h>
+
+#include "slurm_stub.h"
+
+#ifndef lint
+static char rcsid[]
+#	ifdef __GNUC__
+		__attribute__ ((unused))
+#	endif
+	= "$Id$";
+#endif
+
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(20,11,0)
+typedef slurm_conf_t slurm_stub_conf_t;
+#else
+typedef slurm_ctl_conf_t slurm_stub_conf_t;
+#endif
+
+#define SLURM_STUB_FIRST_JOB_ID 1000
+
+typedef enum {
+	STUB_SUBMIT_BATCH_JOB,
+	STUB_LOAD_JOB,
+	STUB_LOAD_JOBS,
+	STUB_LOAD_JOB_USER,
+	STUB_KILL_JOB,
+	STUB_KILL_JOB2,
+	STUB_KILL_JOBS,
+	STUB_SUSPEND,
+	STUB_RESUME,
+	STUB_SUSPEND2,
+	STUB_RESUME2,
+	STUB_UPDATE_JOB,
+	STUB_UPDATE_JOB2,
+	STUB_LOAD_CTL_CONF,
+	STUB_N_CALLS
+} slurm_stub_call_t;
+
+static const char *slurm_stub_call_names[STUB_N_CALLS] = {
+	"slurm_submit_batch_job",
+	"slurm_load_job",
+	"slurm_load_jobs",
+	"slurm_load_job_user",
+	"slurm_kill_job",
+	"slurm_kill_job2",
+	"slurm_kill_jobs",
+	"slurm_suspend",
+	"slurm_resume",
+	"slurm_suspend2",
+	"slurm_resume2",
+	"slurm_update_job",
+	"slurm_update_job2",
+	"slurm_load_ctl_conf"
+};
+
+/*
+ * Job record.  Tasks of job array occupy consecutive identifiers
+ * starting from array_job_id (first task is the array job itself).
+ * State is not stored but computed from times (in milliseconds since
+ * stub initialization) when job is queried.
+ */
+typedef struct {
+	uint32_t job_id;
+	uint32_t array_job_id;   /* 0 - not an array task */
+	uint32_t array_task_id;  /* NO_VAL - not an array task */
+	uint32_t n_tasks;        /* in array (set in first task) */
+	uint32_t user_id;
+	uint32_t group_id;
+	char *name;
+	char *comment;
+	char *wckey;
+	uint64_t submit_ms;
+	uint64_t eligible_ms;    /* of last release */
+	uint64_t suspend_ms;     /* 0 - not suspended */
+	uint64_t suspended_ms;   /* total time of finished suspensions */
+	uint64_t cancel_ms;      /* 0 - not cancelled */
+	bool held;
+	bool started;            /* before hold or cancel */
+	uint64_t start_ms;
+	bool fails;
+} slurm_stub_job_t;
+
+typedef struct {
+	uint32_t state;
+	uint32_t reason;
+	uint64_t start_ms;       /* valid when started */
+	uint64_t end_ms;         /* valid when finished */
+	bool started;
+	bool finished;
+} slurm_stub_status_t;
+
+static pthread_once_t slurm_stub_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t slurm_stub_mutex = PTHREAD_MUTEX_INITIALIZER;
+static slurm_stub_config_t slurm_stub_config;
+static unsigned slurm_stub_random;
+static struct timespec slurm_stub_epoch;
+static time_t slurm_stub_epoch_time;
+
+static slurm_stub_job_t *slurm_stub_jobs = NULL;
+static uint32_t slurm_stub_n_jobs = 0;
+static uint32_t slurm_stub_jobs_capacity = 0;
+
+static unsigned long slurm_stub_counts[STUB_N_CALLS];
+static int slurm_stub_fail_call = -1; /* STUB_N_CALLS - any */
+static unsigned slurm_stub_fail_count = 0;
+static int slurm_stub_fail_error = 0;
+
+static FILE *slurm_stub_report_file = NULL;
+
+
+static unsigned
+slurm_stub_env_unsigned( const char *name, unsigned default_value )
+{
+	const char *value = getenv( name );
+	return value != NULL && value[0] != '\0' ? (unsigned)strtoul( value, NULL, 10 ) : default_value;
+}
+
+
+static double
+slurm_stub_env_double( const char *name, double default_value )
+{
+	const char *value = getenv( name );
+	return value != NULL && value[0] != '\0' ? strtod( value, NULL ) : default_value;
+}
+
+
+static void
+slurm_stub_at_exit( void )
+{
+	slurm_stub_report( slurm_stub_report_file );
+	if( slurm_stub_report_file != stderr )
+		fclose( slurm_stub_report_file );
+	else
+		fflush( stderr );
+}
+
+
+static void
+slurm_stub_init( void )
+{
+	const char *report = getenv( "SLURM_STUB_REPORT" );
+
+	slurm_stub_config.latency_us = slurm_stub_env_unsigned( "SLURM_STUB_LATENCY_US", 0 );
+	slurm_stub_config.queue_ms = slurm_stub_env_unsigned( "SLURM_STUB_QUEUE_MS", 0 );
+	slurm_stub_config.run_ms = slurm_stub_env_unsigned( "SLURM_STUB_RUN_MS", 10 );
+	slurm_stub_config.fail_rate = slurm_stub_env_double( "SLURM_STUB_FAIL_RATE", 0 );
+	slurm_stub_config.error_rate = slurm_stub_env_double( "SLURM_STUB_ERROR_RATE", 0 );
+	slurm_stub_config.error = (int)slurm_stub_env_unsigned( "SLURM_STUB_ERROR",
+			SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR );
+	slurm_stub_config.purge_ms = slurm_stub_env_unsigned( "SLURM_STUB_PURGE_MS", 300000 );
+	slurm_stub_config.max_array_size = slurm_stub_env_unsigned( "SLURM_STUB_MAX_ARRAY_SIZE", 1001 );
+	slurm_stub_config.seed = slurm_stub_env_unsigned( "SLURM_STUB_SEED", 1 );
+	slurm_stub_random = slurm_stub_config.seed;
+
+	clock_gettime( CLOCK_MONOTONIC, &slurm_stub_epoch );
+	slurm_stub_epoch_time = time( NULL );
+
+	if( report != NULL  &&  report[0] != '\0' )
+	 {
+		if( !strcmp( report, "-" ) )
+			slurm_stub_report_file = stderr;
+		else if( (slurm_stub_report_file = fopen( report, "w" )) == NULL )
+			fprintf( stderr, "slurm_stub: could not open SLURM_STUB_REPORT=%s\n", report );
+		if( slurm_stub_report_file != NULL )
+			atexit( slurm_stub_at_exit );
+	 }
+}
+
+
+/* Milliseconds since initialization (never 0). */
+static uint64_t
+slurm_stub_now( void )
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (uint64_t)(ts.tv_sec - slurm_stub_epoch.tv_sec) * 1000
+		+ (ts.tv_nsec - slurm_stub_epoch.tv_nsec) / 1000000 + 1;
+}
+
+
+static time_t
+slurm_stub_time( uint64_t ms )
+{
+	return slurm_stub_epoch_time + (time_t)(ms / 1000);
+}
+
+
+static int
+slurm_stub_error( int error )
+{
+	errno = error;
+	return SLURM_ERROR;
+}
+
+
+/*
+ * Common part of RPCs: counts call, waits latency (without holding
+ * stub mutex) and decides whether call fails.  Returns error to fail
+ * with or 0.
+ */
+static int
+slurm_stub_rpc( slurm_stub_call_t call )
+{
+	unsigned latency_us;
+	int error = 0;
+
+	pthread_once( &slurm_stub_once, slurm_stub_init );
+	pthread_mutex_lock( &slurm_stub_mutex );
+	slurm_stub_counts[call]++;
+	latency_us = slurm_stub_config.latency_us;
+	if( slurm_stub_fail_count > 0
+			&&  (slurm_stub_fail_call == STUB_N_CALLS  ||  slurm_stub_fail_call == (int)call) )
+	 {
+		slurm_stub_fail_count--;
+		error = slurm_stub_fail_error;
+	 }
+	else if( slurm_stub_config.error_rate > 0
+			&&  rand_r( &slurm_stub_random ) / (RAND_MAX + 1.0) < slurm_stub_config.error_rate )
+		error = slurm_stub_config.error;
+	pthread_mutex_unlock( &slurm_stub_mutex );
+
+	if( latency_us > 0 )
+		usleep( latency_us );
+	return error;
+}
+
+
+/* Whether job fails - fixed for given seed and job identifier. */
+static bool
+slurm_stub_job_fails( uint32_t job_id )
+{
+	uint32_t h = (job_id ^ slurm_stub_config.seed) * 2654435761u;
+	h ^= h >> 15;
+	return (h & 0xffffff) / (double)0x1000000 < slurm_stub_config.fail_rate;
+}
+
+
+static slurm_stub_job_t *
+slurm_stub_job( uint32_t job_id )
+{
+	if( job_id < SLURM_STUB_FIRST_JOB_ID
+			||  job_id - SLURM_STUB_FIRST_JOB_ID >= slurm_stub_n_jobs )
+		return NULL;
+	return &slurm_stub_jobs[ job_id - SLURM_STUB_FIRST_JOB_ID ];
+}
+
+
+static void
+slurm_stub_status( const slurm_stub_job_t *job, uint64_t now, slurm_stub_status_t *status )
+{
+	uint64_t start_ms, end_ms;
+
+	memset( status, 0, sizeof(slurm_stub_status_t) );
+	status->reason = WAIT_NO_REASON;
+
+	if( job->started )
+		start_ms = job->start_ms;
+	else if( job->held )
+		start_ms = UINT64_MAX;
+	else
+		start_ms = job->eligible_ms + slurm_stub_config.queue_ms;
+
+	if( job->cancel_ms != 0  &&  job->cancel_ms < start_ms )
+	 {
+		status->state = JOB_CANCELLED;
+		status->finished = true;
+		status->end_ms = job->cancel_ms;
+		return;
+	 }
+	if( now < start_ms )
+	 {
+		status->state = JOB_PENDING;
+		status->reason = job->held ? WAIT_HELD_USER : WAIT_PRIORITY;
+		return;
+	 }
+
+	status->started = true;
+	status->start_ms = start_ms;
+	end_ms = start_ms + slurm_stub_config.run_ms + job->suspended_ms;
+	if( job->cancel_ms != 0  &&  job->cancel_ms < end_ms )
+	 {
+		status->state = JOB_CANCELLED;
+		status->finished = true;
+		status->end_ms = job->cancel_ms;
+	 }
+	else if( job->suspend_ms != 0 )
+		status->state = JOB_SUSPENDED;
+	else if( now < end_ms )
+		status->state = JOB_RUNNING;
+	else
+	 {
+		status->state = job->fails ? JOB_FAILED : JOB_COMPLETE;
+		status->finished = true;
+		status->end_ms = end_ms;
+	 }
+}
+
+
+static bool
+slurm_stub_purged( const slurm_stub_job_t *job, uint64_t now )
+{
+	slurm_stub_status_t status;
+	slurm_stub_status( job, now, &status );
+	return status.finished  &&  now >= status.end_ms + slurm_stub_config.purge_ms;
+}
+
+
+/* Makes started flag explicit before hold / suspend / cancel change times. */
+static void
+slurm_stub_fix_start( slurm_stub_job_t *job, uint64_t now )
+{
+	slurm_stub_status_t status;
+	slurm_stub_status( job, now, &status );
+	if( status.started  &&  !job->started )
+	 {
+		job->started = true;
+		job->start_ms = status.start_ms;
+	 }
+}
+
+
+static void
+slurm_stub_fill_info( slurm_job_info_t *info, const slurm_stub_job_t *job, uint64_t now )
+{
+	slurm_stub_status_t status;
+
+	slurm_stub_status( job, now, &status );
+	memset( info, 0, sizeof(slurm_job_info_t) );
+	info->job_id = job->job_id;
+	info->array_job_id = job->array_job_id;
+	info->array_task_id = job->array_task_id;
+	info->user_id = job->user_id;
+	info->group_id = job->group_id;
+	info->name = job->name ? strdup( job->name ) : NULL;
+	info->comment = job->comment ? strdup( job->comment ) : NULL;
+	info->wckey = job->wckey ? strdup( job->wckey ) : NULL;
+	info->job_state = status.state;
+	info->state_reason = status.reason;
+	info->priority = job->held ? 0 : 1;
+	info->submit_time = slurm_stub_time( job->submit_ms );
+	if( status.started )
+	 {
+		info->start_time = slurm_stub_time( status.start_ms );
+		info->nodes = strdup( "stub1" );
+	 }
+	if( status.finished )
+		info->end_time = slurm_stub_time( status.end_ms );
+	if( job->suspend_ms != 0 )
+		info->suspend_time = slurm_stub_time( job->suspend_ms );
+	if( status.state == JOB_FAILED )
+		info->exit_code = 1 << 8;
+	else if( status.state == JOB_CANCELLED )
+		info->exit_code = SIGKILL;
+}
+
+
+static job_info_msg_t *
+slurm_stub_new_info_msg( uint32_t n )
+{
+	job_info_msg_t *msg = calloc( 1, sizeof(job_info_msg_t) );
+	if( msg == NULL )
+		return NULL;
+	msg->last_update = time( NULL );
+	if( n > 0  &&  (msg->job_array = calloc( n, sizeof(slurm_job_info_t) )) == NULL )
+	 {
+		free( msg );
+		return NULL;
+	 }
+	return msg;
+}
+
+
+/* Number of elements of array_inx ("1-10:2,15,20-22%4") or 0 when invalid. */
+static uint32_t
+slurm_stub_array_tasks( const char *array_inx, uint32_t *tasks )
+{
+	const char *p = array_inx;
+	uint32_t n = 0;
+
+	while( *p != '\0'  &&  *p != '%' )
+	 {
+		char *end;
+		unsigned long first, last, step = 1, i;
+
+		first = strtoul( p, &end, 10 );
+		if( end == p )
+			return 0;
+		last = first;
+		p = end;
+		if( *p == '-' )
+		 {
+			last = strtoul( p + 1, &end, 10 );
+			if( end == p + 1  ||  last < first )
+				return 0;
+			p = end;
+			if( *p == ':' )
+			 {
+				step = strtoul( p + 1, &end, 10 );
+				if( end == p + 1  ||  step == 0 )
+					return 0;
+				p = end;
+			 }
+		 }
+		if( last >= slurm_stub_config.max_array_size )
+			return 0;
+		for( i = first;  i <= last;  i += step, n++ )
+			if( tasks != NULL )
+				tasks[n] = (uint32_t)i;
+		if( *p == ',' )
+			p++;
+		else if( *p != '\0'  &&  *p != '%' )
+			return 0;
+	 }
+	return n;
+}
+
+
+/*
+ * Parses "123", "123_4" and "123_[1-3,7]".  Sets @a tasks to NULL
+ * or to task part (after underscore).
+ */
+static bool
+slurm_stub_parse_spec( const char *spec, uint32_t *job_id, const char **tasks )
+{
+	char *end;
+
+	if( spec == NULL )
+		return false;
+	*job_id = (uint32_t)strtoul( spec, &end, 10 );
+	if( end == spec )
+		return false;
+	if( *end == '\0' )
+		*tasks = NULL;
+	else if( *end == '_'  &&  end[1] != '\0' )
+		*tasks = end + 1;
+	else
+		return false;
+	return true;
+}
+
+
+static bool
+slurm_stub_task_selected( const char *tasks, uint32_t task_id )
+{
+	const char *p = tasks;
+	bool list = false;
+
+	if( tasks == NULL )
+		return true;
+	if( *p == '[' )
+	 {
+		list = true;
+		p++;
+	 }
+	while( *p != '\0'  &&  *p != ']' )
+	 {
+		char *end;
+		unsigned long first, last, step = 1;
+
+		first = last = strtoul( p, &end, 10 );
+		if( end == p )
+			return false;
+		p = end;
+		if( list  &&  *p == '-' )
+		 {
+			last = strtoul( p + 1, &end, 10 );
+			p = end;
+			if( *p == ':' )
+			 {
+				step = strtoul( p + 1, &end, 10 );
+				p = end;
+				if( step == 0 )
+					step = 1;
+			 }
+		 }
+		if( task_id >= first  &&  task_id <= last  &&  (task_id - first) % step == 0 )
+			return true;
+		if( !list )
+			return false;
+		if( *p == ',' )
+			p++;
+		else if( *p != ']' )
+			return false;
+	 }
+	return false;
+}
+
+
+/*
+ * Range of records selected by job identifier (whole array for array
+ * job identifier).  Returns false when job is unknown.
+ */
+static bool
+slurm_stub_range( uint32_t job_id, uint32_t *first, uint32_t *n )
+{
+	slurm_stub_job_t *job = slurm_stub_job( job_id );
+
+	if( job == NULL )
+		return false;
+	*first = job_id;
+	*n = job->array_job_id == job_id ? job->n_tasks : 1;
+	return true;
+}
+
+
+typedef enum {
+	STUB_ACTION_KILL,
+	STUB_ACTION_SUSPEND,
+	STUB_ACTION_RESUME,
+	STUB_ACTION_HOLD,
+	STUB_ACTION_RELEASE,
+	STUB_ACTION_NONE
+} slurm_stub_action_t;
+
+
+static int
+slurm_stub_apply( slurm_stub_job_t *job, slurm_stub_action_t action, uint64_t now )
+{
+	slurm_stub_status_t status;
+
+	slurm_stub_fix_start( job, now );
+	slurm_stub_status( job, now, &status );
+	switch( action )
+	 {
+		case STUB_ACTION_KILL:
+			if( status.finished )
+				return ESLURM_ALREADY_DONE;
+			job->cancel_ms = now;
+			if( job->suspend_ms != 0 )
+			 {
+				job->suspended_ms += now - job->suspend_ms;
+				job->suspend_ms = 0;
+			 }
+			break;
+		case STUB_ACTION_SUSPEND:
+			if( status.state != JOB_RUNNING )
+				return status.finished ? ESLURM_ALREADY_DONE : ESLURM_TRANSITION_STATE_NO_UPDATE;
+			job->suspend_ms = now;
+			break;
+		case STUB_ACTION_RESUME:
+			if( status.state != JOB_SUSPENDED )
+				return status.finished ? ESLURM_ALREADY_DONE : ESLURM_TRANSITION_STATE_NO_UPDATE;
+			job->suspended_ms += now - job->suspend_ms;
+			job->suspend_ms = 0;
+			break;
+		case STUB_ACTION_HOLD:
+			if( status.state != JOB_PENDING )
+				return status.finished ? ESLURM_ALREADY_DONE : ESLURM_TRANSITION_STATE_NO_UPDATE;
+			job->held = true;
+			break;
+		case STUB_ACTION_RELEASE:
+			if( status.state != JOB_PENDING )
+				return status.finished ? ESLURM_ALREADY_DONE : ESLURM_TRANSITION_STATE_NO_UPDATE;
+			if( job->held )
+			 {
+				job->held = false;
+				job->eligible_ms = now;
+			 }
+			break;
+		case STUB_ACTION_NONE:
+			if( status.finished )
+				return ESLURM_ALREADY_DONE;
+			break;
+	 }
+	return SLURM_SUCCESS;
+}
+
+
+static void
+slurm_stub_resp_add( job_array_resp_msg_t **resp, const slurm_stub_job_t *job, int error )
+{
+	job_array_resp_msg_t *r = *resp;
+	char job_id[32];
+	uint32_t n;
+
+	if( r == NULL  &&  (r = *resp = calloc( 1, sizeof(job_array_resp_msg_t) )) == NULL )
+		return;
+	n = r->job_array_count;
+	r->job_array_id = realloc( r->job_array_id, (n+1) * sizeof(char*) );
+	r->error_code = realloc( r->error_code, (n+1) * sizeof(uint32_t) );
+	r->err_msg = realloc( r->err_msg, (n+1) * sizeof(char*) );
+	if( r->job_array_id == NULL  ||  r->error_code == NULL  ||  r->err_msg == NULL )
+		abort();
+	if( job->array_task_id != NO_VAL )
+		snprintf( job_id, sizeof(job_id), "%u_%u", job->array_job_id, job->array_task_id );
+	else
+		snprintf( job_id, sizeof(job_id), "%u", job->job_id );
+	r->job_array_id[n] = strdup( job_id );
+	r->error_code[n] = error;
+	r->err_msg[n] = strdup( slurm_strerror( error ) );
+	r->job_array_count = n + 1;
+}
+
+
+/*
+ * Applies action to jobs selected by spec.  When @a resp is given
+ * errors of array tasks are reported there (as slurmctld does)
+ * and call fails only when no job matches.
+ */
+static int
+slurm_stub_control( const char *spec, uint32_t job_id, slurm_stub_action_t action,
+		job_array_resp_msg_t **resp )
+{
+	const char *tasks = NULL;
+	uint32_t first, n, i;
+	uint64_t now;
+	int error = SLURM_SUCCESS;
+	bool any = false;
+	bool any_ok = false;
+
+	if( resp != NULL )
+		*resp = NULL;
+	if( spec != NULL  &&  !slurm_stub_parse_spec( spec, &job_id, &tasks ) )
+		return slurm_stub_error( ESLURM_INVALID_JOB_ID );
+
+	pthread_mutex_lock( &slurm_stub_mutex );
+	now = slurm_stub_now();
+	if( slurm_stub_range( job_id, &first, &n ) )
+		for( i = first;  i < first + n;  i++ )
+		 {
+			slurm_stub_job_t *job = slurm_stub_job( i );
+			int rc;
+			if( slurm_stub_purged( job, now )
+					||  !slurm_stub_task_selected( tasks, job->array_task_id ) )
+				continue;
+			any = true;
+			rc = slurm_stub_apply( job, action, now );
+			if( rc == SLURM_SUCCESS )
+				any_ok = true;
+			else if( resp != NULL  &&  job->array_task_id != NO_VAL )
+				slurm_stub_resp_add( resp, job, rc );
+			else if( error == SLURM_SUCCESS )
+				error = rc;
+		 }
+	pthread_mutex_unlock( &slurm_stub_mutex );
+
+	if( !any )
+		return slurm_stub_error( ESLURM_INVALID_JOB_ID );
+	if( error != SLURM_SUCCESS  &&  !(any_ok  &&  action == STUB_ACTION_KILL) )
+		return slurm_stub_error( error );
+	return SLURM_SUCCESS;
+}
+
+
+static int
+slurm_stub_load( job_info_msg_t **resp, uint32_t job_id, bool all, uint32_t user_id )
+{
+	job_info_msg_t *msg;
+	uint32_t first = SLURM_STUB_FIRST_JOB_ID, n = slurm_stub_n_jobs, i;
+	uint64_t now;
+	int error = SLURM_SUCCESS;
+
+	pthread_mutex_lock( &slurm_stub_mutex );
+	now = slurm_stub_now();
+	if( !all  &&  !slurm_stub_range( job_id, &first, &n ) )
+		error = ESLURM_INVALID_JOB_ID;
+	else if( (msg = slurm_stub_new_info_msg( n )) == NULL )
+		error = ENOMEM;
+	else
+	 {
+		for( i = first;  i < first + n;  i++ )
+		 {
+			const slurm_stub_job_t *job = slurm_stub_job( i );
+			if( slurm_stub_purged( job, now )
+					||  (user_id != NO_VAL  &&  job->user_id != user_id) )
+				continue;
+			slurm_stub_fill_info( &msg->job_array[ msg->record_count++ ], job, now );
+		 }
+		if( msg->record_count == 0  &&  !all )
+		 {
+			slurm_free_job_info_msg( msg );
+			error = ESLURM_INVALID_JOB_ID;
+		 }
+		else
+			*resp = msg;
+	 }
+	pthread_mutex_unlock( &slurm_stub_mutex );
+
+	return error != SLURM_SUCCESS ? slurm_stub_error( error ) : SLURM_SUCCESS;
+}
+
+
+static char *
+slurm_stub_strdup( const char *s )
+{
+	return s != NULL ? strdup( s ) : NULL;
+}
+
+
+/* ---------------------------------------------------------------------
+ * libslurm entry points
+ */
+
+void
+slurm_init_job_desc_msg( job_desc_msg_t *job_desc_msg )
+{
+	memset( job_desc_msg, 0, sizeof(job_desc_msg_t) );
+	job_desc_msg->alloc_sid = NO_VAL;
+	job_desc_msg->contiguous = NO_VAL16;
+	job_desc_msg->group_id = NO_VAL;
+	job_desc_msg->job_id = NO_VAL;
+	job_desc_msg->kill_on_node_fail = NO_VAL16;
+	job_desc_msg->priority = NO_VAL;
+	job_desc_msg->requeue = NO_VAL16;
+	job_desc_msg->time_limit = NO_VAL;
+	job_desc_msg->user_id = NO_VAL;
+	job_desc_msg->min_cpus = NO_VAL;
+	job_desc_msg->min_nodes = NO_VAL;
+	job_desc_msg->max_nodes = NO_VAL;
+	job_desc_msg->num_tasks = NO_VAL;
+}
+
+
+int
+slurm_submit_batch_job( job_desc_msg_t *job_desc_msg, submit_response_msg_t **slurm_alloc_msg )
+{
+	submit_response_msg_t *resp;
+	uint32_t *tasks = NULL;
+	uint32_t n = 1, i;
+	uint64_t now;
+	int error;
+
+	if( (error = slurm_stub_rpc( STUB_SUBMIT_BATCH_JOB )) != 0 )
+		return slurm_stub_error( error );
+	if( job_desc_msg->script == NULL  ||  job_desc_msg->script[0] == '\0' )
+		return slurm_stub_error( ESLURM_JOB_SCRIPT_MISSING );
+
+	if( job_desc_msg->array_inx != NULL )
+	 {
+		if( (n = slurm_stub_array_tasks( job_desc_msg->array_inx, NULL )) == 0 )
+			return slurm_stub_error( EINVAL );
+		if( (tasks = malloc( n * sizeof(uint32_t) )) == NULL )
+			return slurm_stub_error( ENOMEM );
+		slurm_stub_array_tasks( job_desc_msg->array_inx, tasks );
+	 }
+	if( (resp = calloc( 1, sizeof(submit_response_msg_t) )) == NULL )
+	 {
+		free( tasks );
+		return slurm_stub_error( ENOMEM );
+	 }
+
+	pthread_mutex_lock( &slurm_stub_mutex );
+	if( slurm_stub_n_jobs + n > slurm_stub_jobs_capacity )
+	 {
+		uint32_t capacity = slurm_stub_jobs_capacity ? slurm_stub_jobs_capacity : 1024;
+		slurm_stub_job_t *grown;
+		while( capacity < slurm_stub_n_jobs + n )
+			capacity *= 2;
+		grown = realloc( slurm_stub_jobs, capacity * sizeof(slurm_stub_job_t) );
+		if( grown == NULL )
+		 {
+			pthread_mutex_unlock( &slurm_stub_mutex );
+			free( resp );
+			free( tasks );
+			return slurm_stub_error( ENOMEM );
+		 }
+		slurm_stub_jobs = grown;
+		slurm_stub_jobs_capacity = capacity;
+	 }
+
+	now = slurm_stub_now();
+	resp->job_id = SLURM_STUB_FIRST_JOB_ID + slurm_stub_n_jobs;
+	for( i = 0;  i < n;  i++ )
+	 {
+		slurm_stub_job_t *job = &slurm_stub_jobs[ slurm_stub_n_jobs++ ];
+		memset( job, 0, sizeof(slurm_stub_job_t) );
+		job->job_id = resp->job_id + i;
+		job->array_job_id = tasks ? resp->job_id : 0;
+		job->array_task_id = tasks ? tasks[i] : NO_VAL;
+		job->n_tasks = tasks && i == 0 ? n : 0;
+		job->user_id = job_desc_msg->user_id != NO_VAL ? job_desc_msg->user_id : getuid();
+		job->group_id = job_desc_msg->group_id != NO_VAL ? job_desc_msg->group_id : getgid();
+		job->name = slurm_stub_strdup( job_desc_msg->name );
+		job->comment = slurm_stub_strdup( job_desc_msg->comment );
+		job->wckey = slurm_stub_strdup( job_desc_msg->wckey );
+		job->submit_ms = job->eligible_ms = now;
+		job->held = job_desc_msg->priority == 0;
+		job->fails = slurm_stub_job_fails( job->job_id );
+	 }
+	pthread_mutex_unlock( &slurm_stub_mutex );
+
+	free( tasks );
+	*slurm_alloc_msg = resp;
+	return SLURM_SUCCESS;
+}
+
+
+void
+slurm_free_submit_response_response_msg( submit_response_msg_t *msg )
+{
+	if( msg != NULL )
+	 {
+		free( msg->job_submit_user_msg );
+		free( msg );
+	 }
+}
+
+
+int
+slurm_load_job( job_info_msg_t **resp, uint32_t job_id, uint16_t show_flags )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_LOAD_JOB )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_load( resp, job_id, false, NO_VAL );
+}
+
+
+int
+slurm_load_jobs( time_t update_time, job_info_msg_t **job_info_msg_pptr, uint16_t show_flags )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_LOAD_JOBS )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_load( job_info_msg_pptr, 0, true, NO_VAL );
+}
+
+
+int
+slurm_load_job_user( job_info_msg_t **job_info_msg_pptr, uint32_t user_id, uint16_t show_flags )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_LOAD_JOB_USER )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_load( job_info_msg_pptr, 0, true, user_id );
+}
+
+
+void
+slurm_free_job_info_msg( job_info_msg_t *job_buffer_ptr )
+{
+	uint32_t i;
+
+	if( job_buffer_ptr == NULL )
+		return;
+	for( i = 0;  i < job_buffer_ptr->record_count;  i++ )
+	 {
+		slurm_job_info_t *info = &job_buffer_ptr->job_array[i];
+		free( info->name );
+		free( info->comment );
+		free( info->wckey );
+		free( info->nodes );
+	 }
+	free( job_buffer_ptr->job_array );
+	free( job_buffer_ptr );
+}
+
+
+int
+slurm_kill_job( uint32_t job_id, uint16_t signal, uint16_t flags )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_KILL_JOB )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_control( NULL, job_id, STUB_ACTION_KILL, NULL );
+}
+
+
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(17,11,0)
+int
+slurm_kill_job2( const char *job_id, uint16_t signal, uint16_t flags, const char *sibling )
+#else
+int
+slurm_kill_job2( const char *job_id, uint16_t signal, uint16_t flags )
+#endif
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_KILL_JOB2 )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_control( job_id, 0, STUB_ACTION_KILL, NULL );
+}
+
+
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(23,2,0)
+int
+slurm_kill_jobs( kill_jobs_msg_t *kill_msg, kill_jobs_resp_msg_t **resp )
+{
+	kill_jobs_resp_msg_t *r;
+	uint64_t now;
+	uint32_t i;
+	int error;
+
+	if( (error = slurm_stub_rpc( STUB_KILL_JOBS )) != 0 )
+		return slurm_stub_error( error );
+	if( (r = calloc( 1, sizeof(kill_jobs_resp_msg_t) )) == NULL )
+		return slurm_stub_error( ENOMEM );
+
+	if( kill_msg->jobs_array != NULL )
+	 { /* errors of not matching identifiers are not reported */
+		for( i = 0;  i < kill_msg->jobs_cnt;  i++ )
+			slurm_stub_control( kill_msg->jobs_array[i], 0, STUB_ACTION_KILL, NULL );
+	 }
+	else
+	 {
+		pthread_mutex_lock( &slurm_stub_mutex );
+		now = slurm_stub_now();
+		for( i = 0;  i < slurm_stub_n_jobs;  i++ )
+		 {
+			slurm_stub_job_t *job = &slurm_stub_jobs[i];
+			if( kill_msg->wckey != NULL
+					&&  (job->wckey == NULL  ||  strcmp( job->wckey, kill_msg->wckey )) )
+				continue;
+			if( kill_msg->user_id != NO_VAL  &&  job->user_id != kill_msg->user_id )
+				continue;
+			if( !slurm_stub_purged( job, now ) )
+				slurm_stub_apply( job, STUB_ACTION_KILL, now );
+		 }
+		pthread_mutex_unlock( &slurm_stub_mutex );
+	 }
+
+	*resp = r;
+	return SLURM_SUCCESS;
+}
+
+
+void
+slurm_free_kill_jobs_response_msg( kill_jobs_resp_msg_t *msg )
+{
+	uint32_t i;
+
+	if( msg == NULL )
+		return;
+	for( i = 0;  i < msg->jobs_cnt;  i++ )
+	 {
+		free( msg->job_responses[i].error_msg );
+		free( msg->job_responses[i].sibling_name );
+	 }
+	free( msg->job_responses );
+	free( msg );
+}
+#endif
+
+
+int
+slurm_suspend( uint32_t job_id )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_SUSPEND )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_control( NULL, job_id, STUB_ACTION_SUSPEND, NULL );
+}
+
+
+int
+slurm_resume( uint32_t job_id )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_RESUME )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_control( NULL, job_id, STUB_ACTION_RESUME, NULL );
+}
+
+
+int
+slurm_suspend2( char *job_id, job_array_resp_msg_t **resp )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_SUSPEND2 )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_control( job_id, 0, STUB_ACTION_SUSPEND, resp );
+}
+
+
+int
+slurm_resume2( char *job_id, job_array_resp_msg_t **resp )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_RESUME2 )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_control( job_id, 0, STUB_ACTION_RESUME, resp );
+}
+
+
+void
+slurm_free_job_array_resp( job_array_resp_msg_t *resp )
+{
+	uint32_t i;
+
+	if( resp == NULL )
+		return;
+	for( i = 0;  i < resp->job_array_count;  i++ )
+	 {
+		free( resp->job_array_id[i] );
+		free( resp->err_msg[i] );
+	 }
+	free( resp->job_array_id );
+	free( resp->error_code );
+	free( resp->err_msg );
+	free( resp );
+}
+
+
+static slurm_stub_action_t
+slurm_stub_update_action( const job_desc_msg_t *job_msg )
+{
+	if( job_msg->priority == 0 )
+		return STUB_ACTION_HOLD;
+	else if( job_msg->priority == INFINITE )
+		return STUB_ACTION_RELEASE;
+	else
+		return STUB_ACTION_NONE;
+}
+
+
+int
+slurm_update_job( job_desc_msg_t *job_msg )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_UPDATE_JOB )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_control( job_msg->job_id_str, job_msg->job_id,
+			slurm_stub_update_action( job_msg ), NULL );
+}
+
+
+int
+slurm_update_job2( job_desc_msg_t *job_msg, job_array_resp_msg_t **resp )
+{
+	int error;
+	if( (error = slurm_stub_rpc( STUB_UPDATE_JOB2 )) != 0 )
+		return slurm_stub_error( error );
+	return slurm_stub_control( job_msg->job_id_str, job_msg->job_id,
+			slurm_stub_update_action( job_msg ), resp );
+}
+
+
+int
+slurm_load_ctl_conf( time_t update_time, slurm_stub_conf_t **slurm_ctl_conf_ptr )
+{
+	slurm_stub_conf_t *conf;
+	int error;
+
+	if( (error = slurm_stub_rpc( STUB_LOAD_CTL_CONF )) != 0 )
+		return slurm_stub_error( error );
+	if( (conf = calloc( 1, sizeof(slurm_stub_conf_t) )) == NULL )
+		return slurm_stub_error( ENOMEM );
+	conf->version = strdup( "stub" );
+	pthread_mutex_lock( &slurm_stub_mutex );
+	conf->max_array_sz = slurm_stub_config.max_array_size;
+	conf->min_job_age = slurm_stub_config.purge_ms / 1000;
+	pthread_mutex_unlock( &slurm_stub_mutex );
+	*slurm_ctl_conf_ptr = conf;
+	return SLURM_SUCCESS;
+}
+
+
+void
+slurm_free_ctl_conf( slurm_stub_conf_t *slurm_ctl_conf_ptr )
+{
+	if( slurm_ctl_conf_ptr != NULL )
+	 {
+		free( slurm_ctl_conf_ptr->version );
+		free( slurm_ctl_conf_ptr->sched_params );
+		free( slurm_ctl_conf_ptr );
+	 }
+}
+
+
+#ifndef slurm_get_errno
+int
+slurm_get_errno( void )
+{
+	return errno;
+}
+#endif
+
+
+#ifndef slurm_seterrno
+void
+slurm_seterrno( int errnum )
+{
+	errno = errnum;
+}
+#endif
+
+
+char *
+slurm_strerror( int errnum )
+{
+	static char unknown[] = "Unknown error";
+
+	switch( errnum )
+	 {
+		case SLURM_SUCCESS:  return (char*)"No error";
+		case ESLURM_INVALID_JOB_ID:  return (char*)"Invalid job id specified";
+		case ESLURM_ALREADY_DONE:  return (char*)"Job/step already completing or completed";
+		case ESLURM_TRANSITION_STATE_NO_UPDATE:
+			return (char*)"Requested operation not presently supported for job";
+		case ESLURM_JOB_SCRIPT_MISSING:  return (char*)"Batch script is missing";
+		case ESLURM_ERROR_ON_DESC_TO_RECORD_COPY:
+			return (char*)"Unable to create job record, try again";
+		case SLURM_PROTOCOL_SOCKET_IMPL_TIMEOUT:  return (char*)"Socket timed out on send/recv operation";
+		case SLURM_COMMUNICATIONS_CONNECTION_ERROR:  return (char*)"Communication connection failure";
+		case SLURM_COMMUNICATIONS_SEND_ERROR:  return (char*)"Message send failure";
+		case SLURM_COMMUNICATIONS_RECEIVE_ERROR:  return (char*)"Message receive failure";
+		case SLURM_COMMUNICATIONS_SHUTDOWN_ERROR:  return (char*)"Communication shutdown failure";
+		case SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR:
+			return (char*)"Unable to contact slurm controller (connect failure)";
+		case SLURMCTLD_COMMUNICATIONS_SEND_ERROR:
+			return (char*)"Unable to contact slurm controller (send failure)";
+		case SLURMCTLD_COMMUNICATIONS_RECEIVE_ERROR:
+			return (char*)"Unable to contact slurm controller (receive failure)";
+		case SLURMCTLD_COMMUNICATIONS_SHUTDOWN_ERROR:
+			return (char*)"Unable to contact slurm controller (shutdown failure)";
+		default:
+			if( errnum > 0  &&  errnum < 1000 )
+				return strerror( errnum );
+			return unknown;
+	 }
+}
+
+
+/* ---------------------------------------------------------------------
+ * stub control
+ */
+
+void
+slurm_stub_get_config( slurm_stub_config_t *config )
+{
+	pthread_once( &slurm_stub_once, slurm_stub_init );
+	pthread_mutex_lock( &slurm_stub_mutex );
+	*config = slurm_stub_config;
+	pthread_mutex_unlock( &slurm_stub_mutex );
+}
+
+
+void
+slurm_stub_set_config( const slurm_stub_config_t *config )
+{
+	pthread_once( &slurm_stub_once, slurm_stub_init );
+	pthread_mutex_lock( &slurm_stub_mutex );
+	if( config->seed != slurm_stub_config.seed )
+		slurm_stub_random = config->seed;
+	slurm_stub_config = *config;
+	pthread_mutex_unlock( &slurm_stub_mutex );
+}
+
+
+static int
+slurm_stub_call_index( const char *function )
+{
+	int i;
+	if( function == NULL )
+		return STUB_N_CALLS;
+	for( i = 0;  i < STUB_N_CALLS;  i++ )
+		if( !strcmp( slurm_stub_call_names[i], function ) )
+			return i;
+	fprintf( stderr, "slurm_stub: unknown function: %s\n", function );
+	abort();
+}
+
+
+void
+slurm_stub_fail_next( const char *function, unsigned n, int error )
+{
+	int call = slurm_stub_call_index( function );
+	pthread_once( &slurm_stub_once, slurm_stub_init );
+	pthread_mutex_lock( &slurm_stub_mutex );
+	slurm_stub_fail_call = call;
+	slurm_stub_fail_count = n;
+	slurm_stub_fail_error = error;
+	pthread_mutex_unlock( &slurm_stub_mutex );
+}
+
+
+unsigned long
+slurm_stub_calls( const char *function )
+{
+	int call = slurm_stub_call_index( function );
+	unsigned long result = 0;
+	int i;
+
+	pthread_mutex_lock( &slurm_stub_mutex );
+	if( call < STUB_N_CALLS )
+		result = slurm_stub_counts[call];
+	else
+		for( i = 0;  i < STUB_N_CALLS;  i++ )
+			result += slurm_stub_counts[i];
+	pthread_mutex_unlock( &slurm_stub_mutex );
+	return result;
+}
+
+
+unsigned long
+slurm_stub_jobs_submitted( void )
+{
+	unsigned long result;
+	pthread_mutex_lock( &slurm_stub_mutex );
+	result = slurm_stub_n_jobs;
+	pthread_mutex_unlock( &slurm_stub_mutex );
+	return result;
+}
+
+
+void
+slurm_stub_reset( void )
+{
+	uint32_t i;
+
+	pthread_once( &slurm_stub_once, slurm_stub_init );
+	pthread_mutex_lock( &slurm_stub_mutex );
+	for( i = 0;  i < slurm_stub_n_jobs;  i++ )
+	 {
+		free( slurm_stub_jobs[i].name );
+		free( slurm_stub_jobs[i].comment );
+		free( slurm_stub_jobs[i].wckey );
+	 }
+	free( slurm_stub_jobs );
+	slurm_stub_jobs = NULL;
+	slurm_stub_n_jobs = slurm_stub_jobs_capacity = 0;
+	memset( slurm_stub_counts, 0, sizeof(slurm_stub_counts) );
+	slurm_stub_fail_count = 0;
+	slurm_stub_random = slurm_stub_config.seed;
+	pthread_mutex_unlock( &slurm_stub_mutex );
+}
+
+
+void
+slurm_stub_report( FILE *stream )
+{
+	unsigned long counts[STUB_N_CALLS];
+	unsigned long n_jobs;
+	int i;
+
+	pthread_mutex_lock( &slurm_stub_mutex );
+	memcpy( counts, slurm_stub_counts, sizeof(counts) );
+	n_jobs = slurm_stub_n_jobs;
+	pthread_mutex_unlock( &slurm_stub_mutex );
+
+	fprintf( stream, "slurm_stub: jobs %lu\n", n_jobs );
+	for( i = 0;  i < STUB_N_CALLS;  i++ )
+		if( counts[i] > 0 )
+			fprintf( stream, "slurm_stub: %s %lu\n", slurm_stub_call_names[i], counts[i] );
+}
@@ -0,0 +1,87 @@
+/* $Id$ */
+/*
+ * PSNC DRMAA for SLURM
+ * Copyright (C) 2011 Poznan Supercomputing and Networking Center
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SLURM_DRMAA__SLURM_STUB_H
+#define __SLURM_DRMAA__SLURM_STUB_H
+
+/*
+ * Stand-in for libslurm used by tests and benchmarks (test only - never
+ * installed).  It implements libslurm entry points used by slurm_drmaa
+ * on top of in-memory job table with simulated job lifecycle:
+ *
+ *   pending (queue_ms) -> running (run_ms) -> completed or failed
+ *                                            (fail_rate of jobs)
+ *
+ * with holding, suspending and cancelling of jobs and purging records
+ * of finished jobs after purge_ms.  Every call is counted and every RPC
+ * (call which would talk to slurmctld) takes latency_us and fails with
+ * error with probability error_rate.  Behaviour is deterministic for
+ * given seed (as long as calls are made from one thread).
+ *
+ * Programs linked with libdrmaa.la and libslurm_stub.la get stub
+ * functions instead of libslurm ones (stub object is linked into
+ * executable so its symbols take precedence).  Program must reference
+ * some slurm_stub_* function to pull stub object in.
+ *
+ * Configuration is read from environment at first call:
+ *   SLURM_STUB_LATENCY_US, SLURM_STUB_QUEUE_MS, SLURM_STUB_RUN_MS,
+ *   SLURM_STUB_FAIL_RATE, SLURM_STUB_ERROR_RATE, SLURM_STUB_ERROR,
+ *   SLURM_STUB_PURGE_MS, SLURM_STUB_MAX_ARRAY_SIZE, SLURM_STUB_SEED
+ * and SLURM_STUB_REPORT - file (or "-" for standard error) to write
+ * call counts to at exit.
+ */
+
+#include <stdio.h>
+
+typedef struct slurm_stub_config_s {
+	unsigned latency_us;     /* of every RPC (default 0) */
+	unsigned queue_ms;       /* pending time of released job (default 0) */
+	unsigned run_ms;         /* running time (default 10) */
+	double fail_rate;        /* fraction of jobs exiting with 1 (default 0) */
+	double error_rate;       /* fraction of failing RPCs (default 0) */
+	int error;               /* errno of failing RPCs
+	                            (default SLURMCTLD_COMMUNICATIONS_CONNECTION_ERROR) */
+	unsigned purge_ms;       /* record of finished job kept for (default 300000) */
+	unsigned max_array_size; /* MaxArraySize (default 1001) */
+	unsigned seed;           /* of pseudo random decisions (default 1) */
+} slurm_stub_config_t;
+
+void slurm_stub_get_config( slurm_stub_config_t *config );
+
+void slurm_stub_set_config( const slurm_stub_config_t *config );
+
+/*
+ * Fail next @a n RPCs of @a function (e.g. "slurm_submit_batch_job",
+ * @c NULL - any function) with @a error, regardless of error_rate.
+ */
+void slurm_stub_fail_next( const char *function, unsigned n, int error );
+
+/* Number of calls of @a function (@c NULL - of all RPCs). */
+unsigned long slurm_stub_calls( const char *function );
+
+/* Number of jobs (array tasks) submitted so far. */
+unsigned long slurm_stub_jobs_submitted( void );
+
+/* Forget all jobs, counters and pending failures. */
+void slurm_stub_reset( void );
+
+/* Write call counts. */
+void slurm_stub_report( FILE *stream );
+
+#endif /* __SLURM_DRMAA__SLURM_STUB_H */
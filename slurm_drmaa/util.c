@@ -19,6 +19,7 @@
 #include <drmaa_utils/common.h>
 #include <drmaa_utils/exception.h>
 #include <slurm_drmaa/util.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include <time.h>
@@ -137,6 +138,185 @@ enum slurm_native {
 	SLURM_NATIVE_DEPENDENCY
 };
 
+bool
+slurmdrmaa_parse_array_job_id(const char *job_id, uint32_t *array_job_id, uint32_t *task_id)
+{
+	const char *sep = strchr(job_id, '_');
+	char *end = NULL;
+
+	if (sep == NULL)
+		return false;
+
+	*array_job_id = (uint32_t)strtoul(job_id, &end, 10);
+	if (end != sep || end == job_id)
+		fsd_exc_raise_fmt(FSD_DRMAA_ERRNO_INVALID_JOB, "invalid job id: %s", job_id);
+
+	*task_id = (uint32_t)strtoul(sep + 1, &end, 10);
+	if (*end != '\0' || end == sep + 1)
+		fsd_exc_raise_fmt(FSD_DRMAA_ERRNO_INVALID_JOB, "invalid job id: %s", job_id);
+
+	return true;
+}
+
+bool
+slurmdrmaa_array_task_str_foreach(const char *task_str,
+		bool (*fn)(uint32_t first, uint32_t last, uint32_t step, void *arg), void *arg)
+{
+	const char *p = task_str;
+
+	if (task_str == NULL)
+		return false;
+
+	while (*p != '\0' && *p != '%') {
+		char *end = NULL;
+		unsigned long first, last, step = 1;
+
+		if (*p == '[')
+			p++;
+		first = last = strtoul(p, &end, 10);
+		if (end == p)
+			break;
+		p = end;
+		if (*p == '-') {
+			last = strtoul(p + 1, &end, 10);
+			p = end;
+		}
+		if (*p == ':') {
+			step = strtoul(p + 1, &end, 10);
+			p = end;
+		}
+		if (step != 0 && fn(first, last, step, arg))
+			return true;
+		if (*p == ']')
+			p++;
+		if (*p == ',')
+			p++;
+		else
+			break;
+	}
+
+	return false;
+}
+
+static bool
+slurmdrmaa_range_contains(uint32_t first, uint32_t last, uint32_t step, void *arg)
+{
+	uint32_t task_id = *(uint32_t*)arg;
+	return task_id >= first && task_id <= last && (task_id - first) % step == 0;
+}
+
+bool
+slurmdrmaa_array_task_str_contains(const char *task_str, uint32_t task_id)
+{
+	return slurmdrmaa_array_task_str_foreach(task_str, slurmdrmaa_range_contains, &task_id);
+}
+
+slurm_job_info_t *
+slurmdrmaa_find_job_info(job_info_msg_t *job_info, const char *job_id)
+{
+	uint32_t array_job_id, task_id;
+	unsigned i;
+
+	if (job_info == NULL || job_info->record_count == 0)
+		return NULL;
+
+	if (!slurmdrmaa_parse_array_job_id(job_id, &array_job_id, &task_id))
+		return &job_info->job_array[0];
+
+	/* task which already got its own record */
+	for (i = 0; i < job_info->record_count; i++) {
+		slurm_job_info_t *info = &job_info->job_array[i];
+		if (info->array_job_id == array_job_id && info->array_task_id == task_id)
+			return info;
+	}
+
+	/* pending tasks are still described by single (meta) record */
+	for (i = 0; i < job_info->record_count; i++) {
+		slurm_job_info_t *info = &job_info->job_array[i];
+		if (info->array_job_id == array_job_id && info->array_task_id == NO_VAL
+				&& slurmdrmaa_array_task_str_contains(info->array_task_str, task_id))
+			return info;
+	}
+
+	return NULL;
+}
+
+static uint32_t
+slurmdrmaa_job_info_base_id(const slurm_job_info_t *info)
+{
+	return info->array_job_id ? info->array_job_id : info->job_id;
+}
+
+static int
+slurmdrmaa_job_info_compare(uint32_t job_id, uint32_t task_id, const slurm_job_info_t *info)
+{
+	uint32_t base_id = slurmdrmaa_job_info_base_id(info);
+
+	if (job_id != base_id)
+		return job_id < base_id ? -1 : 1;
+	if (task_id != info->array_task_id)
+		return task_id < info->array_task_id ? -1 : 1;
+	return 0;
+}
+
+static int
+slurmdrmaa_job_info_sort_cmp(const void *a, const void *b)
+{
+	const slurm_job_info_t *info = *(const slurm_job_info_t *const *)a;
+	return slurmdrmaa_job_info_compare(slurmdrmaa_job_info_base_id(info),
+			info->array_task_id, *(const slurm_job_info_t *const *)b);
+}
+
+static slurm_job_info_t *
+slurmdrmaa_job_info_bsearch(slurm_job_info_t **index, uint32_t count, uint32_t job_id, uint32_t task_id)
+{
+	uint32_t lo = 0, hi = count;
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		int cmp = slurmdrmaa_job_info_compare(job_id, task_id, index[mid]);
+		if (cmp == 0)
+			return index[mid];
+		else if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return NULL;
+}
+
+slurm_job_info_t **
+slurmdrmaa_index_job_info(job_info_msg_t *job_info)
+{
+	slurm_job_info_t **index = NULL;
+	uint32_t i;
+
+	fsd_calloc(index, job_info->record_count + 1, slurm_job_info_t*);
+	for (i = 0; i < job_info->record_count; i++)
+		index[i] = &job_info->job_array[i];
+	qsort(index, job_info->record_count, sizeof(slurm_job_info_t*), slurmdrmaa_job_info_sort_cmp);
+	return index;
+}
+
+slurm_job_info_t *
+slurmdrmaa_lookup_job_info(slurm_job_info_t **index, uint32_t count, const char *job_id)
+{
+	uint32_t array_job_id, task_id;
+	slurm_job_info_t *info;
+
+	if (!slurmdrmaa_parse_array_job_id(job_id, &array_job_id, &task_id))
+		return slurmdrmaa_job_info_bsearch(index, count, (uint32_t)strtoul(job_id, NULL, 10), NO_VAL);
+
+	info = slurmdrmaa_job_info_bsearch(index, count, array_job_id, task_id);
+	if (info == NULL) {
+		/* pending tasks are still described by single (meta) record */
+		info = slurmdrmaa_job_info_bsearch(index, count, array_job_id, NO_VAL);
+		if (info != NULL && !slurmdrmaa_array_task_str_contains(info->array_task_str, task_id))
+			info = NULL;
+	}
+	return info;
+}
+
 void
 slurmdrmaa_init_job_desc(job_desc_msg_t *job_desc)
 {
@@ -166,6 +346,7 @@ slurmdrmaa_free_job_desc(job_desc_msg_t *job_desc)
 	fsd_free(job_desc->std_out);
 	fsd_free(job_desc->std_err);	
 	fsd_free(job_desc->work_dir);
+	fsd_free(job_desc->wckey);
 	fsd_free(job_desc->exc_nodes);
 #if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(18,0,8)
 	fsd_free(job_desc->tres_per_node);
@@ -579,3 +760,15 @@ slurmdrmaa_parse_native(job_desc_msg_t *job_desc, const char * value)
 	fsd_log_return(( "" ));
 }
 
+
+
+slurmdrmaa_metrics_t slurmdrmaa_metrics = { -1, -1, -1, -1 };
+
+void
+slurmdrmaa_metrics_register(void)
+{
+	slurmdrmaa_metrics.load_job = fsd_metric_register( "slurm_load_job_us", FSD_METRIC_HISTOGRAM );
+	slurmdrmaa_metrics.load_job_user = fsd_metric_register( "slurm_load_job_user_us", FSD_METRIC_HISTOGRAM );
+	slurmdrmaa_metrics.submit_batch_job = fsd_metric_register( "slurm_submit_batch_job_us", FSD_METRIC_HISTOGRAM );
+	slurmdrmaa_metrics.control = fsd_metric_register( "slurm_control_us", FSD_METRIC_HISTOGRAM );
+}
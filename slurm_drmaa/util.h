@@ -24,6 +24,8 @@
 #	include <config.h>
 #endif
 
+#include <drmaa_utils/metrics.h>
+
 #include <slurm/slurm.h>
 
 /* Parse time to minutes */
@@ -33,4 +35,44 @@ void slurmdrmaa_init_job_desc(job_desc_msg_t *job_desc);
 void slurmdrmaa_free_job_desc(job_desc_msg_t *job_desc);
 void slurmdrmaa_parse_native(job_desc_msg_t *job_desc, const char * value);
 
+/*
+ * Split job identifier of array task (<array_job_id>_<task_id>).
+ * Returns false for plain numeric job identifiers.
+ */
+bool slurmdrmaa_parse_array_job_id(const char *job_id, uint32_t *array_job_id, uint32_t *task_id);
+
+/* Check whether task id belongs to array_task_str (e.g. "1-9:2,15%4") */
+bool slurmdrmaa_array_task_str_contains(const char *task_str, uint32_t task_id);
+
+/*
+ * Call fn for every range of array_task_str until it returns true.
+ * Returns true if stopped by fn.
+ */
+bool slurmdrmaa_array_task_str_foreach(const char *task_str,
+		bool (*fn)(uint32_t first, uint32_t last, uint32_t step, void *arg), void *arg);
+
+/* Find record describing given job (or array task) in slurm_load_job() response */
+slurm_job_info_t *slurmdrmaa_find_job_info(job_info_msg_t *job_info, const char *job_id);
+
+/*
+ * Build index of slurm_load_job_user() response (sorted by job id and task id)
+ * for looking up many jobs at once.  Free with fsd_free().
+ */
+slurm_job_info_t **slurmdrmaa_index_job_info(job_info_msg_t *job_info);
+
+/* Same as slurmdrmaa_find_job_info() but on index returned by slurmdrmaa_index_job_info() */
+slurm_job_info_t *slurmdrmaa_lookup_job_info(slurm_job_info_t **index, uint32_t count, const char *job_id);
+
+/* latency histograms [us] of slurmctld RPCs (-1 until registered) */
+typedef struct {
+	int load_job;
+	int load_job_user;
+	int submit_batch_job;
+	int control;
+} slurmdrmaa_metrics_t;
+
+extern slurmdrmaa_metrics_t slurmdrmaa_metrics;
+
+void slurmdrmaa_metrics_register(void);
+
 #endif /* __SLURM_DRMAA__UTIL_H */